@@ -38,6 +38,12 @@ int main(int argc, char **argv)
   simit::FieldRef<double>     W  = tets.addField<double>("W");
   simit::FieldRef<double,3,3> B  = tets.addField<double,3,3>("B");
 
+  // Bulk-create the vertices and tets, laid out for locality
+  simit::MeshSetOptions options;
+  options.reorder = true;
+  std::vector<simit::ElementRef> vertRefs =
+      simit::createMeshSets(mesh, &verts, &tets, nullptr, options);
+
 
   // Compile program and bind arguments
   Program program;
@@ -52,10 +58,6 @@ int main(int argc, char **argv)
   timestep.init();
 
 
-  // Create a graph and initialize it with mesh data
-  Set points;
-  Set springs(points, points);
-
   // Take 100 time steps
   for (int i = 1; i <= 100; ++i) {
     std::cout << "timestep " << i << std::endl;
@@ -65,12 +67,10 @@ int main(int argc, char **argv)
     timestep.mapArgs();   // Move data back to this memory space
 
     // Copy the x field to the mesh and save it to an obj file
-    int vi = 0;
-    for (auto &vert : points) {
+    for (size_t vi = 0; vi < vertRefs.size(); vi++) {
       for(int ii = 0; ii < 3; ii++){
-        mesh.v[vi][ii] = x.get(vert)(ii);
+        mesh.v[vi][ii] = x.get(vertRefs[vi])(ii);
       }
-      vi++;
     }
     mesh.updateSurfVert();
     mesh.saveTetObj(std::to_string(i)+".obj");
@@ -0,0 +1,104 @@
+// Compares the stream-based mesh loaders with the parallel parser, and
+// building sets element by element with createMeshSets.
+//
+// Usage: simit-mesh-load [tetgen prefix] [repetitions] [threads]
+// The prefix defaults to apps/data/tet-dragon/dragon40k.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "graph.h"
+#include "mesh.h"
+
+using namespace std;
+using namespace simit;
+
+static size_t fileSize(const string &filename) {
+  ifstream in(filename, ios::binary | ios::ate);
+  return in.good() ? (size_t)in.tellg() : 0;
+}
+
+template <typename F>
+static double bestTime(int reps, F f) {
+  double best = 1e30;
+  for (int i=0; i < reps; ++i) {
+    auto start = chrono::high_resolution_clock::now();
+    f();
+    auto end = chrono::high_resolution_clock::now();
+    double secs = chrono::duration<double>(end - start).count();
+    best = (secs < best) ? secs : best;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  string prefix = (argc > 1) ? argv[1]
+                             : string(APPS_DATA_DIR) + "/tet-dragon/dragon40k";
+  int reps = (argc > 2) ? atoi(argv[2]) : 5;
+  unsigned threads = (argc > 3) ? atoi(argv[3]) : 0;
+
+  string nodeFile = prefix + ".node";
+  string eleFile = prefix + ".ele";
+  double mb = (fileSize(nodeFile) + fileSize(eleFile)) / (1024.0*1024.0);
+  if (mb == 0.0) {
+    cerr << "Cannot read " << prefix << ".{node,ele}" << endl;
+    return -1;
+  }
+
+  MeshVol streamMesh, parallelMesh;
+  double streamTime = bestTime(reps, [&]() {
+    streamMesh = MeshVol();
+    streamMesh.loadTet(nodeFile, eleFile);
+  });
+  double parallelTime = bestTime(reps, [&]() {
+    parallelMesh = MeshVol();
+    parallelMesh.loadTetParallel(nodeFile, eleFile, threads);
+  });
+
+  bool same = streamMesh.v == parallelMesh.v && streamMesh.e == parallelMesh.e;
+  printf("%s: %zu vertices, %zu elements, %.2f MB\n", prefix.c_str(),
+         parallelMesh.v.size(), parallelMesh.e.size(), mb);
+  printf("  loadTet          %8.2f ms %8.1f MB/s\n",
+         streamTime*1000, mb/streamTime);
+  printf("  loadTetParallel  %8.2f ms %8.1f MB/s (%.1fx)%s\n",
+         parallelTime*1000, mb/parallelTime, streamTime/parallelTime,
+         same ? "" : "  MISMATCH");
+
+  // Set construction
+  const MeshVol &mesh = parallelMesh;
+  double addTime = bestTime(reps, [&]() {
+    Set verts;
+    Set tets(verts, verts, verts, verts);
+    FieldRef<double,3> x = verts.addField<double,3>("x");
+    vector<ElementRef> refs;
+    for (auto &v : mesh.v) {
+      ElementRef vert = verts.add();
+      x.set(vert, {v[0], v[1], v[2]});
+      refs.push_back(vert);
+    }
+    for (auto &e : mesh.e) {
+      tets.add(refs[e[0]], refs[e[1]], refs[e[2]], refs[e[3]]);
+    }
+  });
+  MeshSetOptions options;
+  options.numThreads = threads;
+  double bulkTime = bestTime(reps, [&]() {
+    Set verts;
+    Set tets(verts, verts, verts, verts);
+    createMeshSets(mesh, &verts, &tets, nullptr, options);
+  });
+  options.reorder = true;
+  double reorderTime = bestTime(reps, [&]() {
+    Set verts;
+    Set tets(verts, verts, verts, verts);
+    createMeshSets(mesh, &verts, &tets, nullptr, options);
+  });
+  printf("  Set::add         %8.2f ms\n", addTime*1000);
+  printf("  createMeshSets   %8.2f ms (%.1fx)\n", bulkTime*1000,
+         addTime/bulkTime);
+  printf("    with reorder   %8.2f ms\n", reorderTime*1000);
+  return same ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Reports the bandwidth and simulated cache misses of a graph or mesh under
+// every vertex reordering heuristic, to choose one before running on it. The
+// edge orders are then compared on the vertices renumbered by the first curve
+// or connectivity heuristic, with the reuse distance histogram of the
+// endpoint gathers of each.
+//
+// Usage: simit-reorder [graph file or tetgen prefix] [hilbert bits]
+//                      [partition size] [cache KiB] [tile size]
+// Files with an extension are loaded with loadGraph; anything else is read as
+// a tetgen mesh. The input defaults to apps/data/tet-dragon/dragon40k.
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "graph_io.h"
+#include "mesh.h"
+#include "reorder.h"
+
+using namespace std;
+using namespace simit;
+
+static void report(const Set &edges, const Set &verts,
+                   const ReorderOptions &options, const CacheModel &cache) {
+  cout << verts.getSize() << " vertices, " << edges.getSize() << " edges"
+       << endl;
+  for (const OrderingReport &report :
+       compareOrderings(edges, verts, options, cache)) {
+    cout << "  " << report << endl;
+  }
+
+  ReorderOptions vertexOptions = options;
+  vertexOptions.heuristic = verts.hasSpatialField()
+                            ? ReorderHeuristic::Hilbert
+                            : ReorderHeuristic::ReverseCuthillMcKee;
+  vector<int> vertexOrdering;
+  computeVertexOrdering(edges, verts, vertexOptions, vertexOrdering);
+  cout << "edge orders after " << vertexOptions.heuristic << " (hit rate of "
+       << cache.cacheBytes / cache.lineBytes << " fully associative lines)"
+       << endl;
+  for (const OrderingReport &report :
+       compareEdgeOrders(edges, vertexOrdering, options, cache)) {
+    cout << "  " << report << endl;
+    cout << "  hit rate " << report.reuse.hitRate(cache.cacheBytes /
+                                                  cache.lineBytes) * 100.0
+         << "%, " << report.reuse << endl;
+  }
+}
+
+int main(int argc, char **argv) {
+  string input = (argc > 1) ? argv[1]
+                            : string(APPS_DATA_DIR) + "/tet-dragon/dragon40k";
+  ReorderOptions options;
+  options.hilbertBits = (argc > 2) ? atoi(argv[2]) : options.hilbertBits;
+  options.partitionSize = (argc > 3) ? atoi(argv[3]) : options.partitionSize;
+  CacheModel cache;
+  cache.cacheBytes = (argc > 4) ? atoi(argv[4]) * 1024 : cache.cacheBytes;
+  options.tileSize = (argc > 5) ? atoi(argv[5]) : options.tileSize;
+
+  size_t slash = input.find_last_of('/');
+  size_t dot = input.find_last_of('.');
+  if (dot != string::npos && (slash == string::npos || dot > slash)) {
+    Set verts;
+    Set edges(verts, verts);
+    if (loadGraph(input, &verts, &edges) < 0) {
+      return -1;
+    }
+    cout << input << ": ";
+    report(edges, verts, options, cache);
+    return 0;
+  }
+
+  MeshVol mesh;
+  if (mesh.loadTetParallel(input + ".node", input + ".ele") < 0) {
+    return -1;
+  }
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  createMeshSets(mesh, &verts, &tets);
+  cout << input << ": ";
+  report(tets, verts, options, cache);
+  return 0;
+}
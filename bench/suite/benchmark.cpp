@@ -0,0 +1,405 @@
+// simit-bench: runs the registered benchmarks and writes their times, GB/s and
+// GFLOP/s as JSON, to track performance between versions.
+//
+// Usage: simit-bench [--list] [--filter=name[,name...]]
+//                    [--sizes=small,medium,large] [--warmup=n] [--reps=n]
+//                    [--label=text] [--output=file.json]
+// Progress goes to stderr, and the JSON to stdout unless --output is given.
+// The default sizes are small and medium. simit-bench-f32 runs the same
+// benchmarks in single precision.
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "init.h"
+#include "program.h"
+#include "function.h"
+#include "types.h"
+#include "util/util.h"
+
+using namespace std;
+
+namespace simit {
+namespace bench {
+
+ostream& operator<<(ostream& os, const Size& size) {
+  switch (size) {
+    case Size::Small:
+      return os << "small";
+    case Size::Medium:
+      return os << "medium";
+    case Size::Large:
+      return os << "large";
+  }
+  return os;
+}
+
+// struct Result
+double Result::minSeconds() const {
+  return seconds.empty() ? 0.0 : *min_element(seconds.begin(), seconds.end());
+}
+
+double Result::medianSeconds() const {
+  if (seconds.empty()) {
+    return 0.0;
+  }
+  vector<double> sorted = seconds;
+  sort(sorted.begin(), sorted.end());
+  size_t mid = sorted.size() / 2;
+  return (sorted.size() % 2 == 1) ? sorted[mid]
+                                  : (sorted[mid-1] + sorted[mid]) / 2.0;
+}
+
+double Result::meanSeconds() const {
+  double sum = 0.0;
+  for (double s : seconds) {
+    sum += s;
+  }
+  return seconds.empty() ? 0.0 : sum / seconds.size();
+}
+
+// class State
+static double timeSeconds(const function<void()> &body) {
+  auto begin = chrono::steady_clock::now();
+  body();
+  return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+void State::setInput(const string &description, size_t elements) {
+  result->input = description;
+  result->elements = elements;
+}
+
+void State::setWork(double bytes, double flops) {
+  result->bytes = bytes;
+  result->flops = flops;
+}
+
+void State::setValue(const string &key, double value) {
+  result->values[key] = value;
+}
+
+void State::run(function<void()> body, function<void()> setup) {
+  for (int i=0; i < options.warmup; ++i) {
+    if (setup) {
+      setup();
+    }
+    body();
+  }
+  for (int i=0; i < options.repetitions; ++i) {
+    if (setup) {
+      setup();
+    }
+    double seconds = timeSeconds(body) - baselineSeconds;
+    result->seconds.push_back(max(seconds, 0.0));
+  }
+  baselineSeconds = 0.0;
+}
+
+void State::setBaseline(function<void()> baseline) {
+  for (int i=0; i < options.warmup; ++i) {
+    baseline();
+  }
+  vector<double> times;
+  for (int i=0; i < max(options.repetitions, 1); ++i) {
+    times.push_back(timeSeconds(baseline));
+  }
+  sort(times.begin(), times.end());
+  baselineSeconds = times[times.size() / 2];
+  result->values["baselineSeconds"] = baselineSeconds;
+}
+
+void State::skip(const string &reason) {
+  result->skipped = reason;
+}
+
+// Registry
+namespace {
+struct Benchmark {
+  string name;
+  BenchmarkFunction function;
+  bool sized;
+};
+
+vector<Benchmark> &registry() {
+  static vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+}
+
+int registerBenchmark(const string &name, BenchmarkFunction function,
+                      bool sized) {
+  registry().push_back({name, function, sized});
+  return (int)registry().size();
+}
+
+vector<string> getBenchmarkNames() {
+  vector<Benchmark> benchmarks = registry();
+  sort(benchmarks.begin(), benchmarks.end(),
+       [](const Benchmark &a, const Benchmark &b) {return a.name < b.name;});
+  vector<string> names;
+  for (const Benchmark &benchmark : benchmarks) {
+    names.push_back(benchmark.name);
+  }
+  return names;
+}
+
+static bool selected(const string &name, const vector<string> &filters) {
+  if (filters.empty()) {
+    return true;
+  }
+  for (const string &filter : filters) {
+    if (name.find(filter) != string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+vector<Result> runBenchmarks(const Options &options, ostream *progress) {
+  vector<Benchmark> benchmarks = registry();
+  sort(benchmarks.begin(), benchmarks.end(),
+       [](const Benchmark &a, const Benchmark &b) {return a.name < b.name;});
+
+  vector<Result> results;
+  for (const Benchmark &benchmark : benchmarks) {
+    if (!selected(benchmark.name, options.filters)) {
+      continue;
+    }
+    vector<Size> sizes = benchmark.sized ? options.sizes
+                                         : vector<Size>({Size::Small});
+    for (Size size : sizes) {
+      Result result;
+      result.name = benchmark.name;
+      result.size = size;
+      result.sized = benchmark.sized;
+      result.elements = 0;
+      result.bytes = 0.0;
+      result.flops = 0.0;
+
+      State state(options, &result);
+      benchmark.function(state);
+
+      if (progress != nullptr) {
+        *progress << left << setw(24) << benchmark.name;
+        if (benchmark.sized) {
+          *progress << setw(8) << util::toString(size);
+        }
+        else {
+          *progress << setw(8) << "";
+        }
+        if (!result.skipped.empty()) {
+          *progress << "skipped: " << result.skipped << endl;
+        }
+        else {
+          double median = result.medianSeconds();
+          *progress << right << fixed << setprecision(3) << setw(10)
+                    << median*1000.0 << " ms";
+          if (result.bytes > 0.0 && median > 0.0) {
+            *progress << setw(9) << result.bytes / median / 1e9 << " GB/s";
+          }
+          if (result.flops > 0.0 && median > 0.0) {
+            *progress << setw(9) << result.flops / median / 1e9 << " GFLOP/s";
+          }
+          *progress << "  " << result.input << endl;
+          progress->unsetf(ios::floatfield);
+        }
+      }
+      results.push_back(result);
+    }
+  }
+  return results;
+}
+
+static void writeJSONString(ostream &os, const string &str) {
+  os << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    }
+    else if (c == '\n') {
+      os << "\\n";
+    }
+    else {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+void writeJSON(ostream &os, const vector<Result> &results,
+               const string &label) {
+  time_t now = time(nullptr);
+  char date[32];
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  os << setprecision(9);
+  os << "{\n  \"version\": ";
+  writeJSONString(os, SIMIT_BENCH_VERSION);
+  os << ",\n  \"label\": ";
+  writeJSONString(os, label);
+  os << ",\n  \"date\": \"" << date << "\""
+     << ",\n  \"floatBytes\": " << ir::ScalarType::floatBytes
+     << ",\n  \"hardwareThreads\": " << thread::hardware_concurrency()
+     << ",\n  \"benchmarks\": [";
+  for (size_t i=0; i < results.size(); ++i) {
+    const Result &result = results[i];
+    os << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+    writeJSONString(os, result.name);
+    os << ", \"size\": ";
+    writeJSONString(os, result.sized ? util::toString(result.size) : "");
+    os << ", \"input\": ";
+    writeJSONString(os, result.input);
+    os << ", \"elements\": " << result.elements;
+    if (!result.skipped.empty()) {
+      os << ", \"skipped\": ";
+      writeJSONString(os, result.skipped);
+      os << "}";
+      continue;
+    }
+    const double median = result.medianSeconds();
+    os << ",\n     \"repetitions\": " << result.seconds.size()
+       << ", \"seconds\": {\"min\": " << result.minSeconds()
+       << ", \"median\": " << median
+       << ", \"mean\": " << result.meanSeconds() << ", \"all\": [";
+    for (size_t r=0; r < result.seconds.size(); ++r) {
+      os << (r == 0 ? "" : ", ") << result.seconds[r];
+    }
+    os << "]},\n     \"bytes\": " << result.bytes
+       << ", \"flops\": " << result.flops
+       << ", \"gbPerSecond\": "
+       << ((median > 0.0) ? result.bytes / median / 1e9 : 0.0)
+       << ", \"gflopPerSecond\": "
+       << ((median > 0.0) ? result.flops / median / 1e9 : 0.0);
+    os << ", \"values\": {";
+    bool first = true;
+    for (auto &value : result.values) {
+      os << (first ? "" : ", ");
+      writeJSONString(os, value.first);
+      os << ": " << value.second;
+      first = false;
+    }
+    os << "}}";
+  }
+  os << "\n  ]\n}" << endl;
+}
+
+string readFile(const string &filename) {
+  ifstream in(filename);
+  if (!in.good()) {
+    return "";
+  }
+  stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+bool compileProgram(State &state, const string &source,
+                    const string &function, Function *compiled) {
+  if (source.empty()) {
+    state.skip("missing program source");
+    return false;
+  }
+  Program program;
+  if (program.loadString(source) != 0) {
+    state.skip(program.getDiagnostics().getMessage());
+    return false;
+  }
+  *compiled = program.compile(function);
+  if (!compiled->defined()) {
+    state.skip("cannot compile " + function);
+    return false;
+  }
+  return true;
+}
+
+}}
+
+using namespace simit::bench;
+
+static bool parseSize(const string &name, Size *size) {
+  if (name == "small") {
+    *size = Size::Small;
+  }
+  else if (name == "medium") {
+    *size = Size::Medium;
+  }
+  else if (name == "large") {
+    *size = Size::Large;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  options.sizes = {Size::Small, Size::Medium};
+  string label;
+  string output;
+
+  for (int i=1; i < argc; ++i) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    string key = arg.substr(0, eq);
+    string value = (eq != string::npos) ? arg.substr(eq+1) : "";
+    if (key == "--list") {
+      for (const string &name : getBenchmarkNames()) {
+        cout << name << endl;
+      }
+      return 0;
+    }
+    else if (key == "--filter") {
+      options.filters = simit::util::split(value, ",");
+    }
+    else if (key == "--sizes") {
+      options.sizes.clear();
+      for (const string &name : simit::util::split(value, ",")) {
+        Size size;
+        if (!parseSize(name, &size)) {
+          cerr << "Unknown size: " << name << endl;
+          return 1;
+        }
+        options.sizes.push_back(size);
+      }
+    }
+    else if (key == "--warmup") {
+      options.warmup = atoi(value.c_str());
+    }
+    else if (key == "--reps") {
+      options.repetitions = max(atoi(value.c_str()), 1);
+    }
+    else if (key == "--label") {
+      label = value;
+    }
+    else if (key == "--output") {
+      output = value;
+    }
+    else {
+      cerr << "Unrecognized arg: " << arg << endl;
+      return 1;
+    }
+  }
+
+  simit::init("cpu", sizeof(simit_float));
+  vector<Result> results = runBenchmarks(options, &cerr);
+
+  if (output.empty()) {
+    writeJSON(cout, results, label);
+  }
+  else {
+    ofstream out(output);
+    writeJSON(out, results, label);
+  }
+  return 0;
+}
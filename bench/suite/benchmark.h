@@ -0,0 +1,157 @@
+#ifndef SIMIT_BENCHMARK_H
+#define SIMIT_BENCHMARK_H
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef F32
+typedef float simit_float;
+#else
+typedef double simit_float;
+#endif
+
+namespace simit {
+class Program;
+class Function;
+
+namespace bench {
+
+/// Input size classes. Every sized benchmark runs once per selected size, on
+/// an input it generates or loads for that size.
+enum class Size {Small, Medium, Large};
+std::ostream& operator<<(std::ostream&, const Size&);
+
+/// Options of a simit-bench run.
+struct Options {
+  Options() : warmup(1), repetitions(5) {}
+
+  /// Untimed runs before the timed repetitions
+  int warmup;
+  int repetitions;
+
+  /// Run only benchmarks whose name contains one of the filters (all if
+  /// empty)
+  std::vector<std::string> filters;
+
+  /// Sizes to run sized benchmarks at
+  std::vector<Size> sizes;
+};
+
+/// Measurements of one benchmark at one size.
+struct Result {
+  std::string name;
+  Size size;
+  bool sized;
+
+  /// Description and number of elements of the input
+  std::string input;
+  size_t elements;
+
+  /// Time of every timed repetition
+  std::vector<double> seconds;
+
+  /// Bytes moved and floating-point operations in one repetition
+  double bytes;
+  double flops;
+
+  /// Other values the benchmark reports, such as iteration counts
+  std::map<std::string, double> values;
+
+  /// Why the benchmark did not run, if it did not
+  std::string skipped;
+
+  double minSeconds() const;
+  double medianSeconds() const;
+  double meanSeconds() const;
+};
+
+/// The interface of a running benchmark to the harness. A benchmark builds
+/// its input for size(), describes the work of one repetition, and then
+/// hands the code to time to run().
+class State {
+public:
+  State(const Options &options, Result *result)
+      : options(options), result(result) {}
+
+  Size size() const {return result->size;}
+
+  /// Pick a value by size.
+  template <typename T>
+  T bySize(T small, T medium, T large) const {
+    return (size() == Size::Small) ? small
+         : (size() == Size::Medium) ? medium : large;
+  }
+
+  /// Describe the input, e.g. "32x32x32 tet box", and its number of elements.
+  void setInput(const std::string &description, size_t elements);
+
+  /// Bytes moved and floating-point operations in one run of the timed code,
+  /// from which the harness reports GB/s and GFLOP/s. Bytes are compulsory
+  /// traffic: every array read or written once.
+  void setWork(double bytes, double flops);
+
+  /// Record another value.
+  void setValue(const std::string &key, double value);
+
+  /// Time `body`: run it `warmup` times untimed and then `repetitions` times
+  /// timed. `setup` runs untimed before every run of `body`.
+  void run(std::function<void()> body,
+           std::function<void()> setup=std::function<void()>());
+
+  /// Subtract the median time of `baseline` from every repetition of the
+  /// next run, for benchmarks that can only time their kernel together with
+  /// other work (e.g. assembling the matrix they multiply by).
+  void setBaseline(std::function<void()> baseline);
+
+  /// Do not run the benchmark, for the given reason (e.g. missing input).
+  void skip(const std::string &reason);
+
+private:
+  const Options &options;
+  Result *result;
+  double baselineSeconds = 0.0;
+};
+
+typedef void (*BenchmarkFunction)(State &state);
+
+/// Register a benchmark. Unsized benchmarks run once, at Size::Small.
+int registerBenchmark(const std::string &name, BenchmarkFunction function,
+                      bool sized);
+
+/// Run the registered benchmarks selected by `options`.
+std::vector<Result> runBenchmarks(const Options &options,
+                                  std::ostream *progress=nullptr);
+
+/// Names of the registered benchmarks.
+std::vector<std::string> getBenchmarkNames();
+
+/// Write results as JSON, labelled with the Simit version and `label`.
+void writeJSON(std::ostream &os, const std::vector<Result> &results,
+               const std::string &label);
+
+/// Read a whole file, or return the empty string.
+std::string readFile(const std::string &filename);
+
+/// Load `source` and compile `function` into `compiled`. Skips the benchmark
+/// and returns false if the program has errors.
+bool compileProgram(State &state, const std::string &source,
+                    const std::string &function, Function *compiled);
+
+}}
+
+#define SIMIT_BENCHMARK_REGISTER(id, name, sized)                              \
+  static void id(simit::bench::State &state);                                  \
+  static int id##Registered = simit::bench::registerBenchmark(name, id, sized);\
+  static void id(simit::bench::State &state)
+
+/// Define a benchmark that runs at every selected size.
+#define SIMIT_BENCHMARK(id, name) SIMIT_BENCHMARK_REGISTER(id, name, true)
+
+/// Define a benchmark whose input does not depend on the size.
+#define SIMIT_UNSIZED_BENCHMARK(id, name)                                      \
+  SIMIT_BENCHMARK_REGISTER(id, name, false)
+
+#endif
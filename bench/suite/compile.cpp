@@ -0,0 +1,37 @@
+// Program::compile latency: parsing, lowering and code generation of the
+// benchmark programs, from source to a callable function.
+
+#include "benchmark.h"
+
+#include "function.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::bench;
+
+namespace {
+
+void timeCompile(State &state, const string &source, const string &function) {
+  if (source.empty()) {
+    state.skip("missing program source");
+    return;
+  }
+  state.setInput(function, source.size());
+  Function compiled;
+  state.run([&]() {compileProgram(state, source, function, &compiled);});
+}
+
+}
+
+SIMIT_UNSIZED_BENCHMARK(compileSpMV, "compile/spmv") {
+  timeCompile(state, readFile(BENCH_INPUT_DIR "/spmv.sim"), "main");
+}
+
+SIMIT_UNSIZED_BENCHMARK(compileCG, "compile/cg") {
+  timeCompile(state, readFile(BENCH_INPUT_DIR "/cg.sim"), "main");
+}
+
+SIMIT_UNSIZED_BENCHMARK(compileFEM, "compile/fem") {
+  timeCompile(state, readFile(APPS_DATA_DIR "/../fem/fem_linear.sim"),
+              "initializeTet");
+}
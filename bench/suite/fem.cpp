@@ -0,0 +1,130 @@
+// Tet assembly: the forces and stiffness matrix of apps/fem/fem_linear.sim on
+// a generated tet box, with the matrix assembled by compute_stiffness. The
+// redundant variant compiles without hoisting loop invariants and eliminating
+// common subexpressions from the inlined element functions, and the rolled
+// variant without unrolling the loops over their 3x3 matrices.
+
+#include "benchmark.h"
+
+#include "function.h"
+#include "graph.h"
+#include "init.h"
+#include "path_expressions.h"
+#include "path_indices.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::bench;
+
+namespace {
+
+const char *AssembleSource =
+    "export func assemble()\n"
+    "  h = 0.005;\n"
+    "  f = map compute_force(h) to tets reduce +;\n"
+    "  K = map compute_stiffness(h) to tets reduce +;\n"
+    "  verts.fe = K * f;\n"
+    "end\n";
+
+/// Number of vertex pairs that share a tet, i.e. the blocks of K.
+unsigned countBlocks(const Set &verts, const Set &tets) {
+  pe::Var v("v", pe::Set("V"));
+  pe::Var t("t", pe::Set("T"));
+  pe::PathExpression vt = pe::Link::make(v, t, pe::Link::ve);
+  pe::PathExpression tv = pe::Link::make(t, v, pe::Link::ev);
+  pe::Var vi("vi");
+  pe::Var vj("vj");
+  pe::PathExpression vtv = pe::And::make({vi,vj},
+                                         {{pe::QuantifiedVar::Exist,t}},
+                                         vt(vi,t), tv(t,vj));
+  pe::PathIndexBuilder builder;
+  builder.bind("V", &verts);
+  builder.bind("T", &tets);
+  return builder.buildSegmented(vtv, 0).numNeighbors();
+}
+
+/// The settings the benchmarks compile with by default.
+Settings getSettings() {
+  Settings settings;
+  settings.floatSize = sizeof(simit_float);
+  return settings;
+}
+
+void runAssembly(State &state, const Settings &settings) {
+  string source = readFile(APPS_DATA_DIR "/../fem/fem_linear.sim");
+  if (source.empty()) {
+    state.skip("cannot read fem_linear.sim");
+    return;
+  }
+  source += AssembleSource;
+
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  verts.addField<simit_float,3>("x");
+  FieldRef<simit_float,3> v = verts.addField<simit_float,3>("v");
+  verts.addField<simit_float,3>("fe");
+  FieldRef<int> c = verts.addField<int>("c");
+  verts.addField<simit_float>("m");
+  FieldRef<simit_float> u = tets.addField<simit_float>("u");
+  FieldRef<simit_float> l = tets.addField<simit_float>("l");
+  tets.addField<simit_float>("W");
+  tets.addField<simit_float,3,3>("B");
+
+  unsigned n = state.bySize(8u, 20u, 40u);
+  createTetBox(&verts, &tets, n, n, n);
+  for (ElementRef vert : verts) {
+    v.set(vert, {0.1, 0.0, 0.1});
+    c.set(vert, 0);
+  }
+  for (ElementRef tet : tets) {
+    u.set(tet, 5e3);
+    l.set(tet, 5e3);
+  }
+  state.setInput(to_string(n) + "^3 tet box", tets.getSize());
+
+  // Read the tet fields and endpoints and the vertex fields, write the
+  // matrix blocks and the two force vectors
+  const double fb = sizeof(simit_float);
+  const double blocks = countBlocks(verts, tets);
+  state.setWork(tets.getSize() * (12*fb + 4*sizeof(int)) +
+                verts.getSize() * (6*fb + sizeof(int) + 6*fb) +
+                blocks * (9*fb + sizeof(int)), 0.0);
+  state.setValue("blocks", blocks);
+
+  Function initialize;
+  Function assemble;
+  init(settings);
+  bool compiled =
+      compileProgram(state, source, "initializeTet", &initialize) &&
+      compileProgram(state, source, "assemble", &assemble);
+  init(getSettings());
+  if (!compiled) {
+    return;
+  }
+  initialize.bind("verts", &verts);
+  initialize.bind("tets", &tets);
+  initialize.runSafe();
+
+  assemble.bind("verts", &verts);
+  assemble.bind("tets", &tets);
+  assemble.init();
+  state.run([&]() {assemble.run();});
+}
+
+}
+
+SIMIT_BENCHMARK(assemblyTets, "assembly/tets") {
+  runAssembly(state, getSettings());
+}
+
+SIMIT_BENCHMARK(assemblyTetsRedundant, "assembly/tets/redundant") {
+  Settings settings = getSettings();
+  settings.eliminateRedundancy = false;
+  runAssembly(state, settings);
+}
+
+SIMIT_BENCHMARK(assemblyTetsRolled, "assembly/tets/rolled") {
+  Settings settings = getSettings();
+  settings.scalarizeSize = 0;
+  runAssembly(state, settings);
+}
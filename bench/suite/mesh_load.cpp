@@ -0,0 +1,54 @@
+// Mesh loading: parsing the tetgen meshes in apps/data with the parallel
+// loader and building their sets with createMeshSets.
+
+#include "benchmark.h"
+
+#include <fstream>
+
+#include "graph.h"
+#include "mesh.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::bench;
+
+namespace {
+
+size_t fileSize(const string &filename) {
+  ifstream in(filename, ios::binary | ios::ate);
+  return in.good() ? (size_t)in.tellg() : 0;
+}
+
+void loadMesh(State &state, const string &prefix) {
+  const string nodeFile = prefix + ".node";
+  const string eleFile = prefix + ".ele";
+  const size_t bytes = fileSize(nodeFile) + fileSize(eleFile);
+  if (bytes == 0) {
+    state.skip("cannot read " + prefix + ".{node,ele}");
+    return;
+  }
+
+  MeshVol mesh;
+  mesh.loadTetParallel(nodeFile, eleFile);
+  state.setInput(prefix.substr(prefix.find_last_of('/') + 1),
+                 mesh.e.size());
+  state.setWork(bytes, 0.0);
+
+  state.run([&]() {
+    MeshVol mesh;
+    mesh.loadTetParallel(nodeFile, eleFile);
+    Set verts;
+    Set tets(verts, verts, verts, verts);
+    createMeshSets(mesh, &verts, &tets);
+  });
+}
+
+}
+
+SIMIT_UNSIZED_BENCHMARK(meshLoadDragon, "mesh_load/dragon40k") {
+  loadMesh(state, APPS_DATA_DIR "/tet-dragon/dragon40k");
+}
+
+SIMIT_UNSIZED_BENCHMARK(meshLoadBunny, "mesh_load/bunny") {
+  loadMesh(state, APPS_DATA_DIR "/tet-bunny/bunny.1");
+}
@@ -0,0 +1,76 @@
+// PathIndexBuilder construction of the vertex-edge-vertex index of a box of
+// springs and the vertex-tet-vertex index of a tet box, the indices behind
+// the matrices assembled from them.
+
+#include "benchmark.h"
+
+#include <memory>
+
+#include "graph.h"
+#include "path_expressions.h"
+#include "path_indices.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::bench;
+
+namespace {
+
+/// The vertex-element-vertex expression over sets V and E.
+pe::PathExpression makeVEV() {
+  pe::Var v("v", pe::Set("V"));
+  pe::Var e("e", pe::Set("E"));
+  pe::PathExpression ve = pe::Link::make(v, e, pe::Link::ve);
+  pe::PathExpression ev = pe::Link::make(e, v, pe::Link::ev);
+  pe::Var vi("vi");
+  pe::Var vj("vj");
+  return pe::And::make({vi,vj}, {{pe::QuantifiedVar::Exist,e}},
+                       ve(vi,e), ev(e,vj));
+}
+
+/// Time building the vev index of `elements`, with a new builder every
+/// repetition since builders memoize their indices.
+void buildVEV(State &state, const Set &vertices, const Set &elements) {
+  pe::PathExpression vev = makeVEV();
+  unsigned nnz = 0;
+  {
+    pe::PathIndexBuilder builder;
+    builder.bind("V", &vertices);
+    builder.bind("E", &elements);
+    nnz = builder.buildSegmented(vev, 0).numNeighbors();
+  }
+  state.setValue("neighbors", nnz);
+
+  // Read the element endpoints, write the segmented index
+  const double endpoints = elements.getCardinality();
+  state.setWork(elements.getSize() * endpoints * sizeof(int) +
+                (vertices.getSize() + 1 + nnz) * sizeof(unsigned), 0.0);
+
+  unique_ptr<pe::PathIndexBuilder> builder;
+  state.run([&]() {builder->buildSegmented(vev, 0);},
+            [&]() {
+              builder.reset(new pe::PathIndexBuilder());
+              builder->bind("V", &vertices);
+              builder->bind("E", &elements);
+            });
+}
+
+}
+
+SIMIT_BENCHMARK(pathIndexSprings, "path_index/springs") {
+  Set points;
+  Set springs(points, points);
+  unsigned n = state.bySize(16u, 48u, 96u);
+  createBox(&points, &springs, n, n, n, false);
+  state.setInput(to_string(n) + "^3 box of springs", springs.getSize());
+  buildVEV(state, points, springs);
+}
+
+SIMIT_BENCHMARK(pathIndexTets, "path_index/tets") {
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  unsigned n = state.bySize(8u, 20u, 40u);
+  createTetBox(&verts, &tets, n, n, n);
+  state.setInput(to_string(n) + "^3 tet box", tets.getSize());
+  buildVEV(state, verts, tets);
+}
@@ -0,0 +1,200 @@
+// Sparse matrix-vector multiplication, edge assembly and conjugate gradient on
+// a box of springs (bench/input/{spmv,spmv_blocked,cg}.sim). Every program
+// assembles A = map stiffness to springs and then runs `iters` iterations of
+// its kernel. The time of a run with zero iterations, which only assembles,
+// is subtracted from the kernel benchmarks. The matrixfree variants do not
+// assemble A, but compute its blocks from the springs in every product.
+
+#include "benchmark.h"
+
+#include "function.h"
+#include "graph.h"
+#include "init.h"
+#include "tensor.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::bench;
+
+namespace {
+
+/// A box of springs with the point and spring fields of the programs.
+struct Springs {
+  Springs(State &state, bool blocked) : springs(points, points) {
+    unsigned n = state.bySize(16u, 48u, 96u);
+    if (blocked) {
+      FieldRef<simit_float,3> b = points.addField<simit_float,3>("b");
+      points.addField<simit_float,3>("c");
+      FieldRef<simit_float,3,3> a = springs.addField<simit_float,3,3>("a");
+      createBox(&points, &springs, n, n, n, false);
+      for (ElementRef p : points) {
+        b.set(p, {1.0, 2.0, 3.0});
+      }
+      for (ElementRef s : springs) {
+        a.set(s, {2.0, 0.0, 0.0, 0.0, 2.0, 0.0, 0.0, 0.0, 2.0});
+      }
+    }
+    else {
+      FieldRef<simit_float> b = points.addField<simit_float>("b");
+      points.addField<simit_float>("c");
+      FieldRef<simit_float> a = springs.addField<simit_float>("a");
+      createBox(&points, &springs, n, n, n, false);
+      for (ElementRef p : points) {
+        b.set(p, 1.0);
+      }
+      for (ElementRef s : springs) {
+        a.set(s, 1.0);
+      }
+    }
+    // Every point has a diagonal entry and every spring two off-diagonal ones
+    numRows = points.getSize();
+    nnz = numRows + 2*springs.getSize();
+    state.setInput(to_string(n) + "^3 box of " + (blocked ? "3x3 " : "") +
+                   "springs", nnz);
+  }
+
+  Set points;
+  Set springs;
+  double numRows;
+  double nnz;
+};
+
+/// Compile `function` of `source` and bind the springs and an iteration count.
+bool compileKernel(State &state, const string &source, Springs *springs,
+                   Tensor<int> *iters, Function *function) {
+  if (!compileProgram(state, source, "main", function)) {
+    return false;
+  }
+  function->bind("points", &springs->points);
+  function->bind("springs", &springs->springs);
+  function->bind("iters", iters);
+  function->init();
+  return true;
+}
+
+/// The settings the benchmarks compile with by default.
+Settings getSettings() {
+  Settings settings;
+  settings.floatSize = sizeof(simit_float);
+  return settings;
+}
+
+/// Time `iters` iterations of the kernel of `source`, less assembly.
+bool runKernel(State &state, const string &source, Springs *springs,
+               int iters, const Settings &settings=getSettings()) {
+  Tensor<int> zero = 0;
+  Tensor<int> many = iters;
+  Function assemble;
+  Function kernel;
+  init(settings);
+  bool compiled =
+      compileKernel(state, source, springs, &zero, &assemble) &&
+      compileKernel(state, source, springs, &many, &kernel);
+  init(getSettings());
+  if (!compiled) {
+    return false;
+  }
+  state.setValue("iterations", iters);
+  state.setBaseline([&]() {assemble.run();});
+  state.run([&]() {kernel.run();});
+  return true;
+}
+
+/// Compulsory traffic of one CSR SpMV with `blockSize`^2 blocks: the values
+/// and column indices, the row pointers, x read and y written.
+double spmvBytes(const Springs &springs, int blockSize) {
+  const double fb = sizeof(simit_float);
+  return springs.nnz * (blockSize*blockSize*fb + sizeof(int)) +
+         (springs.numRows + 1) * sizeof(int) +
+         2 * springs.numRows * blockSize * fb;
+}
+
+const int SpMVIterations = 20;
+const int CGIterations = 20;
+
+/// Time `CGIterations` iterations of CG, with the loops of an iteration
+/// fused or not.
+void runCG(State &state, bool fuseLoops) {
+  Springs springs(state, false);
+  // Every iteration is an SpMV, two dot products and three axpys, which read
+  // nine vectors and write three when they are not fused
+  const double n = springs.numRows;
+  state.setWork(CGIterations * (spmvBytes(springs, 1) +
+                                12 * n * sizeof(simit_float)),
+                CGIterations * (2 * springs.nnz + 10 * n));
+
+  Settings settings = getSettings();
+  settings.fuseLoops = fuseLoops;
+  runKernel(state, readFile(BENCH_INPUT_DIR "/cg.sim"), &springs,
+            CGIterations, settings);
+}
+
+/// Time `SpMVIterations` products by a matrix that is not assembled, but
+/// computed from the springs in every product.
+void runMatrixFree(State &state, const string &source, bool blocked) {
+  Springs springs(state, blocked);
+  // Every product reads the spring values and endpoints, and gathers and
+  // scatters the two endpoint blocks of x and y
+  const int blockSize = blocked ? 3 : 1;
+  const double fb = sizeof(simit_float);
+  const double springBytes = (blocked ? 9 : 1) * fb + 2 * sizeof(int);
+  state.setWork(SpMVIterations * springs.springs.getSize() *
+                (springBytes + 4 * blockSize * fb),
+                SpMVIterations * springs.springs.getSize() *
+                8 * blockSize * blockSize);
+
+  Settings settings = getSettings();
+  settings.matrixFree = MatrixFree::Always;
+  runKernel(state, source, &springs, SpMVIterations, settings);
+}
+
+}
+
+SIMIT_BENCHMARK(spmvScalar, "spmv/scalar") {
+  Springs springs(state, false);
+  state.setWork(SpMVIterations * spmvBytes(springs, 1),
+                SpMVIterations * 2 * springs.nnz);
+  runKernel(state, readFile(BENCH_INPUT_DIR "/spmv.sim"), &springs,
+            SpMVIterations);
+}
+
+SIMIT_BENCHMARK(spmvBlocked3, "spmv/blocked3") {
+  Springs springs(state, true);
+  state.setWork(SpMVIterations * spmvBytes(springs, 3),
+                SpMVIterations * 18 * springs.nnz);
+  runKernel(state, readFile(BENCH_INPUT_DIR "/spmv_blocked.sim"), &springs,
+            SpMVIterations);
+}
+
+SIMIT_BENCHMARK(spmvScalarMatrixFree, "spmv/scalar/matrixfree") {
+  runMatrixFree(state, readFile(BENCH_INPUT_DIR "/spmv.sim"), false);
+}
+
+SIMIT_BENCHMARK(spmvBlocked3MatrixFree, "spmv/blocked3/matrixfree") {
+  runMatrixFree(state, readFile(BENCH_INPUT_DIR "/spmv_blocked.sim"), true);
+}
+
+SIMIT_BENCHMARK(assemblySprings, "assembly/springs") {
+  Springs springs(state, false);
+  // Read the spring values and endpoints, write the matrix values
+  const double fb = sizeof(simit_float);
+  state.setWork(springs.springs.getSize() * (fb + 2*sizeof(int)) +
+                springs.nnz * fb, 0.0);
+
+  Tensor<int> zero = 0;
+  Function assemble;
+  if (compileKernel(state, readFile(BENCH_INPUT_DIR "/spmv.sim"), &springs,
+                    &zero, &assemble)) {
+    state.run([&]() {assemble.run();});
+  }
+}
+
+SIMIT_BENCHMARK(cg, "cg") {
+  // The SpMV is fused with the dot product that consumes Ap, and the x and r
+  // updates with the norm of r
+  runCG(state, true);
+}
+
+SIMIT_BENCHMARK(cgUnfused, "cg/unfused") {
+  runCG(state, false);
+}
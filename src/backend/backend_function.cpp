@@ -8,6 +8,8 @@ using namespace std;
 #include "ir.h"
 #include "ir_visitor.h"
 #include "graph_indices.h"
+#include "timers.h"
+#include "memory_accounting.h"
 #include "util/collections.h"
 #include "error.h"
 
@@ -16,7 +18,8 @@ namespace backend {
 
 // class Function
 Function::Function(const ir::Func& func)
-    : environment(new ir::Environment(func.getEnvironment())) {
+    : environment(new ir::Environment(func.getEnvironment())),
+      memory(new MemoryAccounting()) {
   for (const ir::Var& arg : func.getArguments()) {
     string argName = arg.getName();
     arguments.push_back(argName);
@@ -68,6 +71,10 @@ Function::~Function() {
   delete environment;
 }
 
+void Function::setTimers(std::shared_ptr<ir::Timers> timers) {
+  this->timers = timers;
+}
+
 bool Function::hasArg(std::string arg) const {
   return util::contains(argumentTypes, arg);
 }
@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <memory>
 #include <set>
 
 #include "interfaces/printable.h"
@@ -13,6 +14,7 @@
 namespace simit {
 class Set;
 class TensorData;
+class MemoryAccounting;
 
 namespace ir {
 class Func;
@@ -20,6 +22,7 @@ class Environment;
 class Expr;
 class Type;
 class Var;
+class Timers;
 }
 
 namespace backend {
@@ -61,6 +64,20 @@ public:
   /// Print the function as machine assembly code to the stream.
   virtual void printMachine(std::ostream &os) const = 0;
 
+  /// Attach the timers registered when the function was lowered, which its
+  /// timer intrinsics update. Backends that do not support timers ignore
+  /// them.
+  virtual void setTimers(std::shared_ptr<ir::Timers> timers);
+
+  /// The function's timers, or nullptr if it was compiled without them.
+  std::shared_ptr<ir::Timers> getTimers() const {return timers;}
+
+  /// The memory the function has allocated, per temporary, index and bound
+  /// set field. Backends that do not account memory leave it empty.
+  std::shared_ptr<MemoryAccounting> getMemoryAccounting() const {
+    return memory;
+  }
+
   bool hasArg(std::string arg) const;
   const std::vector<std::string>& getArgs() const;
   const ir::Type& getArgType(std::string arg) const;
@@ -85,6 +102,9 @@ private:
   /// reclaimed if the IR is deleted, as compiled functions are allowed to
   /// access them at runtime.
   std::vector<simit::ir::Expr> literals;
+
+  std::shared_ptr<ir::Timers> timers;
+  std::shared_ptr<MemoryAccounting> memory;
 };
 
 }}
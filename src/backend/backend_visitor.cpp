@@ -41,7 +41,13 @@ void BackendVisitorBase::compile(const ir::Block& op) {
 }
 
 void BackendVisitorBase::compile(const ir::Comment& comment) {
-  comment.commentedStmt.accept(this);
+  if (comment.commentedStmt.defined()) {
+    comment.commentedStmt.accept(this);
+  }
+}
+
+void BackendVisitorBase::compile(const ir::SourceLine& sourceLine) {
+  sourceLine.stmt.accept(this);
 }
 
 }}
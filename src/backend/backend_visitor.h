@@ -26,6 +26,7 @@ protected:
 #endif
   void compile(const ir::Block&);
   void compile(const ir::Comment&);
+  void compile(const ir::SourceLine&);
 };
 
 template <typename T>
@@ -113,6 +114,12 @@ protected:
   /// The default Comment compilation calls compile on the commented statement.
   virtual void compile(const ir::Comment& op) {BackendVisitorBase::compile(op);}
 
+  /// The default SourceLine compilation ignores the line and calls compile on
+  /// the statement.
+  virtual void compile(const ir::SourceLine& op) {
+    BackendVisitorBase::compile(op);
+  }
+
   virtual void compile(const ir::Pass&) {}
 
 private:
@@ -153,6 +160,7 @@ private:
   void visit(const ir::Block* op)      {compile(*op);}
   void visit(const ir::Print* op)      {compile(*op);}
   void visit(const ir::Comment* op)    {compile(*op);}
+  void visit(const ir::SourceLine* op) {compile(*op);}
   void visit(const ir::Pass* op)       {compile(*op);}
 
 #ifdef GPU
@@ -14,11 +14,16 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Dwarf.h"
 
 #if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 4
 #include "llvm/Analysis/Verifier.h"
+#include "llvm/DIBuilder.h"
+#include "llvm/DebugInfo.h"
 #else
 #include "llvm/IR/Verifier.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/DebugInfo.h"
 #endif
 
 #include "llvm/ADT/SmallVector.h"
@@ -28,16 +33,20 @@
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Target/TargetMachine.h"
 #if LLVM_MAJOR_VERSION <=3 && LLVM_MINOR_VERSION <= 6
 #include "llvm/PassManager.h"
 #else
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #endif
 
 #include "llvm_types.h"
 #include "llvm_codegen.h"
 #include "llvm_util.h"
 #include "llvm_data_layouts.h"
+#include "llvm_target.h"
+#include "llvm_vector_math.h"
 
 #include "macros.h"
 #include "types.h"
@@ -59,11 +68,19 @@ using namespace std;
 using namespace simit::ir;
 
 namespace simit {
+extern bool kDebugInfo;
+
 namespace backend {
 
+// Simit's IR tensor type, not the host tensor type that init.h brings in
+using ir::TensorType;
+
 const std::string VAL_SUFFIX(".val");
 const std::string PTR_SUFFIX(".ptr");
 const std::string LEN_SUFFIX(".len");
+const std::string TIMERS_GLOBAL("simit_timers");
+const std::string MEMORY_GLOBAL("simit_memory");
+const std::string POOL_GLOBAL("simit_pool");
 
 // class LLVMBackend
 bool LLVMBackend::llvmInitialized = false;
@@ -78,7 +95,8 @@ shared_ptr<llvm::EngineBuilder> createEngineBuilder(llvm::Module *module) {
   return engineBuilder;
 }
 
-LLVMBackend::LLVMBackend() : builder(new SimitIRBuilder(LLVM_CTX)) {
+LLVMBackend::LLVMBackend() : builder(new SimitIRBuilder(LLVM_CTX)),
+                             hasDebugCompileUnit(false) {
   if (!llvmInitialized) {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
@@ -136,6 +154,19 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   this->globals.clear();
   this->storage = storage;
 
+  // Let LLVM reassociate, use reciprocals and assume no NaN/Inf in Fast mode
+  llvm::FastMathFlags fastMathFlags;
+  if (kMathAccuracy == MathAccuracy::Fast) {
+    fastMathFlags.setUnsafeAlgebra();
+  }
+  builder->SetFastMathFlags(fastMathFlags);
+
+  if (kDebugInfo) {
+    debugBuilder.reset(new llvm::DIBuilder(*module));
+    hasDebugCompileUnit = false;
+    debugScopes.clear();
+  }
+
   // This backend stores dense tensors and sparse tensors with path expressions
   // as globals.
   func = makeSystemTensorsGlobal(func);
@@ -180,17 +211,9 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   }
   iassert(llvmFunc);
 
-  // Declare malloc and free if necessary
-  llvm::FunctionType *m =
-      llvm::FunctionType::get(LLVM_INT8_PTR, {LLVM_INT}, false);
-  llvm::Function *malloc =
-      llvm::cast<llvm::Function>(module->getOrInsertFunction("malloc", m));
-  llvm::FunctionType *f =
-      llvm::FunctionType::get(LLVM_VOID, {LLVM_INT8_PTR}, false);
-  llvm::Function *free =
-      llvm::cast<llvm::Function>(module->getOrInsertFunction("free", f));
-
-  // Create initialization function
+  // Create initialization function. Buffers come from the function's memory
+  // pool, and the buffers of a previous init go back to it first, so that
+  // re-initializing a function recycles them.
   emitEmptyFunction(func.getName()+"_init", func.getArguments(),
                     func.getResults(), true);
   for (auto &buffer : buffers) {
@@ -202,10 +225,17 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
 
     iassert(type.isTensor());
     const TensorType *ttype = type.toTensor();
+    emitFreeBuffer(bufferVar, bufferVal);
+
     llvm::Value *len= emitComputeLen(ttype,this->storage.getStorage(bufferVar));
     unsigned compSize = ttype->getComponentType().bytes();
     llvm::Value *size = builder->CreateMul(len, llvmInt(compSize));
-    llvm::Value *mem = builder->CreateCall(malloc, size);
+    llvm::Value *mem =
+        emitCall("simit_buffer_allocate",
+                 {builder->CreateLoad(getHostPointerGlobal(POOL_GLOBAL)),
+                  builder->CreateLoad(getHostPointerGlobal(MEMORY_GLOBAL)),
+                  emitGlobalString(bufferVar.getName()), size},
+                 LLVM_INT8_PTR);
 
     mem = builder->CreateCast(llvm::Instruction::CastOps::BitCast, mem, ltype);
     builder->CreateStore(mem, bufferVal);
@@ -218,21 +248,25 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   emitEmptyFunction(func.getName()+"_deinit", func.getArguments(),
                     func.getResults(), true);
   for (auto &buffer : buffers) {
-    Var var = buffer.first;
-    llvm::Value *bufferVal = buffer.second;
-
-    llvm::Value *tmpPtr = builder->CreateLoad(bufferVal);
-    tmpPtr = builder->CreateCast(llvm::Instruction::CastOps::BitCast,
-                                 tmpPtr, LLVM_INT8_PTR);
-    builder->CreateCall(free, tmpPtr);
+    emitFreeBuffer(buffer.first, buffer.second);
   }
   builder->CreateRetVoid();
   symtable.clear();
 
+  if (debugBuilder) {
+    debugBuilder->finalize();
+    debugBuilder.reset();
+    debugScopes.clear();
+  }
+
   iassert(!llvm::verifyModule(*module))
       << "LLVM module does not pass verification";
 
+  // Generate code for the features of the target CPU, e.g. AVX2 and FMA,
+  // rather than for the baseline of its architecture
   auto engineBuilder = createEngineBuilder(module);
+  engineBuilder->setMCPU(getTargetCPU());
+  engineBuilder->setMAttrs(getTargetFeatures());
 
 #ifndef SIMIT_DEBUG
   // Run LLVM optimization passes on the function
@@ -254,6 +288,20 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
 //  pmBuilder.LoadCombine = 1;
   pmBuilder.SLPVectorize = 1;
 
+  // Tell the vectorizers the vector width of the target, and which math
+  // functions they can call vector variants of
+  unique_ptr<llvm::TargetMachine> targetMachine(engineBuilder->selectTarget());
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+  targetMachine->addAnalysisPasses(fpm);
+  targetMachine->addAnalysisPasses(mpm);
+#else
+  fpm.add(llvm::createTargetTransformInfoWrapperPass(
+      targetMachine->getTargetIRAnalysis()));
+  mpm.add(llvm::createTargetTransformInfoWrapperPass(
+      targetMachine->getTargetIRAnalysis()));
+#endif
+  addLibraryInfo(&pmBuilder, kMathAccuracy);
+
   llvm::DataLayout dataLayout(module);
 #if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 4
   fpm.add(new llvm::DataLayout(dataLayout));
@@ -690,6 +738,12 @@ void LLVMBackend::compile(const ir::VarDecl& varDecl) {
 
         llvmVar = builder->CreateAlloca(llvmType(type), llvmInt(1),
                                         var.getName()+PTR_SUFFIX);
+
+        // The runtime reuses the arrays of a previous result, so start out
+        // without any
+        builder->CreateStore(defaultInitializer(LLVM_INT_PTR), rowptrPtr);
+        builder->CreateStore(defaultInitializer(LLVM_INT_PTR), colidxPtr);
+        builder->CreateStore(defaultInitializer(llvmType(type)), llvmVar);
       }
     }
   } else if (type.isOpaque()) {
@@ -963,13 +1017,15 @@ void LLVMBackend::emitIntrinsicCall(const ir::CallStmt& callStmt) {
                                           {overloadType});
     call = builder->CreateCall(fun, args);
   }
-  // is it an intrinsic from libm?
+  // is it an intrinsic from libm? (called directly, so that single precision
+  // code calls the single precision functions)
   else if (callStmt.callee == ir::intrinsics::atan2() ||
            callStmt.callee == ir::intrinsics::tan()   ||
            callStmt.callee == ir::intrinsics::asin()  ||
            callStmt.callee == ir::intrinsics::acos()) {
-    std::string fname = callStmt.callee.getName() + floatTypeName;
-    call = emitCall(fname, args, llvmFloatType());
+    std::string fname = callStmt.callee.getName() +
+                        (ir::ScalarType::singleFloat() ? "f" : "");
+    call = emitMathCall(fname, args);
   }
   else if (callStmt.callee == ir::intrinsics::mod()) {
     iassert(callStmt.actuals.size() == 2) << "mod takes two inputs, got"
@@ -1003,32 +1059,38 @@ void LLVMBackend::emitIntrinsicCall(const ir::CallStmt& callStmt) {
   else if (callStmt.callee == ir::intrinsics::clock()) {
     call = emitCall("clock", args, llvmFloatType());
   }
-  else if (callStmt.callee == ir::intrinsics::storeTime()) {
-    call = emitCall("storeTime", args);
+  else if (callStmt.callee == ir::intrinsics::startTimer() ||
+           callStmt.callee == ir::intrinsics::stopTimer()) {
+    iassert(args.size() == 1);
+    std::string fname = (callStmt.callee == ir::intrinsics::startTimer())
+                        ? "simit_timer_start" : "simit_timer_stop";
+    llvm::Value *timers = builder->CreateLoad(getTimersGlobal());
+    call = emitCall(fname, {timers, args[0]});
   }
   else if (callee == ir::intrinsics::det()) {
     iassert(args.size() == 1);
-    std::string fname = callStmt.callee.getName() + "3" + floatTypeName;
-    call = emitCall(fname, args, llvmFloatType());
+    call = emitDet3(args[0]);
   }
   else if (callee == ir::intrinsics::inv()) {
     iassert(args.size() == 1);
 
     Var result = callStmt.results[0];
     llvm::Value *llvmResult = symtable.get(result);
-    args.push_back(llvmResult);
-
-    std::string fname = callStmt.callee.getName() + "3" + floatTypeName;
-    call = emitCall(fname, args);
+    emitInv3(args[0], llvmResult);
+    return;
   }
   else if (callStmt.callee == ir::intrinsics::solve()) {
     std::string fname = "cMatSolve" + floatTypeName;
     call = emitCall(fname, args);
   }
   else if (callStmt.callee == ir::intrinsics::complexNorm()) {
-    std::string fname = "complexNorm" + floatTypeName;
-    call = emitCall(fname, {builder->ComplexGetReal(args[0]),
-      builder->ComplexGetImag(args[0])}, llvmFloatType());
+    llvm::Value *real = builder->ComplexGetReal(args[0]);
+    llvm::Value *imag = builder->ComplexGetImag(args[0]);
+    llvm::Value *norm2 = builder->CreateFAdd(builder->CreateFMul(real, real),
+                                             builder->CreateFMul(imag, imag));
+    fun = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::sqrt,
+                                          {llvmFloatType()});
+    call = builder->CreateCall(fun, norm2);
   }
   else if (callStmt.callee == ir::intrinsics::createComplex()) {
     call = builder->CreateComplex(args[0], args[1]);
@@ -1365,6 +1427,18 @@ void LLVMBackend::compile(const ir::Print& print) {
   }
 }
 
+void LLVMBackend::compile(const ir::SourceLine& sourceLine) {
+  if (!debugBuilder) {
+    compile(sourceLine.stmt);
+    return;
+  }
+  llvm::DebugLoc enclosing = builder->getCurrentDebugLocation();
+  builder->SetCurrentDebugLocation(
+      llvm::DebugLoc::get(sourceLine.line, 0, getDebugScope(sourceLine)));
+  compile(sourceLine.stmt);
+  builder->SetCurrentDebugLocation(enclosing);
+}
+
 
 // helper methods
 llvm::Function *LLVMBackend::getBuiltIn(std::string name,
@@ -1514,6 +1588,59 @@ llvm::Value *LLVMBackend::loadFromArray(llvm::Value *array, llvm::Value *index){
   return builder->CreateLoad(loc);
 }
 
+llvm::Value *LLVMBackend::emitMathCall(string name,
+                                       vector<llvm::Value*> args) {
+  llvm::Value *call = emitCall(name, args, llvmFloatType());
+
+  // Simit does not read errno, so math functions only compute their result
+  // from their arguments, and LLVM may hoist, merge and vectorize the calls
+  llvm::Function *fun = llvm::cast<llvm::CallInst>(call)->getCalledFunction();
+  fun->setDoesNotAccessMemory();
+  fun->setDoesNotThrow();
+  return call;
+}
+
+llvm::Value *LLVMBackend::emitDet3(llvm::Value *a,
+                                   vector<llvm::Value*> *cofactors) {
+  vector<llvm::Value*> m;
+  for (int i = 0; i < 9; ++i) {
+    m.push_back(loadFromArray(a, llvmInt(i)));
+  }
+
+  // The cofactor (i,j) is m[k]*m[l] - m[p]*m[q] for the entry {k,l,p,q}
+  const int terms[9][4] = {{4,8,5,7}, {5,6,3,8}, {3,7,4,6},
+                           {2,7,1,8}, {0,8,2,6}, {1,6,0,7},
+                           {1,5,2,4}, {2,3,0,5}, {0,4,1,3}};
+  vector<llvm::Value*> cof;
+  for (int i = 0; i < (cofactors != nullptr ? 9 : 3); ++i) {
+    const int *t = terms[i];
+    cof.push_back(builder->CreateFSub(builder->CreateFMul(m[t[0]], m[t[1]]),
+                                      builder->CreateFMul(m[t[2]], m[t[3]])));
+  }
+  if (cofactors != nullptr) {
+    *cofactors = cof;
+  }
+
+  llvm::Value *det = builder->CreateFMul(m[0], cof[0]);
+  det = builder->CreateFAdd(det, builder->CreateFMul(m[1], cof[1]));
+  det = builder->CreateFAdd(det, builder->CreateFMul(m[2], cof[2]));
+  return det;
+}
+
+void LLVMBackend::emitInv3(llvm::Value *a, llvm::Value *inv) {
+  vector<llvm::Value*> cof;
+  llvm::Value *det = emitDet3(a, &cof);
+  llvm::Value *rdet = builder->CreateFDiv(llvmFP(1.0), det);
+
+  // The inverse is the transposed cofactor matrix divided by the determinant
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      llvm::Value *entry = builder->CreateFMul(cof[j*3 + i], rdet);
+      builder->CreateStore(entry, builder->CreateGEP(inv, llvmInt(i*3 + j)));
+    }
+  }
+}
+
 llvm::Value *LLVMBackend::emitCall(string name, vector<llvm::Value*> args) {
   return emitCall(name, args, LLVM_VOID);
 }
@@ -1536,6 +1663,86 @@ llvm::Value *LLVMBackend::emitCall(string name, vector<llvm::Value*> args,
   return builder->CreateCall(fun, std::vector<llvm::Value*>(args));
 }
 
+llvm::MDNode *LLVMBackend::getDebugScope(const ir::SourceLine& sourceLine) {
+  llvm::Function *function = builder->GetInsertBlock()->getParent();
+  auto scope = debugScopes.find(function);
+  if (scope != debugScopes.end()) {
+    return scope->second;
+  }
+
+  size_t slash = sourceLine.file.find_last_of('/');
+  std::string directory = (slash != std::string::npos)
+                          ? sourceLine.file.substr(0, slash) : ".";
+  std::string filename = (slash != std::string::npos)
+                         ? sourceLine.file.substr(slash+1) : sourceLine.file;
+  if (!hasDebugCompileUnit) {
+    module->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                          llvm::DEBUG_METADATA_VERSION);
+    debugBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C, filename,
+                                    directory, "simit", true, "", 0);
+    hasDebugCompileUnit = true;
+  }
+
+  const unsigned line = sourceLine.line;
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+  llvm::DIFile file = debugBuilder->createFile(filename, directory);
+#if LLVM_MINOR_VERSION <= 5
+  llvm::DICompositeType type = debugBuilder->createSubroutineType(
+      file, debugBuilder->getOrCreateArray(llvm::ArrayRef<llvm::Value*>()));
+#else
+  llvm::DICompositeType type = debugBuilder->createSubroutineType(
+      file,
+      debugBuilder->getOrCreateTypeArray(llvm::ArrayRef<llvm::Metadata*>()));
+#endif
+  llvm::DISubprogram subprogram =
+      debugBuilder->createFunction(file, function->getName(),
+                                   function->getName(), file, line, type,
+                                   false, true, line, 0, true, function);
+  llvm::MDNode *node = subprogram;
+#else
+  llvm::DIFile *file = debugBuilder->createFile(filename, directory);
+  llvm::DISubroutineType *type = debugBuilder->createSubroutineType(
+      file,
+      debugBuilder->getOrCreateTypeArray(llvm::ArrayRef<llvm::Metadata*>()));
+  llvm::MDNode *node =
+      debugBuilder->createFunction(file, function->getName(),
+                                   function->getName(), file, line, type,
+                                   false, true, line, 0, true, function);
+#endif
+  debugScopes.insert({function, node});
+  return node;
+}
+
+void LLVMBackend::emitFreeBuffer(const ir::Var& var, llvm::Value* buffer) {
+  llvm::Value *mem = builder->CreateLoad(buffer);
+  mem = builder->CreateCast(llvm::Instruction::CastOps::BitCast,
+                            mem, LLVM_INT8_PTR);
+  emitCall("simit_buffer_free",
+           {builder->CreateLoad(getHostPointerGlobal(POOL_GLOBAL)),
+            builder->CreateLoad(getHostPointerGlobal(MEMORY_GLOBAL)),
+            emitGlobalString(var.getName()), mem});
+  builder->CreateStore(llvm::Constant::getNullValue(
+      buffer->getType()->getPointerElementType()), buffer);
+}
+
+llvm::GlobalVariable *LLVMBackend::getTimersGlobal() {
+  return getHostPointerGlobal(TIMERS_GLOBAL);
+}
+
+llvm::GlobalVariable *
+LLVMBackend::getHostPointerGlobal(const std::string& name) {
+  llvm::GlobalVariable *global = module->getNamedGlobal(name);
+  if (global == nullptr) {
+    global = new llvm::GlobalVariable(*module, LLVM_INT8_PTR, false,
+                                      llvm::GlobalValue::ExternalLinkage,
+                                      llvm::ConstantPointerNull::get(
+                                          LLVM_INT8_PTR),
+                                      name);
+    global->setAlignment(8);
+  }
+  return global;
+}
+
 llvm::Constant *LLVMBackend::emitGlobalString(const std::string& str) {
   auto strValue = llvm::ConstantDataArray::getString(LLVM_CTX, str);
   auto strType = llvm::ArrayType::get(LLVM_INT8, str.size()+1);
@@ -23,11 +23,14 @@ class ConstantFolder;
 template<bool> class IRBuilderDefaultInserter;
 template<bool, typename, typename> class IRBuilder;
 class Constant;
+class GlobalVariable;
 class Type;
 class Value;
 class Instruction;
 class Function;
 class DataLayout;
+class DIBuilder;
+class MDNode;
 }
 
 
@@ -45,6 +48,17 @@ extern const std::string VAL_SUFFIX;
 extern const std::string PTR_SUFFIX;
 extern const std::string LEN_SUFFIX;
 
+/// Name of the module global that holds the function's ir::Timers pointer.
+extern const std::string TIMERS_GLOBAL;
+
+/// Name of the module global that holds the function's MemoryAccounting
+/// pointer.
+extern const std::string MEMORY_GLOBAL;
+
+/// Name of the module global that holds the function's util::MemoryPool
+/// pointer, which the init code allocates buffers from.
+extern const std::string POOL_GLOBAL;
+
 std::shared_ptr<llvm::EngineBuilder> createEngineBuilder(llvm::Module *module);
 
 /// Code generator that uses LLVM to compile Simit IR.
@@ -69,6 +83,12 @@ protected:
   std::unique_ptr<llvm::DataLayout> dataLayout;
   std::unique_ptr<SimitIRBuilder> builder;
 
+  /// Debug info of the module, emitted when kDebugInfo is set, and the debug
+  /// scope of every function that has source lines
+  std::unique_ptr<llvm::DIBuilder> debugBuilder;
+  bool hasDebugCompileUnit;
+  std::map<llvm::Function*, llvm::MDNode*> debugScopes;
+
   using BackendImpl::compile;
   virtual Function* compile(ir::Func func, const ir::Storage& storage);
 
@@ -109,6 +129,7 @@ protected:
   virtual void compile(const ir::For&);
   virtual void compile(const ir::While&);
   virtual void compile(const ir::Print&);
+  virtual void compile(const ir::SourceLine&);
 
   /// Get a pointer to the given field
   llvm::Value *emitFieldRead(const ir::Expr &elemOrSet, std::string fieldName);
@@ -129,9 +150,36 @@ protected:
   llvm::Value *emitCall(std::string name, std::vector<llvm::Value*> args,
                         llvm::Type *returnType);
 
+  /// Call a libm function that takes and returns floats of the current float
+  /// size, and tell LLVM that it does not access memory.
+  llvm::Value *emitMathCall(std::string name, std::vector<llvm::Value*> args);
+
+  /// Emit the determinant of the row-major 3x3 matrix `a`. If `cofactors` is
+  /// given it is set to the cofactors of `a`, in row-major order.
+  llvm::Value *emitDet3(llvm::Value *a,
+                        std::vector<llvm::Value*> *cofactors=nullptr);
+
+  /// Emit stores of the inverse of the row-major 3x3 matrix `a` to `inv`.
+  void emitInv3(llvm::Value *a, llvm::Value *inv);
+
   /// Build a global string and return a constant pointer to it
   llvm::Constant *emitGlobalString(const std::string& str);
 
+  /// Get the global that holds the timers pointer, declaring it on first use
+  llvm::GlobalVariable *getTimersGlobal();
+
+  /// Get the global that holds a host object pointer, declaring it as a null
+  /// pointer on first use
+  llvm::GlobalVariable *getHostPointerGlobal(const std::string& name);
+
+  /// Return the buffer of `var`, stored in the global `buffer`, to the memory
+  /// pool and null the global. Does nothing to a null buffer.
+  void emitFreeBuffer(const ir::Var& var, llvm::Value* buffer);
+
+  /// Get the debug scope of the function being emitted, describing it as a
+  /// function of the source file of `sourceLine` on first use
+  llvm::MDNode *getDebugScope(const ir::SourceLine& sourceLine);
+
   /// Gets a reference to a named built-in
   llvm::Function* getBuiltIn(std::string name,
                              llvm::Type *retTy,
@@ -1,5 +1,6 @@
 #include "llvm_function.h"
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -28,11 +29,18 @@
 #include "util/collections.h"
 #include "util/util.h"
 #include "llvm_util.h"
+#include "llvm_backend.h"
+#include "llvm_perf_map.h"
+#include "timers.h"
+#include "memory_accounting.h"
 
 using namespace std;
 using namespace simit::ir;
 
 namespace simit {
+extern bool kPerfMap;
+extern bool kHugePages;
+
 namespace backend {
 
 typedef void (*FuncPtrType)();
@@ -57,12 +65,27 @@ LLVMFunction::LLVMFunction(ir::Func func, const ir::Storage &storage,
           unique_ptr<llvm::Module>(harnessModule))),
       harnessExecEngine(harnessEngineBuilder->create()),
 #endif
-      deinit(nullptr) {
+      pool(kHugePages), deinit(nullptr) {
+
+  if (kPerfMap) {
+    executionEngine->RegisterJITEventListener(getPerfMapListener());
+  }
 
   // Finalize existing module so we can get global pointer hooks
   // from the LLVM memory manager.
   executionEngine->finalizeObject();
 
+  // The generated init and deinit code allocate buffers from the pool and
+  // account them
+  if (module->getNamedGlobal(POOL_GLOBAL) != nullptr) {
+    uint64_t addr = executionEngine->getGlobalValueAddress(POOL_GLOBAL);
+    *(void**)addr = &pool;
+  }
+  if (module->getNamedGlobal(MEMORY_GLOBAL) != nullptr) {
+    uint64_t addr = executionEngine->getGlobalValueAddress(MEMORY_GLOBAL);
+    *(void**)addr = getMemoryAccounting().get();
+  }
+
   const Environment& env = getEnvironment();
 
   // Initialize extern pointers
@@ -124,10 +147,20 @@ LLVMFunction::~LLVMFunction() {
     deinit();
   }
   for (auto& tmpPtr : temporaryPtrs) {
-    free(*tmpPtr.second);
+    pool.free(*tmpPtr.second);
     *tmpPtr.second = nullptr;
+    getMemoryAccounting()->free(MemoryKind::Temporary, tmpPtr.first);
   }
+}
 
+void LLVMFunction::setTimers(std::shared_ptr<ir::Timers> timers) {
+  Function::setTimers(timers);
+  // The timer intrinsics read the timers through a module global, which only
+  // exists if the function was compiled with timers
+  if (module->getNamedGlobal(TIMERS_GLOBAL) != nullptr) {
+    uint64_t addr = executionEngine->getGlobalValueAddress(TIMERS_GLOBAL);
+    *(void**)addr = timers.get();
+  }
 }
 
 void LLVMFunction::bind(const std::string& name, simit::Set* set) {
@@ -257,6 +290,17 @@ Function::FuncType LLVMFunction::init() {
   }
 
   const Environment& environment = getEnvironment();
+  MemoryAccounting* memory = getMemoryAccounting().get();
+
+  // Account the fields of the bound sets
+  for (auto* actuals : {&arguments, &globals}) {
+    for (auto& pair : *actuals) {
+      Actual* actual = pair.second.get();
+      if (isa<SetActual>(actual)) {
+        memory->recordSet(pair.first, *to<SetActual>(actual)->getSet());
+      }
+    }
+  }
 
   // Initialize indices
   initIndices(piBuilder, environment);
@@ -277,8 +321,9 @@ Function::FuncType LLVMFunction::init() {
         Type blockType = tensorType->getBlockType();
         size_t blockSize = blockType.toTensor()->size();
         size_t componentSize = tensorType->getComponentType().bytes();
-        *temporaryPtrs.at(tmp.getName()) =
-            calloc(size(vecDimension) *blockSize, componentSize);
+        size_t vecSize = size(vecDimension) * blockSize * componentSize;
+        void* vec = allocateTemporary(tmp.getName(), vecSize);
+        memset(vec, 0, vecSize);
       }
       else if (order == 2) {
         Type blockType = tensorType->getBlockType();
@@ -292,7 +337,7 @@ Function::FuncType LLVMFunction::init() {
           iassert(util::contains(pathIndices, pexpr));
           size_t matSize = pathIndices.at(pexpr).numNeighbors() *
               blockSize * componentSize;
-          *temporaryPtrs.at(tmp.getName()) = malloc(matSize);
+          allocateTemporary(tmp.getName(), matSize);
         }
         else if (ti.getKind() == TensorIndex::Sten) {
           auto iss = tensorType->getOuterDimensions();
@@ -303,7 +348,7 @@ Function::FuncType LLVMFunction::init() {
           const StencilLayout& stencil = ti.getStencilLayout();
           size_t matSize = stencil.getLayout().size() *
               latticeSize * blockSize * componentSize;
-          *temporaryPtrs.at(tmp.getName()) = malloc(matSize);
+          allocateTemporary(tmp.getName(), matSize);
         }
         else {
           not_supported_yet;
@@ -436,8 +481,20 @@ void LLVMFunction::initIndices(pe::PathIndexBuilder& piBuilder,
     if (tensorIndex.getKind() == TensorIndex::PExpr) {
       pe::PathExpression pexpr = tensorIndex.getPathExpression();
       pe::PathIndex pidx = piBuilder.buildSegmented(pexpr, 0);
+      // Replace the index of a previous init, which the tensor index
+      // pointers no longer point to
+      pathIndices.erase(pexpr);
       pathIndices.insert({pexpr, pidx});
 
+      const string pidxName = util::toString(pexpr);
+      const size_t pidxBytes =
+          (pidx.numElements() + 1 + pidx.numNeighbors()) * sizeof(uint32_t);
+      MemoryAccounting* memory = getMemoryAccounting().get();
+      memory->free(MemoryKind::PathIndex, pidxName);
+      memory->allocate(MemoryKind::PathIndex, pidxName, pidxBytes);
+      memory->alias(MemoryKind::TensorIndex, tensorIndex.getName(), pidxBytes,
+                    pidxName);
+
       pair<const uint32_t**,const uint32_t**> ptrPair = tensorIndexPtrs.at(pexpr);
 
       if (isa<pe::SegmentedPathIndex>(pidx)) {
@@ -458,6 +515,18 @@ void LLVMFunction::initIndices(pe::PathIndexBuilder& piBuilder,
   }
 }
 
+void* LLVMFunction::allocateTemporary(const std::string& name, size_t bytes) {
+  // Recycle the temporary of a previous init, which is likely the same size
+  void** tmpPtr = temporaryPtrs.at(name);
+  pool.free(*tmpPtr);
+  *tmpPtr = pool.allocate(bytes);
+
+  MemoryAccounting* memory = getMemoryAccounting().get();
+  memory->free(MemoryKind::Temporary, name);
+  memory->allocate(MemoryKind::Temporary, name, bytes);
+  return *tmpPtr;
+}
+
 void LLVMFunction::createHarness(
     const std::string &name,
     const llvm::SmallVector<llvm::Value*,8> &args) {
@@ -13,6 +13,7 @@
 #include "ir.h"
 #include "storage.h"
 #include "tensor_data.h"
+#include "util/memory_pool.h"
 
 namespace llvm {
 class ExecutionEngine;
@@ -49,6 +50,8 @@ class LLVMFunction : public backend::Function {
   virtual void print(std::ostream &os) const;
   virtual void printMachine(std::ostream &os) const;
 
+  virtual void setTimers(std::shared_ptr<ir::Timers> timers);
+
  protected:
   /// Get the number of elements in the index domains.
   size_t size(const ir::IndexDomain &dimension);
@@ -56,6 +59,10 @@ class LLVMFunction : public backend::Function {
   void initIndices(pe::PathIndexBuilder& piBuilder,
                    const ir::Environment& environment);
 
+  /// Allocate the named temporary from the pool, returning its previous data
+  /// to the pool, and account its bytes.
+  void* allocateTemporary(const std::string& name, size_t bytes);
+
   bool initialized;
 
   llvm::Function*                        llvmFunc;
@@ -84,6 +91,9 @@ class LLVMFunction : public backend::Function {
   /// Temporaries
   std::map<std::string, void**> temporaryPtrs;
 
+  /// Recycles the temporaries and buffers across inits
+  util::MemoryPool pool;
+
   FuncType deinit;
 
   // MCJIT does not allow module modification after code generation. Instead,
@@ -0,0 +1,172 @@
+#include "llvm_perf_map.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/DebugInfo/DIContext.h"
+
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 5
+#include "llvm/ExecutionEngine/ObjectImage.h"
+#else
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#endif
+#if !(LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6)
+#include "llvm/Object/SymbolSize.h"
+#endif
+
+using namespace std;
+
+namespace simit {
+namespace backend {
+
+namespace {
+
+class PerfMapListener : public llvm::JITEventListener {
+public:
+  PerfMapListener() : file(nullptr) {}
+
+  ~PerfMapListener() {
+    if (file != nullptr) {
+      fclose(file);
+    }
+  }
+
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 5
+  void NotifyObjectEmitted(const llvm::ObjectImage &object) override {
+#if LLVM_MINOR_VERSION <= 4
+    unique_ptr<llvm::DIContext> context(
+        llvm::DIContext::getDWARFContext(object.getObjectFile()));
+    llvm::error_code ec;
+    for (llvm::object::symbol_iterator it = object.begin_symbols(),
+         end = object.end_symbols(); it != end; it.increment(ec)) {
+      addSymbol(*it, context.get());
+    }
+#else
+    unique_ptr<llvm::DIContext> context(
+        llvm::DIContext::getDWARFContext(*object.getObjectFile()));
+    for (llvm::object::symbol_iterator it = object.begin_symbols(),
+         end = object.end_symbols(); it != end; ++it) {
+      addSymbol(*it, context.get());
+    }
+#endif
+  }
+#else
+  void NotifyObjectEmitted(const llvm::object::ObjectFile &object,
+                           const llvm::RuntimeDyld::LoadedObjectInfo &info)
+      override {
+    // The debug object has the sections at their load addresses
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObject =
+        info.getObjectForDebug(object);
+    const llvm::object::ObjectFile *loaded = debugObject.getBinary();
+    if (loaded == nullptr) {
+      return;
+    }
+    llvm::DWARFContextInMemory context(*loaded);
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+    for (llvm::object::symbol_iterator it = loaded->symbol_begin(),
+         end = loaded->symbol_end(); it != end; ++it) {
+      addSymbol(*it, &context);
+    }
+#else
+    for (const auto &symbol : llvm::object::computeSymbolSizes(*loaded)) {
+      if (symbol.first.getType() != llvm::object::SymbolRef::ST_Function) {
+        continue;
+      }
+      llvm::ErrorOr<llvm::StringRef> name = symbol.first.getName();
+      llvm::ErrorOr<uint64_t> address = symbol.first.getAddress();
+      if (name && address) {
+        write(*name, *address, symbol.second, &context);
+      }
+    }
+#endif
+  }
+#endif
+
+private:
+  mutex writeMutex;
+  FILE *file;
+
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+  void addSymbol(const llvm::object::SymbolRef &symbol,
+                 llvm::DIContext *context) {
+    llvm::object::SymbolRef::Type type;
+    llvm::StringRef name;
+    uint64_t address;
+    uint64_t size;
+    if (symbol.getType(type) || type != llvm::object::SymbolRef::ST_Function ||
+        symbol.getName(name) || symbol.getAddress(address) ||
+        symbol.getSize(size)) {
+      return;
+    }
+    write(name, address, size, context);
+  }
+#endif
+
+  void writeRange(uint64_t begin, uint64_t end, const string &name) {
+    if (end > begin) {
+      fprintf(file, "%llx %llx %s\n", (unsigned long long)begin,
+              (unsigned long long)(end - begin), name.c_str());
+    }
+  }
+
+  void write(llvm::StringRef symbol, uint64_t address, uint64_t size,
+             llvm::DIContext *context) {
+    lock_guard<mutex> lock(writeMutex);
+    if (file == nullptr) {
+      char filename[64];
+      snprintf(filename, sizeof(filename), "/tmp/perf-%d.map", (int)getpid());
+      file = fopen(filename, "a");
+      if (file == nullptr) {
+        return;
+      }
+    }
+
+    const string function = "simit::" + symbol.str();
+    llvm::DILineInfoTable lines;
+    if (context != nullptr) {
+      lines = context->getLineInfoForAddressRange(address, size);
+    }
+
+    // Merge consecutive rows of the line table with the same line, and name
+    // the code outside any line after the function
+    uint64_t begin = address;
+    string name = function;
+    for (const auto &row : lines) {
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 4
+      const string rowFile = row.second.getFileName();
+      const unsigned rowLine = row.second.getLine();
+#else
+      const string rowFile = row.second.FileName;
+      const unsigned rowLine = row.second.Line;
+#endif
+      string rowName = function;
+      if (rowLine != 0) {
+        rowName += " " + rowFile.substr(rowFile.find_last_of('/') + 1) +
+                   ":" + to_string(rowLine);
+      }
+      if (rowName != name && row.first > begin) {
+        writeRange(begin, row.first, name);
+        begin = row.first;
+      }
+      name = rowName;
+    }
+    writeRange(begin, address + size, name);
+    fflush(file);
+  }
+};
+
+}
+
+llvm::JITEventListener *getPerfMapListener() {
+  static PerfMapListener listener;
+  return &listener;
+}
+
+}}
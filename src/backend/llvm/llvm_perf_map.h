@@ -0,0 +1,20 @@
+#ifndef SIMIT_LLVM_PERF_MAP_H
+#define SIMIT_LLVM_PERF_MAP_H
+
+namespace llvm {
+class JITEventListener;
+}
+
+namespace simit {
+namespace backend {
+
+/// Get the JIT event listener that appends the address range of every
+/// function MCJIT emits to /tmp/perf-<pid>.map, the file perf reads to name
+/// samples in JIT code. Functions with debug line info get one range per
+/// Simit source line, named `simit::<function> <file>:<line>`, so that
+/// `perf report` attributes samples to source lines; other functions get one
+/// range named `simit::<function>`.
+llvm::JITEventListener *getPerfMapListener();
+
+}}
+#endif
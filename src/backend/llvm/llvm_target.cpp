@@ -0,0 +1,54 @@
+#include "llvm_target.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Host.h"
+
+#include "init.h"
+
+using namespace std;
+
+namespace simit {
+namespace backend {
+
+string getTargetCPU() {
+  return (kCPU == "host") ? string(llvm::sys::getHostCPUName()) : kCPU;
+}
+
+vector<string> getTargetFeatures() {
+  vector<string> features;
+
+  // The host CPU name does not tell whether e.g. the OS saves AVX registers,
+  // so the features the host actually supports are listed as well
+  llvm::StringMap<bool> hostFeatures;
+  if (kCPU == "host" && llvm::sys::getHostCPUFeatures(hostFeatures)) {
+    for (auto &feature : hostFeatures) {
+      features.push_back((feature.getValue() ? "+" : "-") +
+                         feature.getKey().str());
+    }
+  }
+
+  size_t begin = 0;
+  while (begin < kCPUFeatures.size()) {
+    size_t end = kCPUFeatures.find(',', begin);
+    if (end == string::npos) {
+      end = kCPUFeatures.size();
+    }
+    if (end > begin) {
+      features.push_back(kCPUFeatures.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return features;
+}
+
+bool hasTargetFeature(const string &feature) {
+  bool enabled = false;
+  for (auto &targetFeature : getTargetFeatures()) {
+    if (targetFeature.substr(1) == feature) {
+      enabled = (targetFeature[0] == '+');
+    }
+  }
+  return enabled;
+}
+
+}}
@@ -0,0 +1,25 @@
+#ifndef SIMIT_LLVM_TARGET_H
+#define SIMIT_LLVM_TARGET_H
+
+#include <string>
+#include <vector>
+
+namespace simit {
+namespace backend {
+
+/// Get the LLVM name of the CPU that CPU code is generated for, which is
+/// Settings::cpu with "host" resolved to the CPU of this machine.
+std::string getTargetCPU();
+
+/// Get the features to enable ("+avx2") or disable ("-avx512f") on top of
+/// those the target CPU implies. These are the features this machine supports
+/// when Settings::cpu is "host", followed by Settings::cpuFeatures.
+std::vector<std::string> getTargetFeatures();
+
+/// Returns true if the target features enable `feature`, e.g. "avx2". The
+/// features a named target CPU implies are not known here, so for those only
+/// the ones Settings::cpuFeatures enables count.
+bool hasTargetFeature(const std::string &feature);
+
+}}
+#endif
@@ -0,0 +1,80 @@
+#include "llvm_vector_math.h"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+#include "llvm/Target/TargetLibraryInfo.h"
+#else
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#endif
+
+#include "llvm_target.h"
+
+namespace simit {
+namespace backend {
+
+#if !(LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6)
+// The libmvec function for `fn` that takes vectors of `vf` doubles (or `fvf`
+// floats) for each of its `args`, built for the instruction set `isa`, e.g.
+// _ZGVdN4v_sin and _ZGVdN8v_sinf for AVX2. The scalar functions are mapped by
+// their libm and their LLVM intrinsic names.
+#define SIMIT_LIBMVEC_FUNCTION(fn, args, isa, vf, fvf)                        \
+  {#fn, "_ZGV" isa "N" #vf args "_" #fn, vf},                                  \
+  {"llvm." #fn ".f64", "_ZGV" isa "N" #vf args "_" #fn, vf},                   \
+  {#fn "f", "_ZGV" isa "N" #fvf args "_" #fn "f", fvf},                        \
+  {"llvm." #fn ".f32", "_ZGV" isa "N" #fvf args "_" #fn "f", fvf}
+
+#define SIMIT_LIBMVEC(isa, vf, fvf)                                            \
+  SIMIT_LIBMVEC_FUNCTION(sin, "v", isa, vf, fvf),                              \
+  SIMIT_LIBMVEC_FUNCTION(cos, "v", isa, vf, fvf),                              \
+  SIMIT_LIBMVEC_FUNCTION(exp, "v", isa, vf, fvf),                              \
+  SIMIT_LIBMVEC_FUNCTION(log, "v", isa, vf, fvf),                              \
+  SIMIT_LIBMVEC_FUNCTION(pow, "vv", isa, vf, fvf)
+
+static const llvm::VecDesc LibmvecSSE[] = {SIMIT_LIBMVEC("b", 2, 4)};
+static const llvm::VecDesc LibmvecAVX[] = {SIMIT_LIBMVEC("c", 4, 8)};
+static const llvm::VecDesc LibmvecAVX2[] = {SIMIT_LIBMVEC("d", 4, 8)};
+static const llvm::VecDesc LibmvecAVX512[] = {SIMIT_LIBMVEC("e", 8, 16)};
+
+#undef SIMIT_LIBMVEC
+#undef SIMIT_LIBMVEC_FUNCTION
+
+/// Load libmvec into the process, so that MCJIT resolves calls to it.
+static bool loadLibmvec() {
+  static bool loaded =
+      !llvm::sys::DynamicLibrary::LoadLibraryPermanently("libmvec.so.1");
+  return loaded;
+}
+#endif
+
+void addLibraryInfo(llvm::PassManagerBuilder *pmBuilder,
+                    MathAccuracy accuracy) {
+  llvm::Triple triple(llvm::sys::getProcessTriple());
+#if LLVM_MAJOR_VERSION <= 3 && LLVM_MINOR_VERSION <= 6
+  // Vector library mappings are only supported from LLVM 3.7
+  (void)accuracy;
+  pmBuilder->LibraryInfo = new llvm::TargetLibraryInfo(triple);
+#else
+  llvm::TargetLibraryInfoImpl *libraryInfo =
+      new llvm::TargetLibraryInfoImpl(triple);
+  if (accuracy != MathAccuracy::Precise &&
+      triple.getArch() == llvm::Triple::x86_64 &&
+      triple.isOSLinux() && loadLibmvec()) {
+    libraryInfo->addVectorizableFunctions(LibmvecSSE);
+    if (hasTargetFeature("avx2")) {
+      libraryInfo->addVectorizableFunctions(LibmvecAVX2);
+    }
+    else if (hasTargetFeature("avx")) {
+      libraryInfo->addVectorizableFunctions(LibmvecAVX);
+    }
+    if (hasTargetFeature("avx512f")) {
+      libraryInfo->addVectorizableFunctions(LibmvecAVX512);
+    }
+  }
+  pmBuilder->LibraryInfo = libraryInfo;
+#endif
+}
+
+}}
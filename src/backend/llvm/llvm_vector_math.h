@@ -0,0 +1,24 @@
+#ifndef SIMIT_LLVM_VECTOR_MATH_H
+#define SIMIT_LLVM_VECTOR_MATH_H
+
+#include "init.h"
+
+namespace llvm {
+class PassManagerBuilder;
+}
+
+namespace simit {
+namespace backend {
+
+/// Give the optimization passes of `pmBuilder` library info for the target.
+/// Unless `accuracy` is Precise, and if glibc's SIMD math library (libmvec)
+/// can be loaded, it maps sin, cos, exp, log and pow, and the LLVM intrinsics
+/// for them, to the libmvec variants for the vector widths the target
+/// features enable (SSE, AVX/AVX2 and AVX-512), so that loops that call them
+/// vectorize. sqrt needs no library, since LLVM vectorizes it to an
+/// instruction.
+void addLibraryInfo(llvm::PassManagerBuilder *pmBuilder,
+                    MathAccuracy accuracy);
+
+}}
+#endif
@@ -14,6 +14,11 @@ void* simit_malloc(std::size_t size) {
   return malloc(size);
 }
 
+extern "C" inline
+void* simit_realloc(void* ptr, std::size_t size) {
+  return realloc(ptr, size);
+}
+
 extern "C" inline
 void simit_free(void* ptr) {
   return free(ptr);
@@ -75,6 +75,32 @@ private:
     }
   }
 
+  /// True if `a` and `b` can be combined element-wise: neither reduces and
+  /// every tensor they index is indexed by the same variables in the same
+  /// order, so that the combined expression reads each tensor at the element
+  /// it writes (unindexed operands such as scalars are broadcast).
+  static bool isElementwise(Expr a, Expr b) {
+    class GetIndexVarLists : public IRVisitor {
+    public:
+      set<vector<IndexVar>> indexVarLists;
+    private:
+      using IRVisitor::visit;
+      void visit(const IndexedTensor *op) {
+        if (op->indexVars.size() > 0) {
+          indexVarLists.insert(op->indexVars);
+        }
+      }
+    };
+
+    if (containsReductionVar(a) || containsReductionVar(b)) {
+      return false;
+    }
+    GetIndexVarLists indexVarLists;
+    a.accept(&indexVarLists);
+    b.accept(&indexVarLists);
+    return indexVarLists.indexVarLists.size() <= 1;
+  }
+
   std::pair<Expr,Expr> spillAsNeeded(Expr a, Expr b) {
     class IsAnyInputSparseVisitor : public IRQuery {
       using IRQuery::visit;
@@ -85,7 +111,9 @@ private:
       }
     };
 
-    if (countIndexVars(a) == countIndexVars(b) &&
+    // Element-wise operands are fused into one loop instead of computing
+    // each into a temporary (e.g. x + alpha*(r + p) is a single loop)
+    if ((countIndexVars(a) == countIndexVars(b) || isElementwise(a, b)) &&
         !IsAnyInputSparseVisitor().query(a) &&
         !IsAnyInputSparseVisitor().query(b)) {
       return pair<Expr,Expr>(a,b);
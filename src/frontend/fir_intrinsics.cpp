@@ -134,10 +134,6 @@ std::vector<fir::FuncDecl::Ptr> createIntrinsics() {
   addScalarIntrinsic(&intrinsics,
                      ir::intrinsics::clock().getName(),
                      {}, {ScalarType::Type::FLOAT});
-  addScalarIntrinsic(&intrinsics,
-                     ir::intrinsics::storeTime().getName(),
-                     {ScalarType::Type::INT, ScalarType::Type::FLOAT},
-                     {ScalarType::Type::FLOAT});
 
   // Local vectors/matrices
   addIntrinsic(&intrinsics,
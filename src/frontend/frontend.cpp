@@ -23,7 +23,8 @@ using namespace simit::internal;
 
 // Frontend
 int Frontend::parseStream(std::istream &programStream, ProgramContext *ctx,
-                          std::vector<ParseError> *errors) {
+                          std::vector<ParseError> *errors,
+                          const std::string &filename) {
   std::vector<fir::FuncDecl::Ptr> intrinsics = fir::createIntrinsics();
 
   // Lexical and syntactic analyses.
@@ -44,14 +45,14 @@ int Frontend::parseStream(std::istream &programStream, ProgramContext *ctx,
   }
 
   // IR generation.
-  fir::IREmitter(ctx).emitIR(program);
+  fir::IREmitter(ctx, filename).emitIR(program);
   return 0;
 }
 
 int Frontend::parseString(const std::string &programString, ProgramContext *ctx,
                           std::vector<ParseError> *errors) {
   std::istringstream programStream(programString);
-  return parseStream(programStream, ctx, errors);
+  return parseStream(programStream, ctx, errors, "<string>");
 }
 
 int Frontend::parseFile(const std::string &filename, ProgramContext *ctx,
@@ -60,5 +61,5 @@ int Frontend::parseFile(const std::string &filename, ProgramContext *ctx,
   if (!programStream.good()) {
     return 2;
   }
-  return parseStream(programStream, ctx, errors);
+  return parseStream(programStream, ctx, errors, filename);
 }
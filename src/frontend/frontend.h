@@ -19,8 +19,10 @@ class ProgramContext;
 class Frontend {
 public:
   /// Parses, typechecks and turns a given Simit-formated stream into Simit IR.
+  /// `filename` names the stream in debug info.
   int parseStream(std::istream &programStream, ProgramContext *ctx,
-                  std::vector<ParseError> *errors);
+                  std::vector<ParseError> *errors,
+                  const std::string &filename="");
 
   /// Parses, typechecks and turns a given Simit-formated string into Simit IR.
   int parseString(const std::string &programString, ProgramContext *ctx,
@@ -7,11 +7,17 @@
 #include "ir.h"
 
 namespace simit {
+extern bool kDebugInfo;
+
 namespace fir {
 
 void IREmitter::visit(StmtBlock::Ptr stmtBlock) {
   for (auto stmt : stmtBlock->stmts) {
+    const size_t first = ctx->getStatements()->size();
     stmt->accept(this);
+    if (kDebugInfo) {
+      addSourceLines(stmt, first);
+    }
   }
   
   const std::vector<ir::Stmt> *stmts = ctx->getStatements();
@@ -1114,6 +1120,20 @@ ir::Stmt IREmitter::getCallStmts() {
   return callStmts;
 }
 
+void IREmitter::addSourceLines(Stmt::Ptr stmt, size_t first) {
+  if (stmt->getLineBegin() == 0) {
+    return;
+  }
+  // Declarations are left unwrapped so they stay visible to later statements
+  std::vector<ir::Stmt> *stmts = ctx->getStatements();
+  for (size_t i = first; i < stmts->size(); ++i) {
+    if (!ir::isa<ir::VarDecl>((*stmts)[i])) {
+      (*stmts)[i] = ir::SourceLine::make(file, stmt->getLineBegin(),
+                                         (*stmts)[i]);
+    }
+  }
+}
+
 }
 }
 
@@ -18,8 +18,8 @@ namespace fir {
 // Handles translation from higher-level IR to Simit IR.
 class IREmitter : public FIRVisitor {
 public:
-  IREmitter(internal::ProgramContext *ctx) : 
-    retField(ir::Field("", ir::Type())), ctx(ctx) {}
+  IREmitter(internal::ProgramContext *ctx, const std::string &file="") :
+    retField(ir::Field("", ir::Type())), ctx(ctx), file(file) {}
 
   void emitIR(Program::Ptr program) { program->accept(this); }
 
@@ -186,6 +186,10 @@ private:
 
   ir::Stmt getCallStmts();
 
+  /// Wrap the statements emitted for `stmt`, from the `first` statement of
+  /// the current scope on, in SourceLine statements.
+  void addSourceLines(Stmt::Ptr stmt, size_t first);
+
 private:
   // Used during IR generation to store call and map statements that have to be 
   // emitted before an expression can be fully evaluated at runtime. Needed to 
@@ -202,6 +206,9 @@ private:
 
   internal::ProgramContext *ctx;
   SetExprMap                setExprs;
+
+  // Name of the source file, for debug info
+  std::string               file;
 };
 
 }
@@ -1,22 +1,278 @@
 #include "function.h"
 
+#include <algorithm>
+#include <map>
+
 #include "backend/backend_function.h"
 #include "types_convert.h"
 #include "graph.h"  // TODO: should not need this include
+#include "reorder.h"
+#include "timers.h"
+#include "memory_accounting.h"
 
 using namespace std;
 
 namespace simit {
 
+// struct Function::Reordering
+struct Function::Reordering {
+  Reordering() : enabled(false), initialized(true), permuted(false) {}
+
+  ~Reordering() {
+    release();
+  }
+
+  /// An element ordering applied to a bound set. Element i of the permuted
+  /// set is element gather[i] of the original set, and ordering is the
+  /// inverse (old to new indices).
+  struct SetOrdering {
+    Set* set;
+    vector<int> gather;
+    vector<int> ordering;
+  };
+
+  bool enabled;
+  ReorderOptions options;
+
+  /// False if the reordering changed since the function was initialized.
+  bool initialized;
+
+  /// True if the bound sets are in the function's order.
+  bool permuted;
+
+  /// Bound sets in the order they were first bound, and bound tensors.
+  vector<pair<string,Set*>> sets;
+  vector<string> tensors;
+
+  vector<SetOrdering> orderings;
+
+  /// The values permuteSet stages, kept to reuse between permutations.
+  vector<char> scratch;
+
+  /// The reordering whose order each permuted set is in. A set bound to
+  /// several reordering functions is put back in its original order before
+  /// another one permutes it.
+  static map<const Set*, Reordering*>& owners() {
+    static map<const Set*, Reordering*> owners;
+    return owners;
+  }
+
+  void bindSet(const string& name, Set* set) {
+    restore();
+    orderings.clear();
+    if (enabled) {
+      initialized = false;
+    }
+    for (auto& boundSet : sets) {
+      if (boundSet.first == name) {
+        boundSet.second = set;
+        return;
+      }
+    }
+    sets.push_back(make_pair(name, set));
+  }
+
+  void bindTensor(const string& name) {
+    if (find(tensors.begin(), tensors.end(), name) == tensors.end()) {
+      tensors.push_back(name);
+    }
+  }
+
+  /// Restore the bound sets that other reorderings permuted, and record that
+  /// they are about to be in this reordering's order.
+  void claim() {
+    for (auto& boundSet : sets) {
+      auto owner = owners().find(boundSet.second);
+      if (owner != owners().end() && owner->second != this) {
+        owner->second->restore();
+      }
+    }
+    for (auto& boundSet : sets) {
+      owners()[boundSet.second] = this;
+    }
+  }
+
+  void release() {
+    for (auto it = owners().begin(); it != owners().end();) {
+      it = (it->second == this) ? owners().erase(it) : next(it);
+    }
+  }
+
+  /// Renumber the endpoints that refer to `ordering.set` in all bound sets
+  /// and permute its elements, or undo that.
+  void apply(const SetOrdering& ordering, bool inverse) {
+    uassert(ordering.set->getSize() == (int)ordering.gather.size())
+        << "Reordered sets cannot change size without reinitializing the "
+        << "function";
+    const vector<int>& gather = inverse ? ordering.ordering : ordering.gather;
+    const vector<int>& renumber = inverse ? ordering.gather : ordering.ordering;
+    for (auto& boundSet : sets) {
+      Set* edgeSet = boundSet.second;
+      for (int i=0; i < edgeSet->getCardinality(); ++i) {
+        if (edgeSet->getEndpointSet(i) == ordering.set) {
+          renumberEndpoints(*edgeSet, *ordering.set, renumber,
+                            options.numThreads);
+          break;
+        }
+      }
+    }
+    permuteSet(*ordering.set, gather, options.numThreads, &scratch);
+  }
+
+  /// Put the bound sets in the function's order.
+  void permute() {
+    if (!permuted) {
+      claim();
+      for (const SetOrdering& ordering : orderings) {
+        apply(ordering, false);
+      }
+      permuted = true;
+    }
+  }
+
+  /// Put the bound sets back in their original order.
+  void restore() {
+    if (permuted) {
+      for (auto it = orderings.rbegin(); it != orderings.rend(); ++it) {
+        apply(*it, true);
+      }
+      permuted = false;
+      release();
+    }
+  }
+
+  /// Compute and apply the orderings of all bound sets. Sets are ordered
+  /// after all their endpoint sets, so that edge sets are sorted by their
+  /// renumbered endpoints.
+  void reorder(const backend::Function& function) {
+    restore();
+    orderings.clear();
+    claim();
+    permuted = true;
+
+    for (const string& name : tensors) {
+      const ir::Type& type = function.getBindableType(name);
+      if (!type.isTensor()) {
+        continue;
+      }
+      for (const ir::IndexDomain& dim : type.toTensor()->getDimensions()) {
+        for (const ir::IndexSet& indexSet : dim.getIndexSets()) {
+          uassert(indexSet.getKind() != ir::IndexSet::Set)
+              << "Cannot reorder the sets of a function with the set-indexed "
+              << "tensor " << util::quote(name) << " bound";
+        }
+      }
+    }
+
+    // Lattices address their points by grid coordinates, so the point sets
+    // of bound lattices keep their order
+    vector<const Set*> latticePoints;
+    for (auto& boundSet : sets) {
+      const Set* set = boundSet.second;
+      for (int i=0; set->getKind() != Set::Unstructured &&
+                    i < set->getCardinality(); ++i) {
+        latticePoints.push_back(set->getEndpointSet(i));
+      }
+    }
+    vector<Set*> pending;
+    for (auto& boundSet : sets) {
+      Set* set = boundSet.second;
+      if (set->getKind() == Set::Unstructured &&
+          find(latticePoints.begin(), latticePoints.end(), set) ==
+              latticePoints.end()) {
+        pending.push_back(set);
+      }
+    }
+    auto isPending = [&](const Set* set) {
+      return find(pending.begin(), pending.end(), set) != pending.end();
+    };
+
+    while (!pending.empty()) {
+      auto ready = find_if(pending.begin(), pending.end(), [&](Set* set) {
+        for (int i=0; i < set->getCardinality(); ++i) {
+          if (isPending(set->getEndpointSet(i))) {
+            return false;
+          }
+        }
+        return true;
+      });
+      uassert(ready != pending.end())
+          << "Cannot reorder sets with cyclic endpoint sets";
+      Set* set = *ready;
+      pending.erase(ready);
+
+      SetOrdering ordering;
+      ordering.set = set;
+      if (set->getCardinality() == 0) {
+        if (!computeVertexOrdering(*set, ordering.ordering)) {
+          continue;
+        }
+        ordering.gather.resize(ordering.ordering.size());
+        for (size_t i=0; i < ordering.ordering.size(); ++i) {
+          ordering.gather[ordering.ordering[i]] = i;
+        }
+      }
+      else {
+        computeEdgeOrdering(*set, options, ordering.gather);
+        ordering.ordering.resize(ordering.gather.size());
+        for (size_t i=0; i < ordering.gather.size(); ++i) {
+          ordering.ordering[ordering.gather[i]] = i;
+        }
+      }
+      orderings.push_back(ordering);
+      apply(orderings.back(), false);
+    }
+  }
+
+  /// Compute the ordering of a set without endpoints, returning false if the
+  /// heuristic does not apply to it.
+  bool computeVertexOrdering(const Set& vertexSet, vector<int>& ordering) {
+    if (options.heuristic == ReorderHeuristic::EdgeSort) {
+      return false;
+    }
+
+    const Set* edgeSet = nullptr;
+    for (auto& boundSet : sets) {
+      const Set* candidate = boundSet.second;
+      bool connects = candidate->getCardinality() > 0;
+      for (int i=0; i < candidate->getCardinality(); ++i) {
+        connects &= (candidate->getEndpointSet(i) == &vertexSet);
+      }
+      if (connects) {
+        edgeSet = candidate;
+        break;
+      }
+    }
+
+    ReorderOptions vertexOptions = options;
+    bool curve = options.heuristic == ReorderHeuristic::Hilbert ||
+                 options.heuristic == ReorderHeuristic::Morton;
+    if (curve && !vertexSet.hasSpatialField()) {
+      vertexOptions.heuristic = ReorderHeuristic::ReverseCuthillMcKee;
+      curve = false;
+    }
+    if (!curve && edgeSet == nullptr) {
+      return false;
+    }
+    // The curve heuristics only read the vertex set
+    simit::computeVertexOrdering(edgeSet ? *edgeSet : vertexSet, vertexSet,
+                                 vertexOptions, ordering);
+    return true;
+  }
+};
+
 // class Function
 Function::Function() : Function(nullptr) {
 }
 
-Function::Function(backend::Function* func) : impl(func), funcPtr(nullptr) {
+Function::Function(backend::Function* func)
+    : impl(func), reordering(new Reordering), funcPtr(nullptr) {
 }
 
 void Function::clear() {
+  reordering->restore();
   impl = nullptr;
+  reordering = make_shared<Reordering>();
 }
 
 void Function::bind(const std::string& name, simit::Set *set) {
@@ -87,6 +343,7 @@ void Function::bind(const std::string& name, simit::Set *set) {
   }
 #endif
 
+  reordering->bindSet(name, set);
   impl->bind(name, set);
 }
 
@@ -108,38 +365,94 @@ void Function::bind(const std::string& name, void* data) {
   uassert(defined()) << "undefined function";
   uassert(impl->hasBindable(name))
       << "no argument or global of this name in the function";
+  reordering->bindTensor(name);
   impl->bind(name, data);
 }
 
 void Function::bind(const string& name, TensorData& data) {
+  reordering->bindTensor(name);
   impl->bind(name, data);
 }
 
 void Function::init() {
   uassert(defined()) << "undefined function";
-  funcPtr = impl->init();
+  if (reordering->enabled) {
+    // Build the function's indices over the reordered sets, which stay in
+    // the function's order until mapArgs
+    reordering->reorder(*impl);
+    funcPtr = impl->init();
+  }
+  else {
+    reordering->restore();
+    reordering->orderings.clear();
+    funcPtr = impl->init();
+  }
+  reordering->initialized = true;
+}
+
+void Function::run() {
+  uassert(reordering->permuted || reordering->orderings.empty())
+      << "the bound sets are reordered by the function, so unmapArgs must be "
+      << "called before run";
+  funcPtr();
 }
 
 void Function::runSafe() {
   uassert(defined()) << "undefined function";
-  if (!impl->isInitialized()) {
+  if (!impl->isInitialized() || !reordering->initialized) {
     init();
   }
+  // Leave reordered sets in the function's order between runs
   unmapArgs();
   funcPtr();
-  mapArgs();
+  impl->mapArgs();
 }
 
 void Function::mapArgs() {
   uassert(defined()) << "undefined function";
   impl->mapArgs();
+  reordering->restore();
 }
 
 void Function::unmapArgs(bool updated) {
   uassert(defined()) << "undefined function";
+  reordering->permute();
   impl->unmapArgs(updated);
 }
 
+void Function::setReordering(const ReorderOptions& options) {
+  reordering->restore();
+  reordering->enabled = true;
+  reordering->options = options;
+  reordering->initialized = false;
+}
+
+void Function::clearReordering() {
+  reordering->restore();
+  reordering->enabled = false;
+  reordering->initialized = false;
+}
+
+std::shared_ptr<ir::Timers> Function::getTimers() const {
+  return defined() ? impl->getTimers() : nullptr;
+}
+
+void Function::printTimers(std::ostream& os) const {
+  if (getTimers() != nullptr) {
+    getTimers()->print(os);
+  }
+}
+
+std::shared_ptr<MemoryAccounting> Function::getMemoryAccounting() const {
+  return defined() ? impl->getMemoryAccounting() : nullptr;
+}
+
+void Function::printMemory(std::ostream& os) const {
+  if (getMemoryAccounting() != nullptr) {
+    getMemoryAccounting()->print(os);
+  }
+}
+
 void Function::print(std::ostream& os) const {
   if (defined()) {
     os << *impl;
@@ -8,6 +8,12 @@
 namespace simit {
 class Set;
 class TensorData;
+class MemoryAccounting;
+struct ReorderOptions;
+
+namespace ir {
+class Timers;
+}
 
 namespace backend {
 class Function;
@@ -20,8 +26,8 @@ class Function;
 /// If you call the function using `run` (recommended for performance) you have
 /// to first call `init` to initialize bound arguments and externs. Furthermore,
 /// you must make the bound arguments and externs available to the function by
-/// calling `mapArgs`. Finally, when the host program needs to read results and
-/// externs it must call `unmapArgs` to make updates made by the function
+/// calling `unmapArgs`. Finally, when the host program needs to read results and
+/// externs it must call `mapArgs` to make updates made by the function
 /// visible.
 ///
 /// If you call the function using `runSafe` (recommended for testing) you don't
@@ -62,12 +68,13 @@ public:
   /// automatically as needed.
   void init();
 
-  /// Run the function. Make sure to bind arguments and map arguments, and to
-  /// init the function before calling this method. Also make sure to map/unmap
-  /// arguments if you need to access them between calls to run.
-  inline void run() {
-    funcPtr();
-  }
+  /// Run the function. Make sure to bind arguments, to init the function and
+  /// to unmap arguments before calling this method. Also make sure to map
+  /// arguments if you need to access them between calls to run, and to unmap
+  /// them again before the next call. Fails if the function reorders the
+  /// bound sets and they are in their original order, since its indices are
+  /// over the reordered sets.
+  void run();
 
   /// Run the function. This method will automatically map/unmap arguments and
   /// initialize the function as necessary. However, it will incur additional
@@ -77,6 +84,47 @@ public:
   void mapArgs();
   void unmapArgs(bool updated=true);
 
+  /// Reorder the elements of the bound sets for locality whenever the function
+  /// is initialized. Sets without endpoints are ordered by `options.heuristic`
+  /// over the first bound edge set whose endpoints are all in the set, and
+  /// edge sets are then ordered by `options.edgeOrder`. The Hilbert and Morton
+  /// heuristics fall back to Reverse Cuthill-McKee for sets without a spatial
+  /// field. The point sets of lattices keep their order, since lattices
+  /// address their points by grid coordinates.
+  ///
+  /// The sets are permuted in place once, when the function is initialized,
+  /// and stay in the function's order across runs, including those of
+  /// runSafe. `mapArgs` puts them back in their original order, so the host
+  /// must call it before it reads fields through element references from
+  /// before the reordering, and `unmapArgs` permutes them again. Sets bound
+  /// to another reordering function are put back in their original order
+  /// before that function permutes them. Tensors indexed by sets cannot be
+  /// bound to a reordering function.
+  void setReordering(const ReorderOptions& options);
+
+  /// Stop reordering the bound sets. Takes effect when the function is next
+  /// initialized.
+  void clearReordering();
+
+  /// The per-statement timers of a function compiled with
+  /// Program::compileWithTimers, or nullptr. The timers accumulate over
+  /// runs until they are reset, and outlive the function.
+  std::shared_ptr<ir::Timers> getTimers() const;
+
+  /// Print the function's lowered IR annotated with the share of the run
+  /// time spent in every timed statement. Prints nothing if the function was
+  /// compiled without timers.
+  void printTimers(std::ostream& os) const;
+
+  /// The memory the function has allocated: the bytes of every temporary,
+  /// buffer, tensor index and path index it allocated and of the fields of
+  /// the sets bound to it, with their peak values. Updated whenever the
+  /// function is initialized, and outlives the function.
+  std::shared_ptr<MemoryAccounting> getMemoryAccounting() const;
+
+  /// Print the function's memory accounting as a table.
+  void printMemory(std::ostream& os) const;
+
   /// True if the function has been defined, false otherwise.
   bool defined() const {return impl != nullptr;}
 
@@ -90,6 +138,10 @@ public:
 private:
   std::shared_ptr<backend::Function> impl;
 
+  // Bound sets and the element orderings applied to them while reordering.
+  struct Reordering;
+  std::shared_ptr<Reordering> reordering;
+
   // To make the run method faster we store the function pointer here.
   std::function<void()> funcPtr;
 };
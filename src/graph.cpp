@@ -1,7 +1,14 @@
 #include "graph.h"
 
 #include <iostream>
+#include <atomic>
+#include <climits>
+#include <numeric>
+#include <random>
 #include "graph_indices.h"
+#include "mesh.h"
+#include "reorder.h"
+#include "util/parallel.h"
 
 using namespace std;
 
@@ -31,6 +38,65 @@ void Set::increaseCapacity() {
   capacity += capacityIncrement;
 }
 
+void Set::addField(const std::string &name, ComponentType componentType,
+                   const std::vector<int> &dimensions) {
+  uassert(!hasField(name)) << "The set already has a field " << name;
+  FieldData::TensorType *type =
+      new FieldData::TensorType(componentType, dimensions);
+  FieldData *fieldData = new FieldData(name, type, this);
+  fieldData->data = calloc(capacity, fieldData->sizeOfType);
+  fields.push_back(fieldData);
+  fieldNames[name] = fields.size()-1;
+}
+
+void Set::reserve(int n) {
+  if (n <= capacity) {
+    return;
+  }
+  for (auto f : fields) {
+    size_t typeSize = f->sizeOfType;
+    f->data = realloc(f->data, n * typeSize);
+    memset((char*)(f->data)+capacity*typeSize, 0, (n-capacity)*typeSize);
+
+    for (FieldRefBase *fieldRef : f->fieldReferences) {
+      fieldRef->data = f->data;
+    }
+  }
+  if (getCardinality() > 0) {
+    size_t endpointsSize = getCardinality() * sizeof(int);
+    endpoints = (int*)realloc(endpoints, n * endpointsSize);
+    memset((char*)endpoints + capacity*endpointsSize, 0,
+           (n-capacity)*endpointsSize);
+  }
+  capacity = n;
+}
+
+ElementRef Set::addElements(int num) {
+  uassert(num >= 0) << "Cannot add a negative number of elements";
+  uassert(kind != LatticeLink)
+      << "Bulk element addition disallowed for lattice link edge sets";
+
+  // Storage past the old capacity is zeroed by reserve, but storage between
+  // the size and the old capacity may hold data of removed elements.
+  int oldCapacity = capacity;
+  reserve(numElements + num);
+  int numStale = std::min(oldCapacity, numElements+num) - numElements;
+  if (numStale > 0) {
+    for (auto f : fields) {
+      memset((char*)(f->data) + numElements*f->sizeOfType, 0,
+             numStale*f->sizeOfType);
+    }
+    if (getCardinality() > 0) {
+      memset(endpoints + numElements*getCardinality(), 0,
+             numStale*getCardinality()*sizeof(int));
+    }
+  }
+
+  ElementRef first(numElements);
+  numElements += num;
+  return first;
+}
+
 const internal::NeighborIndex *Set::getNeighborIndex() const {
   iassert(getCardinality() > 0) << "Vertex sets have no neighbor index.";
 
@@ -48,8 +114,65 @@ const internal::NeighborIndex *Set::getNeighborIndex() const {
 
 // Graph generators
 void createElements(Set *elements, unsigned num) {
-  for (size_t i=0; i < num; ++i) {
-    elements->add();
+  elements->addElements(num);
+}
+
+/// Return a reference to element `ident` of `set`.
+static ElementRef elementRef(const Set *set, int ident) {
+  return *Set::ElementIterator(set, ident);
+}
+
+static void checkEdgeSet(const Set *edgeSet, const Set *vertices,
+                         int cardinality) {
+  uassert(edgeSet->getCardinality() == cardinality)
+      << "Expected an edge set with " << cardinality << " endpoints, but the "
+      << "set has " << edgeSet->getCardinality();
+  for (int k=0; k < cardinality; ++k) {
+    uassert(edgeSet->getEndpointSet(k) == vertices)
+        << "The edge set must have the vertex set as every endpoint set";
+  }
+}
+
+/// Return the 3-vector position field of `vertices`, adding it as a double
+/// field if it does not exist, and make it the set's spatial field.
+static Set::FieldData *getPositionField(Set *vertices, const string &name) {
+  if (!vertices->hasField(name)) {
+    vertices->addField<double,3>(name);
+  }
+  vertices->setSpatialField(name);
+  Set::FieldData *field = vertices->getFields()[vertices->getFieldIndex(name)];
+  ComponentType type = field->type->getComponentType();
+  uassert(type == ComponentType::Double || type == ComponentType::Float)
+      << "Positions must be stored in a float or double field";
+  return field;
+}
+
+template <typename T, typename PositionFn>
+static void writePositions(T *data, size_t num, PositionFn position,
+                           unsigned numThreads) {
+  util::parallelFor(0, num, [&](size_t begin, size_t end) {
+    double xyz[3];
+    for (size_t i=begin; i < end; ++i) {
+      position(i, xyz);
+      for (int k=0; k < 3; ++k) {
+        data[i*3+k] = static_cast<T>(xyz[k]);
+      }
+    }
+  }, numThreads);
+}
+
+/// Write the positions of `num` vertices starting at vertex `first`, where
+/// `position(i, xyz)` stores the coordinates of the i'th vertex in xyz.
+template <typename PositionFn>
+static void writePositions(Set::FieldData *field, size_t first, size_t num,
+                           PositionFn position, unsigned numThreads) {
+  if (field->type->getComponentType() == ComponentType::Double) {
+    writePositions(static_cast<double*>(field->data) + 3*first, num, position,
+                   numThreads);
+  }
+  else {
+    writePositions(static_cast<float*>(field->data) + 3*first, num, position,
+                   numThreads);
   }
 }
 
@@ -60,48 +183,103 @@ void createElements(Set *elements, unsigned num) {
 
 Box::Box(unsigned nX, unsigned nY, unsigned nZ,
     std::vector<ElementRef> refs, std::map<Box::Coord, ElementRef> coords2edges)
-    : nX(nX), nY(nY), nZ(nZ), refs(refs), coords2edges(coords2edges) {
+    : nX(nX), nY(nY), nZ(nZ), refs(refs), coords2edges(coords2edges),
+      hasEdgeMap(true) {
+  iassert(refs.size() == nX*nY*nZ);
+}
+
+Box::Box(unsigned nX, unsigned nY, unsigned nZ,
+    std::vector<ElementRef> refs, ElementRef firstEdge)
+    : nX(nX), nY(nY), nZ(nZ), refs(refs), firstEdge(firstEdge),
+      hasEdgeMap(false) {
   iassert(refs.size() == nX*nY*nZ);
 }
 
 ElementRef Box::getEdge(ElementRef p1, ElementRef p2) const {
-  Coord coord(p1,p2);
-  if (coords2edges.find(coord) == coords2edges.end()) {
+  if (hasEdgeMap) {
+    Coord coord(p1,p2);
+    if (coords2edges.find(coord) == coords2edges.end()) {
+      return ElementRef();
+    }
+    return coords2edges.at(coord);
+  }
+  if (!firstEdge.defined()) {
+    return ElementRef();
+  }
+
+  // Vertices are numbered x*nY*nZ + y*nZ + z from the first vertex, and the x,
+  // y and z edges follow each other in the same order.
+  const int numNodes = nX*nY*nZ;
+  const int n1 = p1.getIdent() - refs[0].getIdent();
+  const int n2 = p2.getIdent() - refs[0].getIdent();
+  if (n1 < 0 || n1 >= numNodes || n2 < 0 || n2 >= numNodes) {
     return ElementRef();
   }
-  return coords2edges.at(coord);
+  const unsigned x = n1 / (nY*nZ);
+  const unsigned y = (n1 / nZ) % nY;
+  const unsigned z = n1 % nZ;
+  const int numXEdges = (nX-1)*nY*nZ;
+  const int numYEdges = nX*(nY-1)*nZ;
+  int edge;
+  if (n2 == n1 + (int)(nY*nZ) && x+1 < nX) {
+    edge = x*nY*nZ + y*nZ + z;
+  }
+  else if (n2 == n1 + (int)nZ && y+1 < nY) {
+    edge = numXEdges + x*(nY-1)*nZ + y*nZ + z;
+  }
+  else if (n2 == n1 + 1 && z+1 < nZ) {
+    edge = numXEdges + numYEdges + x*nY*(nZ-1) + y*(nZ-1) + z;
+  }
+  else {
+    return ElementRef();
+  }
+  return ElementRef(firstEdge.getIdent() + edge);
 }
 
 std::vector<ElementRef> Box::getEdges() {
   std::vector<ElementRef> edges;
-  for (auto &coord2edge : coords2edges) {
-    edges.push_back(coord2edge.second);
+  if (hasEdgeMap) {
+    for (auto &coord2edge : coords2edges) {
+      edges.push_back(coord2edge.second);
+    }
+  }
+  else if (firstEdge.defined()) {
+    int numEdges = (nX-1)*nY*nZ + nX*(nY-1)*nZ + nX*nY*(nZ-1);
+    for (int i=0; i < numEdges; ++i) {
+      edges.push_back(ElementRef(firstEdge.getIdent() + i));
+    }
   }
   return edges;
 }
 
 Box createBox(Set *vertices, Set *edges,
-              unsigned numX, unsigned numY, unsigned numZ) {
+              unsigned numX, unsigned numY, unsigned numZ, bool edgeMap) {
   uassert(numX >= 1 && numY >= 1 && numZ >= 1);
-  vector<ElementRef> points(numX*numY*numZ);
+  checkEdgeSet(edges, vertices, 2);
 
-  for(unsigned x = 0; x < numX; ++x) {
-    for(unsigned y = 0; y < numY; ++y) {
-      for(unsigned z = 0; z < numZ; ++z) {
-        points[node0(x,y,z)] = vertices->add();
-      }
-    }
+  const int numNodes = numX*numY*numZ;
+  const int base = vertices->addElements(numNodes).getIdent();
+  vector<ElementRef> points(numNodes);
+  for (int i=0; i < numNodes; ++i) {
+    points[i] = elementRef(vertices, base + i);
   }
 
-  map<Box::Coord, ElementRef> coords2edges;
+  const int numEdges = (numX-1)*numY*numZ + numX*(numY-1)*numZ +
+                       numX*numY*(numZ-1);
+  ElementRef firstEdge = edges->addElements(numEdges);
+  int *endpoints = edges->getEndpointsPtr() + 2*firstEdge.getIdent();
+  int edge = 0;
+  auto addEdge = [&](int node, int neighbor) {
+    endpoints[2*edge]   = base + node;
+    endpoints[2*edge+1] = base + neighbor;
+    edge++;
+  };
 
   // x edges
   for(unsigned x = 0; x < numX-1; ++x) {
     for(unsigned y = 0; y < numY; ++y) {
       for(unsigned z = 0; z < numZ; ++z) {
-        Box::Coord coord(points[node0(x,y,z)], points[node1X(x,y,z)]);
-        simit::ElementRef edge = edges->add(coord.first, coord.second);
-        coords2edges[coord] = edge;
+        addEdge(node0(x,y,z), node1X(x,y,z));
       }
     }
   }
@@ -110,9 +288,7 @@ Box createBox(Set *vertices, Set *edges,
   for(unsigned x = 0; x < numX; ++x) {
     for(unsigned y = 0; y < numY - 1; ++y) {
       for(unsigned z = 0; z < numZ; ++z) {
-        Box::Coord coord(points[node0(x,y,z)], points[node1Y(x,y,z)]);
-        simit::ElementRef edge = edges->add(coord.first, coord.second);
-        coords2edges[coord] = edge;
+        addEdge(node0(x,y,z), node1Y(x,y,z));
       }
     }
   }
@@ -121,14 +297,393 @@ Box createBox(Set *vertices, Set *edges,
   for(unsigned x = 0; x < numX; ++x) {
     for(unsigned y = 0; y < numY; ++y) {
       for(unsigned z = 0; z < numZ-1; ++z) {
-        Box::Coord coord(points[node0(x,y,z)], points[node1Z(x,y,z)]);
-        simit::ElementRef edge = edges->add(coord.first, coord.second);
-        coords2edges[coord] = edge;
+        addEdge(node0(x,y,z), node1Z(x,y,z));
       }
     }
   }
+  iassert(edge == numEdges);
 
+  if (!edgeMap) {
+    return Box(numX, numY, numZ, points,
+               (numEdges > 0) ? firstEdge : ElementRef());
+  }
+  map<Box::Coord, ElementRef> coords2edges;
+  for (int i=0; i < numEdges; ++i) {
+    Box::Coord coord(points[endpoints[2*i] - base],
+                     points[endpoints[2*i+1] - base]);
+    coords2edges[coord] = elementRef(edges, firstEdge.getIdent() + i);
+  }
   return Box(numX, numY, numZ, points, coords2edges);
 }
 
+Box createTetBox(Set *vertices, Set *tets,
+                 unsigned numX, unsigned numY, unsigned numZ,
+                 const std::string &positionField, unsigned numThreads) {
+  uassert(numX >= 1 && numY >= 1 && numZ >= 1);
+  checkEdgeSet(tets, vertices, 4);
+  Set::FieldData *positions = getPositionField(vertices, positionField);
+
+  const int numNodes = numX*numY*numZ;
+  const int base = vertices->addElements(numNodes).getIdent();
+  vector<ElementRef> points(numNodes);
+  for (int i=0; i < numNodes; ++i) {
+    points[i] = elementRef(vertices, base + i);
+  }
+  writePositions(positions, base, numNodes, [&](size_t node, double *xyz) {
+    xyz[0] = node / (numY*numZ);
+    xyz[1] = (node / numZ) % numY;
+    xyz[2] = node % numZ;
+  }, numThreads);
+
+  // Every cell is split into the six tets around its main diagonal, one per
+  // ordering of the axes, which makes the decomposition conforming. Tets of
+  // odd orderings have their last two vertices swapped to orient them
+  // positively.
+  static const int axisOrders[6][3] = {{0,1,2}, {1,2,0}, {2,0,1},
+                                       {0,2,1}, {2,1,0}, {1,0,2}};
+  const int numCellsX = numX-1, numCellsY = numY-1, numCellsZ = numZ-1;
+  const size_t numCells = (size_t)numCellsX * numCellsY * numCellsZ;
+  const int steps[3] = {(int)(numY*numZ), (int)numZ, 1};
+  int first = tets->addElements(6*numCells).getIdent();
+  int *endpoints = tets->getEndpointsPtr() + 4*(size_t)first;
+  util::parallelFor(0, numCells, [&](size_t begin, size_t end) {
+    for (size_t cell=begin; cell < end; ++cell) {
+      unsigned x = cell / (numCellsY*numCellsZ);
+      unsigned y = (cell / numCellsZ) % numCellsY;
+      unsigned z = cell % numCellsZ;
+      int corner = base + node0(x,y,z);
+      for (int t=0; t < 6; ++t) {
+        int *tet = endpoints + 4*(6*cell + t);
+        const int *axes = axisOrders[t];
+        int v1 = corner + steps[axes[0]];
+        int v2 = v1 + steps[axes[1]];
+        int v3 = v2 + steps[axes[2]];
+        bool odd = (t >= 3);
+        tet[0] = corner;
+        tet[1] = v1;
+        tet[2] = odd ? v3 : v2;
+        tet[3] = odd ? v2 : v3;
+      }
+    }
+  }, numThreads);
+
+  return Box(numX, numY, numZ, points, ElementRef());
+}
+
+// Random graph generators draw numbers in fixed-size blocks, each with its own
+// generator, so that their output does not depend on the number of threads.
+static const size_t RandomBlockSize = 1 << 14;
+
+static std::mt19937_64 blockGenerator(uint64_t seed, uint64_t block) {
+  std::seed_seq seq = {(uint32_t)seed, (uint32_t)(seed >> 32),
+                       (uint32_t)block, (uint32_t)(block >> 32)};
+  return std::mt19937_64(seq);
+}
+
+/// Uniform double in [0,1) from the top 53 bits of the generator output.
+static inline double uniform(std::mt19937_64 &rng) {
+  return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+template <typename BlockFn>
+static void forEachRandomBlock(size_t num, BlockFn blockFn,
+                               unsigned numThreads) {
+  size_t numBlocks = (num + RandomBlockSize - 1) / RandomBlockSize;
+  util::parallelFor(0, numBlocks, [&](size_t begin, size_t end) {
+    for (size_t block=begin; block < end; ++block) {
+      size_t first = block * RandomBlockSize;
+      blockFn(block, first, std::min(num, first + RandomBlockSize));
+    }
+  }, numThreads, 1);
+}
+
+/// Points binned into a grid of cells at least as wide as the radius, so that
+/// the neighbors of a point lie in the 27 cells around it. Points are stored
+/// sorted by cell so that neighbor queries in that order stay in cache.
+struct GeometricGrid {
+  int cellsPerAxis;
+  vector<size_t> cellStart;     // first sorted point of every cell
+  vector<int> cellPoints;       // point indices sorted by cell
+  vector<double> sortedCoords;  // point coordinates sorted by cell
+  double radius2;
+
+  GeometricGrid(const vector<double> &coords, double radius)
+      : radius2(radius*radius) {
+    // Keep the grid coarse enough to have about one point per cell
+    const size_t n = coords.size() / 3;
+    cellsPerAxis = std::max(1, (int)std::min(1.0 / radius,
+                                             2.0 * std::cbrt((double)n)));
+    size_t numCells = (size_t)cellsPerAxis * cellsPerAxis * cellsPerAxis;
+    cellStart.assign(numCells+1, 0);
+    for (size_t i=0; i < n; ++i) {
+      cellStart[cellOf(&coords[3*i])+1]++;
+    }
+    std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+    cellPoints.resize(n);
+    sortedCoords.resize(3*n);
+    vector<size_t> next(cellStart.begin(), cellStart.end()-1);
+    for (size_t i=0; i < n; ++i) {
+      size_t k = next[cellOf(&coords[3*i])]++;
+      cellPoints[k] = i;
+      std::copy(&coords[3*i], &coords[3*i] + 3, &sortedCoords[3*k]);
+    }
+  }
+
+  int cellCoord(double c) const {
+    return std::min(cellsPerAxis-1, (int)(c * cellsPerAxis));
+  }
+
+  size_t cellOf(const double *p) const {
+    return ((size_t)cellCoord(p[0]) * cellsPerAxis + cellCoord(p[1])) *
+           cellsPerAxis + cellCoord(p[2]);
+  }
+
+  /// Call f(j) for every point j > i closer than the radius to point
+  /// i = cellPoints[k].
+  template <typename F>
+  void forEachNeighbor(size_t k, F f) const {
+    const int i = cellPoints[k];
+    const double *p = &sortedCoords[3*k];
+    const int c[3] = {cellCoord(p[0]), cellCoord(p[1]), cellCoord(p[2])};
+    int lo[3], hi[3];
+    for (int d=0; d < 3; ++d) {
+      lo[d] = std::max(0, c[d]-1);
+      hi[d] = std::min(cellsPerAxis-1, c[d]+1);
+    }
+    for (int x=lo[0]; x <= hi[0]; ++x) {
+      for (int y=lo[1]; y <= hi[1]; ++y) {
+        size_t row = ((size_t)x * cellsPerAxis + y) * cellsPerAxis;
+        for (size_t m=cellStart[row+lo[2]]; m < cellStart[row+hi[2]+1]; ++m) {
+          const double *q = &sortedCoords[3*m];
+          double dx = p[0]-q[0], dy = p[1]-q[1], dz = p[2]-q[2];
+          if (cellPoints[m] > i && dx*dx + dy*dy + dz*dz < radius2) {
+            f(cellPoints[m]);
+          }
+        }
+      }
+    }
+  }
+};
+
+void createRandomGeometricGraph(Set *vertices, Set *edges,
+                                unsigned numVertices, double radius,
+                                uint64_t seed, const std::string &positionField,
+                                unsigned numThreads) {
+  uassert(radius > 0.0) << "The radius must be positive";
+  uassert(numVertices <= (unsigned)INT_MAX) << "Too many vertices";
+  checkEdgeSet(edges, vertices, 2);
+  Set::FieldData *positions = getPositionField(vertices, positionField);
+
+  const size_t n = numVertices;
+  vector<double> coords(3*n);
+  forEachRandomBlock(n, [&](size_t block, size_t first, size_t last) {
+    std::mt19937_64 rng = blockGenerator(seed, block);
+    for (size_t i=3*first; i < 3*last; ++i) {
+      coords[i] = uniform(rng);
+    }
+  }, numThreads);
+
+  GeometricGrid grid(coords, radius);
+
+  // Count the edges of every vertex, then write them in vertex order. Vertices
+  // are visited in cell order for locality.
+  vector<size_t> offsets(n+1, 0);
+  util::parallelFor(0, n, [&](size_t begin, size_t end) {
+    for (size_t k=begin; k < end; ++k) {
+      size_t count = 0;
+      grid.forEachNeighbor(k, [&](int) { count++; });
+      offsets[grid.cellPoints[k]+1] = count;
+    }
+  }, numThreads);
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  uassert(offsets[n] <= (size_t)INT_MAX) << "Too many edges";
+
+  const int base = vertices->addElements(n).getIdent();
+  writePositions(positions, base, n, [&](size_t i, double *xyz) {
+    std::copy(&coords[3*i], &coords[3*i] + 3, xyz);
+  }, numThreads);
+
+  const int firstEdge = edges->addElements(offsets[n]).getIdent();
+  int *endpoints = edges->getEndpointsPtr() + 2*(size_t)firstEdge;
+  util::parallelFor(0, n, [&](size_t begin, size_t end) {
+    vector<int> neighbors;
+    for (size_t k=begin; k < end; ++k) {
+      neighbors.clear();
+      grid.forEachNeighbor(k, [&](int j) { neighbors.push_back(j); });
+      std::sort(neighbors.begin(), neighbors.end());
+      const int i = grid.cellPoints[k];
+      int *edge = endpoints + 2*offsets[i];
+      for (int j : neighbors) {
+        *edge++ = base + i;
+        *edge++ = base + j;
+      }
+    }
+  }, numThreads);
+}
+
+void createRMATGraph(Set *vertices, Set *edges,
+                     unsigned scale, unsigned edgeFactor,
+                     double a, double b, double c,
+                     uint64_t seed, unsigned numThreads) {
+  uassert(scale < 31) << "R-MAT scale must be less than 31";
+  uassert(a >= 0.0 && b >= 0.0 && c >= 0.0 && a+b+c <= 1.0)
+      << "Invalid R-MAT probabilities";
+  checkEdgeSet(edges, vertices, 2);
+  const size_t numVertices = size_t(1) << scale;
+  const size_t numEdges = numVertices * edgeFactor;
+  uassert(numEdges <= (size_t)INT_MAX) << "Too many edges";
+
+  // Random vertex relabeling (Fisher-Yates)
+  vector<int> labels(numVertices);
+  std::iota(labels.begin(), labels.end(), 0);
+  std::mt19937_64 rng = blockGenerator(seed, UINT64_MAX);
+  for (size_t i=numVertices-1; i > 0; --i) {
+    std::swap(labels[i], labels[rng() % (i+1)]);
+  }
+
+  const int base = vertices->addElements(numVertices).getIdent();
+  const int firstEdge = edges->addElements(numEdges).getIdent();
+  int *endpoints = edges->getEndpointsPtr() + 2*(size_t)firstEdge;
+  // Quadrant thresholds on 32-bit uniform words. Each 64-bit draw gives two
+  // words, which is ample resolution for the quadrant probabilities.
+  const double scale32 = 4294967296.0;
+  const uint64_t ta   = (uint64_t)(a * scale32);
+  const uint64_t tab  = (uint64_t)((a+b) * scale32);
+  const uint64_t tabc = (uint64_t)((a+b+c) * scale32);
+  forEachRandomBlock(numEdges, [&](size_t block, size_t first, size_t last) {
+    std::mt19937_64 rng = blockGenerator(seed, block);
+    for (size_t e=first; e < last; ++e) {
+      size_t source = 0, target = 0;
+      uint64_t bits = 0;
+      for (unsigned level=0; level < scale; ++level) {
+        uint64_t word;
+        if (level % 2 == 0) {
+          bits = rng();
+          word = bits & 0xffffffff;
+        }
+        else {
+          word = bits >> 32;
+        }
+        source = 2*source + (word >= tab);
+        target = 2*target + (((word >= ta) & (word < tab)) | (word >= tabc));
+      }
+      endpoints[2*e]   = base + labels[source];
+      endpoints[2*e+1] = base + labels[target];
+    }
+  }, numThreads);
+}
+
+// Mesh sets
+/// Add `num` edges to `edgeSet`, where `endpoint(i,k)` is the mesh vertex of
+/// endpoint k of edge i. If `vertexOrdering` is not empty the endpoints are
+/// renumbered by it and the edges are sorted by their endpoints.
+template <typename EndpointFn>
+static void fillMeshEdgeSet(Set *edgeSet, size_t num, EndpointFn endpoint,
+                            int numVertices, const vector<int> &vertexOrdering,
+                            unsigned numThreads) {
+  const int cardinality = edgeSet->getCardinality();
+
+  // Validate (and renumber) the endpoints before touching the set
+  vector<int> renumbered;
+  if (!vertexOrdering.empty()) {
+    renumbered.resize(num * cardinality);
+  }
+  std::atomic<bool> valid(true);
+  util::parallelFor(0, num, [&](size_t begin, size_t end) {
+    for (size_t i=begin; i < end; ++i) {
+      for (int k=0; k < cardinality; ++k) {
+        int vertex = endpoint(i,k);
+        if (vertex < 0 || vertex >= numVertices) {
+          valid = false;
+          return;
+        }
+        if (!renumbered.empty()) {
+          renumbered[i*cardinality+k] = vertexOrdering[vertex];
+        }
+      }
+    }
+  }, numThreads);
+  uassert(valid) << "Mesh element refers to a vertex that does not exist";
+
+  edgeSet->addElements(num);
+  int *endpoints = edgeSet->getEndpointsPtr();
+  if (renumbered.empty()) {
+    util::parallelFor(0, num, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        for (int k=0; k < cardinality; ++k) {
+          endpoints[i*cardinality+k] = endpoint(i,k);
+        }
+      }
+    }, numThreads);
+  }
+  else {
+    vector<int> edgeOrdering;
+    edgeVertexSortReordering(renumbered.data(), num, cardinality,
+                             edgeOrdering);
+    util::parallelFor(0, num, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        const int *source = &renumbered[edgeOrdering[i]*cardinality];
+        std::copy(source, source+cardinality, &endpoints[i*cardinality]);
+      }
+    }, numThreads);
+  }
+}
+
+std::vector<ElementRef> createMeshSets(const MeshVol &mesh, Set *vertices,
+                                       Set *elements, Set *edges,
+                                       const MeshSetOptions &options) {
+  uassert(vertices->getSize() == 0 && elements->getSize() == 0 &&
+          (edges == nullptr || edges->getSize() == 0))
+      << "createMeshSets requires empty sets";
+  const int numVertices = mesh.v.size();
+  const int cardinality = mesh.e.empty() ? elements->getCardinality()
+                                         : mesh.e[0].size();
+  for (const vector<int> &element : mesh.e) {
+    uassert((int)element.size() == cardinality)
+        << "createMeshSets requires elements with the same number of vertices";
+  }
+  checkEdgeSet(elements, vertices, cardinality);
+  if (edges != nullptr) {
+    checkEdgeSet(edges, vertices, 2);
+  }
+
+  vector<int> vertexOrdering;
+  if (options.reorder && numVertices > 0) {
+    hilbert::hilbertReorder(mesh.v[0].data(), numVertices, vertexOrdering, 8,
+                            options.numThreads);
+  }
+
+  // Vertices, gathered so that every thread writes a contiguous range
+  Set::FieldData *positions = getPositionField(vertices, options.positionField);
+  vertices->addElements(numVertices);
+  vector<int> inverse;
+  if (!vertexOrdering.empty()) {
+    inverse.resize(numVertices);
+    for (int i=0; i < numVertices; ++i) {
+      inverse[vertexOrdering[i]] = i;
+    }
+  }
+  writePositions(positions, 0, numVertices, [&](size_t i, double *xyz) {
+    const std::array<double,3> &v = mesh.v[inverse.empty() ? i : inverse[i]];
+    std::copy(v.begin(), v.end(), xyz);
+  }, options.numThreads);
+
+  // Elements and edges
+  fillMeshEdgeSet(elements, mesh.e.size(),
+                  [&mesh](size_t i, int k) { return mesh.e[i][k]; },
+                  numVertices, vertexOrdering, options.numThreads);
+  if (edges != nullptr) {
+    fillMeshEdgeSet(edges, mesh.edges.size(),
+                    [&mesh](size_t i, int k) { return mesh.edges[i][k]; },
+                    numVertices, vertexOrdering, options.numThreads);
+  }
+
+  vector<ElementRef> refs(numVertices);
+  for (int i=0; i < numVertices; ++i) {
+    int index = vertexOrdering.empty() ? i : vertexOrdering[i];
+    refs[i] = elementRef(vertices, index);
+  }
+  return refs;
+}
+
 } // namespace simit
@@ -2,6 +2,7 @@
 #define SIMIT_GRAPH_H
 
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <vector>
 #include <string>
@@ -18,6 +19,7 @@
 namespace simit {
 
 class Function;
+class Box;
 
 class Set;
 class FieldRefBase;
@@ -78,6 +80,7 @@ private:
   int ident;
 
   friend class Set;
+  friend class Box;
   friend class FieldRefBase;
   friend class internal::VertexToEdgeEndpointIndex;
   friend class internal::VertexToEdgeIndex;
@@ -177,6 +180,9 @@ public:
   /// Return the number of elements in the Set
   inline int getSize() const { return numElements; }
 
+  /// Number of elements the set has room for before it grows its fields.
+  inline int getCapacity() const { return capacity; }
+
   /// Returns the dimensions for a lattice link set
   inline const std::vector<int>& getDimensions() const {
     uassert(kind == LatticeLink)
@@ -262,6 +268,16 @@ public:
     return FieldRef<T, dimensions...>(fieldData);
   }
  
+  /// Add a tensor field whose component type and dimensions are only known at
+  /// runtime, such as fields read from a file.
+  void addField(const std::string &name, ComponentType componentType,
+                const std::vector<int> &dimensions);
+
+  /// True if the set has a field with the given name.
+  bool hasField(const std::string &name) const {
+    return fieldNames.find(name) != fieldNames.end();
+  }
+
   // Added for reordering
   void setSpatialField(const std::string& name) {
     uassert(fieldNames.find(name) != fieldNames.end())
@@ -304,6 +320,15 @@ public:
     return ElementRef(numElements++);
   }
 
+  /// Reserve storage for at least `n` elements, so that growing the set to `n`
+  /// elements does not reallocate its fields and endpoints.
+  void reserve(int n);
+
+  /// Add `num` elements in bulk, returning the first. Fields of the new
+  /// elements are zero. The endpoints of new edges are zero and must be
+  /// written through getEndpointsPtr() before the set is used.
+  ElementRef addElements(int num);
+
   /// Remove an element from the Set
   void remove(ElementRef element) {
     uassert(kind != LatticeLink)
@@ -538,7 +563,7 @@ public:
   }
 
   // A field on the members of the Set.
-  // Invariant: elements < capacity
+  // Invariant: elements <= capacity
   struct FieldData {
     // Replace with simit::TensorType
     class TensorType {
@@ -604,6 +629,8 @@ public:
   inline int getFieldIndex(std::string name) { return fieldNames[name]; } inline 
     std::vector<FieldData*>& getFields() { return fields; } inline std::string 
     getSpatialFieldName() const { return spatialFieldName; }
+  inline const std::vector<FieldData*>& getFields() const { return fields; }
+  inline const int* getEndpointsPtr() const { return endpoints; }
   inline bool hasSpatialField() const { return !spatialFieldName.empty(); }
 
 private:
@@ -1084,6 +1111,12 @@ public:
   Box(unsigned nX, unsigned nY, unsigned nZ, std::vector<ElementRef> refs,
       std::map<Box::Coord, ElementRef> coords2edges);
 
+  /// Construct a box without an edge map, whose edges were added in the order
+  /// createBox adds them starting at `firstEdge` (undefined if the box has no
+  /// edges).
+  Box(unsigned nX, unsigned nY, unsigned nZ, std::vector<ElementRef> refs,
+      ElementRef firstEdge);
+
   unsigned numX() const {return nX;}
   unsigned numY() const {return nY;}
   unsigned numZ() const {return nZ;}
@@ -1100,10 +1133,79 @@ private:
   unsigned nX, nY, nZ;
   std::vector<ElementRef> refs;
   std::map<Coord, ElementRef> coords2edges;
+  ElementRef firstEdge;
+  bool hasEdgeMap;
 };
 
+/// Create a numX*numY*numZ box of vertices, where `edges` connect every vertex
+/// to its neighbour in the positive x, y and z direction. The returned box
+/// looks edges up in a map from endpoints to edges, which costs memory and
+/// time on large boxes. If `edgeMap` is false the map is not built and edges
+/// are found arithmetically instead.
 Box createBox(Set *vertices, Set *edges,
-              unsigned numX, unsigned numY, unsigned numZ);
+              unsigned numX, unsigned numY, unsigned numZ,
+              bool edgeMap=true);
+
+/// Create a numX*numY*numZ box of vertices on a grid with unit spacing, with
+/// the vertex coordinates stored in a 3-vector position field, and decompose
+/// every grid cell into six positively oriented tetrahedra in `tets`. The
+/// decomposition is conforming, so neighbouring cells share tet faces. The
+/// position field is added as a double field if it does not exist.
+Box createTetBox(Set *vertices, Set *tets,
+                 unsigned numX, unsigned numY, unsigned numZ,
+                 const std::string &positionField="x", unsigned numThreads=0);
+
+/// Create a random geometric graph: `numVertices` points drawn uniformly from
+/// the unit cube, stored in a 3-vector position field, with an edge between
+/// every pair of points closer than `radius`. Each pair is connected once,
+/// from the lower to the higher vertex. The graph only depends on the seed,
+/// not on the number of threads used to create it.
+void createRandomGeometricGraph(Set *vertices, Set *edges,
+                                unsigned numVertices, double radius,
+                                uint64_t seed=0,
+                                const std::string &positionField="x",
+                                unsigned numThreads=0);
+
+/// Create an R-MAT (stochastic Kronecker) power-law graph with 2^scale
+/// vertices and edgeFactor*2^scale directed edges. Every edge picks one
+/// quadrant of the adjacency matrix per level with probabilities a, b, c and
+/// 1-a-b-c, as in the Graph500 generator, and vertex labels are randomly
+/// permuted so that degree does not correlate with vertex index. Self loops
+/// and duplicate edges are kept. The graph only depends on the seed, not on
+/// the number of threads used to create it.
+void createRMATGraph(Set *vertices, Set *edges,
+                     unsigned scale, unsigned edgeFactor,
+                     double a=0.57, double b=0.19, double c=0.19,
+                     uint64_t seed=0, unsigned numThreads=0);
+
+struct MeshVol;
+
+/// Options for createMeshSets.
+struct MeshSetOptions {
+  MeshSetOptions() : positionField("x"), reorder(false), numThreads(0) {}
+
+  /// Vertex field that receives the mesh vertex coordinates.
+  std::string positionField;
+
+  /// Lay the vertices out in Hilbert order and sort the elements and edges by
+  /// their endpoints while filling the sets, as simit::reorder would.
+  bool reorder;
+
+  /// Threads used to fill the sets (0 uses all hardware threads).
+  unsigned numThreads;
+};
+
+/// Build sets from a volumetric mesh in bulk. `vertices` gets one element per
+/// mesh vertex, with the coordinates stored in a 3-vector position field that
+/// is added as a double field if it does not exist. `elements` gets one edge
+/// per mesh element and `edges`, if given, one edge per mesh edge. The sets
+/// must be empty and the edge sets must have `vertices` as every endpoint set.
+/// Each set is allocated once with its exact capacity and filled in parallel.
+/// Returns the vertex element of every mesh vertex.
+std::vector<ElementRef> createMeshSets(const MeshVol &mesh, Set *vertices,
+                                       Set *elements, Set *edges=nullptr,
+                                       const MeshSetOptions &options =
+                                           MeshSetOptions());
 
 } // namespace simit
 
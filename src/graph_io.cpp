@@ -0,0 +1,570 @@
+#include "graph_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "graph.h"
+#include "util/mapped_file.h"
+#include "util/number_parsing.h"
+#include "util/parallel.h"
+#include "util/text_records.h"
+
+using namespace std;
+
+namespace simit {
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::ostream &operator<<(std::ostream &os, const GraphLoadStats &stats) {
+  return os << stats.numVertices << " vertices, " << stats.numEdges
+            << " edges, " << stats.bytes / (1024.0*1024.0) << " MB in "
+            << stats.seconds * 1000.0 << " ms ("
+            << stats.megabytesPerSecond() << " MB/s, "
+            << stats.edgesPerSecond() / 1e6 << " Medges/s)";
+}
+
+static void checkGraphSets(const Set *vertices, const Set *edges) {
+  uassert(vertices->getSize() == 0 && edges->getSize() == 0)
+      << "Graphs must be loaded into empty sets";
+  uassert(edges->getCardinality() == 2)
+      << "Graph edge sets must have two endpoints";
+  uassert(edges->getEndpointSet(0) == vertices &&
+          edges->getEndpointSet(1) == vertices)
+      << "Graph edge sets must have the vertex set as both endpoint sets";
+}
+
+/// Check that an existing weight field can hold the weights, before the file
+/// is parsed.
+static void checkWeightField(Set *edges, const string &name) {
+  if (name.empty() || !edges->hasField(name)) {
+    return;
+  }
+  Set::FieldData *field = edges->getFields()[edges->getFieldIndex(name)];
+  ComponentType type = field->type->getComponentType();
+  uassert(field->type->getSize() == 1 &&
+          (type == ComponentType::Double || type == ComponentType::Float))
+      << "Edge weights must be stored in a float or double scalar field";
+}
+
+/// Return the weight field of the edge set, adding it if needed, or nullptr if
+/// weights are not loaded.
+static Set::FieldData *getWeightField(Set *edges, const string &name) {
+  if (name.empty()) {
+    return nullptr;
+  }
+  checkWeightField(edges, name);
+  if (!edges->hasField(name)) {
+    edges->addField<double>(name);
+  }
+  return edges->getFields()[edges->getFieldIndex(name)];
+}
+
+static inline void setWeight(Set::FieldData *weights, size_t i, double value) {
+  if (weights->type->getComponentType() == ComponentType::Double) {
+    static_cast<double*>(weights->data)[i] = value;
+  }
+  else {
+    static_cast<float*>(weights->data)[i] = static_cast<float>(value);
+  }
+}
+
+/// A parsed graph, kept apart from the sets until the whole file has been
+/// parsed so that malformed files leave the sets unchanged.
+struct ParsedEdges {
+  ParsedEdges() : numVertices(0) {}
+
+  std::vector<int> endpoints;   // two per edge
+  std::vector<double> weights;  // one per edge, or empty
+  int numVertices;
+};
+
+/// Parse the `source target [weight]` lines in [begin,end), and count as many
+/// vertices as the largest index requires. If `numExpected` is not negative
+/// the file must have exactly that many edges. Indices must lie in
+/// [indexBase, indexBase+maxRows) and [indexBase, indexBase+maxCols).
+static int parseEdges(const char *begin, const char *end,
+                      const char *commentChars, int indexBase,
+                      int64_t maxRows, int64_t maxCols, int64_t numExpected,
+                      bool loadWeights, unsigned numThreads,
+                      ParsedEdges *parsed) {
+  vector<int> maxVertex;
+  bool ok = util::parseRecords(begin, end, numThreads, commentChars,
+      [&](size_t numRecords, unsigned numChunks) {
+    if (numRecords > (size_t)INT_MAX ||
+        (numExpected >= 0 && numRecords != (size_t)numExpected)) {
+      return false;
+    }
+    parsed->endpoints.resize(2*numRecords);
+    if (loadWeights) {
+      parsed->weights.resize(numRecords);
+    }
+    maxVertex.assign(numChunks, -1);
+    return true;
+  },
+      [&](unsigned chunk, size_t record, const char *line,
+          const char *lineEnd) {
+    int64_t source, target;
+    const char *p = util::nextInt(line, lineEnd, source);
+    p = util::nextInt(p, lineEnd, target);
+    if (p == nullptr) {
+      return false;
+    }
+    source -= indexBase;
+    target -= indexBase;
+    if (source < 0 || source >= maxRows || target < 0 || target >= maxCols) {
+      return false;
+    }
+    parsed->endpoints[2*record]   = (int)source;
+    parsed->endpoints[2*record+1] = (int)target;
+    maxVertex[chunk] = max(maxVertex[chunk], (int)max(source, target));
+    if (loadWeights) {
+      // Edges without a weight get unit weights, but a weight must parse
+      double weight = 1.0;
+      p = util::skipBlanks(p, lineEnd);
+      if (p < lineEnd && *p != '\n') {
+        p = util::nextDouble(p, lineEnd, weight);
+        if (p == nullptr || (p < lineEnd && !util::isBlank(*p) && *p != '\n')) {
+          return false;
+        }
+      }
+      parsed->weights[record] = weight;
+    }
+    return true;
+  });
+  if (!ok) {
+    return -1;
+  }
+  parsed->numVertices = maxVertex.empty() ? 0 : *max_element(maxVertex.begin(),
+                                                             maxVertex.end())+1;
+  return 0;
+}
+
+/// Add the parsed vertices and edges to the sets.
+static void addEdges(const ParsedEdges &parsed, Set *vertices, Set *edges,
+                     const GraphLoadOptions &options) {
+  size_t numEdges = parsed.endpoints.size() / 2;
+  vertices->addElements(parsed.numVertices);
+  edges->addElements(numEdges);
+  Set::FieldData *weights = getWeightField(edges, options.weightField);
+  int *endpoints = edges->getEndpointsPtr();
+  util::parallelFor(0, numEdges, [&](size_t b, size_t e) {
+    copy(parsed.endpoints.begin() + 2*b, parsed.endpoints.begin() + 2*e,
+         endpoints + 2*b);
+    for (size_t i=b; weights != nullptr && i < e; ++i) {
+      setWeight(weights, i, parsed.weights[i]);
+    }
+  }, options.numThreads);
+}
+
+static void fillStats(GraphLoadStats *stats, size_t bytes,
+                      const Set *vertices, const Set *edges,
+                      Clock::time_point start) {
+  if (stats != nullptr) {
+    stats->seconds = secondsSince(start);
+    stats->bytes = bytes;
+    stats->numVertices = vertices->getSize();
+    stats->numEdges = edges->getSize();
+  }
+}
+
+static int spillSnapshot(const GraphLoadOptions &options,
+                         const Set *vertices, const Set *edges) {
+  if (options.snapshotFile.empty()) {
+    return 0;
+  }
+  return saveGraphSnapshot(options.snapshotFile, *vertices, *edges);
+}
+
+int loadEdgeList(const std::string &filename, Set *vertices, Set *edges,
+                 const GraphLoadOptions &options, GraphLoadStats *stats) {
+  checkGraphSets(vertices, edges);
+  Clock::time_point start = Clock::now();
+
+  util::MappedFile file;
+  if (file.open(filename) < 0) {
+    cerr << "Cannot read " << filename << endl;
+    return -1;
+  }
+  checkWeightField(edges, options.weightField);
+  ParsedEdges parsed;
+  if (parseEdges(file.begin(), file.end(), "#%", options.indexBase, INT_MAX,
+                 INT_MAX, -1, !options.weightField.empty(),
+                 options.numThreads, &parsed) < 0) {
+    cerr << "Malformed edge list " << filename << endl;
+    return -1;
+  }
+  addEdges(parsed, vertices, edges, options);
+  fillStats(stats, file.getSize(), vertices, edges, start);
+  return spillSnapshot(options, vertices, edges);
+}
+
+/// Read the next blank-separated word of the line, lower-cased.
+static const char *nextWord(const char *p, const char *lineEnd, string &word) {
+  p = util::skipBlanks(p, lineEnd);
+  word.clear();
+  while (p < lineEnd && !util::isBlank(*p) && *p != '\n') {
+    word += tolower(*p++);
+  }
+  return p;
+}
+
+int loadMatrixMarket(const std::string &filename, Set *vertices, Set *edges,
+                     const GraphLoadOptions &options, GraphLoadStats *stats) {
+  checkGraphSets(vertices, edges);
+  Clock::time_point start = Clock::now();
+
+  util::MappedFile file;
+  if (file.open(filename) < 0) {
+    cerr << "Cannot read " << filename << endl;
+    return -1;
+  }
+  const char *end = file.end();
+
+  // Banner: %%MatrixMarket matrix coordinate <field> <symmetry>
+  const char *line = file.begin();
+  const char *lineEnd = util::nextLine(line, end);
+  string banner, object, format, field, symmetry;
+  const char *p = nextWord(line, lineEnd, banner);
+  p = nextWord(p, lineEnd, object);
+  p = nextWord(p, lineEnd, format);
+  p = nextWord(p, lineEnd, field);
+  p = nextWord(p, lineEnd, symmetry);
+  if (banner != "%%matrixmarket" || object != "matrix") {
+    cerr << "Malformed Matrix Market banner in " << filename << endl;
+    return -1;
+  }
+  if (format != "coordinate" ||
+      (field != "real" && field != "double" && field != "integer" &&
+       field != "pattern") ||
+      (symmetry != "general" && symmetry != "symmetric" &&
+       symmetry != "skew-symmetric")) {
+    cerr << "Unsupported Matrix Market format '" << format << " " << field
+         << " " << symmetry << "' in " << filename << endl;
+    return -1;
+  }
+
+  // Size line: rows columns entries
+  line = lineEnd;
+  while (line < end &&
+         !util::isDataLine(line, util::nextLine(line, end), "%")) {
+    line = util::nextLine(line, end);
+  }
+  lineEnd = util::nextLine(line, end);
+  int64_t rows, cols, numEntries;
+  p = util::nextInt(line, lineEnd, rows);
+  p = util::nextInt(p, lineEnd, cols);
+  p = util::nextInt(p, lineEnd, numEntries);
+  if (p == nullptr || rows < 0 || cols < 0 || numEntries < 0 ||
+      rows > INT_MAX || cols > INT_MAX) {
+    cerr << "Malformed Matrix Market size line in " << filename << endl;
+    return -1;
+  }
+
+  // Entries of pattern matrices have no value and get unit weights
+  checkWeightField(edges, options.weightField);
+  ParsedEdges parsed;
+  if (parseEdges(lineEnd, end, "%", 1, rows, cols, numEntries,
+                 !options.weightField.empty(), options.numThreads,
+                 &parsed) < 0) {
+    cerr << "Malformed Matrix Market file " << filename << endl;
+    return -1;
+  }
+  parsed.numVertices = max(rows, cols);
+
+  // Add the mirrored edge of every off-diagonal entry of symmetric matrices
+  if (symmetry != "general") {
+    const double sign = (symmetry == "skew-symmetric") ? -1.0 : 1.0;
+    const size_t numStored = parsed.endpoints.size() / 2;
+    unsigned numChunks = util::numThreads(options.numThreads);
+    vector<size_t> offsets(numChunks+1, 0);
+    auto chunkRange = [&](unsigned chunk, size_t *first, size_t *last) {
+      *first = numStored * chunk / numChunks;
+      *last = numStored * (chunk+1) / numChunks;
+    };
+    util::parallelChunks(numChunks, [&](unsigned chunk) {
+      const int *endpoints = parsed.endpoints.data();
+      size_t first, last;
+      chunkRange(chunk, &first, &last);
+      for (size_t i=first; i < last; ++i) {
+        offsets[chunk+1] += (endpoints[2*i] != endpoints[2*i+1]);
+      }
+    });
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    if (numStored + offsets[numChunks] > (size_t)INT_MAX) {
+      cerr << "Too many edges in " << filename << endl;
+      return -1;
+    }
+    const size_t numEdges = numStored + offsets[numChunks];
+    parsed.endpoints.resize(2*numEdges);
+    if (!parsed.weights.empty()) {
+      parsed.weights.resize(numEdges);
+    }
+    util::parallelChunks(numChunks, [&](unsigned chunk) {
+      int *endpoints = parsed.endpoints.data();
+      double *weights = parsed.weights.data();
+      size_t first, last;
+      chunkRange(chunk, &first, &last);
+      size_t mirror = numStored + offsets[chunk];
+      for (size_t i=first; i < last; ++i) {
+        if (endpoints[2*i] != endpoints[2*i+1]) {
+          endpoints[2*mirror]   = endpoints[2*i+1];
+          endpoints[2*mirror+1] = endpoints[2*i];
+          if (!parsed.weights.empty()) {
+            weights[mirror] = sign * weights[i];
+          }
+          mirror++;
+        }
+      }
+    });
+  }
+  addEdges(parsed, vertices, edges, options);
+
+  fillStats(stats, file.getSize(), vertices, edges, start);
+  return spillSnapshot(options, vertices, edges);
+}
+
+
+// Snapshots
+//
+// A snapshot stores a vertex set followed by an edge set, in native byte
+// order:
+//   magic "SIMITSGS", uint32 version
+//   per set: int64 size, int32 cardinality, int32 field count,
+//            int32 endpoints[size*cardinality],
+//            per field: uint32 name length, name, int32 component type,
+//                       int32 order, int32 dimensions[order],
+//                       data[size*field size]
+static const char SnapshotMagic[8] = {'S','I','M','I','T','S','G','S'};
+static const uint32_t SnapshotVersion = 1;
+
+template <typename T>
+static void writeValue(ofstream &out, T value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(ifstream &in, T &value) {
+  return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+static void writeSet(ofstream &out, const Set &set) {
+  int64_t size = set.getSize();
+  int32_t cardinality = set.getCardinality();
+  writeValue(out, size);
+  writeValue(out, cardinality);
+  writeValue(out, (int32_t)set.getFields().size());
+  if (cardinality > 0) {
+    out.write(reinterpret_cast<const char*>(set.getEndpointsPtr()),
+              size * cardinality * sizeof(int));
+  }
+  for (const Set::FieldData *field : set.getFields()) {
+    writeValue(out, (uint32_t)field->name.size());
+    out.write(field->name.data(), field->name.size());
+    writeValue(out, (int32_t)field->type->getComponentType());
+    writeValue(out, (int32_t)field->type->getOrder());
+    for (size_t i=0; i < field->type->getOrder(); ++i) {
+      writeValue(out, (int32_t)field->type->getDimension(i));
+    }
+    out.write(static_cast<const char*>(field->data), size * field->sizeOfType);
+  }
+}
+
+int saveGraphSnapshot(const std::string &filename, const Set &vertices,
+                      const Set &edges) {
+  ofstream out(filename, ios::binary);
+  if (!out.good()) {
+    cerr << "Cannot write to " << filename << endl;
+    return -1;
+  }
+  out.write(SnapshotMagic, sizeof(SnapshotMagic));
+  writeValue(out, SnapshotVersion);
+  writeSet(out, vertices);
+  writeSet(out, edges);
+  if (!out.good()) {
+    cerr << "Cannot write to " << filename << endl;
+    return -1;
+  }
+  return 0;
+}
+
+/// A set read from a snapshot, kept apart from the Set until the whole
+/// snapshot has been read and validated.
+struct SnapshotSet {
+  struct Field {
+    string name;
+    ComponentType type;
+    vector<int> dimensions;
+    vector<char> data;
+  };
+
+  int64_t size;
+  vector<int> endpoints;
+  vector<Field> fields;
+};
+
+/// Read a set record whose arrays must fit in the `remaining` bytes of the
+/// file, and check that its fields can be stored in the fields of `set`.
+static bool readSet(ifstream &in, int64_t remaining, const Set &set,
+                    SnapshotSet *snapshot) {
+  int64_t size;
+  int32_t cardinality, numFields;
+  if (!readValue(in, size) || !readValue(in, cardinality) ||
+      !readValue(in, numFields) || size < 0 || size > INT_MAX ||
+      cardinality != set.getCardinality() || numFields < 0 ||
+      size * cardinality * (int64_t)sizeof(int) > remaining) {
+    return false;
+  }
+  snapshot->size = size;
+  snapshot->endpoints.resize(size * cardinality);
+  if (cardinality > 0 &&
+      !in.read(reinterpret_cast<char*>(snapshot->endpoints.data()),
+               size * cardinality * sizeof(int))) {
+    return false;
+  }
+
+  for (int32_t f=0; f < numFields; ++f) {
+    uint32_t nameLength;
+    int32_t componentType, order;
+    if (!readValue(in, nameLength) || nameLength > (1u << 16)) {
+      return false;
+    }
+    string name(nameLength, ' ');
+    if (!in.read(&name[0], nameLength) || !readValue(in, componentType) ||
+        !readValue(in, order) || componentType < 0 ||
+        componentType > (int32_t)ComponentType::DoubleComplex || order < 0 ||
+        order * (int64_t)sizeof(int32_t) > remaining) {
+      return false;
+    }
+    ComponentType type = static_cast<ComponentType>(componentType);
+    vector<int> dimensions(order);
+    int64_t fieldBytes = size * componentSize(type);
+    for (int32_t i=0; i < order; ++i) {
+      if (!readValue(in, dimensions[i]) || dimensions[i] < 0) {
+        return false;
+      }
+      fieldBytes *= dimensions[i];
+      if (fieldBytes > remaining) {
+        return false;
+      }
+    }
+
+    for (const Set::FieldData *field : set.getFields()) {
+      if (field->name != name) {
+        continue;
+      }
+      bool sameType = field->type->getComponentType() == type &&
+                      field->type->getOrder() == dimensions.size();
+      for (size_t i=0; sameType && i < dimensions.size(); ++i) {
+        sameType = (int)field->type->getDimension(i) == dimensions[i];
+      }
+      if (!sameType) {
+        cerr << "Snapshot field " << name << " does not match the set field"
+             << endl;
+        return false;
+      }
+    }
+    SnapshotSet::Field field = {name, type, dimensions,
+                                vector<char>(fieldBytes)};
+    if (!in.read(field.data.data(), fieldBytes)) {
+      return false;
+    }
+    snapshot->fields.push_back(move(field));
+  }
+  return true;
+}
+
+/// Add the elements and field values of a validated snapshot set to the set.
+static void addSet(const SnapshotSet &snapshot, Set *set) {
+  set->addElements(snapshot.size);
+  copy(snapshot.endpoints.begin(), snapshot.endpoints.end(),
+       set->getEndpointsPtr());
+  for (const SnapshotSet::Field &field : snapshot.fields) {
+    if (!set->hasField(field.name)) {
+      set->addField(field.name, field.type, field.dimensions);
+    }
+    copy(field.data.begin(), field.data.end(),
+         static_cast<char*>(set->getFields()[set->getFieldIndex(field.name)]
+                                ->data));
+  }
+}
+
+int loadGraphSnapshot(const std::string &filename, Set *vertices, Set *edges,
+                      GraphLoadStats *stats) {
+  checkGraphSets(vertices, edges);
+  Clock::time_point start = Clock::now();
+
+  ifstream in(filename, ios::binary | ios::ate);
+  if (!in.good()) {
+    cerr << "Cannot read " << filename << endl;
+    return -1;
+  }
+  const int64_t fileSize = in.tellg();
+  in.seekg(0);
+  char magic[sizeof(SnapshotMagic)];
+  uint32_t version;
+  if (!in.read(magic, sizeof(magic)) ||
+      !equal(magic, magic+sizeof(magic), SnapshotMagic) ||
+      !readValue(in, version) || version != SnapshotVersion) {
+    cerr << filename << " is not a graph snapshot" << endl;
+    return -1;
+  }
+  SnapshotSet vertexSnapshot, edgeSnapshot;
+  if (!readSet(in, fileSize - in.tellg(), *vertices, &vertexSnapshot) ||
+      !readSet(in, fileSize - in.tellg(), *edges, &edgeSnapshot)) {
+    cerr << "Malformed graph snapshot " << filename << endl;
+    return -1;
+  }
+
+  // Validate the endpoints, since the snapshot is read without parsing
+  const int *endpoints = edgeSnapshot.endpoints.data();
+  const int64_t numVertices = vertexSnapshot.size;
+  std::atomic<bool> valid(true);
+  util::parallelFor(0, edgeSnapshot.endpoints.size(), [&](size_t b, size_t e) {
+    for (size_t i=b; i < e; ++i) {
+      if (endpoints[i] < 0 || endpoints[i] >= numVertices) {
+        valid = false;
+        return;
+      }
+    }
+  });
+  if (!valid) {
+    cerr << "Malformed graph snapshot " << filename << endl;
+    return -1;
+  }
+
+  addSet(vertexSnapshot, vertices);
+  addSet(edgeSnapshot, edges);
+  fillStats(stats, (size_t)in.tellg(), vertices, edges, start);
+  return 0;
+}
+
+static bool hasExtension(const string &filename, const string &extension) {
+  return filename.size() >= extension.size() &&
+         filename.compare(filename.size() - extension.size(), string::npos,
+                          extension) == 0;
+}
+
+int loadGraph(const std::string &filename, Set *vertices, Set *edges,
+              const GraphLoadOptions &options, GraphLoadStats *stats) {
+  if (hasExtension(filename, ".mtx")) {
+    return loadMatrixMarket(filename, vertices, edges, options, stats);
+  }
+  else if (hasExtension(filename, ".sgs")) {
+    return loadGraphSnapshot(filename, vertices, edges, stats);
+  }
+  return loadEdgeList(filename, vertices, edges, options, stats);
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef SIMIT_GRAPH_IO_H
+#define SIMIT_GRAPH_IO_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace simit {
+class Set;
+
+/// Options for the graph loaders.
+struct GraphLoadOptions {
+  GraphLoadOptions() : indexBase(0), numThreads(0) {}
+
+  /// Edge field that receives the edge weights. Weights are not loaded if it
+  /// is empty. The field is added as a double field if the edge set does not
+  /// have it, and edges without a weight get weight 1.
+  std::string weightField;
+
+  /// Index of the first vertex in edge list files. Matrix Market files are
+  /// always one-based.
+  int indexBase;
+
+  /// Threads used to parse the file (0 uses all hardware threads).
+  unsigned numThreads;
+
+  /// If not empty, the loaded graph is also saved as a binary snapshot to this
+  /// file, which loadGraphSnapshot reloads without parsing.
+  std::string snapshotFile;
+};
+
+/// Statistics reported by the graph loaders.
+struct GraphLoadStats {
+  GraphLoadStats() : bytes(0), numVertices(0), numEdges(0), seconds(0.0) {}
+
+  size_t bytes;
+  size_t numVertices;
+  size_t numEdges;
+  double seconds;
+
+  double megabytesPerSecond() const {
+    return (seconds > 0.0) ? bytes / (1024.0*1024.0) / seconds : 0.0;
+  }
+  double edgesPerSecond() const {
+    return (seconds > 0.0) ? numEdges / seconds : 0.0;
+  }
+};
+std::ostream &operator<<(std::ostream &os, const GraphLoadStats &stats);
+
+/// Load a whitespace-separated edge list with one `source target [weight]`
+/// edge per line, where lines starting with '#' or '%' are comments. The
+/// vertex set gets one element per vertex up to the largest vertex index, and
+/// the edge set (which must have the vertex set as both endpoint sets) one
+/// element per line. Both sets must be empty. The file is memory-mapped and
+/// parsed in parallel straight into the sets.
+/// return -1 if failed to load
+int loadEdgeList(const std::string &filename, Set *vertices, Set *edges,
+                 const GraphLoadOptions &options=GraphLoadOptions(),
+                 GraphLoadStats *stats=nullptr);
+
+/// Load a Matrix Market coordinate file as a graph, with one edge from the row
+/// to the column vertex of every entry and the entry values as weights.
+/// Symmetric and skew-symmetric matrices get an edge in each direction for
+/// every off-diagonal entry. Requirements on the sets are as for loadEdgeList.
+/// return -1 if failed to load or the format is unsupported
+int loadMatrixMarket(const std::string &filename, Set *vertices, Set *edges,
+                     const GraphLoadOptions &options=GraphLoadOptions(),
+                     GraphLoadStats *stats=nullptr);
+
+/// Save a vertex set, an edge set over it and all their fields to a binary
+/// snapshot file.
+/// return -1 if failed to save
+int saveGraphSnapshot(const std::string &filename, const Set &vertices,
+                      const Set &edges);
+
+/// Load a snapshot saved by saveGraphSnapshot into empty sets. Fields in the
+/// snapshot are added to the sets unless they already exist, in which case
+/// their types must match.
+/// return -1 if failed to load
+int loadGraphSnapshot(const std::string &filename, Set *vertices, Set *edges,
+                      GraphLoadStats *stats=nullptr);
+
+/// Load a graph, choosing the loader from the file extension: `.mtx` files
+/// are Matrix Market files, `.sgs` files snapshots and all others edge lists.
+/// return -1 if failed to load
+int loadGraph(const std::string &filename, Set *vertices, Set *edges,
+              const GraphLoadOptions &options=GraphLoadOptions(),
+              GraphLoadStats *stats=nullptr);
+
+}
+#endif
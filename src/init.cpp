@@ -1,5 +1,16 @@
 #include "init.h"
 
 namespace simit {
+std::string kCPU = "host";
+std::string kCPUFeatures = "";
 bool kIndexlessStencils;
+bool kDebugInfo = false;
+bool kPerfMap = false;
+bool kHugePages = false;
+bool kFuseLoops = true;
+bool kEliminateRedundancy = true;
+bool kReuseBuffers = true;
+int kScalarizeSize = 64;
+MatrixFree kMatrixFree = MatrixFree::Never;
+MathAccuracy kMathAccuracy = MathAccuracy::Precise;
 }
@@ -11,14 +11,104 @@
 namespace simit {
 
 extern const std::vector<std::string> VALID_BACKENDS;
+
+/// When to multiply by system matrices without assembling them.
+enum class MatrixFree {
+  Never,   ///< Always assemble system matrices.
+  Auto,    ///< Use the cost model to decide per matrix.
+  Always   ///< Never assemble a matrix that is only multiplied by vectors.
+};
+
+/// How accurately generated code computes transcendental functions and
+/// floating point arithmetic, traded for speed.
+enum class MathAccuracy {
+  Precise,  ///< Call the scalar libm function for every sin, cos, exp, log
+            ///< and pow (within 1 ulp of the exact result).
+  Vector,   ///< Let loops that call them vectorize, using the SIMD variants
+            ///< of glibc's libmvec (within 4 ulp) where it is available.
+  Fast      ///< Vector, and also compile floating point arithmetic with
+            ///< LLVM's unsafe algebra: it may reassociate (e.g. to
+            ///< vectorize sums over sets), replace divisions by
+            ///< multiplications with the reciprocal, and assume that no
+            ///< value is NaN or infinite, so code that produces them has
+            ///< undefined results.
+};
+
 extern std::string kBackend;
+extern std::string kCPU;
+extern std::string kCPUFeatures;
 extern bool kIndexlessStencils;
+extern bool kDebugInfo;
+extern bool kPerfMap;
+extern bool kHugePages;
+extern bool kFuseLoops;
+extern bool kEliminateRedundancy;
+extern bool kReuseBuffers;
+extern int kScalarizeSize;
+extern MatrixFree kMatrixFree;
+extern MathAccuracy kMathAccuracy;
 
 // Settings struct with default values
 struct Settings {
   std::string backend="cpu";
   int floatSize = 8;
+
+  /// The LLVM name of the CPU to generate CPU code for, e.g. "haswell" or
+  /// "skylake-avx512". "host" targets the CPU and features of the machine that
+  /// compiles, and "generic" the baseline of its architecture, which runs on
+  /// any machine of that architecture.
+  std::string cpu = "host";
+
+  /// Comma separated features to enable or disable on top of those of `cpu`,
+  /// e.g. "+fma,-avx512f". The math functions Vector accuracy calls are chosen
+  /// by the features of the host, or listed here for other CPUs.
+  std::string cpuFeatures = "";
   bool indexlessStencils = false;
+
+  /// Emit debug line info that maps generated code to the Simit source
+  /// lines it came from, for debuggers and for perfMap.
+  bool debugInfo = false;
+
+  /// Append the address ranges of generated functions to /tmp/perf-<pid>.map
+  /// so that perf attributes samples in them. With debugInfo the ranges are
+  /// split by Simit source line.
+  bool perfMap = false;
+
+  /// Back large temporaries and buffers (2MB and up) with transparent huge
+  /// pages where the OS supports them.
+  bool hugePages = false;
+
+  /// Fuse consecutive loops over the same set on the CPU, e.g. the SpMV of a
+  /// CG iteration with the dot product that consumes its result.
+  bool fuseLoops = true;
+
+  /// Move code out of the loops of inlined maps that computes the same value
+  /// in every iteration, and keep scalars that are read more than once in
+  /// locals, e.g. the endpoints and fields an element function reads.
+  bool eliminateRedundancy = true;
+
+  /// Let system tensor temporaries that are not live at the same time share
+  /// one buffer, and let dense temporaries update the buffer of an operand
+  /// that dies in the element-wise statement that defines them in place.
+  bool reuseBuffers = true;
+
+  /// Fully unroll loop nests of at most this many iterations over dense
+  /// tensors of at most this many components, e.g. the 3x3 matrix products of
+  /// element functions, and keep such local tensors in scalars instead of
+  /// memory. 0 disables it.
+  int scalarizeSize = 64;
+
+  /// Do not assemble a matrix `A = map f to E reduce +` that is only used in
+  /// products `A*x`. Each product is computed by a map that multiplies the
+  /// blocks f computes by x instead, which recomputes f but never stores A.
+  /// With Auto this is done when the cost model estimates that evaluating f
+  /// is cheaper than streaming the assembled matrix.
+  MatrixFree matrixFree = MatrixFree::Never;
+
+  /// The accuracy of the math functions and floating point arithmetic of CPU
+  /// code. Precise gives the same results as scalar C code, while Vector and
+  /// Fast let element loops that call sin, cos, exp, log or pow vectorize.
+  MathAccuracy mathAccuracy = MathAccuracy::Precise;
 };
 
 inline void init(const Settings& settings) {
@@ -34,8 +124,38 @@ inline void init(const Settings& settings) {
       << "Invalid float bytes: " << settings.floatSize;
   ir::ScalarType::floatBytes = settings.floatSize;
 
+  // cpu
+  uassert(!settings.cpu.empty()) << "Invalid cpu: use \"host\" or a CPU name";
+  kCPU = settings.cpu;
+
+  // cpuFeatures
+  size_t feature = 0;
+  while (feature < settings.cpuFeatures.size()) {
+    uassert(settings.cpuFeatures[feature] == '+' ||
+            settings.cpuFeatures[feature] == '-')
+        << "Invalid cpu features: " << settings.cpuFeatures
+        << " (features must start with + or -)";
+    feature = settings.cpuFeatures.find(',', feature);
+    feature = (feature == std::string::npos) ? feature : feature + 1;
+  }
+  kCPUFeatures = settings.cpuFeatures;
+
   // indexlessStencils
   kIndexlessStencils = settings.indexlessStencils;
+
+  kDebugInfo = settings.debugInfo;
+  kPerfMap = settings.perfMap;
+  kHugePages = settings.hugePages;
+  kFuseLoops = settings.fuseLoops;
+  kEliminateRedundancy = settings.eliminateRedundancy;
+  kReuseBuffers = settings.reuseBuffers;
+
+  // scalarizeSize
+  uassert(settings.scalarizeSize >= 0)
+      << "Invalid scalarize size: " << settings.scalarizeSize;
+  kScalarizeSize = settings.scalarizeSize;
+  kMatrixFree = settings.matrixFree;
+  kMathAccuracy = settings.mathAccuracy;
 }
 
 inline void init(std::string backend="cpu", int floatSize=8) {
@@ -11,6 +11,7 @@
 #include "lattice_ops.h"
 #include "tensor_index.h"
 #include "stencils.h"
+#include "var_replace_rewriter.h"
 
 using namespace std;
 
@@ -383,6 +384,41 @@ Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
   }
 }
 
+/// Returns true if `stmt` assigns to `var` or writes to its components.
+static bool isAssigned(Stmt stmt, Var var) {
+  class IsAssigned : public IRVisitor {
+  public:
+    IsAssigned(Var var) : var(var) {}
+    Var var;
+    bool assigned = false;
+
+    using IRVisitor::visit;
+    void visit(const AssignStmt *op) {
+      assigned |= (op->var == var);
+      IRVisitor::visit(op);
+    }
+    void visit(const TensorWrite *op) {
+      Expr tensor = op->tensor;
+      while (isa<TensorRead>(tensor)) {
+        tensor = to<TensorRead>(tensor)->tensor;
+      }
+      assigned |= (isa<VarExpr>(tensor) && to<VarExpr>(tensor)->var == var);
+      IRVisitor::visit(op);
+    }
+    void visit(const CallStmt *op) {
+      assigned |= util::contains(op->results, var);
+      IRVisitor::visit(op);
+    }
+    void visit(const Map *op) {
+      assigned |= util::contains(op->vars, var);
+      IRVisitor::visit(op);
+    }
+  };
+  IsAssigned visitor(var);
+  stmt.accept(&visitor);
+  return visitor.assigned;
+}
+
 Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
                Storage* storage) {
   Func kernel = map->function;
@@ -411,6 +447,15 @@ Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
   for (size_t i=0; i<map->partial_actuals.size(); i++) {
     Var tvar = kernel.getArguments()[i];
     Expr rval = map->partial_actuals[i];
+    // Read system tensors the map does not write in place instead of copying
+    // them, e.g. the vector of a matrix-free product
+    if (isa<VarExpr>(rval) && isSystemTensorType(rval.type()) &&
+        !util::contains(map->vars, to<VarExpr>(rval)->var) &&
+        !isAssigned(kernel.getBody(), tvar)) {
+      inlinedMapFunc = replaceVar(inlinedMapFunc, tvar,
+                                  to<VarExpr>(rval)->var);
+      continue;
+    }
     initializers.push_back(AssignStmt::make(tvar, rval));
   }
 
@@ -1,12 +1,15 @@
 #include "insert_frees.h"
 
+#include <set>
 #include <stack>
 
 #include "ir.h"
 #include "ir_rewriter.h"
 #include "intrinsics.h"
+#include "ir_visitor.h"
 #include "tensor_index.h"
 #include "path_expressions.h"
+#include "util/collections.h"
 
 using namespace std;
 
@@ -15,12 +18,20 @@ namespace ir {
 
 class InsertFrees : public IRRewriter {
 public:
-  InsertFrees(const Storage& storage) : storage{storage} {}
+  InsertFrees(const Storage& storage, const set<Var>& callResults)
+      : storage{storage}, callResults(callResults), loopDepth(0) {}
 
 private:
   const Storage& storage;
+  const set<Var>& callResults;
   stack<vector<Var>> varsToFreeStack;
 
+  /// The number of loops around the current statement, and the declarations
+  /// and frees moved out of the loops.
+  int loopDepth;
+  vector<Stmt> loopDecls;
+  vector<Var> loopVarsToFree;
+
   using IRRewriter::visit;
 
   void visit(const Scope* op) {
@@ -39,23 +50,68 @@ private:
     // If a indexed tensor does not have a path expression, then its storage is
     // managed on the stack and it must be freed.
     Var var = op->var;
+    stmt = op;
     if (storage.hasStorage(var)) {
       auto tensorStorage = storage.getStorage(var);
       if (tensorStorage.getKind() == TensorStorage::Indexed) {
         auto index = tensorStorage.getTensorIndex();
         if (!index.getPathExpression().defined()) {
-          varsToFreeStack.top().push_back(index.getRowptrArray());
-          varsToFreeStack.top().push_back(index.getColidxArray());
-          varsToFreeStack.top().push_back(var);
+          vector<Var> vars = {index.getRowptrArray(), index.getColidxArray(),
+                              var};
+          // The runtime's sparse products reallocate the arrays of a previous
+          // result that are passed back to them, so tensors computed in a loop
+          // are declared in front of the loop and freed after it. Extern
+          // functions allocate new arrays with mallocMatrix, so their results
+          // are still freed every iteration.
+          if (loopDepth > 0 && !util::contains(callResults, var)) {
+            loopDecls.push_back(op);
+            loopVarsToFree.insert(loopVarsToFree.end(),vars.begin(),vars.end());
+            stmt = Stmt();
+          }
+          else {
+            varsToFreeStack.top().insert(varsToFreeStack.top().end(),
+                                         vars.begin(), vars.end());
+          }
         }
       }
     }
-    stmt = op;
+  }
+
+  template <class Loop>
+  void visitLoop(const Loop* op) {
+    loopDepth++;
+    IRRewriter::visit(op);
+    loopDepth--;
+    if (loopDepth == 0 && !loopDecls.empty()) {
+      loopDecls.push_back(stmt);
+      stmt = Block::make(loopDecls);
+      varsToFreeStack.top().insert(varsToFreeStack.top().end(),
+                                   loopVarsToFree.begin(),
+                                   loopVarsToFree.end());
+      loopDecls.clear();
+      loopVarsToFree.clear();
+    }
+  }
+
+  void visit(const ForRange* op) {
+    visitLoop(op);
+  }
+
+  void visit(const For* op) {
+    visitLoop(op);
+  }
+
+  void visit(const While* op) {
+    visitLoop(op);
   }
 };
 
 Func insertFrees(Func func) {
-  return InsertFrees(func.getStorage()).rewrite(func);
+  set<Var> callResults;
+  match(func.getBody(), function<void(const CallStmt*)>([&](const CallStmt* op){
+    callResults.insert(op->results.begin(), op->results.end());
+  }));
+  return InsertFrees(func.getStorage(), callResults).rewrite(func);
 }
 
 }}
@@ -7,7 +7,9 @@ namespace simit {
 namespace ir {
 
 /// Insert a free wherever a sparse tensor allocated by an extern function
-/// leaves scope.
+/// leaves scope. Sparse tensors computed in loops are declared in front of the
+/// outermost loop and freed after it, so that the runtime can reuse their
+/// arrays in every iteration.
 Func insertFrees(Func func);
 
 }}
@@ -431,18 +431,32 @@ const Func& clock() {
   return clockVar;
 }
 
-static Func storeTimeVar;
-void storeTimeInit() {
-  storeTimeVar = Func("storeTime",
-                      {Var("i", Int), Var("val", Float)},
-                      {Var("r", Float)},
+static Func startTimerVar;
+void startTimerInit() {
+  startTimerVar = Func("startTimer",
+                       {Var("id", Int)},
+                       {},
+                       Func::Intrinsic);
+}
+const Func& startTimer() {
+  if (!startTimerVar.defined()) {
+    startTimerInit();
+  }
+  return startTimerVar;
+}
+
+static Func stopTimerVar;
+void stopTimerInit() {
+  stopTimerVar = Func("stopTimer",
+                      {Var("id", Int)},
+                      {},
                       Func::Intrinsic);
 }
-const Func& storeTime() {
-  if (!storeTimeVar.defined()) {
-    storeTimeInit();
+const Func& stopTimer() {
+  if (!stopTimerVar.defined()) {
+    stopTimerInit();
   }
-  return storeTimeVar;
+  return stopTimerVar;
 }
 
 static Func mallocVar;
@@ -521,7 +535,8 @@ const std::map<std::string,Func> &byNames() {
     strcpyInit();
     strcatInit();
     clockInit();
-    storeTimeInit();
+    startTimerInit();
+    stopTimerInit();
     mallocInit();
     freeInit();
     locInit();
@@ -555,7 +570,8 @@ const std::map<std::string,Func> &byNames() {
                       {"strcpy", strcpyVar},
                       {"strcat", strcatVar},
                       {"clock",clockVar},
-                      {"storeTime",storeTimeVar},
+                      {"startTimer",startTimerVar},
+                      {"stopTimer",stopTimerVar},
                       {"malloc", mallocVar},
                       {"free", freeVar},
                       {"__loc", locVar}});
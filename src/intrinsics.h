@@ -55,7 +55,10 @@ const Func& strcat();
 
 // Clock
 const Func& clock();
-const Func& storeTime();
+
+// Timers
+const Func& startTimer();
+const Func& stopTimer();
 
 // Internal functions
 const Func& malloc();
@@ -868,6 +868,16 @@ Stmt Comment::make(std::string comment, Stmt commentedStmt,
   return node;
 }
 
+// struct SourceLine
+Stmt SourceLine::make(std::string file, unsigned line, Stmt stmt) {
+  iassert(stmt.defined());
+  SourceLine *node = new SourceLine;
+  node->file = file;
+  node->line = line;
+  node->stmt = stmt;
+  return node;
+}
+
 // struct Pass
 Stmt Pass::make() {
   Pass *node = new Pass;
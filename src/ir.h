@@ -465,6 +465,17 @@ struct Comment : public StmtNode {
   void accept(IRVisitorStrict *v) const {v->visit((const Comment*)this);}
 };
 
+/// A statement that originates from a line of a Simit source file. Emitted by
+/// the frontend when debug info is enabled, so that backends can map the code
+/// they generate for the statement back to the line.
+struct SourceLine : public StmtNode {
+  std::string file;
+  unsigned line;
+  Stmt stmt;
+  static Stmt make(std::string file, unsigned line, Stmt stmt);
+  void accept(IRVisitorStrict *v) const {v->visit((const SourceLine*)this);}
+};
+
 /// Empty statement that is convenient during code development.
 struct Pass : public StmtNode {
   static Stmt make();
@@ -502,6 +502,11 @@ void IRPrinter::visit(const Comment *op) {
   }
 }
 
+void IRPrinter::visit(const SourceLine *op) {
+  // Source lines are debug info, and the statement prints as it would without
+  print(op->stmt);
+}
+
 void IRPrinter::visit(const Pass *op) {
   indent();
   os << "pass;";
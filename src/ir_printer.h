@@ -68,6 +68,7 @@ private:
   virtual void visit(const Block *op);
   virtual void visit(const Print *op);
   virtual void visit(const Comment *op);
+  virtual void visit(const SourceLine *op);
   virtual void visit(const Pass *op);
 
   virtual void visit(const TupleRead *op);
@@ -378,6 +378,19 @@ void IRRewriter::visit(const Comment *op) {
   }
 }
 
+void IRRewriter::visit(const SourceLine *op) {
+  Stmt body = rewrite(op->stmt);
+  if (body == op->stmt) {
+    stmt = op;
+  }
+  else if (!body.defined()) {
+    stmt = body;
+  }
+  else {
+    stmt = SourceLine::make(op->file, op->line, body);
+  }
+}
+
 void IRRewriter::visit(const Pass *op) {
   stmt = op;
 }
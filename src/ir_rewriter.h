@@ -67,6 +67,7 @@ protected:
   virtual void visit(const Block *op);
   virtual void visit(const Print *op);
   virtual void visit(const Comment *op);
+  virtual void visit(const SourceLine *op);
   virtual void visit(const Pass *op);
 
   /// High-level IRNodes that are lowered and never reach the backend
@@ -1,6 +1,15 @@
 #include "ir_transforms.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+
+#include "intrinsics.h"
+#include "ir_queries.h"
 #include "ir_rewriter.h"
+#include "ir_visitor.h"
 #include "util/collections.h"
 
 using namespace std;
@@ -127,4 +136,783 @@ Func makeSystemTensorsGlobal(Func func) {
   return MakeSystemTensorsGlobalRewriter().rewrite(func);
 }
 
+/// The variables and fields an expression or statement reads. Fields are only
+/// identified by name, since they may be read through any set or element.
+class ReadSet : public IRVisitor {
+public:
+  set<Var> vars;
+  set<string> fields;
+
+  /// True if the reads include loads from tensors, fields or set indices.
+  bool memory = false;
+
+  ReadSet(Expr expr) {expr.accept(this);}
+  ReadSet(Stmt stmt) {stmt.accept(this);}
+
+private:
+  using IRVisitor::visit;
+
+  void visit(const VarExpr *op) {
+    vars.insert(op->var);
+  }
+
+  void visit(const FieldRead *op) {
+    fields.insert(op->fieldName);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Load *op) {
+    memory = true;
+    IRVisitor::visit(op);
+  }
+
+  void visit(const TensorRead *op) {
+    memory = true;
+    IRVisitor::visit(op);
+  }
+
+  void visit(const TupleRead *op) {
+    memory = true;
+    IRVisitor::visit(op);
+  }
+
+  void visit(const SetRead *op) {
+    memory = true;
+    IRVisitor::visit(op);
+  }
+
+  // Fixed index variables stand for the expressions they are fixed to
+  void visit(const IndexedTensor *op) {
+    visitFixed(op->indexVars);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const IndexExpr *op) {
+    visitFixed(op->resultVars);
+    IRVisitor::visit(op);
+  }
+
+  void visitFixed(const vector<IndexVar>& indexVars) {
+    for (auto &indexVar : indexVars) {
+      if (indexVar.isFixed() && indexVar.getFixedExpr() != nullptr) {
+        indexVar.getFixedExpr()->accept(this);
+      }
+    }
+  }
+};
+
+/// The variables and fields a statement may write.
+class WriteSet : public IRVisitor {
+public:
+  /// The number of statements that write each variable.
+  map<Var,int> vars;
+
+  /// Variables declared by the statement, including loop variables, which get
+  /// a new value every time the statement executes.
+  set<Var> declared;
+
+  set<string> fields;
+
+  /// True if the statement calls a function that is not pure, and that may
+  /// therefore write any memory.
+  bool opaque = false;
+
+  bool prints = false;
+
+  WriteSet(Stmt stmt) {stmt.accept(this);}
+
+  /// True if the statement may change a value that `reads` reads.
+  bool changes(const ReadSet& reads) const {
+    if (opaque && (reads.memory || reads.fields.size() > 0)) {
+      return true;
+    }
+    for (auto &var : reads.vars) {
+      if (util::contains(vars, var) || util::contains(declared, var) ||
+          (opaque && !isScalar(var.getType()))) {
+        return true;
+      }
+    }
+    for (auto &field : reads.fields) {
+      if (util::contains(fields, field)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  using IRVisitor::visit;
+
+  void write(Expr target) {
+    while (isa<TensorRead>(target)) {
+      target = to<TensorRead>(target)->tensor;
+    }
+    if (isa<VarExpr>(target)) {
+      vars[to<VarExpr>(target)->var]++;
+    }
+    else if (isa<FieldRead>(target)) {
+      fields.insert(to<FieldRead>(target)->fieldName);
+    }
+    else {
+      opaque = true;
+    }
+  }
+
+  void visit(const VarDecl *op) {
+    declared.insert(op->var);
+  }
+
+  void visit(const AssignStmt *op) {
+    vars[op->var]++;
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Store *op) {
+    write(op->buffer);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const TensorWrite *op) {
+    write(op->tensor);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const FieldWrite *op) {
+    fields.insert(op->fieldName);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const CallStmt *op) {
+    for (auto &result : op->results) {
+      vars[result]++;
+    }
+    if (!isPure(op->callee)) {
+      opaque = true;
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const ForRange *op) {
+    declared.insert(op->var);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const For *op) {
+    declared.insert(op->var);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Map *op) {
+    opaque = true;
+  }
+
+  void visit(const Print *op) {
+    prints = true;
+    IRVisitor::visit(op);
+  }
+};
+
+bool isPure(Func func) {
+  switch (func.getKind()) {
+    case Func::Intrinsic: {
+      static const set<string> pureIntrinsics = {
+        intrinsics::mod().getName(), intrinsics::sin().getName(),
+        intrinsics::cos().getName(), intrinsics::tan().getName(),
+        intrinsics::asin().getName(), intrinsics::acos().getName(),
+        intrinsics::atan2().getName(), intrinsics::sqrt().getName(),
+        intrinsics::log().getName(), intrinsics::exp().getName(),
+        intrinsics::pow().getName(), intrinsics::createComplex().getName(),
+        intrinsics::complexNorm().getName(),
+        intrinsics::complexConj().getName(),
+        intrinsics::complexGetReal().getName(),
+        intrinsics::complexGetImag().getName(), intrinsics::norm().getName(),
+        intrinsics::dot().getName(), intrinsics::det().getName(),
+        intrinsics::inv().getName(), intrinsics::loc().getName(),
+        intrinsics::strcmp().getName(), intrinsics::strlen().getName()
+      };
+      return util::contains(pureIntrinsics, func.getName());
+    }
+    case Func::External:
+      return false;
+    case Func::Internal: {
+      if (!func.getBody().defined()) {
+        return false;
+      }
+      WriteSet writes(func.getBody());
+      ReadSet reads(func.getBody());
+      if (writes.opaque || writes.prints || writes.fields.size() > 0 ||
+          reads.fields.size() > 0) {
+        return false;
+      }
+
+      // Only the results and locals may be written, and only the arguments,
+      // results, locals and constants read
+      set<Var> results(func.getResults().begin(), func.getResults().end());
+      for (auto &var : writes.vars) {
+        if (!util::contains(writes.declared, var.first) &&
+            !util::contains(results, var.first)) {
+          return false;
+        }
+      }
+      set<Var> visible = writes.declared;
+      visible.insert(results.begin(), results.end());
+      visible.insert(func.getArguments().begin(), func.getArguments().end());
+      for (auto &constant : func.getEnvironment().getConstants()) {
+        visible.insert(constant.first);
+      }
+      for (auto &var : reads.vars) {
+        if (!util::contains(visible, var)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+static bool isBoth(Expr a, Expr b) {
+  return isa<T>(a) && isa<T>(b);
+}
+
+/// Returns true if `a` and `b` are the same computation on the same values.
+static bool equal(Expr a, Expr b) {
+  if (a == b) {
+    return true;
+  }
+  if (!a.defined() || !b.defined()) {
+    return false;
+  }
+  if (isBoth<Literal>(a, b)) {
+    return *to<Literal>(a) == *to<Literal>(b);
+  }
+  if (isBoth<VarExpr>(a, b)) {
+    return to<VarExpr>(a)->var == to<VarExpr>(b)->var;
+  }
+  if (isBoth<Load>(a, b)) {
+    return equal(to<Load>(a)->buffer, to<Load>(b)->buffer) &&
+           equal(to<Load>(a)->index, to<Load>(b)->index);
+  }
+  if (isBoth<FieldRead>(a, b)) {
+    return to<FieldRead>(a)->fieldName == to<FieldRead>(b)->fieldName &&
+           equal(to<FieldRead>(a)->elementOrSet,
+                 to<FieldRead>(b)->elementOrSet);
+  }
+  if (isBoth<IndexRead>(a, b)) {
+    // The index is only set for lattice dimension reads
+    return to<IndexRead>(a)->kind == to<IndexRead>(b)->kind &&
+           (to<IndexRead>(a)->kind != IndexRead::LatticeDim ||
+            to<IndexRead>(a)->index == to<IndexRead>(b)->index) &&
+           equal(to<IndexRead>(a)->edgeSet, to<IndexRead>(b)->edgeSet);
+  }
+  if (isBoth<Length>(a, b)) {
+    return to<Length>(a)->indexSet == to<Length>(b)->indexSet;
+  }
+  if (isBoth<TupleRead>(a, b)) {
+    return equal(to<TupleRead>(a)->tuple, to<TupleRead>(b)->tuple) &&
+           equal(to<TupleRead>(a)->index, to<TupleRead>(b)->index);
+  }
+  if (isBoth<TensorRead>(a, b)) {
+    const TensorRead *ra = to<TensorRead>(a);
+    const TensorRead *rb = to<TensorRead>(b);
+    if (ra->indices.size() != rb->indices.size() ||
+        !equal(ra->tensor, rb->tensor)) {
+      return false;
+    }
+    for (size_t i=0; i < ra->indices.size(); ++i) {
+      if (!equal(ra->indices[i], rb->indices[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (isBoth<Neg>(a, b) || isBoth<Not>(a, b)) {
+    return equal(to<UnaryExpr>(a)->a, to<UnaryExpr>(b)->a);
+  }
+  if (isBoth<Add>(a, b) || isBoth<Sub>(a, b) || isBoth<Mul>(a, b) ||
+      isBoth<Div>(a, b) || isBoth<Rem>(a, b) || isBoth<Eq>(a, b) ||
+      isBoth<Ne>(a, b) || isBoth<Gt>(a, b) || isBoth<Lt>(a, b) ||
+      isBoth<Ge>(a, b) || isBoth<Le>(a, b) || isBoth<And>(a, b) ||
+      isBoth<Or>(a, b) || isBoth<Xor>(a, b)) {
+    return equal(to<BinaryExpr>(a)->a, to<BinaryExpr>(b)->a) &&
+           equal(to<BinaryExpr>(a)->b, to<BinaryExpr>(b)->b);
+  }
+  return false;
+}
+
+/// Returns true if `expr` is a scalar read that is worth keeping in a local.
+static bool isScalarRead(Expr expr) {
+  return isScalar(expr.type()) && !isa<VarExpr>(expr) &&
+         !isa<Literal>(expr) && !containsIndexedTensor(expr) &&
+         ReadSet(expr).memory;
+}
+
+/// Appends the statements of nested blocks to `stmts`. The statements of a
+/// source line are each wrapped in the line, except for declarations, which
+/// are never wrapped.
+static void flattenBlocks(Stmt stmt, vector<Stmt>* stmts) {
+  if (isa<Block>(stmt)) {
+    flattenBlocks(to<Block>(stmt)->first, stmts);
+    flattenBlocks(to<Block>(stmt)->rest, stmts);
+  }
+  else if (isa<SourceLine>(stmt)) {
+    const SourceLine *sourceLine = to<SourceLine>(stmt);
+    vector<Stmt> lineStmts;
+    flattenBlocks(sourceLine->stmt, &lineStmts);
+    for (auto &lineStmt : lineStmts) {
+      stmts->push_back(isa<VarDecl>(lineStmt)
+          ? lineStmt
+          : SourceLine::make(sourceLine->file, sourceLine->line, lineStmt));
+    }
+  }
+  else if (stmt.defined()) {
+    stmts->push_back(stmt);
+  }
+}
+
+static Stmt unscope(Stmt stmt) {
+  while (isa<Scope>(stmt)) {
+    stmt = to<Scope>(stmt)->scopedStmt;
+  }
+  return stmt;
+}
+
+/// Returns the statement that debug info wraps in a source line.
+static Stmt unwrapSourceLine(Stmt stmt) {
+  return isa<SourceLine>(stmt) ? to<SourceLine>(stmt)->stmt : stmt;
+}
+
+/// Returns the literal that `value` assigns to `var`, if `value` is a tensor
+/// literal or a copy of one, and an undefined Expr otherwise.
+static Expr getLiteral(const Var& var, Expr value) {
+  if (isa<IndexExpr>(value) && isa<IndexedTensor>(to<IndexExpr>(value)->value)) {
+    const IndexExpr *indexExpr = to<IndexExpr>(value);
+    const IndexedTensor *indexedTensor = to<IndexedTensor>(indexExpr->value);
+    if (indexedTensor->indexVars != indexExpr->resultVars) {
+      return Expr();
+    }
+    value = indexedTensor->tensor;
+  }
+  if (!isa<Literal>(value) || !var.getType().isTensor()) {
+    return Expr();
+  }
+  const TensorType *varType = var.getType().toTensor();
+  const TensorType *literalType = value.type().toTensor();
+  if (varType->hasSystemDimensions() ||
+      !(varType->getComponentType() == literalType->getComponentType()) ||
+      varType->getDimensions() != literalType->getDimensions()) {
+    return Expr();
+  }
+  const Literal *literal = to<Literal>(value);
+  return Literal::make(var.getType(), literal->data, literal->size);
+}
+
+Func hoistLoopInvariants(Func func) {
+  // Locals that are only ever assigned a literal become constants, which the
+  // backends initialize once instead of every time the assignment executes
+  WriteSet writes(func.getBody());
+  map<Var,Expr> constants;
+  match(func.getBody(),
+    function<void(const AssignStmt*)>([&](const AssignStmt *op) {
+      if (op->cop == CompoundOperator::None &&
+          util::contains(writes.declared, op->var) &&
+          writes.vars.at(op->var) == 1) {
+        Expr literal = getLiteral(op->var, op->value);
+        if (literal.defined()) {
+          constants[op->var] = literal;
+        }
+      }
+    })
+  );
+
+  class RemoveConstantsRewriter : public IRRewriter {
+  public:
+    RemoveConstantsRewriter(const map<Var,Expr>& constants)
+        : constants(constants) {}
+
+  private:
+    const map<Var,Expr>& constants;
+
+    using IRRewriter::visit;
+
+    void visit(const VarDecl *op) {
+      stmt = util::contains(constants, op->var) ? Stmt() : op;
+    }
+
+    void visit(const AssignStmt *op) {
+      stmt = util::contains(constants, op->var) ? Stmt() : op;
+    }
+  };
+
+  /// Replaces loop-invariant scalar reads in the statements of a loop body by
+  /// locals that are read in front of the loop.
+  class InvariantReadsRewriter : public IRRewriter {
+  public:
+    InvariantReadsRewriter(const function<bool(Expr)>& isInvariant)
+        : isInvariant(isInvariant) {}
+
+    /// The declarations and reads of the locals.
+    vector<Stmt> reads;
+
+    using IRRewriter::rewrite;
+
+    Expr rewrite(Expr e) {
+      if (!e.defined() || !isScalarRead(e) || !isInvariant(e)) {
+        return IRRewriter::rewrite(e);
+      }
+      for (auto &value : values) {
+        if (equal(value.first, e)) {
+          return VarExpr::make(value.second);
+        }
+      }
+      Var var("@inv", e.type());
+      reads.push_back(VarDecl::make(var));
+      reads.push_back(AssignStmt::make(var, e));
+      values.push_back({e, var});
+      return VarExpr::make(var);
+    }
+
+  private:
+    const function<bool(Expr)>& isInvariant;
+    vector<pair<Expr,Var>> values;
+
+    using IRRewriter::visit;
+
+    // Only the statements that execute in every iteration are rewritten
+    void visit(const IfThenElse *op) {
+      Expr condition = rewrite(op->condition);
+      if (condition == op->condition) {
+        stmt = op;
+      }
+      else {
+        stmt = op->elseBody.defined()
+            ? IfThenElse::make(condition, unscope(op->thenBody),
+                               unscope(op->elseBody))
+            : IfThenElse::make(condition, unscope(op->thenBody));
+      }
+    }
+
+    void visit(const Scope *op) {stmt = op;}
+    void visit(const ForRange *op) {stmt = op;}
+    void visit(const For *op) {stmt = op;}
+    void visit(const While *op) {stmt = op;}
+    void visit(const Kernel *op) {stmt = op;}
+  };
+
+  class LoopInvariantCodeMotion : public IRRewriter {
+    using IRRewriter::visit;
+
+    // Loops are scoped by their Scope, and are returned in a new scope behind
+    // the statements hoisted out of them
+    void visit(const Scope *op) {
+      Stmt scopedStmt = unscope(op);
+      if (isa<ForRange>(scopedStmt) || isa<For>(scopedStmt)) {
+        Stmt loop = rewrite(scopedStmt);
+        stmt = (loop == scopedStmt) ? Stmt(op) : loop;
+      }
+      else {
+        IRRewriter::visit(op);
+      }
+    }
+
+    void visit(const ForRange *op) {
+      bool iterates = isa<Literal>(op->start) && isa<Literal>(op->end) &&
+                      isInt(op->start.type()) && isInt(op->end.type()) &&
+                      to<Literal>(op->end)->getIntVal(0) >
+                      to<Literal>(op->start)->getIntVal(0);
+      vector<Stmt> invariants;
+      Stmt body = hoist(rewrite(op->body), op->var, iterates, &invariants);
+      if (body == op->body) {
+        stmt = op;
+        return;
+      }
+      invariants.push_back(ForRange::make(op->var, op->start, op->end,
+                                          unscope(body)));
+      stmt = Block::make(invariants);
+    }
+
+    void visit(const For *op) {
+      bool iterates = op->domain.kind == ForDomain::IndexSet &&
+                      op->domain.indexSet.getKind() == IndexSet::Range &&
+                      op->domain.indexSet.getSize() > 0;
+      vector<Stmt> invariants;
+      Stmt body = hoist(rewrite(op->body), op->var, iterates, &invariants);
+      if (body == op->body) {
+        stmt = op;
+        return;
+      }
+      invariants.push_back(For::make(op->var, op->domain, unscope(body)));
+      stmt = Block::make(invariants);
+    }
+
+    /// Moves the statements of the loop `body` that compute the same value
+    /// in every iteration to `invariants`, and returns the rest. Reads are
+    /// only moved if the loop `iterates` at least once, since their indices
+    /// may be out of bounds if it does not.
+    Stmt hoist(Stmt body, Var loopVar, bool iterates,
+               vector<Stmt>* invariants) {
+      vector<Stmt> stmts;
+      flattenBlocks(unscope(body), &stmts);
+      WriteSet writes(body);
+      writes.declared.insert(loopVar);
+
+      // The locals defined by the hoisted statements
+      set<Var> defined;
+      function<bool(Expr)> isInvariant = [&](Expr expr) {
+        ReadSet reads(expr);
+        if ((reads.memory && !iterates) ||
+            (writes.opaque && (reads.memory || reads.fields.size() > 0))) {
+          return false;
+        }
+        for (auto &var : reads.vars) {
+          if (!util::contains(defined, var) &&
+              (util::contains(writes.vars, var) ||
+               util::contains(writes.declared, var) ||
+               (writes.opaque && !isScalar(var.getType())))) {
+            return false;
+          }
+        }
+        for (auto &field : reads.fields) {
+          if (util::contains(writes.fields, field)) {
+            return false;
+          }
+        }
+        return true;
+      };
+
+      // A statement can be hoisted if it is the only one to assign a local of
+      // the loop body, and it computes the local from invariant values
+      set<Var> declared;
+      auto isLocal = [&](const Var& var) {
+        return util::contains(declared, var) && writes.vars.at(var) == 1 &&
+               !isSystemTensorType(var.getType());
+      };
+      vector<bool> invariant(stmts.size(), false);
+      for (size_t i=0; i < stmts.size(); ++i) {
+        Stmt stmt = unwrapSourceLine(stmts[i]);
+        if (isa<VarDecl>(stmt)) {
+          declared.insert(to<VarDecl>(stmt)->var);
+        }
+        else if (isa<AssignStmt>(stmt)) {
+          const AssignStmt *assign = to<AssignStmt>(stmt);
+          invariant[i] = assign->cop == CompoundOperator::None &&
+                         isLocal(assign->var) && isInvariant(assign->value);
+          if (invariant[i]) {
+            defined.insert(assign->var);
+          }
+        }
+        else if (isa<CallStmt>(stmt)) {
+          const CallStmt *call = to<CallStmt>(stmt);
+          invariant[i] = isPure(call->callee);
+          for (auto &result : call->results) {
+            invariant[i] = invariant[i] && isLocal(result);
+          }
+          for (auto &actual : call->actuals) {
+            invariant[i] = invariant[i] && isInvariant(actual);
+          }
+          if (invariant[i]) {
+            defined.insert(call->results.begin(), call->results.end());
+          }
+        }
+      }
+
+      // Move the hoisted statements and the declarations of their locals, and
+      // then the invariant reads of the remaining statements
+      InvariantReadsRewriter readsRewriter(isInvariant);
+      vector<Stmt> variant;
+      for (size_t i=0; i < stmts.size(); ++i) {
+        if (invariant[i] || (isa<VarDecl>(stmts[i]) &&
+                             util::contains(defined,
+                                            to<VarDecl>(stmts[i])->var))) {
+          invariants->push_back(stmts[i]);
+        }
+        else {
+          variant.push_back(iterates ? readsRewriter.rewrite(stmts[i])
+                                     : stmts[i]);
+        }
+      }
+      invariants->insert(invariants->end(), readsRewriter.reads.begin(),
+                         readsRewriter.reads.end());
+      if (invariants->size() == 0) {
+        return body;
+      }
+      Stmt rest = (variant.size() > 0) ? Block::make(variant) : Pass::make();
+      return isa<Scope>(body) ? Scope::make(rest) : rest;
+    }
+  };
+
+  Stmt body = RemoveConstantsRewriter(constants).rewrite(func.getBody());
+  body = LoopInvariantCodeMotion().rewrite(body);
+  if (body == func.getBody()) {
+    return func;
+  }
+  Func result(func, body);
+  for (auto &constant : constants) {
+    result.getEnvironment().addConstant(constant.first, constant.second);
+  }
+  return result;
+}
+
+Func eliminateCommonSubexpressions(Func func) {
+  /// Reads every scalar read into a local, and replaces later reads of the
+  /// same value by the local, until something the read reads is written.
+  class CommonSubexpressionRewriter : public IRRewriter {
+  public:
+    /// The value each local was read from.
+    map<Var,Expr> definitions;
+
+    using IRRewriter::rewrite;
+
+    Stmt rewrite(Stmt s) {
+      Stmt result = IRRewriter::rewrite(s);
+      if (s.defined() && !isa<Block>(s)) {
+        invalidate(WriteSet(s));
+      }
+      return result;
+    }
+
+  private:
+    /// The available values, and the locals they were read into.
+    vector<pair<Expr,Var>> values;
+
+    using IRRewriter::visit;
+
+    void invalidate(const WriteSet& writes) {
+      values.erase(remove_if(values.begin(), values.end(),
+                             [&writes](const pair<Expr,Var>& value) {
+                               return writes.changes(ReadSet(value.first));
+                             }),
+                   values.end());
+    }
+
+    Expr reuse(Expr e) {
+      if (!isScalarRead(e)) {
+        return e;
+      }
+      for (auto &value : values) {
+        if (equal(value.first, e)) {
+          return VarExpr::make(value.second);
+        }
+      }
+      Var var("@cse", e.type());
+      spill(VarDecl::make(var));
+      spill(AssignStmt::make(var, e));
+      values.push_back({e, var});
+      definitions[var] = e;
+      return VarExpr::make(var);
+    }
+
+    void visit(const Load *op) {
+      IRRewriter::visit(op);
+      expr = reuse(expr);
+    }
+
+    void visit(const TensorRead *op) {
+      IRRewriter::visit(op);
+      expr = reuse(expr);
+    }
+
+    // The values read in a scope, branch or loop body are not available
+    // outside it, and values read in front of a loop are only available in
+    // it if the loop does not write them
+    void visit(const Scope *op) {
+      vector<pair<Expr,Var>> available = values;
+      IRRewriter::visit(op);
+      values = available;
+    }
+
+    void visit(const IfThenElse *op) {
+      Expr condition = rewrite(op->condition);
+      Stmt spilledCond = getSpilledStmts();
+      vector<pair<Expr,Var>> available = values;
+      Stmt thenBody = rewrite(op->thenBody);
+      values = available;
+      Stmt elseBody = rewrite(op->elseBody);
+      values = available;
+      if (condition == op->condition && thenBody == op->thenBody &&
+          elseBody == op->elseBody) {
+        stmt = op;
+        return;
+      }
+      stmt = elseBody.defined()
+          ? IfThenElse::make(condition, unscope(thenBody), unscope(elseBody))
+          : IfThenElse::make(condition, unscope(thenBody));
+      if (spilledCond.defined()) {
+        stmt = Block::make(spilledCond, stmt);
+      }
+    }
+
+    void visit(const ForRange *op) {
+      invalidate(WriteSet(op));
+      vector<pair<Expr,Var>> available = values;
+      IRRewriter::visit(op);
+      values = available;
+    }
+
+    void visit(const For *op) {
+      invalidate(WriteSet(op));
+      vector<pair<Expr,Var>> available = values;
+      IRRewriter::visit(op);
+      values = available;
+    }
+
+    // The condition is evaluated in every iteration, so it is left as is
+    void visit(const While *op) {
+      invalidate(WriteSet(op));
+      vector<pair<Expr,Var>> available = values;
+      Stmt body = rewrite(op->body);
+      values = available;
+      stmt = (body == op->body) ? Stmt(op)
+                                : While::make(op->condition, unscope(body));
+    }
+  };
+  CommonSubexpressionRewriter cse;
+  Stmt body = cse.rewrite(func.getBody());
+
+  // Values that are only read once are read where they are used instead
+  map<Var,int> uses;
+  match(body, function<void(const VarExpr*)>([&](const VarExpr *op) {
+    if (util::contains(cse.definitions, op->var)) {
+      uses[op->var]++;
+    }
+  }));
+
+  class InlineValuesRewriter : public IRRewriter {
+  public:
+    InlineValuesRewriter(const map<Var,Expr>& values) : values(values) {}
+
+  private:
+    const map<Var,Expr>& values;
+
+    using IRRewriter::visit;
+
+    void visit(const VarDecl *op) {
+      stmt = util::contains(values, op->var) ? Stmt() : op;
+    }
+
+    void visit(const AssignStmt *op) {
+      if (util::contains(values, op->var)) {
+        stmt = Stmt();
+      }
+      else {
+        IRRewriter::visit(op);
+      }
+    }
+
+    void visit(const VarExpr *op) {
+      expr = util::contains(values, op->var) ? rewrite(values.at(op->var))
+                                              : Expr(op);
+    }
+  };
+  map<Var,Expr> inlined;
+  for (auto &definition : cse.definitions) {
+    if (uses[definition.first] == 1) {
+      inlined.insert(definition);
+    }
+  }
+  body = InlineValuesRewriter(inlined).rewrite(body);
+  return (body == func.getBody()) ? func : Func(func, body);
+}
+
 }}
@@ -27,5 +27,23 @@ Stmt moveVarDeclsToFront(Stmt stmt);
 /// The global variables are added to the resulting Funcs environment.
 Func makeSystemTensorsGlobal(Func func);
 
+/// Returns true if calls to `func` only compute their results from their
+/// arguments, so that they can be moved and merged like arithmetic. This holds
+/// for the math intrinsics (including `loc`, `det` and `inv`), and for Simit
+/// functions that write only their results and locals, read no fields and
+/// globals, and call only pure functions. External functions are never pure.
+bool isPure(Func func);
+
+/// Moves code that computes the same value in every iteration of a loop in
+/// front of the loop. Locals that are only assigned a tensor literal become
+/// constants of the function, statements that compute a local from values
+/// the loop does not change are moved out of it, and reads the loop does not
+/// change are read once before loops with a constant number of iterations.
+Func hoistLoopInvariants(Func func);
+
+/// Reads each scalar a function reads more than once, without writing it in
+/// between, into a local that the later reads use instead.
+Func eliminateCommonSubexpressions(Func func);
+
 }}
 #endif
@@ -184,6 +184,10 @@ void IRVisitor::visit(const Comment *op) {
   }
 }
 
+void IRVisitor::visit(const SourceLine *op) {
+  op->stmt.accept(this);
+}
+
 void IRVisitor::visit(const Pass *op) {
 }
 
@@ -54,6 +54,7 @@ struct Kernel;
 struct Block;
 struct Print;
 struct Comment;
+struct SourceLine;
 struct Pass;
 
 struct TupleRead;
@@ -112,6 +113,7 @@ public:
   virtual void visit(const Block* op) = 0;
   virtual void visit(const Print* op) = 0;
   virtual void visit(const Comment* op) = 0;
+  virtual void visit(const SourceLine* op) = 0;
   virtual void visit(const Pass* op) = 0;
 
   /// High-level IRNodes that are lowered and never reach the backend
@@ -183,6 +185,7 @@ public:
   virtual void visit(const Block *op);
   virtual void visit(const Print *op);
   virtual void visit(const Comment *op);
+  virtual void visit(const SourceLine *op);
   virtual void visit(const Pass *op);
 
   /// High-level IRNodes that are lowered and never reach the backend
@@ -312,6 +315,7 @@ private:
   RULE(Block)
   RULE(Print)
   RULE(Comment)
+  RULE(SourceLine)
   RULE(Pass)
 
   RULE(TupleRead)
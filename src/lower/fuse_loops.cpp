@@ -0,0 +1,432 @@
+#include "fuse_loops.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "intrinsics.h"
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
+#include "var_replace_rewriter.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// A tensor (var, "") or a field of a set (set, field name).
+typedef pair<Var,string> Buffer;
+
+/// An access to a buffer. Local accesses read or write the block
+/// [i*stride, (i+1)*stride) of the buffer, where i is the loop variable.
+struct Access {
+  bool write;
+  bool local;
+  int stride;
+};
+
+/// Computes the constant bounds of an integer expression over the given
+/// ranges of loop variables. Returns false if the bounds are not constant.
+static bool getBounds(Expr expr, const map<Var,pair<int,int>>& ranges,
+                      int* lo, int* hi) {
+  if (isa<Literal>(expr)) {
+    const Literal* literal = to<Literal>(expr);
+    if (!isInt(literal->type)) {
+      return false;
+    }
+    *lo = *hi = literal->getIntVal(0);
+    return true;
+  }
+  else if (isa<Length>(expr)) {
+    const IndexSet& indexSet = to<Length>(expr)->indexSet;
+    if (indexSet.getKind() != IndexSet::Range) {
+      return false;
+    }
+    *lo = *hi = indexSet.getSize();
+    return true;
+  }
+  else if (isa<VarExpr>(expr)) {
+    auto range = ranges.find(to<VarExpr>(expr)->var);
+    if (range == ranges.end()) {
+      return false;
+    }
+    *lo = range->second.first;
+    *hi = range->second.second;
+    return true;
+  }
+  else if (isa<Add>(expr) || isa<Mul>(expr)) {
+    Expr a = isa<Add>(expr) ? to<Add>(expr)->a : to<Mul>(expr)->a;
+    Expr b = isa<Add>(expr) ? to<Add>(expr)->b : to<Mul>(expr)->b;
+    int alo, ahi, blo, bhi;
+    if (!getBounds(a, ranges, &alo, &ahi) ||
+        !getBounds(b, ranges, &blo, &bhi)) {
+      return false;
+    }
+    if (isa<Add>(expr)) {
+      *lo = alo + blo;
+      *hi = ahi + bhi;
+      return true;
+    }
+    if (alo < 0 || blo < 0) {
+      return false;
+    }
+    *lo = alo * blo;
+    *hi = ahi * bhi;
+    return true;
+  }
+  return false;
+}
+
+/// Collects the buffer accesses of a loop body, and classifies the accesses
+/// whose index is of the form `i * stride + offset`, with `offset` in
+/// [0, stride), as local to the iteration of loop variable `i`.
+class LoopAccesses : public IRVisitor {
+public:
+  map<Buffer,vector<Access>> accesses;
+  bool sideEffects = false;
+
+  LoopAccesses(Var loopVar) : loopVar(loopVar) {}
+
+  /// True if `this` and `other` access no common buffer that one of them
+  /// writes, so that they can be reordered.
+  bool isIndependent(const LoopAccesses& other) const {
+    if (sideEffects || other.sideEffects) {
+      return false;
+    }
+    for (auto& buffer : accesses) {
+      auto otherBuffer = other.accesses.find(buffer.first);
+      if (otherBuffer != other.accesses.end() &&
+          (isWritten(buffer.second) || isWritten(otherBuffer->second))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// True if every common buffer that `this` or `other` writes is accessed at
+  /// the block of the current element, with the same block size, so that the
+  /// loops can be fused.
+  bool isFusible(const LoopAccesses& other) const {
+    if (sideEffects || other.sideEffects) {
+      return false;
+    }
+    for (auto& buffer : accesses) {
+      auto otherBuffer = other.accesses.find(buffer.first);
+      if (otherBuffer == other.accesses.end() ||
+          !(isWritten(buffer.second) || isWritten(otherBuffer->second))) {
+        continue;
+      }
+      int stride = buffer.second[0].stride;
+      for (auto* list : {&buffer.second, &otherBuffer->second}) {
+        for (const Access& access : *list) {
+          if (!access.local || access.stride != stride) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+private:
+  Var loopVar;
+  map<Var,pair<int,int>> ranges;
+
+  using IRVisitor::visit;
+
+  static bool isWritten(const vector<Access>& accesses) {
+    for (const Access& access : accesses) {
+      if (access.write) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool isLoopVar(Expr expr) const {
+    return isa<VarExpr>(expr) && to<VarExpr>(expr)->var == loopVar;
+  }
+
+  /// Returns the stride if `index` is local to the loop variable, else 0.
+  int getStride(Expr index) const {
+    if (isLoopVar(index)) {
+      return 1;
+    }
+    if (isa<Mul>(index)) {
+      const Mul* mul = to<Mul>(index);
+      Expr stride = isLoopVar(mul->a) ? mul->b :
+                    isLoopVar(mul->b) ? mul->a : Expr();
+      int lo, hi;
+      if (stride.defined() && getBounds(stride, ranges, &lo, &hi) &&
+          lo == hi && lo > 0) {
+        return lo;
+      }
+    }
+    else if (isa<Add>(index)) {
+      const Add* add = to<Add>(index);
+      for (auto& terms : {make_pair(add->a, add->b),
+                          make_pair(add->b, add->a)}) {
+        int stride = getStride(terms.first);
+        int lo, hi;
+        if (stride > 0 && getBounds(terms.second, ranges, &lo, &hi) &&
+            lo >= 0 && hi < stride) {
+          return stride;
+        }
+      }
+    }
+    return 0;
+  }
+
+  void access(Buffer buffer, bool write, Expr index=Expr()) {
+    int stride = index.defined() ? getStride(index) : 0;
+    accesses[buffer].push_back({write, stride > 0, stride});
+  }
+
+  /// Records an indexed access if `buffer` is a tensor or field, and returns
+  /// false if it is not.
+  bool access(Expr buffer, Expr index, bool write) {
+    if (isa<VarExpr>(buffer)) {
+      access(Buffer(to<VarExpr>(buffer)->var, ""), write, index);
+      return true;
+    }
+    if (isa<FieldRead>(buffer) &&
+        isa<VarExpr>(to<FieldRead>(buffer)->elementOrSet)) {
+      const FieldRead* fieldRead = to<FieldRead>(buffer);
+      access(Buffer(to<VarExpr>(fieldRead->elementOrSet)->var,
+                    fieldRead->fieldName), write, index);
+      return true;
+    }
+    return false;
+  }
+
+  void visit(const VarExpr* op) {
+    access(Buffer(op->var, ""), false);
+  }
+
+  void visit(const FieldRead* op) {
+    if (!access(op, Expr(), false)) {
+      IRVisitor::visit(op);
+    }
+  }
+
+  void visit(const Load* op) {
+    if (!access(op->buffer, op->index, false)) {
+      op->buffer.accept(this);
+    }
+    op->index.accept(this);
+  }
+
+  void visit(const Store* op) {
+    if (!access(op->buffer, op->index, true)) {
+      sideEffects = true;
+    }
+    op->index.accept(this);
+    op->value.accept(this);
+  }
+
+  void visit(const AssignStmt* op) {
+    access(Buffer(op->var, ""), true);
+    op->value.accept(this);
+  }
+
+  void visit(const FieldWrite* op) {
+    if (!isa<VarExpr>(op->elementOrSet)) {
+      sideEffects = true;
+    }
+    else {
+      access(Buffer(to<VarExpr>(op->elementOrSet)->var, op->fieldName), true);
+    }
+    op->value.accept(this);
+  }
+
+  void visit(const TensorWrite* op) {
+    if (!access(op->tensor, Expr(), true)) {
+      sideEffects = true;
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const CallStmt* op) {
+    // Calls to external functions may touch anything
+    if (op->callee.getKind() != Func::Intrinsic) {
+      sideEffects = true;
+    }
+    for (const Var& result : op->results) {
+      access(Buffer(result, ""), true);
+    }
+    for (const Expr& actual : op->actuals) {
+      if (op->callee == intrinsics::free() && isa<VarExpr>(actual)) {
+        access(Buffer(to<VarExpr>(actual)->var, ""), true);
+      }
+      actual.accept(this);
+    }
+  }
+
+  void visit(const Print* op) {
+    sideEffects = true;
+  }
+
+  void visit(const ForRange* op) {
+    int startLo, startHi, endLo, endHi;
+    bool bounded = getBounds(op->start, ranges, &startLo, &startHi) &&
+                   getBounds(op->end, ranges, &endLo, &endHi) &&
+                   startLo == startHi && endLo == endHi && startLo < endLo;
+    if (bounded) {
+      ranges[op->var] = {startLo, endLo - 1};
+    }
+    IRVisitor::visit(op);
+    ranges.erase(op->var);
+  }
+
+  void visit(const For* op) {
+    const ForDomain& domain = op->domain;
+    if (domain.kind == ForDomain::IndexSet &&
+        domain.indexSet.getKind() == IndexSet::Range &&
+        domain.indexSet.getSize() > 0) {
+      ranges[op->var] = {0, domain.indexSet.getSize() - 1};
+    }
+    IRVisitor::visit(op);
+    ranges.erase(op->var);
+  }
+};
+
+class FuseLoops : public IRRewriter {
+  using IRRewriter::visit;
+
+  /// Append the statements of nested blocks to `stmts`. Comments are split
+  /// from the statements they annotate, so that these can be fused.
+  static void flatten(Stmt stmt, vector<Stmt>* stmts) {
+    if (isa<Block>(stmt)) {
+      const Block* block = to<Block>(stmt);
+      flatten(block->first, stmts);
+      if (block->rest.defined()) {
+        flatten(block->rest, stmts);
+      }
+    }
+    else if (isa<SourceLine>(stmt)) {
+      // Every statement of a source line but its declarations keeps the line
+      const SourceLine* sourceLine = to<SourceLine>(stmt);
+      vector<Stmt> lineStmts;
+      flatten(sourceLine->stmt, &lineStmts);
+      for (Stmt& lineStmt : lineStmts) {
+        stmts->push_back(isa<VarDecl>(lineStmt)
+            ? lineStmt
+            : SourceLine::make(sourceLine->file, sourceLine->line, lineStmt));
+      }
+    }
+    else if (isa<Comment>(stmt) && to<Comment>(stmt)->commentedStmt.defined()){
+      const Comment* comment = to<Comment>(stmt);
+      stmts->push_back(Comment::make(comment->comment, Stmt(),
+                                     comment->footerSpace,
+                                     comment->headerSpace));
+      flatten(comment->commentedStmt, stmts);
+    }
+    else {
+      stmts->push_back(stmt);
+    }
+  }
+
+  /// Returns the loop in `stmt`, which For::make wraps in scopes and debug
+  /// info in a source line, or nullptr.
+  static const For* getLoop(Stmt stmt) {
+    while (isa<Scope>(stmt) || isa<SourceLine>(stmt)) {
+      stmt = isa<Scope>(stmt) ? to<Scope>(stmt)->scopedStmt
+                              : to<SourceLine>(stmt)->stmt;
+    }
+    return isa<For>(stmt) ? to<For>(stmt) : nullptr;
+  }
+
+  /// Returns `body` in the source line of the loop `stmt`, if it has one, so
+  /// that the bodies of fused loops keep their lines.
+  static Stmt inSourceLine(Stmt stmt, Stmt body) {
+    if (!isa<SourceLine>(stmt)) {
+      return body;
+    }
+    const SourceLine* sourceLine = to<SourceLine>(stmt);
+    return SourceLine::make(sourceLine->file, sourceLine->line, body);
+  }
+
+  /// Returns the set variable of a loop over a set, or an undefined Var.
+  static Var getLoopSet(Stmt stmt) {
+    const For* loop = getLoop(stmt);
+    if (loop == nullptr) {
+      return Var();
+    }
+    const ForDomain& domain = loop->domain;
+    if (domain.kind != ForDomain::IndexSet ||
+        domain.indexSet.getKind() != IndexSet::Set ||
+        !isa<VarExpr>(domain.indexSet.getSet())) {
+      return Var();
+    }
+    return to<VarExpr>(domain.indexSet.getSet())->var;
+  }
+
+  static LoopAccesses getAccesses(Stmt stmt, Var loopVar=Var()) {
+    LoopAccesses accesses(loopVar);
+    stmt.accept(&accesses);
+    return accesses;
+  }
+
+  /// Fuse the loop at stmts[k] with the following loops over the same set,
+  /// moving the statements between them above it where possible.
+  static void fuse(vector<Stmt>* stmts, size_t k) {
+    while (true) {
+      const For* loop = getLoop((*stmts)[k]);
+      LoopAccesses loopAccesses = getAccesses(loop->body, loop->var);
+
+      size_t next = k + 1;
+      while (next < stmts->size()) {
+        Stmt stmt = (*stmts)[next];
+        if (getLoopSet(stmt).defined() &&
+            getLoopSet(stmt) == getLoopSet((*stmts)[k])) {
+          break;
+        }
+        if (!getAccesses(stmt).isIndependent(loopAccesses)) {
+          return;
+        }
+        ++next;
+      }
+      if (next == stmts->size()) {
+        return;
+      }
+
+      const For* nextLoop = getLoop((*stmts)[next]);
+      if (!loopAccesses.isFusible(getAccesses(nextLoop->body,
+                                              nextLoop->var))) {
+        return;
+      }
+      Stmt nextBody = replaceVar(nextLoop->body, nextLoop->var, loop->var);
+      Stmt fused = For::make(loop->var, loop->domain,
+                             Block::make(inSourceLine((*stmts)[k], loop->body),
+                                         inSourceLine((*stmts)[next],
+                                                      nextBody)));
+
+      // Move the statements in between above the fused loop
+      stmts->erase(stmts->begin() + next);
+      stmts->erase(stmts->begin() + k);
+      stmts->insert(stmts->begin() + next - 1, fused);
+      k = next - 1;
+    }
+  }
+
+  void visit(const Block* op) {
+    vector<Stmt> stmts;
+    flatten(op, &stmts);
+    for (Stmt& stmt : stmts) {
+      stmt = rewrite(stmt);
+    }
+    for (size_t k = 0; k < stmts.size(); ++k) {
+      if (getLoopSet(stmts[k]).defined()) {
+        fuse(&stmts, k);
+      }
+    }
+    stmt = Block::make(stmts);
+  }
+};
+
+Func fuseLoops(Func func) {
+  return FuseLoops().rewrite(func);
+}
+
+}}
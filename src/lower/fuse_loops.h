@@ -0,0 +1,17 @@
+#ifndef SIMIT_FUSE_LOOPS_H
+#define SIMIT_FUSE_LOOPS_H
+
+#include "ir.h"
+
+namespace simit {
+namespace ir {
+
+/// Fuse consecutive loops over the same set into one loop, so that the
+/// tensors and fields they share are streamed once. Two loops are fused when
+/// every tensor or field one of them writes and the other accesses is only
+/// accessed at the block of the current element. Statements between the
+/// loops that are independent of the first loop are moved above it.
+Func fuseLoops(Func func);
+
+}}
+#endif
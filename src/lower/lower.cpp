@@ -4,6 +4,10 @@
 #include <fstream>
 
 #include "lower_maps.h"
+#include "fuse_loops.h"
+#include "matrix_free.h"
+#include "reuse_buffers.h"
+#include "scalarize.h"
 #include "index_expressions/lower_index_expressions.h"
 
 #include "lower_accesses.h"
@@ -15,6 +19,7 @@
 #include "timers.h"
 #include "temps.h"
 #include "flatten.h"
+#include "init.h"
 #include "insert_frees.h"
 #include "ir_rewriter.h"
 #include "ir_transforms.h"
@@ -29,6 +34,7 @@ using namespace std;
 
 namespace simit {
 extern std::string kBackend;
+extern bool kFuseLoops;
 
 namespace ir {
 
@@ -72,11 +78,10 @@ void visitCallGraph(Func func, const function<void(Func)>& visitRule) {
 }
 
 static inline
-void printTimedCallGraph(string headerText, Func func, ostream* os) {
+void addTimedSourceLines(Func func, Timers* timers) {
   stringstream ss;
   simit::ir::IRPrinterCallGraph(ss).print(func);
-  TimerStorage::getInstance().addSourceLines(ss);
-  *os << ss.rdbuf();
+  timers->addSourceLines(ss);
 }
 
 static inline
@@ -88,7 +93,7 @@ void printCallGraph(string headerText, Func func, ostream* os) {
   }
 }
 
-Func lower(Func func, std::ostream* os, bool time) {
+Func lower(Func func, std::ostream* os, Timers* timers) {
 #ifdef GPU
   // Rewrite system assignments
   if (kBackend == "gpu") {
@@ -102,6 +107,15 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, insertTemporaries);
   printCallGraph("Insert Temporaries and Flatten Index Expressions", func, os);
 
+  // Compute products by system matrices without assembling the matrices
+  if (kMatrixFree != MatrixFree::Never) {
+    bool always = (kMatrixFree == MatrixFree::Always);
+    func = rewriteCallGraph(func, [always](Func func) -> Func {
+      return lowerMatrixFree(func, always);
+    });
+    printCallGraph("Matrix-Free Products", func, os);
+  }
+
   // Determine Storage
   func = rewriteCallGraph(func, [](Func func) -> Func {
     updateStorage(func, &func.getStorage(), &func.getEnvironment());
@@ -119,6 +133,12 @@ Func lower(Func func, std::ostream* os, bool time) {
     *os << endl;
   }
 
+  // Share buffers between temporaries that are not live at the same time
+  if (kReuseBuffers && kBackend != "gpu") {
+    func = rewriteCallGraph(func, reuseBuffers);
+    printCallGraph("Reuse Buffers", func, os);
+  }
+
   func = rewriteCallGraph(func, insertFrees);
   printCallGraph("Insert Frees", func, os);
 
@@ -137,6 +157,14 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, lowerMaps);
   printCallGraph("Lower Maps", func, os);
 
+  // Remove the redundant computations of the inlined map bodies
+  if (kEliminateRedundancy && kBackend != "gpu") {
+    func = rewriteCallGraph(func, hoistLoopInvariants);
+    func = rewriteCallGraph(func, eliminateCommonSubexpressions);
+    printCallGraph("Hoist Loop Invariants and Eliminate Common Subexpressions",
+                   func, os);
+  }
+
   // Lower Index Expressions
   func = rewriteCallGraph(func, lowerIndexExpressions);
   printCallGraph("Lower Index Expressions", func, os);
@@ -145,9 +173,25 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, lowerTensorAccesses);
   printCallGraph("Lower Tensor Reads and Writes", func, os);
 
-  if (time) {
-    printTimedCallGraph("Insert Timers", func, os);
-    func = rewriteCallGraph(func, insertTimers);
+  // Unroll loops over small tensors and keep small local tensors in scalars
+  if (kScalarizeSize > 0 && kBackend != "gpu") {
+    func = rewriteCallGraph(func, [](Func func) -> Func {
+      return scalarize(func, kScalarizeSize);
+    });
+    printCallGraph("Scalarize Small Tensors", func, os);
+  }
+
+  // Fuse loops over the same set (the GPU backend fuses its kernels instead)
+  if (kFuseLoops && kBackend != "gpu") {
+    func = rewriteCallGraph(func, fuseLoops);
+    printCallGraph("Fuse Loops", func, os);
+  }
+
+  if (timers != nullptr) {
+    addTimedSourceLines(func, timers);
+    func = rewriteCallGraph(func, [timers](Func func) -> Func {
+      return insertTimers(func, timers);
+    });
     printCallGraph("Insert Timers", func, os);
   }
 
@@ -5,11 +5,13 @@
 
 namespace simit {
 namespace ir {
+class Timers;
 
 /// Optimize and lower `func` into the low level part of the Simit IR, that is
 /// is supported by backends. If `print` is true, then the IR will be printed
-/// to stdout between each lowering step.
-Func lower(Func func, std::ostream* os=nullptr, bool time=false);
+/// to stdout between each lowering step. If `timers` is not null, then timers
+/// are inserted around the lowered statements and registered in it.
+Func lower(Func func, std::ostream* os=nullptr, Timers* timers=nullptr);
 
 }}
 #endif
@@ -0,0 +1,675 @@
+#include "matrix_free.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "flatten.h"
+#include "ir_queries.h"
+#include "ir_rewriter.h"
+#include "ir_transforms.h"
+#include "ir_visitor.h"
+#include "temps.h"
+#include "util/collections.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// Machine balance assumed by the cost model: the flops a core does in the
+/// time it takes to stream one byte from memory.
+static const double FlopsPerByte = 4.0;
+
+/// Estimated flops of a call, e.g. to sqrt or norm.
+static const double CallFlops = 20.0;
+
+/// Assumed trip count of the loops around a product.
+static const double LoopTrips = 10.0;
+
+/// Matches the index expression (i A(i,+j) * x(+j)) or (i A(+j,i) * x(+j)),
+/// with the operands in either order, and returns A, x and whether A is
+/// transposed.
+static bool matchProduct(Expr value, Var* matrix, Expr* vector,
+                         bool* transposed) {
+  if (!isa<IndexExpr>(value)) {
+    return false;
+  }
+  const IndexExpr* indexExpr = to<IndexExpr>(value);
+  if (indexExpr->resultVars.size() != 1 || !isa<Mul>(indexExpr->value)) {
+    return false;
+  }
+  const Mul* mul = to<Mul>(indexExpr->value);
+  if (!isa<IndexedTensor>(mul->a) || !isa<IndexedTensor>(mul->b)) {
+    return false;
+  }
+  const IndexedTensor* a = to<IndexedTensor>(mul->a);
+  const IndexedTensor* b = to<IndexedTensor>(mul->b);
+  if (a->indexVars.size() == 1) {
+    swap(a, b);
+  }
+  if (a->indexVars.size() != 2 || b->indexVars.size() != 1 ||
+      !isa<VarExpr>(a->tensor)) {
+    return false;
+  }
+
+  const IndexVar& i = indexExpr->resultVars[0];
+  const IndexVar& j = b->indexVars[0];
+  if (!j.isReductionVar() ||
+      j.getOperator().getKind() != ReductionOperator::Sum) {
+    return false;
+  }
+  if (a->indexVars[0] == i && a->indexVars[1] == j) {
+    *transposed = false;
+  }
+  else if (a->indexVars[0] == j && a->indexVars[1] == i) {
+    *transposed = true;
+  }
+  else {
+    return false;
+  }
+  *matrix = to<VarExpr>(a->tensor)->var;
+  *vector = b->tensor;
+  return true;
+}
+
+/// Returns the size of the blocks of a system matrix, if they are scalars or
+/// matrices of scalars.
+static bool getBlockSize(Type matrixType, int* rows, int* cols) {
+  Type blockType = matrixType.toTensor()->getBlockType();
+  if (isScalar(blockType)) {
+    *rows = 1;
+    *cols = 1;
+    return true;
+  }
+  const TensorType* block = blockType.toTensor();
+  if (block->order() != 2 || !isScalar(block->getBlockType())) {
+    return false;
+  }
+  vector<IndexDomain> dims = block->getDimensions();
+  for (auto& dim : dims) {
+    if (dim.getNumIndexSets() != 1 ||
+        dim.getIndexSets()[0].getKind() != IndexSet::Range) {
+      return false;
+    }
+  }
+  *rows = dims[0].getSize();
+  *cols = dims[1].getSize();
+  return true;
+}
+
+/// Returns true if `expr` reads `var` or the field `fieldName` of any set.
+static bool reads(Expr expr, Var var, string fieldName) {
+  class Reads : public IRVisitor {
+  public:
+    Reads(Var var, string fieldName) : var(var), fieldName(fieldName) {}
+    Var var;
+    string fieldName;
+    bool found = false;
+
+    using IRVisitor::visit;
+    void visit(const VarExpr* op) {
+      found |= var.defined() && op->var == var;
+    }
+    void visit(const FieldRead* op) {
+      found |= fieldName != "" && op->fieldName == fieldName;
+      IRVisitor::visit(op);
+    }
+  };
+  Reads visitor(var, fieldName);
+  expr.accept(&visitor);
+  return visitor.found;
+}
+
+/// Adds the vars `expr` reads to `vars`.
+static void getVars(Expr expr, set<Var>* vars) {
+  class GetVars : public IRVisitor {
+  public:
+    GetVars(set<Var>* vars) : vars(vars) {}
+    set<Var>* vars;
+
+    using IRVisitor::visit;
+    void visit(const VarExpr* op) {
+      vars->insert(op->var);
+    }
+  };
+  GetVars visitor(vars);
+  expr.accept(&visitor);
+}
+
+/// The function of an assembly map: the fields and flops it takes to compute
+/// the blocks of its matrix, and whether it writes nothing but the blocks.
+class MapFunctionAnalysis : public IRVisitor {
+public:
+  MapFunctionAnalysis(Func function) : result(function.getResults()[0]) {
+    function.getBody().accept(this);
+  }
+
+  bool isValid() const {return valid && numWrites > 0;}
+
+  /// The element and set fields the function reads.
+  const set<string>& getFieldsRead() const {return fieldsRead;}
+
+  /// The number of block writes to the matrix per element.
+  double getNumWrites() const {return numWrites;}
+
+  /// Estimated flops to compute the blocks of one element.
+  double getFlops() const {return flops;}
+
+private:
+  Var result;
+  bool valid = true;
+  set<string> fieldsRead;
+  double numWrites = 0.0;
+  double flops = 0.0;
+  double scale = 1.0;
+
+  using IRVisitor::visit;
+
+  void visit(const VarExpr* op) {
+    valid &= (op->var != result);
+  }
+
+  void visit(const FieldRead* op) {
+    fieldsRead.insert(op->fieldName);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const TensorWrite* op) {
+    if (isa<VarExpr>(op->tensor) && to<VarExpr>(op->tensor)->var == result) {
+      valid &= (op->indices.size() == 2);
+      numWrites += scale;
+      for (auto& index : op->indices) {
+        index.accept(this);
+      }
+      op->value.accept(this);
+    }
+    else {
+      // Writes to fields would be repeated by every product
+      Expr tensor = op->tensor;
+      while (isa<TensorRead>(tensor)) {
+        tensor = to<TensorRead>(tensor)->tensor;
+      }
+      valid &= !isa<FieldRead>(tensor);
+      IRVisitor::visit(op);
+    }
+  }
+
+  void visit(const FieldWrite*) {
+    valid = false;
+  }
+
+  void visit(const CallStmt* op) {
+    flops += scale * CallFlops;
+    if (op->callee.getKind() != Func::Intrinsic) {
+      for (auto& actual : op->actuals) {
+        valid &= !actual.type().isElement() && !actual.type().isSet() &&
+                 !actual.type().isTuple();
+      }
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const ForRange* op) {
+    double trips = LoopTrips;
+    if (isa<Literal>(op->start) && isa<Literal>(op->end)) {
+      trips = to<Literal>(op->end)->getIntVal(0) -
+              to<Literal>(op->start)->getIntVal(0);
+    }
+    double outerScale = scale;
+    scale *= max(trips, 0.0);
+    IRVisitor::visit(op);
+    scale = outerScale;
+  }
+
+  void visit(const IndexExpr* op) {
+    // Every operation is done once per component of the iteration space
+    vector<IndexVar> indexVars = op->resultVars;
+    for (auto& indexVar : getReductionVars(op->value)) {
+      indexVars.push_back(indexVar);
+    }
+    double outerScale = scale;
+    for (auto& indexVar : indexVars) {
+      for (auto& indexSet : indexVar.getDomain().getIndexSets()) {
+        if (indexSet.getKind() == IndexSet::Range) {
+          scale *= indexSet.getSize();
+        }
+      }
+    }
+    IRVisitor::visit(op);
+    scale = outerScale;
+  }
+
+  void visit(const Add* op) {flops += scale; IRVisitor::visit(op);}
+  void visit(const Sub* op) {flops += scale; IRVisitor::visit(op);}
+  void visit(const Mul* op) {flops += scale; IRVisitor::visit(op);}
+  void visit(const Div* op) {flops += scale; IRVisitor::visit(op);}
+  void visit(const Neg* op) {flops += scale; IRVisitor::visit(op);}
+};
+
+/// Finds the matrices that are assembled by one map and only used in
+/// matrix-vector products, together with the products and the writes that
+/// may clobber what the map reads.
+class MatrixUses : public IRVisitor {
+public:
+  /// A statement and the loops around it, in program order.
+  struct Position {
+    int index;
+    vector<const StmtNode*> loops;
+
+    /// The number of loops around this position that are not around `other`.
+    int getLoopsAround(const Position& other) const {
+      int loopsAround = 0;
+      for (auto& loop : loops) {
+        loopsAround += !util::contains(other.loops, loop);
+      }
+      return loopsAround;
+    }
+  };
+
+  struct Product {
+    Stmt stmt;
+    Expr vector;
+    bool transposed;
+    Position position;
+  };
+
+  struct Assembly {
+    const Map* map;
+    Position position;
+    vector<Product> products;
+  };
+
+  /// A write to a var, to a field of a set, or to anything (`opaque`).
+  struct Write {
+    Var var;
+    string fieldName;
+    bool opaque;
+    Position position;
+  };
+
+  MatrixUses(Func func) {
+    func.getBody().accept(this);
+
+    // The matrix must be assembled once and only be used in products
+    invalid.insert(func.getArguments().begin(), func.getArguments().end());
+    invalid.insert(func.getResults().begin(), func.getResults().end());
+    for (auto& write : writes) {
+      if (write.var.defined() && assemblies.find(write.var) !=
+          assemblies.end() && write.position.index !=
+          assemblies.at(write.var).position.index) {
+        invalid.insert(write.var);
+      }
+    }
+    for (auto& var : invalid) {
+      assemblies.erase(var);
+    }
+  }
+
+  const map<Var,Assembly>& getAssemblies() const {return assemblies;}
+
+  /// True if something the assembly reads may be written between the
+  /// assembly and the product.
+  bool isClobbered(const Assembly& assembly, const Product& product,
+                   const set<string>& fieldsRead,
+                   const set<Var>& varsRead) const {
+    if (product.position.index < assembly.position.index) {
+      return true;
+    }
+    for (auto& write : writes) {
+      bool clobbers = write.opaque ||
+                      (write.var.defined() && util::contains(varsRead,
+                                                             write.var)) ||
+                      util::contains(fieldsRead, write.fieldName);
+      if (!clobbers) {
+        continue;
+      }
+      if (write.position.index > assembly.position.index &&
+          write.position.index < product.position.index) {
+        return true;
+      }
+      // A write in a loop around the product, but not the assembly, happens
+      // before the product in the next iteration
+      for (auto& loop : product.position.loops) {
+        if (util::contains(write.position.loops, loop) &&
+            !util::contains(assembly.position.loops, loop)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+private:
+  map<Var,Assembly> assemblies;
+  set<Var> invalid;
+  vector<Write> writes;
+  int index = 0;
+  vector<const StmtNode*> loops;
+
+  Position getPosition() {
+    return {index++, loops};
+  }
+
+  void addWrite(Var var) {
+    writes.push_back({var, "", false, getPosition()});
+  }
+
+  using IRVisitor::visit;
+
+  void visit(const VarExpr* op) {
+    invalid.insert(op->var);
+  }
+
+  void visit(const Map* op) {
+    for (auto& actual : op->partial_actuals) {
+      actual.accept(this);
+    }
+    Position position = getPosition();
+    for (auto& var : op->vars) {
+      writes.push_back({var, "", false, position});
+    }
+
+    const Func& function = op->function;
+    if (op->vars.size() != 1 ||
+        op->reduction.getKind() != ReductionOperator::Sum ||
+        op->through.defined() || function.getKind() != Func::Internal ||
+        !op->target.type().isUnstructuredSet()) {
+      return;
+    }
+    Var matrix = op->vars[0];
+    Type type = matrix.getType();
+    int rows, cols;
+    if (!type.isTensor() || type.toTensor()->order() != 2 ||
+        !type.toTensor()->hasSystemDimensions() ||
+        !getBlockSize(type, &rows, &cols)) {
+      return;
+    }
+    if (assemblies.find(matrix) != assemblies.end()) {
+      invalid.insert(matrix);
+      return;
+    }
+    assemblies.insert({matrix, {op, position, {}}});
+  }
+
+  void visit(const AssignStmt* op) {
+    if (!matchProduct(op, op->value, op->cop)) {
+      op->value.accept(this);
+    }
+    addWrite(op->var);
+  }
+
+  void visit(const FieldWrite* op) {
+    op->elementOrSet.accept(this);
+    if (!matchProduct(op, op->value, op->cop)) {
+      op->value.accept(this);
+    }
+    writes.push_back({Var(), op->fieldName, false, getPosition()});
+  }
+
+  void visit(const TensorWrite* op) {
+    IRVisitor::visit(op);
+    Expr tensor = op->tensor;
+    while (isa<TensorRead>(tensor)) {
+      tensor = to<TensorRead>(tensor)->tensor;
+    }
+    if (isa<VarExpr>(tensor)) {
+      addWrite(to<VarExpr>(tensor)->var);
+    }
+    else if (isa<FieldRead>(tensor)) {
+      writes.push_back({Var(), to<FieldRead>(tensor)->fieldName, false,
+                        getPosition()});
+    }
+    else {
+      writes.push_back({Var(), "", true, getPosition()});
+    }
+  }
+
+  void visit(const CallStmt* op) {
+    IRVisitor::visit(op);
+    for (auto& result : op->results) {
+      addWrite(result);
+    }
+    // Functions may write the fields of the sets they are passed
+    if (op->callee.getKind() != Func::Intrinsic) {
+      writes.push_back({Var(), "", true, getPosition()});
+    }
+  }
+
+  void visit(const ForRange* op) {
+    loops.push_back(op);
+    IRVisitor::visit(op);
+    loops.pop_back();
+  }
+
+  void visit(const For* op) {
+    loops.push_back(op);
+    IRVisitor::visit(op);
+    loops.pop_back();
+  }
+
+  void visit(const While* op) {
+    loops.push_back(op);
+    IRVisitor::visit(op);
+    loops.pop_back();
+  }
+
+  /// Records `stmt` as a product if it computes one and returns true.
+  bool matchProduct(Stmt stmt, Expr value, CompoundOperator cop) {
+    Var matrix;
+    Expr vector;
+    bool transposed;
+    if (cop != CompoundOperator::None ||
+        !ir::matchProduct(value, &matrix, &vector, &transposed) ||
+        assemblies.find(matrix) == assemblies.end()) {
+      return false;
+    }
+    vector.accept(this);
+
+    // The map zeroes the result before it reads the vector
+    Var lhs = isa<AssignStmt>(stmt) ? to<AssignStmt>(stmt)->var : Var();
+    string field = isa<FieldWrite>(stmt) ? to<FieldWrite>(stmt)->fieldName : "";
+    if (reads(vector, lhs, field) || reads(vector, matrix, "")) {
+      invalid.insert(matrix);
+    }
+    assemblies.at(matrix).products.push_back({stmt, vector, transposed,
+                                              getPosition()});
+    return true;
+  }
+};
+
+/// Rewrites the function of an assembly map to compute y = A*x (or A'*x)
+/// instead of A, by multiplying every block it writes by a block of x.
+class ProductFunctionRewriter : public IRRewriter {
+public:
+  ProductFunctionRewriter(Var matrix, Var x, Var y, bool transposed)
+      : matrix(matrix), x(x), y(y), transposed(transposed) {}
+
+private:
+  Var matrix;
+  Var x;
+  Var y;
+  bool transposed;
+
+  using IRRewriter::visit;
+
+  void visit(const TensorWrite* op) {
+    if (!isa<VarExpr>(op->tensor) || to<VarExpr>(op->tensor)->var != matrix) {
+      IRRewriter::visit(op);
+      return;
+    }
+    Expr row = rewrite(op->indices[transposed ? 1 : 0]);
+    Expr col = rewrite(op->indices[transposed ? 0 : 1]);
+    Expr block = rewrite(op->value);
+    Expr xBlock = TensorRead::make(x, {col});
+
+    Expr value;
+    if (isScalar(block.type())) {
+      value = Mul::make(block, xBlock);
+    }
+    else {
+      vector<IndexDomain> dims = block.type().toTensor()->getDimensions();
+      IndexVar i("i", dims[transposed ? 1 : 0]);
+      IndexVar j("j", dims[transposed ? 0 : 1], ReductionOperator::Sum);
+      Expr blockij = transposed ? IndexedTensor::make(block, {j,i})
+                                : IndexedTensor::make(block, {i,j});
+      value = IndexExpr::make({i}, Mul::make(blockij,
+                                             IndexedTensor::make(xBlock, {j})));
+    }
+    // The map reduction sums the products of the blocks
+    stmt = TensorWrite::make(y, {row}, value, op->cop);
+  }
+};
+
+/// Creates the function of a map that computes y = A*x (or A'*x) where A is
+/// assembled by `function`.
+static Func createProductFunction(Func function, Type xType, Type yType,
+                                  bool transposed) {
+  Var matrix = function.getResults()[0];
+  Var x(INTERNAL_PREFIX("x"), xType);
+  Var y(INTERNAL_PREFIX("y"), yType);
+  Stmt body = ProductFunctionRewriter(matrix, x, y, transposed)
+      .rewrite(function.getBody());
+
+  vector<Var> arguments = {x};
+  arguments.insert(arguments.end(), function.getArguments().begin(),
+                   function.getArguments().end());
+  string name = function.getName() + (transposed ? "_tmul" : "_mul");
+  Func product(name, arguments, {y}, body, function.getEnvironment());
+  product = flattenIndexExpressions(product);
+  return insertTemporaries(product);
+}
+
+/// Rewrites the products of the matrix-free assemblies to maps and removes
+/// the assemblies.
+class MatrixFreeRewriter : public IRRewriter {
+public:
+  MatrixFreeRewriter(const map<Stmt,Stmt>& products, const set<Var>& matrices)
+      : products(products), matrices(matrices) {}
+
+private:
+  const map<Stmt,Stmt>& products;
+  const set<Var>& matrices;
+
+  using IRRewriter::visit;
+
+  void visit(const VarDecl* op) {
+    stmt = util::contains(matrices, op->var) ? Stmt() : op;
+  }
+
+  void visit(const Map* op) {
+    stmt = (op->vars.size() == 1 && util::contains(matrices, op->vars[0]))
+        ? Stmt() : op;
+  }
+
+  void visit(const AssignStmt* op) {
+    auto product = products.find(op);
+    stmt = (product != products.end()) ? product->second : op;
+  }
+
+  void visit(const FieldWrite* op) {
+    auto product = products.find(op);
+    stmt = (product != products.end()) ? product->second : op;
+  }
+};
+
+/// Estimates whether computing the products from the assembly function is
+/// cheaper than assembling the matrix once and multiplying by it.
+static bool isMatrixFreeCheaper(const MatrixUses::Assembly& assembly,
+                                const MapFunctionAnalysis& function) {
+  int rows, cols;
+  getBlockSize(assembly.map->vars[0].getType(), &rows, &cols);
+  const double blockBytes =
+      rows * cols * assembly.map->vars[0].getType().toTensor()
+                        ->getComponentType().bytes();
+
+  // Per element: a value block and a column index per block written
+  const double blocks = function.getNumWrites();
+  const double matrixBytes = blocks * (blockBytes + sizeof(int));
+  const double productFlops = blocks * 2 * rows * cols;
+
+  // Products in loops are done once per iteration
+  double numProducts = 0.0;
+  for (auto& product : assembly.products) {
+    int loops = product.position.getLoopsAround(assembly.position);
+    double products = 1.0;
+    for (int i=0; i < loops; ++i) {
+      products *= LoopTrips;
+    }
+    numProducts += products;
+  }
+
+  const double assembled = function.getFlops() + matrixBytes * FlopsPerByte +
+      numProducts * (matrixBytes * FlopsPerByte + productFlops);
+  const double matrixFree = numProducts * (function.getFlops() + productFlops);
+  return matrixFree < assembled;
+}
+
+Func lowerMatrixFree(Func func, bool always) {
+  MatrixUses uses(func);
+
+  map<Stmt,Stmt> products;
+  set<Var> matrices;
+  for (auto& entry : uses.getAssemblies()) {
+    const MatrixUses::Assembly& assembly = entry.second;
+    if (assembly.products.size() == 0) {
+      continue;
+    }
+    const Map* map = assembly.map;
+    MapFunctionAnalysis function(map->function);
+    if (!function.isValid()) {
+      continue;
+    }
+
+    set<Var> varsRead;
+    for (auto& actual : map->partial_actuals) {
+      getVars(actual, &varsRead);
+    }
+    bool clobbered = false;
+    for (auto& product : assembly.products) {
+      clobbered |= uses.isClobbered(assembly, product,
+                                    function.getFieldsRead(), varsRead);
+    }
+    if (clobbered || (!always && !isMatrixFreeCheaper(assembly, function))) {
+      continue;
+    }
+
+    matrices.insert(entry.first);
+    for (auto& product : assembly.products) {
+      Type yType = isa<AssignStmt>(product.stmt)
+          ? to<AssignStmt>(product.stmt)->var.getType()
+          : to<FieldWrite>(product.stmt)->value.type();
+      Func productFunction = createProductFunction(
+          map->function, product.vector.type(), yType, product.transposed);
+
+      vector<Expr> actuals = {product.vector};
+      actuals.insert(actuals.end(), map->partial_actuals.begin(),
+                     map->partial_actuals.end());
+      if (isa<AssignStmt>(product.stmt)) {
+        Var y = to<AssignStmt>(product.stmt)->var;
+        products[product.stmt] = Map::make({y}, productFunction, actuals,
+                                           map->target, map->neighbors,
+                                           Expr(), map->reduction);
+      }
+      else {
+        const FieldWrite* fieldWrite = to<FieldWrite>(product.stmt);
+        Var y(INTERNAL_PREFIX("y"), yType);
+        products[product.stmt] = Block::make(
+            Map::make({y}, productFunction, actuals, map->target,
+                      map->neighbors, Expr(), map->reduction),
+            FieldWrite::make(fieldWrite->elementOrSet, fieldWrite->fieldName,
+                             y));
+      }
+    }
+  }
+
+  if (matrices.size() == 0) {
+    return func;
+  }
+  func = MatrixFreeRewriter(products, matrices).rewrite(func);
+  return insertVarDecls(func);
+}
+
+}}
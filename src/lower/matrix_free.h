@@ -0,0 +1,18 @@
+#ifndef SIMIT_MATRIX_FREE_H
+#define SIMIT_MATRIX_FREE_H
+
+#include "ir.h"
+
+namespace simit {
+namespace ir {
+
+/// Replace the products y = A*x and y = A'*x by a system matrix assembled by
+/// `A = map f to E reduce +`, and used in nothing else, by maps over E that
+/// multiply the blocks f computes by x. A is then never assembled. Unless
+/// `always` is set this is only done where the cost model estimates that
+/// evaluating f per product is cheaper than streaming A. Must run on
+/// flattened index expressions, before storage is determined.
+Func lowerMatrixFree(Func func, bool always=false);
+
+}}
+#endif
@@ -0,0 +1,368 @@
+#include "reuse_buffers.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
+#include "storage.h"
+#include "tensor_index.h"
+#include "util/collections.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// The positions, in program order, at which the variables of a function body
+/// are declared and accessed. Every statement that is not a block, scope or
+/// loop gets its own position, as do the headers of loops and conditionals.
+class LiveRanges : public IRVisitor {
+public:
+  struct Range {
+    int declared = -1;
+    int first = -1;
+    int last = -1;
+  };
+
+  /// The range of positions each variable is live at.
+  map<Var,Range> ranges;
+
+  /// The scopes each variable is declared in, outermost first.
+  map<Var,vector<int>> scopes;
+
+  /// The statement at each position.
+  map<int,Stmt> stmts;
+
+  LiveRanges(Stmt body) {
+    body.accept(this);
+
+    // A variable that is accessed in a loop it is declared outside of carries
+    // its value between iterations, so it is live during the whole loop. The
+    // loops are recorded inner loops first, so one pass extends the ranges of
+    // variables accessed in nested loops to the outermost loop.
+    for (auto &loop : loops) {
+      for (auto &range : ranges) {
+        Range &r = range.second;
+        if (r.first != -1 && r.first <= loop.second && r.last >= loop.first &&
+            r.declared < loop.first) {
+          r.first = min(r.first, loop.first);
+          r.last = max(r.last, loop.second);
+        }
+      }
+    }
+  }
+
+private:
+  int position = 0;
+  int numScopes = 0;
+  vector<int> scope;
+  vector<pair<int,int>> loops;
+
+  using IRVisitor::visit;
+
+  void access(const Var &var) {
+    Range &range = ranges[var];
+    if (range.first == -1) {
+      range.first = position;
+    }
+    range.last = position;
+  }
+
+  void next(Stmt stmt) {
+    stmts[++position] = stmt;
+  }
+
+  void visit(const VarExpr *op) {
+    access(op->var);
+  }
+
+  void visit(const VarDecl *op) {
+    next(op);
+    ranges[op->var].declared = position;
+    scopes[op->var] = scope;
+  }
+
+  void visit(const AssignStmt *op) {
+    next(op);
+    IRVisitor::visit(op);
+    access(op->var);
+  }
+
+  void visit(const CallStmt *op) {
+    next(op);
+    IRVisitor::visit(op);
+    for (auto &result : op->results) {
+      access(result);
+    }
+  }
+
+  void visit(const Map *op) {
+    next(op);
+    IRVisitor::visit(op);
+    for (auto &var : op->vars) {
+      access(var);
+    }
+  }
+
+  void visit(const FieldWrite *op) {
+    next(op);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const TensorWrite *op) {
+    next(op);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Store *op) {
+    next(op);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Print *op) {
+    next(op);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Scope *op) {
+    scope.push_back(numScopes++);
+    IRVisitor::visit(op);
+    scope.pop_back();
+  }
+
+  void visit(const IfThenElse *op) {
+    next(op);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const ForRange *op) {
+    next(op);
+    int start = position;
+    IRVisitor::visit(op);
+    loops.push_back({start, position});
+  }
+
+  void visit(const For *op) {
+    next(op);
+    int start = position;
+    IRVisitor::visit(op);
+    loops.push_back({start, position});
+  }
+
+  void visit(const While *op) {
+    next(op);
+    int start = position;
+    IRVisitor::visit(op);
+    loops.push_back({start, position});
+  }
+};
+
+/// Returns true if `stmt` defines `var` by an index expression that reads
+/// `operand` only at the element it computes, and that has no reductions.
+/// The lowered loop then reads each element of `operand` before it writes the
+/// same element of `var`, so the two can share a dense buffer.
+static bool isElementwiseUpdate(Stmt stmt, const Var &var, const Var &operand) {
+  if (!isa<AssignStmt>(stmt) || to<AssignStmt>(stmt)->var != var ||
+      to<AssignStmt>(stmt)->cop != CompoundOperator::None ||
+      !isa<IndexExpr>(to<AssignStmt>(stmt)->value)) {
+    return false;
+  }
+  const IndexExpr *indexExpr = to<IndexExpr>(to<AssignStmt>(stmt)->value);
+
+  bool elementwise = true;
+  int reads = 0;
+  int elementReads = 0;
+  match(indexExpr->value,
+    function<void(const IndexedTensor*)>([&](const IndexedTensor *op) {
+      for (auto &indexVar : op->indexVars) {
+        elementwise &= !indexVar.isReductionVar();
+      }
+      if (isa<VarExpr>(op->tensor) &&
+          to<VarExpr>(op->tensor)->var == operand &&
+          op->indexVars == indexExpr->resultVars) {
+        elementReads++;
+      }
+    }),
+    function<void(const VarExpr*)>([&](const VarExpr *op) {
+      reads += (op->var == operand);
+    })
+  );
+  return elementwise && reads > 0 && reads == elementReads;
+}
+
+/// Returns true if `stmt` assigns all of `var`, so that the values a buffer
+/// held before do not matter.
+static bool isDefinition(Stmt stmt, const Var &var) {
+  if (isa<AssignStmt>(stmt)) {
+    return to<AssignStmt>(stmt)->var == var &&
+           to<AssignStmt>(stmt)->cop == CompoundOperator::None;
+  }
+  if (isa<Map>(stmt)) {
+    return util::contains(to<Map>(stmt)->vars, var);
+  }
+  if (isa<CallStmt>(stmt)) {
+    return util::contains(to<CallStmt>(stmt)->results, var);
+  }
+  return false;
+}
+
+/// Returns true if `a` and `b` are stored in buffers of the same size and
+/// layout.
+static bool isSameBuffer(const Var &a, const Var &b, const Storage &storage) {
+  const TensorType *aType = a.getType().toTensor();
+  const TensorType *bType = b.getType().toTensor();
+  if (!(aType->getComponentType() == bType->getComponentType()) ||
+      aType->getDimensions() != bType->getDimensions()) {
+    return false;
+  }
+  const TensorStorage &aStorage = storage.getStorage(a);
+  const TensorStorage &bStorage = storage.getStorage(b);
+  if (aStorage.getKind() != bStorage.getKind()) {
+    return false;
+  }
+  return aStorage.getKind() != TensorStorage::Indexed ||
+         aStorage.getTensorIndex().getPathExpression() ==
+         bStorage.getTensorIndex().getPathExpression();
+}
+
+/// Returns true if `var` is stored in a buffer of the function (rather than
+/// on the stack or in memory that extern functions manage).
+static bool isBuffer(const Var &var, const Func &func) {
+  const Storage &storage = func.getStorage();
+  if (!var.getType().isTensor() || !isSystemTensorType(var.getType()) ||
+      !storage.hasStorage(var) ||
+      func.getEnvironment().hasTemporary(var)) {
+    return false;
+  }
+  const TensorStorage &tensorStorage = storage.getStorage(var);
+  switch (tensorStorage.getKind()) {
+    case TensorStorage::Dense:
+      return true;
+    case TensorStorage::Indexed:
+      return tensorStorage.getTensorIndex().getPathExpression().defined();
+    default:
+      return false;
+  }
+}
+
+Func reuseBuffers(Func func) {
+  LiveRanges liveRanges(func.getBody());
+  const Storage &storage = func.getStorage();
+
+  vector<Var> temporaries;
+  for (auto &range : liveRanges.ranges) {
+    if (range.second.declared != -1 && range.second.first != -1 &&
+        isBuffer(range.first, func)) {
+      temporaries.push_back(range.first);
+    }
+  }
+  sort(temporaries.begin(), temporaries.end(),
+       [&liveRanges](const Var &a, const Var &b) {
+         return liveRanges.ranges.at(a).first < liveRanges.ranges.at(b).first;
+       });
+
+  // Assign the temporaries, in the order they become live, to the first
+  // buffer that is free by then. A buffer is named after the temporary that
+  // first used it, which must be declared in a scope that encloses the
+  // declarations of the temporaries that share it.
+  struct Buffer {
+    Var var;
+    Var last;
+  };
+  vector<Buffer> buffers;
+  map<Var,Var> renames;
+  for (auto &temporary : temporaries) {
+    const LiveRanges::Range &range = liveRanges.ranges.at(temporary);
+    const vector<int> &scope = liveRanges.scopes.at(temporary);
+    Stmt definition = liveRanges.stmts.at(range.first);
+
+    // Only temporaries that are first assigned as a whole can take over a
+    // buffer, since they must not depend on what it held before
+    Buffer *shared = nullptr;
+    for (auto &buffer : buffers) {
+      if (shared != nullptr || !isDefinition(definition, temporary)) {
+        break;
+      }
+      const vector<int> &bufferScope = liveRanges.scopes.at(buffer.var);
+      int end = liveRanges.ranges.at(buffer.last).last;
+      if (!isSameBuffer(buffer.var, temporary, storage) ||
+          bufferScope.size() > scope.size() ||
+          !equal(bufferScope.begin(), bufferScope.end(), scope.begin())) {
+        continue;
+      }
+      if (end < range.first ||
+          (end == range.first &&
+           storage.getStorage(temporary).getKind() == TensorStorage::Dense &&
+           isElementwiseUpdate(definition, temporary, buffer.last))) {
+        shared = &buffer;
+      }
+    }
+    if (shared != nullptr) {
+      renames[temporary] = shared->var;
+      shared->last = temporary;
+    }
+    else {
+      buffers.push_back({temporary, temporary});
+    }
+  }
+  if (renames.empty()) {
+    return func;
+  }
+
+  class RenameRewriter : public IRRewriter {
+  public:
+    RenameRewriter(const map<Var,Var> &renames) : renames(renames) {}
+
+  private:
+    const map<Var,Var> &renames;
+
+    using IRRewriter::visit;
+
+    Var rename(const Var &var) {
+      return util::contains(renames, var) ? renames.at(var) : var;
+    }
+
+    void visit(const VarExpr *op) {
+      expr = util::contains(renames, op->var)
+          ? VarExpr::make(renames.at(op->var)) : Expr(op);
+    }
+
+    void visit(const VarDecl *op) {
+      stmt = util::contains(renames, op->var) ? Stmt() : Stmt(op);
+    }
+
+    void visit(const AssignStmt *op) {
+      stmt = AssignStmt::make(rename(op->var), rewrite(op->value), op->cop);
+    }
+
+    void visit(const CallStmt *op) {
+      vector<Var> results;
+      for (auto &result : op->results) {
+        results.push_back(rename(result));
+      }
+      vector<Expr> actuals;
+      for (auto &actual : op->actuals) {
+        actuals.push_back(rewrite(actual));
+      }
+      stmt = CallStmt::make(results, op->callee, actuals);
+    }
+
+    void visit(const Map *op) {
+      IRRewriter::visit(op);
+      vector<Var> vars;
+      for (auto &var : op->vars) {
+        vars.push_back(rename(var));
+      }
+      const Map *rewritten = to<Map>(stmt);
+      stmt = Map::make(vars, rewritten->function, rewritten->partial_actuals,
+                       rewritten->target, rewritten->neighbors,
+                       rewritten->through, rewritten->reduction);
+    }
+  };
+  Stmt body = RenameRewriter(renames).rewrite(func.getBody());
+  return Func(func, body);
+}
+
+}}
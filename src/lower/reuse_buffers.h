@@ -0,0 +1,19 @@
+#ifndef SIMIT_REUSE_BUFFERS_H
+#define SIMIT_REUSE_BUFFERS_H
+
+#include "ir.h"
+
+namespace simit {
+namespace ir {
+
+/// Let system tensor temporaries whose live ranges do not overlap share one
+/// buffer, by renaming them to the same variable. A temporary is live from its
+/// first to its last access, and over the whole of every loop it is accessed
+/// in but declared outside of. Dense temporaries may also take over the buffer
+/// of an operand that dies in the element-wise statement that defines them,
+/// e.g. `r = b - t` where t is not used again, which then updates it in place.
+/// Must run after storage is determined.
+Func reuseBuffers(Func func);
+
+}}
+#endif
@@ -0,0 +1,352 @@
+#include "scalarize.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ir_rewriter.h"
+#include "ir_transforms.h"
+#include "ir_visitor.h"
+#include "substitute.h"
+#include "util/collections.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+static bool isIntLiteral(Expr expr) {
+  return isa<Literal>(expr) && isInt(expr.type());
+}
+
+static int getIntValue(Expr expr) {
+  return to<Literal>(expr)->getIntVal(0);
+}
+
+/// Returns true if `type` is a dense (non-system) tensor with at most
+/// `maxSize` components.
+static bool isSmallTensor(const Type &type, size_t maxSize) {
+  return type.isTensor() && !isScalar(type) && !isSystemTensorType(type) &&
+         type.toTensor()->size() <= maxSize;
+}
+
+/// Folds integer arithmetic on literals and the lengths of ranges, which
+/// turns the indices of unrolled loads and stores into literals.
+class FoldIndices : public IRRewriter {
+  using IRRewriter::visit;
+
+  void visit(const Length *op) {
+    expr = (op->indexSet.getKind() == IndexSet::Range)
+        ? Literal::make((int)op->indexSet.getSize()) : Expr(op);
+  }
+
+  void visit(const Neg *op) {
+    IRRewriter::visit(op);
+    if (isa<Neg>(expr) && isIntLiteral(to<Neg>(expr)->a)) {
+      expr = Literal::make(-getIntValue(to<Neg>(expr)->a));
+    }
+  }
+
+  void visit(const Add *op) {
+    fold(op, [](int a, int b) {return a + b;}, 0, true);
+  }
+
+  void visit(const Sub *op) {
+    fold(op, [](int a, int b) {return a - b;}, 0, false);
+  }
+
+  void visit(const Mul *op) {
+    fold(op, [](int a, int b) {return a * b;}, 1, true);
+  }
+
+  /// Folds a binary operation on two literals, and drops an operand that is
+  /// the `identity` of the operation.
+  template <class T>
+  void fold(const T *op, function<int(int,int)> compute, int identity,
+            bool commutative) {
+    IRRewriter::visit(op);
+    if (!isa<T>(expr)) {
+      return;
+    }
+    Expr a = to<T>(expr)->a;
+    Expr b = to<T>(expr)->b;
+    if (isIntLiteral(a) && isIntLiteral(b)) {
+      expr = Literal::make(compute(getIntValue(a), getIntValue(b)));
+    }
+    else if (isIntLiteral(b) && getIntValue(b) == identity) {
+      expr = a;
+    }
+    else if (commutative && isIntLiteral(a) && getIntValue(a) == identity) {
+      expr = b;
+    }
+  }
+};
+
+/// Fully unrolls loop nests over the components of small tensors, innermost
+/// loops first. A loop is only unrolled if every loop in its body was, so
+/// code is only duplicated for nests that become straight-line code.
+class UnrollLoops : public IRRewriter {
+public:
+  UnrollLoops(size_t maxSize) : maxSize(maxSize) {}
+
+private:
+  size_t maxSize;
+
+  /// The number of iterations of the largest nest unrolled in the statement
+  /// that is being rewritten.
+  size_t iterations = 1;
+
+  using IRRewriter::visit;
+
+  bool indexesSmallTensor(Stmt stmt, const Var &var) {
+    bool indexes = false;
+    auto check = [&](Expr buffer, Expr index) {
+      if (!isa<VarExpr>(buffer) || !isSmallTensor(buffer.type(), maxSize)) {
+        return;
+      }
+      match(index, function<void(const VarExpr*)>([&](const VarExpr *op) {
+        indexes |= (op->var == var);
+      }));
+    };
+    match(stmt,
+      function<void(const Load*)>([&](const Load *op) {
+        check(op->buffer, op->index);
+      }),
+      function<void(const Store*)>([&](const Store *op) {
+        check(op->buffer, op->index);
+      })
+    );
+    return indexes;
+  }
+
+  static bool containsLoop(Stmt stmt) {
+    bool loop = false;
+    match(stmt,
+      function<void(const ForRange*)>([&](const ForRange*) {loop = true;}),
+      function<void(const For*)>([&](const For*) {loop = true;}),
+      function<void(const While*)>([&](const While*) {loop = true;})
+    );
+    return loop;
+  }
+
+  /// Rewrites the body of a loop of `var` from `start` to `end` into
+  /// `rewrittenBody`, and returns the unrolled loop, or an undefined statement
+  /// if it is not unrolled.
+  Stmt unroll(const Var &var, Expr start, Expr end, Stmt body,
+              Stmt *rewrittenBody) {
+    size_t outerIterations = iterations;
+    iterations = 1;
+    body = rewrite(body);
+    size_t bodyIterations = iterations;
+    iterations = outerIterations;
+    *rewrittenBody = body;
+
+    int numIterations = (isIntLiteral(start) && isIntLiteral(end))
+        ? getIntValue(end) - getIntValue(start) : 0;
+    if (numIterations <= 0 ||
+        (size_t)numIterations * bodyIterations > maxSize ||
+        containsLoop(body) || !indexesSmallTensor(body, var)) {
+      return Stmt();
+    }
+
+    // Declare the locals of the body once, in front of its copies
+    pair<Stmt,vector<Stmt>> varDecls = removeVarDecls(body);
+    vector<Stmt> stmts = varDecls.second;
+    Expr varExpr = VarExpr::make(var);
+    for (int i = getIntValue(start); i < getIntValue(end); ++i) {
+      Stmt iteration = substitute({{varExpr, Literal::make(i)}},
+                                  varDecls.first);
+      stmts.push_back(FoldIndices().rewrite(iteration));
+    }
+    iterations = max(iterations, (size_t)numIterations * bodyIterations);
+    return Block::make(stmts);
+  }
+
+  void visit(const ForRange *op) {
+    Expr start = FoldIndices().rewrite(op->start);
+    Expr end = FoldIndices().rewrite(op->end);
+    Stmt body;
+    stmt = unroll(op->var, start, end, op->body, &body);
+    if (!stmt.defined()) {
+      stmt = (start == op->start && end == op->end && body == op->body)
+          ? Stmt(op) : ForRange::make(op->var, start, end, body);
+    }
+  }
+
+  void visit(const For *op) {
+    if (op->domain.kind != ForDomain::IndexSet ||
+        op->domain.indexSet.getKind() != IndexSet::Range) {
+      IRRewriter::visit(op);
+      return;
+    }
+    Expr size = Literal::make((int)op->domain.indexSet.getSize());
+    Stmt body;
+    stmt = unroll(op->var, Literal::make(0), size, op->body, &body);
+    if (!stmt.defined()) {
+      stmt = (body == op->body) ? Stmt(op)
+                                : For::make(op->var, op->domain, body);
+    }
+  }
+};
+
+/// Finds the locals that are small tensors whose components are only loaded
+/// and stored at literal indices, or all set to zero.
+class FindScalarizableTensors : public IRVisitor {
+public:
+  FindScalarizableTensors(size_t maxSize) : maxSize(maxSize) {}
+
+  set<Var> find(Stmt stmt) {
+    stmt.accept(this);
+    set<Var> scalarizable;
+    for (auto &var : declared) {
+      if (!util::contains(escaped, var)) {
+        scalarizable.insert(var);
+      }
+    }
+    return scalarizable;
+  }
+
+private:
+  size_t maxSize;
+  set<Var> declared;
+  set<Var> escaped;
+
+  using IRVisitor::visit;
+
+  bool isComponent(Expr buffer, Expr index) {
+    return isa<VarExpr>(buffer) && isIntLiteral(index) &&
+           getIntValue(index) >= 0 &&
+           (size_t)getIntValue(index) < buffer.type().toTensor()->size();
+  }
+
+  void visit(const VarDecl *op) {
+    if (isSmallTensor(op->var.getType(), maxSize)) {
+      declared.insert(op->var);
+    }
+  }
+
+  void visit(const VarExpr *op) {
+    escaped.insert(op->var);
+  }
+
+  void visit(const Load *op) {
+    if (!isComponent(op->buffer, op->index)) {
+      IRVisitor::visit(op);
+    }
+  }
+
+  void visit(const Store *op) {
+    if (isComponent(op->buffer, op->index)) {
+      op->value.accept(this);
+    }
+    else {
+      IRVisitor::visit(op);
+    }
+  }
+
+  void visit(const AssignStmt *op) {
+    if (op->cop != CompoundOperator::None || !isa<Literal>(op->value) ||
+        !to<Literal>(op->value)->isAllZeros()) {
+      escaped.insert(op->var);
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const CallStmt *op) {
+    escaped.insert(op->results.begin(), op->results.end());
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Map *op) {
+    escaped.insert(op->vars.begin(), op->vars.end());
+    IRVisitor::visit(op);
+  }
+};
+
+/// Replaces the given tensors by one scalar local per component.
+class ScalarizeTensors : public IRRewriter {
+public:
+  ScalarizeTensors(const set<Var> &tensors) {
+    for (auto &tensor : tensors) {
+      const TensorType *type = tensor.getType().toTensor();
+      Type componentType = TensorType::make(type->getComponentType());
+      for (size_t i = 0; i < type->size(); ++i) {
+        components[tensor].push_back(Var(tensor.getName() + "_" +
+                                         to_string(i), componentType));
+      }
+    }
+  }
+
+private:
+  map<Var,vector<Var>> components;
+
+  using IRRewriter::visit;
+
+  const Var *getComponent(Expr buffer, Expr index) {
+    if (!isa<VarExpr>(buffer) ||
+        !util::contains(components, to<VarExpr>(buffer)->var)) {
+      return nullptr;
+    }
+    return &components.at(to<VarExpr>(buffer)->var)[getIntValue(index)];
+  }
+
+  void visit(const VarDecl *op) {
+    if (!util::contains(components, op->var)) {
+      stmt = op;
+      return;
+    }
+    vector<Stmt> varDecls;
+    for (auto &component : components.at(op->var)) {
+      varDecls.push_back(VarDecl::make(component));
+    }
+    stmt = Block::make(varDecls);
+  }
+
+  void visit(const AssignStmt *op) {
+    if (!util::contains(components, op->var)) {
+      IRRewriter::visit(op);
+      return;
+    }
+    vector<Stmt> zeros;
+    for (auto &component : components.at(op->var)) {
+      zeros.push_back(AssignStmt::make(component,
+                                       Literal::make(component.getType())));
+    }
+    stmt = Block::make(zeros);
+  }
+
+  void visit(const Load *op) {
+    const Var *component = getComponent(op->buffer, op->index);
+    if (component == nullptr) {
+      IRRewriter::visit(op);
+      return;
+    }
+    expr = VarExpr::make(*component);
+  }
+
+  void visit(const Store *op) {
+    const Var *component = getComponent(op->buffer, op->index);
+    if (component == nullptr) {
+      IRRewriter::visit(op);
+      return;
+    }
+    stmt = AssignStmt::make(*component, rewrite(op->value), op->cop);
+  }
+};
+
+Func scalarize(Func func, size_t maxSize) {
+  if (maxSize == 0) {
+    return func;
+  }
+  Stmt body = FoldIndices().rewrite(func.getBody());
+  body = UnrollLoops(maxSize).rewrite(body);
+  set<Var> tensors = FindScalarizableTensors(maxSize).find(body);
+  if (!tensors.empty()) {
+    body = ScalarizeTensors(tensors).rewrite(body);
+  }
+  return (body == func.getBody()) ? func : Func(func, body);
+}
+
+}}
@@ -0,0 +1,19 @@
+#ifndef SIMIT_SCALARIZE_H
+#define SIMIT_SCALARIZE_H
+
+#include "ir.h"
+
+namespace simit {
+namespace ir {
+
+/// Fully unroll the loop nests with constant bounds and at most `maxSize`
+/// iterations that index dense tensors of at most `maxSize` components, and
+/// keep the local dense tensors of at most `maxSize` components whose
+/// components are then only accessed at constant indices in scalars. The
+/// products of 3x3 matrices in element functions, e.g. `F = Ds*e.B`, then
+/// become straight-line code on scalars that the backend keeps in registers.
+/// Must run after tensor reads and writes are lowered to loads and stores.
+Func scalarize(Func func, size_t maxSize);
+
+}}
+#endif
@@ -0,0 +1,323 @@
+#include "memory_accounting.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+#include "graph.h"
+#include "ir.h"
+#include "ir_visitor.h"
+#include "storage.h"
+#include "tensor_index.h"
+#include "path_expressions.h"
+#include "util/util.h"
+
+using namespace std;
+
+namespace simit {
+
+std::ostream& operator<<(std::ostream& os, const MemoryKind& kind) {
+  switch (kind) {
+    case MemoryKind::Temporary:
+      return os << "temporary";
+    case MemoryKind::Buffer:
+      return os << "buffer";
+    case MemoryKind::TensorIndex:
+      return os << "tensor index";
+    case MemoryKind::PathIndex:
+      return os << "path index";
+    case MemoryKind::SetField:
+      return os << "set field";
+  }
+  return os;
+}
+
+// class MemoryAccounting
+MemoryAccounting::MemoryAccounting() : bytes(0), peakBytes(0) {
+}
+
+MemoryRecord& MemoryAccounting::getOrCreate(MemoryKind kind,
+                                            const std::string& name) {
+  auto key = make_pair(kind, name);
+  auto it = records.find(key);
+  if (it == records.end()) {
+    MemoryRecord record;
+    record.kind = kind;
+    record.name = name;
+    record.bytes = 0;
+    record.peakBytes = 0;
+    record.allocations = 0;
+    it = records.insert({key, record}).first;
+  }
+  return it->second;
+}
+
+void MemoryAccounting::release(MemoryRecord& record) {
+  if (record.owner.empty()) {
+    bytes -= record.bytes;
+  }
+  record.bytes = 0;
+}
+
+void MemoryAccounting::allocate(MemoryKind kind, const std::string& name,
+                                size_t bytes) {
+  lock_guard<std::mutex> lock(mutex);
+  MemoryRecord& record = getOrCreate(kind, name);
+  if (!record.owner.empty()) {
+    release(record);
+    record.owner.clear();
+  }
+  record.bytes += bytes;
+  record.peakBytes = max(record.peakBytes, record.bytes);
+  record.allocations++;
+  this->bytes += bytes;
+  peakBytes = max(peakBytes, this->bytes);
+}
+
+void MemoryAccounting::free(MemoryKind kind, const std::string& name) {
+  lock_guard<std::mutex> lock(mutex);
+  auto it = records.find(make_pair(kind, name));
+  if (it != records.end()) {
+    release(it->second);
+  }
+}
+
+void MemoryAccounting::alias(MemoryKind kind, const std::string& name,
+                             size_t bytes, const std::string& owner) {
+  lock_guard<std::mutex> lock(mutex);
+  MemoryRecord& record = getOrCreate(kind, name);
+  release(record);
+  record.owner = owner;
+  record.bytes = bytes;
+  record.peakBytes = max(record.peakBytes, bytes);
+  record.allocations++;
+}
+
+void MemoryAccounting::recordSet(const std::string& name, const Set& set) {
+  vector<pair<string,size_t>> objects;
+  for (const Set::FieldData* field : set.getFields()) {
+    objects.push_back({name + "." + field->name,
+                       set.getCapacity() * field->sizeOfType});
+  }
+  if (set.getCardinality() > 0) {
+    objects.push_back({name + ".endpoints",
+                       set.getCapacity() * set.getCardinality() *
+                       sizeof(int)});
+  }
+
+  // Sets are rebound on every init, so only record fields that were
+  // reallocated since
+  for (auto& object : objects) {
+    const MemoryRecord* record = getRecord(MemoryKind::SetField, object.first);
+    if (record != nullptr && record->bytes == object.second) {
+      continue;
+    }
+    free(MemoryKind::SetField, object.first);
+    allocate(MemoryKind::SetField, object.first, object.second);
+  }
+}
+
+size_t MemoryAccounting::getBytes() const {
+  lock_guard<std::mutex> lock(mutex);
+  return bytes;
+}
+
+size_t MemoryAccounting::getPeakBytes() const {
+  lock_guard<std::mutex> lock(mutex);
+  return peakBytes;
+}
+
+size_t MemoryAccounting::getBytes(MemoryKind kind) const {
+  lock_guard<std::mutex> lock(mutex);
+  size_t result = 0;
+  for (auto& record : records) {
+    if (record.first.first == kind && record.second.owner.empty()) {
+      result += record.second.bytes;
+    }
+  }
+  return result;
+}
+
+const MemoryRecord* MemoryAccounting::getRecord(MemoryKind kind,
+                                                const std::string& name) const{
+  lock_guard<std::mutex> lock(mutex);
+  auto it = records.find(make_pair(kind, name));
+  return (it != records.end()) ? &it->second : nullptr;
+}
+
+std::vector<MemoryRecord> MemoryAccounting::getRecords() const {
+  lock_guard<std::mutex> lock(mutex);
+  vector<MemoryRecord> result;
+  for (auto& record : records) {
+    result.push_back(record.second);
+  }
+  return result;
+}
+
+void MemoryAccounting::clear() {
+  lock_guard<std::mutex> lock(mutex);
+  records.clear();
+  bytes = 0;
+  peakBytes = 0;
+}
+
+static string formatBytes(size_t bytes) {
+  const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+  double value = bytes;
+  int unit = 0;
+  while (value >= 1024.0 && unit < 4) {
+    value /= 1024.0;
+    ++unit;
+  }
+  char str[32];
+  snprintf(str, sizeof(str), (unit == 0) ? "%.0f %s" : "%.1f %s",
+           value, units[unit]);
+  return str;
+}
+
+void MemoryAccounting::print(std::ostream& os) const {
+  vector<MemoryRecord> records = getRecords();
+  size_t nameWidth = 4;
+  for (const MemoryRecord& record : records) {
+    nameWidth = max(nameWidth, record.name.size());
+  }
+
+  os << left << setw(14) << "kind" << setw(nameWidth + 2) << "name"
+     << right << setw(12) << "bytes" << setw(12) << "peak" << endl;
+  for (const MemoryRecord& record : records) {
+    os << left << setw(14) << util::toString(record.kind)
+       << setw(nameWidth + 2) << record.name << right
+       << setw(12) << formatBytes(record.bytes)
+       << setw(12) << formatBytes(record.peakBytes);
+    if (!record.owner.empty()) {
+      os << "  (in " << record.owner << ")";
+    }
+    os << endl;
+  }
+  os << left << setw(14 + nameWidth + 2) << "total" << right
+     << setw(12) << formatBytes(getBytes())
+     << setw(12) << formatBytes(getPeakBytes()) << endl;
+}
+
+// printMemoryPlan
+namespace {
+
+string sizeFormula(const ir::IndexSet& indexSet) {
+  switch (indexSet.getKind()) {
+    case ir::IndexSet::Range:
+      return to_string(indexSet.getSize());
+    case ir::IndexSet::Set:
+      return "|" + util::toString(indexSet.getSet()) + "|";
+    case ir::IndexSet::Single:
+    case ir::IndexSet::Dynamic:
+      return "?";
+  }
+  return "?";
+}
+
+/// Bytes of one block of the tensor.
+size_t blockBytes(const ir::TensorType* type) {
+  return type->getBlockType().toTensor()->size() *
+         type->getComponentType().bytes();
+}
+
+string tensorFormula(const ir::Var& var, const ir::Storage& storage) {
+  const ir::TensorType* type = var.getType().toTensor();
+  const string block = to_string(blockBytes(type));
+  vector<ir::IndexSet> dimensions = type->getOuterDimensions();
+
+  if (storage.hasStorage(var)) {
+    const ir::TensorStorage& tensorStorage = storage.getStorage(var);
+    if (tensorStorage.getKind() == ir::TensorStorage::Indexed) {
+      const ir::TensorIndex& index = tensorStorage.getTensorIndex();
+      if (!index.getPathExpression().defined()) {
+        return "allocated while running";
+      }
+      return block + " * nnz(" +
+             util::toString(index.getPathExpression()) + ")";
+    }
+    else if (tensorStorage.getKind() == ir::TensorStorage::Stencil) {
+      const ir::TensorIndex& index = tensorStorage.getTensorIndex();
+      size_t points = index.getStencilLayout().getLayout().size();
+      return to_string(points * blockBytes(type)) + " * " +
+             sizeFormula(dimensions[0]);
+    }
+  }
+  // Fold the static dimensions into the block size
+  size_t bytes = blockBytes(type);
+  vector<string> factors;
+  for (const ir::IndexSet& dimension : dimensions) {
+    if (dimension.getKind() == ir::IndexSet::Range) {
+      bytes *= dimension.getSize();
+    }
+    else {
+      factors.push_back(sizeFormula(dimension));
+    }
+  }
+  factors.insert(factors.begin(), to_string(bytes));
+  return util::join(factors, " * ");
+}
+
+/// Collects the non-scalar local tensors the generated init code allocates.
+class FindBuffers : public ir::IRVisitor {
+public:
+  vector<ir::Var> buffers;
+
+private:
+  using ir::IRVisitor::visit;
+
+  void visit(const ir::VarDecl* op) {
+    ir::Type type = op->var.getType();
+    if (type.isTensor() && !ir::isScalar(type)) {
+      buffers.push_back(op->var);
+    }
+  }
+};
+
+}
+
+void printMemoryPlan(std::ostream& os, const ir::Func& func) {
+  const ir::Environment& environment = func.getEnvironment();
+  const ir::Storage& storage = func.getStorage();
+
+  vector<pair<MemoryKind,ir::Var>> tensors;
+  for (const ir::Var& tmp : environment.getTemporaries()) {
+    if (tmp.getType().isTensor()) {
+      tensors.push_back({MemoryKind::Temporary, tmp});
+    }
+  }
+  FindBuffers findBuffers;
+  func.getBody().accept(&findBuffers);
+  for (const ir::Var& buffer : findBuffers.buffers) {
+    tensors.push_back({MemoryKind::Buffer, buffer});
+  }
+
+  size_t nameWidth = 4;
+  for (auto& tensor : tensors) {
+    nameWidth = max(nameWidth, tensor.second.getName().size());
+  }
+  for (const ir::TensorIndex& index : environment.getTensorIndices()) {
+    nameWidth = max(nameWidth, index.getName().size());
+  }
+
+  os << "Memory of " << func.getName() << " (bytes):" << endl;
+  for (auto& tensor : tensors) {
+    os << "  " << left << setw(14) << util::toString(tensor.first)
+       << setw(nameWidth + 2) << tensor.second.getName()
+       << tensorFormula(tensor.second, storage) << endl;
+  }
+  for (const ir::TensorIndex& index : environment.getTensorIndices()) {
+    if (index.getKind() != ir::TensorIndex::PExpr) {
+      continue;
+    }
+    const pe::PathExpression& pexpr = index.getPathExpression();
+    // Row pointers and column indices are views of the path index
+    os << "  " << left << setw(14) << util::toString(MemoryKind::TensorIndex)
+       << setw(nameWidth + 2) << index.getName()
+       << "4 * (|" << pexpr.getPathEndpoint(0).getSet().getName()
+       << "| + 1) + 4 * nnz(" << pexpr << ")" << endl;
+  }
+  os << left;
+}
+
+}
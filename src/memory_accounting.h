@@ -0,0 +1,113 @@
+#ifndef SIMIT_MEMORY_ACCOUNTING_H
+#define SIMIT_MEMORY_ACCOUNTING_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "interfaces/printable.h"
+
+namespace simit {
+class Set;
+
+namespace ir {
+class Func;
+}
+
+/// The kinds of memory a compiled function uses.
+enum class MemoryKind {
+  /// Temporaries allocated by Function::init, such as assembled matrices
+  Temporary,
+  /// Local tensors allocated by the function's generated init code
+  Buffer,
+  /// Row pointer and column index arrays of sparse tensors
+  TensorIndex,
+  /// Path indices built from the bound sets
+  PathIndex,
+  /// Fields and endpoints of the bound sets
+  SetField
+};
+std::ostream& operator<<(std::ostream&, const MemoryKind&);
+
+/// The memory accounted to one object.
+struct MemoryRecord {
+  MemoryKind kind;
+  std::string name;
+
+  /// Bytes currently allocated, and the most ever allocated at once
+  size_t bytes;
+  size_t peakBytes;
+
+  /// Times the object was allocated
+  unsigned allocations;
+
+  /// The name of the record that owns the memory, if the object is a view of
+  /// memory accounted elsewhere (e.g. a tensor index that points into a path
+  /// index). Views do not count towards the totals.
+  std::string owner;
+};
+
+/// Tracks the bytes a compiled function allocates, per temporary, buffer,
+/// tensor index, path index and set field, with current and peak values.
+/// Function::init records temporaries, indices and the bound sets, and the
+/// generated init and deinit code records buffers through the runtime, so
+/// the accounting is safe to update from any thread.
+class MemoryAccounting : public interfaces::Printable {
+public:
+  MemoryAccounting();
+
+  /// Record that `bytes` more were allocated for the named object.
+  void allocate(MemoryKind kind, const std::string& name, size_t bytes);
+
+  /// Record that all the memory of the named object was freed.
+  void free(MemoryKind kind, const std::string& name);
+
+  /// Record that the named object is a view of `bytes` owned by `owner`.
+  void alias(MemoryKind kind, const std::string& name, size_t bytes,
+             const std::string& owner);
+
+  /// Record the fields and endpoints of a set bound as `name`, replacing any
+  /// previous record of them.
+  void recordSet(const std::string& name, const Set& set);
+
+  /// Bytes currently allocated, and the most ever allocated at once, by all
+  /// objects or by the objects of one kind.
+  size_t getBytes() const;
+  size_t getPeakBytes() const;
+  size_t getBytes(MemoryKind kind) const;
+
+  /// The record of the named object, or nullptr if it has none.
+  const MemoryRecord* getRecord(MemoryKind kind,
+                                const std::string& name) const;
+
+  /// All records, ordered by kind and name.
+  std::vector<MemoryRecord> getRecords() const;
+
+  /// Forget all records and reset the totals.
+  void clear();
+
+  /// Print a table of the records with their current and peak bytes.
+  void print(std::ostream& os) const;
+
+private:
+  mutable std::mutex mutex;
+  std::map<std::pair<MemoryKind,std::string>, MemoryRecord> records;
+  size_t bytes;
+  size_t peakBytes;
+
+  MemoryRecord& getOrCreate(MemoryKind kind, const std::string& name);
+  void release(MemoryRecord& record);
+};
+
+/// Print the memory a lowered function allocates when it is initialized: a
+/// line per temporary, buffer and tensor index with its size as a formula of
+/// the sizes of the sets (|set|) and the number of neighbors in the path
+/// indices (nnz(...)) it depends on.
+void printMemoryPlan(std::ostream& os, const ir::Func& func);
+
+}
+#endif
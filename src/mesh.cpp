@@ -3,8 +3,14 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <numeric>
 #include "mesh.h"
 
+#include "util/mapped_file.h"
+#include "util/number_parsing.h"
+#include "util/parallel.h"
+#include "util/text_records.h"
+
 using namespace simit;
 using namespace std;
 
@@ -605,3 +611,375 @@ void MeshVol::makeTetSurf()
   }
 }
 
+// Parallel loaders
+
+static int openMapped(util::MappedFile & file, const string & filename)
+{
+  if(file.open(filename)<0){
+    std::cerr << "Cannot read " << filename << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+//Call parseRecord(record, line, lineEnd) for every data line in the text.
+//Returns false if there are fewer than numRecords data lines or if any record
+//failed to parse.
+template <typename ParseRecord>
+static bool parseRecords(const char * begin, const char * end,
+                         unsigned numThreads, size_t numRecords,
+                         ParseRecord parseRecord)
+{
+  return util::parseRecords(begin, end, numThreads, "#",
+      [&](size_t count, unsigned){ return count>=numRecords; },
+      [&](unsigned, size_t record, const char * line, const char * lineEnd){
+    return parseRecord(record, line, lineEnd);
+  });
+}
+
+//parse the integers on the first data line, returning the start of the
+//line after it, or nullptr if there is no such line.
+static const char * parseHeader(const char * begin, const char * end,
+                                vector<int> & header)
+{
+  for(const char * line = begin; line<end;){
+    const char * lineEnd = util::nextLine(line, end);
+    if(util::isDataLine(line, lineEnd)){
+      int val;
+      const char * p = line;
+      while((p = util::nextInt(p, lineEnd, val)) != nullptr){
+        header.push_back(val);
+      }
+      return lineEnd;
+    }
+    line = lineEnd;
+  }
+  return nullptr;
+}
+
+int Mesh::loadParallel(std::string filename, unsigned numThreads)
+{
+  util::MappedFile file;
+  int status = openMapped(file, filename);
+  if(status<0){
+    return status;
+  }
+  return parse(file.begin(), file.end(), numThreads);
+}
+
+//is the line an obj record of the given single character type
+static bool isObjRecord(const char * line, const char * lineEnd, char type)
+{
+  line = util::skipBlanks(line, lineEnd);
+  return line+1<lineEnd && line[0]==type && util::isBlank(line[1]);
+}
+
+static bool isObjEnd(const char * line, const char * lineEnd)
+{
+  if(lineEnd-line<4 || strncmp(line, "#end", 4)!=0){
+    return false;
+  }
+  line = util::skipBlanks(line+4, lineEnd);
+  return line==lineEnd || *line=='\n';
+}
+
+//parse the vertex indices of an element, which must be less than nv
+static const char * parseIndices(const char * p, const char * lineEnd,
+                                 size_t nv, vector<int> & indices)
+{
+  for(size_t ii = 0; ii<indices.size() && p!=nullptr; ii++){
+    p = util::nextInt(p, lineEnd, indices[ii]);
+    if(p!=nullptr && (indices[ii]<0 || (size_t)indices[ii]>=nv)){
+      return nullptr;
+    }
+  }
+  return p;
+}
+
+//number of vertex references on a face line
+static size_t countFaceVerts(const char * line, const char * lineEnd)
+{
+  size_t cnt = 0;
+  const char * p = util::skipBlanks(line, lineEnd) + 1;
+  while(true){
+    p = util::skipBlanks(p, lineEnd);
+    if(p==lineEnd || *p=='\n'){
+      break;
+    }
+    cnt++;
+    while(p<lineEnd && !util::isBlank(*p) && *p!='\n'){
+      p++;
+    }
+  }
+  return cnt;
+}
+
+int Mesh::parse(const char * begin, const char * end, unsigned numThreads)
+{
+  vector<const char*> bounds = util::chunkLines(begin, end, numThreads);
+  unsigned numChunks = bounds.size()-1;
+
+  //count vertices and triangles per chunk, and find the #end marker
+  vector<size_t> vOffsets(numChunks+1, 0);
+  vector<size_t> tOffsets(numChunks+1, 0);
+  vector<const char*> chunkEnds(bounds.begin()+1, bounds.end());
+  util::parallelChunks(numChunks, [&](unsigned chunk){
+    const char * chunkEnd = bounds[chunk+1];
+    for(const char * line = bounds[chunk]; line<chunkEnd;){
+      const char * lineEnd = util::nextLine(line, chunkEnd);
+      if(isObjEnd(line, lineEnd)){
+        chunkEnds[chunk] = line;
+        break;
+      }
+      if(isObjRecord(line, lineEnd, 'v')){
+        vOffsets[chunk+1]++;
+      }else if(isObjRecord(line, lineEnd, 'f')){
+        size_t nv = countFaceVerts(line, lineEnd);
+        tOffsets[chunk+1] += (nv>2) ? nv-2 : 0;
+      }
+      line = lineEnd;
+    }
+  });
+  //ignore everything after #end
+  for(unsigned chunk = 0; chunk<numChunks; chunk++){
+    if(chunkEnds[chunk]!=bounds[chunk+1]){
+      numChunks = chunk+1;
+      break;
+    }
+  }
+  partial_sum(vOffsets.begin(), vOffsets.end(), vOffsets.begin());
+  partial_sum(tOffsets.begin(), tOffsets.end(), tOffsets.begin());
+  v.resize(vOffsets[numChunks]);
+  t.resize(tOffsets[numChunks]);
+
+  size_t nv = v.size();
+  vector<char> ok(numChunks, 1);
+  vector<char> facesOk(numChunks, 1);
+  util::parallelChunks(numChunks, [&](unsigned chunk){
+    const char * chunkEnd = chunkEnds[chunk];
+    size_t vi = vOffsets[chunk];
+    size_t ti = tOffsets[chunk];
+    vector<int> vidx;
+    for(const char * line = bounds[chunk]; line<chunkEnd;){
+      const char * lineEnd = util::nextLine(line, chunkEnd);
+      if(isObjRecord(line, lineEnd, 'v')){
+        const char * p = util::skipBlanks(line, lineEnd) + 1;
+        for(int ii = 0; ii<3; ii++){
+          p = util::nextDouble(p, lineEnd, v[vi][ii]);
+        }
+        if(p==nullptr){
+          ok[chunk] = 0;
+          return;
+        }
+        vi++;
+      }else if(isObjRecord(line, lineEnd, 'f')){
+        //read vertex indices, skipping texture and normal indices
+        vidx.clear();
+        const char * p = util::skipBlanks(line, lineEnd) + 1;
+        int x;
+        while((p = util::nextInt(p, lineEnd, x)) != nullptr){
+          if(x<1 || (size_t)x>nv){
+            facesOk[chunk] = 0;
+            return;
+          }
+          vidx.push_back(x);
+          while(p<lineEnd && !util::isBlank(*p) && *p!='\n'){
+            p++;
+          }
+        }
+        for(size_t ii = 0; ii+2<vidx.size(); ii++){
+          Vector3i & trig = t[ti++];
+          trig[0] = vidx[0]-1;
+          for (int jj = 1; jj < 3; jj++) {
+            trig[jj] = vidx[ii+jj]-1;
+          }
+        }
+      }
+      line = lineEnd;
+    }
+  });
+  if(find(ok.begin(), ok.end(), 0) != ok.end()){
+    std::cerr << "Malformed vertex in obj file" << std::endl;
+    return -1;
+  }
+  if(find(facesOk.begin(), facesOk.end(), 0) != facesOk.end()){
+    std::cerr << "Malformed face in obj file" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int MeshVol::loadParallel(std::string filename, unsigned numThreads)
+{
+  util::MappedFile file;
+  int status = openMapped(file, filename);
+  if(status<0){
+    return status;
+  }
+  return parse(file.begin(), file.end(), numThreads);
+}
+
+int MeshVol::parse(const char * begin, const char * end, unsigned numThreads)
+{
+  //header: "#vertices n" and "#elements m" on the first two lines
+  const char * p = begin;
+  int counts[2] = {0, 0};
+  for(int ii = 0; ii<2; ii++){
+    while(p<end && (util::isBlank(*p) || *p=='\n')){
+      p++;
+    }
+    while(p<end && !util::isBlank(*p) && *p!='\n'){
+      p++;
+    }
+    p = util::nextInt(p, end, counts[ii]);
+    if(p==nullptr || counts[ii]<0){
+      std::cerr << "Malformed volume mesh header" << std::endl;
+      return -1;
+    }
+  }
+  p = util::nextLine(p, end);
+
+  size_t nv = counts[0];
+  size_t ne = counts[1];
+  v.resize(nv);
+  e.resize(ne);
+  bool ok = parseRecords(p, end, numThreads, nv+ne,
+      [&](size_t record, const char * line, const char * lineEnd) {
+    if(record<nv){
+      const char * q = line;
+      for(int ii = 0; ii<3; ii++){
+        q = util::nextDouble(q, lineEnd, v[record][ii]);
+      }
+      return q!=nullptr;
+    }
+    record -= nv;
+    if(record<ne){
+      int num;
+      const char * q = util::nextInt(line, lineEnd, num);
+      if(q==nullptr || num<0){
+        return false;
+      }
+      e[record].resize(num);
+      return parseIndices(q, lineEnd, nv, e[record])!=nullptr;
+    }
+    return true;
+  });
+  if(!ok){
+    std::cerr << "Malformed volume mesh" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int MeshVol::loadTetParallel(std::string nodeFile, std::string eleFile,
+                             unsigned numThreads)
+{
+  util::MappedFile nodeIn, eleIn;
+  int status = openMapped(nodeIn, nodeFile);
+  if(status<0){
+    return status;
+  }
+  status = openMapped(eleIn, eleFile);
+  if(status<0){
+    return status;
+  }
+  return parseTet(nodeIn.begin(), nodeIn.end(), eleIn.begin(), eleIn.end(),
+                  numThreads);
+}
+
+int MeshVol::parseTet(const char * nodeBegin, const char * nodeEnd,
+                      const char * eleBegin, const char * eleEnd,
+                      unsigned numThreads)
+{
+  //load vertices
+  vector<int> header;
+  const char * body = parseHeader(nodeBegin, nodeEnd, header);
+  if(body==nullptr || header.size()<1 || header[0]<0){
+    std::cerr << "Malformed tetgen node header" << std::endl;
+    return -1;
+  }
+  size_t nv = header[0];
+  v.resize(nv);
+  bool ok = parseRecords(body, nodeEnd, numThreads, nv,
+      [&](size_t record, const char * line, const char * lineEnd) {
+    if(record>=nv){
+      return true;
+    }
+    int index;
+    const char * p = util::nextInt(line, lineEnd, index);
+    for(int ii = 0; ii<3; ii++){
+      p = util::nextDouble(p, lineEnd, v[record][ii]);
+    }
+    return p!=nullptr;
+  });
+  if(!ok){
+    std::cerr << "Malformed tetgen node file" << std::endl;
+    return -1;
+  }
+
+  //load elements
+  header.clear();
+  body = parseHeader(eleBegin, eleEnd, header);
+  if(body==nullptr || header.size()<2 || header[0]<0 || header[1]<0){
+    std::cerr << "Malformed tetgen ele header" << std::endl;
+    return -1;
+  }
+  size_t ne = header[0];
+  int nV = header[1];
+  e.resize(ne);
+  ok = parseRecords(body, eleEnd, numThreads, ne,
+      [&](size_t record, const char * line, const char * lineEnd) {
+    if(record>=ne){
+      return true;
+    }
+    int index;
+    const char * p = util::nextInt(line, lineEnd, index);
+    e[record].resize(nV);
+    return parseIndices(p, lineEnd, nv, e[record])!=nullptr;
+  });
+  if(!ok){
+    std::cerr << "Malformed tetgen ele file" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int MeshVol::loadTetEdgeParallel(std::string edgeFile, unsigned numThreads)
+{
+  util::MappedFile edgeIn;
+  int status = openMapped(edgeIn, edgeFile);
+  if(status<0){
+    return status;
+  }
+  return parseTetEdge(edgeIn.begin(), edgeIn.end(), numThreads);
+}
+
+int MeshVol::parseTetEdge(const char * begin, const char * end,
+                          unsigned numThreads)
+{
+  vector<int> header;
+  const char * body = parseHeader(begin, end, header);
+  if(body==nullptr || header.size()<1 || header[0]<0){
+    std::cerr << "Malformed tetgen edge header" << std::endl;
+    return -1;
+  }
+  size_t ne = header[0];
+  edges.resize(ne);
+  bool ok = parseRecords(body, end, numThreads, ne,
+      [&](size_t record, const char * line, const char * lineEnd) {
+    if(record>=ne){
+      return true;
+    }
+    int index;
+    const char * p = util::nextInt(line, lineEnd, index);
+    for(int ii = 0; ii<2; ii++){
+      p = util::nextInt(p, lineEnd, edges[record][ii]);
+    }
+    return p!=nullptr;
+  });
+  if(!ok){
+    std::cerr << "Malformed tetgen edge file" << std::endl;
+    return -1;
+  }
+  return 0;
+}
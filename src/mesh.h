@@ -29,6 +29,15 @@ struct Mesh{
   ///return -1 if failed to save
   int save(const char * filename);
   int save(std::ostream & out);
+
+  ///Load with the parallel parser. The file is memory-mapped, split into
+  ///line-aligned chunks and parsed by numThreads threads (0 uses all
+  ///hardware threads). Replaces the current vertices and triangles.
+  ///return -1 if failed to load
+  int loadParallel(std::string filename, unsigned numThreads=0);
+  ///parse an obj file already in memory with the parallel parser.
+  ///return -1 if failed to parse
+  int parse(const char * begin, const char * end, unsigned numThreads=0);
 };
 
 ///a struct used to load custom volumetric mesh file.
@@ -63,6 +72,24 @@ struct MeshVol{
   int loadTetEdge(std::string edgeFile);
   int loadTetEdge(std::istream & edgeIn);
 
+  ///Parallel versions of the loaders above. Files are memory-mapped, split
+  ///into line-aligned chunks and parsed by numThreads threads (0 uses all
+  ///hardware threads) straight into the preallocated v, e and edges vectors.
+  ///return -1 if failed to load
+  int loadParallel(std::string filename, unsigned numThreads=0);
+  int loadTetParallel(std::string nodeFile, std::string eleFile,
+                      unsigned numThreads=0);
+  int loadTetEdgeParallel(std::string edgeFile, unsigned numThreads=0);
+
+  ///Parse files already in memory with the parallel parser.
+  ///return -1 if failed to parse
+  int parse(const char * begin, const char * end, unsigned numThreads=0);
+  int parseTet(const char * nodeBegin, const char * nodeEnd,
+               const char * eleBegin, const char * eleEnd,
+               unsigned numThreads=0);
+  int parseTetEdge(const char * begin, const char * end,
+                   unsigned numThreads=0);
+
   ///return -1 if failed to save
   int save(const char * filename);
   int save(std::string filename);
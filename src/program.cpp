@@ -32,8 +32,17 @@ Function compile(ir::Func func, backend::Backend *backend, bool addTimers) {
   // Fill in storage path expressions, etc.
   /// map<Var,pe::PathExpressions> pes = assignPathExpressions(func);
   /// storage.addPathExpressions(pes);
-  func = lower(func, nullptr, addTimers);
-  return Function(backend->compile(func, storage));
+  std::shared_ptr<ir::Timers> timers;
+  if (addTimers) {
+    timers = std::make_shared<ir::Timers>();
+    timers->setName(func.getName());
+  }
+  func = lower(func, nullptr, timers.get());
+  backend::Function* function = backend->compile(func, storage);
+  if (timers) {
+    function->setTimers(timers);
+  }
+  return Function(function);
 }
 
 static Function compile(ir::Func func, backend::Backend *backend) {
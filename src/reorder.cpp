@@ -1,6 +1,7 @@
 #include "reorder.h"
 #include "graph.h"
 #include "hilbert.h"
+#include "util/parallel.h"
 
 #include <vector>
 #include <cstdio>
@@ -8,110 +9,510 @@
 #include <cmath>
 #include <climits>
 #include <cfloat>
+#include <chrono>
 #include <string>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
 
 using namespace std;
 namespace simit {
 
-  // ---------- Hilbert Reordering Heuristic ----------
-  namespace hilbert {
-    // This function populates the hilbertId field of each vertex_t in nodes, by
-    // remapping every vertex onto an n^3 lattice using appropriate scaling 
-    // factors,
-    // and then traversing the lattice using a 3-D Hilbert curve.
-    //
-    // hilbertBits = number of bits in Hilbert grid (grid with side 
-    // 2^hilbertBits)
-    void assignHilbertIds(vertex_t * const nodes, const int cntNodes,
-                          const unsigned hilbertBits) {
-      // We first traverse all vertices to find the maximal and minimal 
-      // coordinates
-      // along each axis: xMin, xMax, yMin, yMax, zMin, zMax.
-
-      double xMin, xMax, yMin, yMax, zMin, zMax;
-      uint64_t hilbertGridN = 1 << hilbertBits; xMin = yMin = zMin = DBL_MAX;
-      xMax = yMax = zMax = DBL_MIN;
-      for (int i = 0; i < cntNodes; ++i) {
-        xMin = fmin(xMin, nodes[i].x);
-        yMin = fmin(yMin, nodes[i].y);
-        zMin = fmin(zMin, nodes[i].z);
-        xMax = fmax(xMax, nodes[i].x);
-        yMax = fmax(yMax, nodes[i].y);
-        zMax = fmax(zMax, nodes[i].z);
-      }
-
-      // We now create a mapping that maps:
-      //   (xMin, yMin, zMin) to lattice point (0, 0, 0)
-      //   (xMax, yMax, zMax) to lattice point (n-1, n-1, n-1)
-      // where n = hilbertGridN
-      //
-      // This mapping is the following: for the T axis,
-      // tLattice = round((t - tMin) * (hilbertGridN - 1) / tMax);
-
-      for (int i = 0; i < cntNodes; ++i) {
-        bitmask_t latticeCoords[3];
-        bitmask_t hilbertIndex;
+  // ---------- Space-Filling Curve Reordering Heuristics ----------
+  // The curve orderings map every vertex onto a 2^bits lattice along each
+  // axis, compute its index along the curve in parallel, and sort the
+  // (index, vertex) pairs with a parallel LSD radix sort. The radix sort is
+  // stable, so vertices with the same index keep their relative order.
 
-        nodes[i].id = (vid_t)i;
+  struct Bounds {
+    Bounds() : min{DBL_MAX, DBL_MAX, DBL_MAX}, max{-DBL_MAX, -DBL_MAX, -DBL_MAX}
+    {}
+    double min[3];
+    double max[3];
+  };
 
-        latticeCoords[0] = (uint64_t) round((nodes[i].x - xMin) * (hilbertGridN 
-              - 1) / xMax);
-        latticeCoords[1] = (uint64_t) round((nodes[i].y - yMin) * (hilbertGridN 
-              - 1) / yMax);
-        latticeCoords[2] = (uint64_t) round((nodes[i].z - zMin) * (hilbertGridN 
-              - 1) / zMax);
+  static Bounds computeBounds(const double* coords, size_t numVertices,
+      unsigned numThreads) {
+    const unsigned numChunks = util::numThreads(numThreads);
+    vector<Bounds> chunkBounds(numChunks);
+    util::parallelChunks(numChunks, [&](unsigned chunk) {
+      Bounds& bounds = chunkBounds[chunk];
+      const size_t begin = numVertices * chunk / numChunks;
+      const size_t end = numVertices * (chunk+1) / numChunks;
+      for (size_t i=begin; i < end; ++i) {
+        for (int d=0; d < 3; ++d) {
+          bounds.min[d] = fmin(bounds.min[d], coords[i*3+d]);
+          bounds.max[d] = fmax(bounds.max[d], coords[i*3+d]);
+        }
+      }
+    });
+    Bounds bounds;
+    for (const Bounds& chunk : chunkBounds) {
+      for (int d=0; d < 3; ++d) {
+        bounds.min[d] = fmin(bounds.min[d], chunk.min[d]);
+        bounds.max[d] = fmax(bounds.max[d], chunk.max[d]);
+      }
+    }
+    return bounds;
+  }
 
-        hilbertIndex = hilbert_c2i(3, hilbertBits, latticeCoords);
-        nodes[i].hilbertId = (vid_t) hilbertIndex;
+  // Spread the low 21 bits of x so that there are two zero bits between
+  // consecutive bits.
+  static inline uint64_t spreadBits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+  }
 
-      }
+  // Computes the curve key of every vertex with `key(latticeCoords)`. The
+  // lattice mapping is:
+  //   (xMin, yMin, zMin) to lattice point (0, 0, 0)
+  //   (xMax, yMax, zMax) to lattice point (n-1, n-1, n-1)
+  // where n = 2^bits, and for the T axis
+  //   tLattice = round((t - tMin) * (n - 1) / (tMax - tMin))
+  // with axes without extent mapping to 0.
+  template <typename KeyFunction>
+  static void computeCurveKeys(const double* coords, size_t numVertices,
+      unsigned bits, unsigned numThreads, vector<uint64_t>& keys,
+      KeyFunction key) {
+    uassert(bits >= 1 && bits <= 21)
+        << "Space-filling curve grids must have between 1 and 21 bits per axis";
+    const Bounds bounds = computeBounds(coords, numVertices, numThreads);
+    const uint64_t gridN = uint64_t(1) << bits;
+    double scale[3];
+    for (int d=0; d < 3; ++d) {
+      scale[d] = (bounds.max[d] > bounds.min[d])
+                 ? (gridN-1) / (bounds.max[d] - bounds.min[d]) : 0;
     }
 
-    bool vertexComparator(const vertex_t& a, const vertex_t& b) {
-      if (a.hilbertId != b.hilbertId) {
-        return a.hilbertId < b.hilbertId;
-      } else {
-        return a.id < b.id;
+    keys.resize(numVertices);
+    util::parallelFor(0, numVertices, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        bitmask_t latticeCoords[3];
+        for (int d=0; d < 3; ++d) {
+          latticeCoords[d] =
+              (uint64_t) round((coords[i*3+d] - bounds.min[d]) * scale[d]);
+        }
+        keys[i] = key(latticeCoords);
+      }
+    }, numThreads);
+  }
+
+  // Sorts the ids 0..n-1 by key with a stable LSD radix sort on (key, id)
+  // pairs, so that ids[i] is the id with the i-th smallest key. Each pass
+  // sorts one byte: every thread counts the digits of its contiguous chunk,
+  // and then scatters the chunk to the digit offsets of the chunk, which keeps
+  // the sort stable.
+  static void radixSort(vector<uint64_t>& keys, unsigned keyBits,
+      unsigned numThreads, vector<int>& ids) {
+    const size_t n = keys.size();
+    const unsigned RadixBits = 8;
+    const unsigned Radix = 1 << RadixBits;
+    const size_t grain = 1 << 16;
+    unsigned numChunks = util::numThreads(numThreads);
+    numChunks = (unsigned)max<size_t>(1, min<size_t>(numChunks, n / grain));
+    auto chunkBegin = [&](unsigned chunk) { return n * chunk / numChunks; };
+
+    ids.resize(n);
+    util::parallelFor(0, n, [&](size_t begin, size_t end) {
+      iota(ids.begin() + begin, ids.begin() + end, (int)begin);
+    }, numThreads);
+    vector<uint64_t> keysOut(n);
+    vector<int> idsOut(n);
+    vector<size_t> offsets(numChunks * Radix);
+    for (unsigned shift=0; shift < keyBits; shift += RadixBits) {
+      fill(offsets.begin(), offsets.end(), 0);
+      util::parallelChunks(numChunks, [&](unsigned chunk) {
+        size_t* counts = offsets.data() + chunk * Radix;
+        for (size_t i=chunkBegin(chunk); i < chunkBegin(chunk+1); ++i) {
+          ++counts[(keys[i] >> shift) & (Radix-1)];
+        }
+      });
+
+      // Skip passes where all keys have the same digit
+      bool sorted = false;
+      for (unsigned digit=0; digit < Radix && !sorted; ++digit) {
+        size_t count = 0;
+        for (unsigned chunk=0; chunk < numChunks; ++chunk) {
+          count += offsets[chunk * Radix + digit];
+        }
+        sorted = (count == n);
+      }
+      if (sorted) {
+        continue;
+      }
+
+      size_t offset = 0;
+      for (unsigned digit=0; digit < Radix; ++digit) {
+        for (unsigned chunk=0; chunk < numChunks; ++chunk) {
+          size_t count = offsets[chunk * Radix + digit];
+          offsets[chunk * Radix + digit] = offset;
+          offset += count;
+        }
       }
+      util::parallelChunks(numChunks, [&](unsigned chunk) {
+        size_t* next = offsets.data() + chunk * Radix;
+        for (size_t i=chunkBegin(chunk); i < chunkBegin(chunk+1); ++i) {
+          size_t position = next[(keys[i] >> shift) & (Radix-1)]++;
+          keysOut[position] = keys[i];
+          idsOut[position] = ids[i];
+        }
+      });
+      keys.swap(keysOut);
+      ids.swap(idsOut);
     }
+  }
 
-    static void createIdTranslationMapping(vertex_t * reorderedNodes, 
-        vector<int>& vertexOrdering, int cntNodes) {
-      iassert(vertexOrdering.size() == 0);
-      vertexOrdering.resize(cntNodes);
+  // Sorts the vertices by key and returns the old to new vertex ordering.
+  static void radixSortOrdering(vector<uint64_t>& keys, unsigned keyBits,
+      unsigned numThreads, vector<int>& vertexOrdering) {
+    const size_t n = keys.size();
+    vector<int> ids;
+    radixSort(keys, keyBits, numThreads, ids);
+    vertexOrdering.resize(n);
+    util::parallelFor(0, n, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        vertexOrdering[ids[i]] = (int)i;
+      }
+    }, numThreads);
+  }
 
-      for (int i = 0; i < cntNodes; ++i) {
-        vertexOrdering[reorderedNodes[i].id] = i;
+  // Returns the vertex set's spatial field as xyz triples, converting float
+  // fields into `storage`.
+  static const double* spatialCoordinates(const Set& vertexSet,
+      vector<double>& storage) {
+    const Set::FieldData* spatialField = nullptr;
+    for (const Set::FieldData* field : vertexSet.getFields()) {
+      if (field->name == vertexSet.getSpatialFieldName()) {
+        spatialField = field;
       }
     }
+    uassert(spatialField != nullptr && spatialField->type->getSize() == 3)
+        << "Spatial reordering requires a spatial field with 3 components";
 
-    void loadNodes(Set& vertexSet, vertex_t ** outNodes, int numNodes) {
-      vertex_t * nodes = new (nothrow) vertex_t[numNodes];
-      
-      auto& fields = vertexSet.getFields();
-      int fieldIndex = vertexSet.getFieldIndex(vertexSet.getSpatialFieldName());
-      double * spatialData = static_cast<double*>(fields[fieldIndex]->data);  
-     
-      for (int i = 0; i < numNodes; ++i) {
-        nodes[i].id = i; nodes[i].x = spatialData[i*3+0];
-        nodes[i].y = spatialData[i*3+1];
-        nodes[i].z = spatialData[i*3+2];
+    switch (spatialField->type->getComponentType()) {
+      case ComponentType::Double:
+        return static_cast<const double*>(spatialField->data);
+      case ComponentType::Float: {
+        const float* data = static_cast<const float*>(spatialField->data);
+        storage.assign(data, data + vertexSet.getSize()*3);
+        return storage.data();
       }
-      
-      *outNodes = nodes;
+      default:
+        uerror << "Spatial reordering requires a float or double spatial "
+               << "field";
     }
+    return nullptr;
+  }
 
-    void hilbertReorder(Set& vertexSet, vector<int>& vertexOrdering) {
-      vertex_t * nodes;
-      const int hilbertBits = 8;  int cntNodes = vertexSet.getSize();
-      loadNodes(vertexSet, &nodes, cntNodes);
+  void mortonReordering(const double* coords, int numVertices,
+      vector<int>& vertexOrdering, unsigned bits, unsigned numThreads) {
+    vector<uint64_t> keys;
+    computeCurveKeys(coords, numVertices, bits, numThreads, keys,
+        [](const bitmask_t* latticeCoords) {
+          return spreadBits(latticeCoords[0]) |
+                 spreadBits(latticeCoords[1]) << 1 |
+                 spreadBits(latticeCoords[2]) << 2;
+        });
+    radixSortOrdering(keys, 3*bits, numThreads, vertexOrdering);
+  }
+
+  namespace hilbert {
+    void hilbertReorder(const double* coords, int numVertices, vector<int>& 
+        vertexOrdering, unsigned hilbertBits, unsigned numThreads) {
+      vector<uint64_t> keys;
+      computeCurveKeys(coords, numVertices, hilbertBits, numThreads, keys,
+          [hilbertBits](const bitmask_t* latticeCoords) {
+            return hilbert_c2i(3, hilbertBits, latticeCoords);
+          });
+      radixSortOrdering(keys, 3*hilbertBits, numThreads, vertexOrdering);
+    }
 
-      assignHilbertIds(nodes, cntNodes, hilbertBits);
-      stable_sort(nodes, nodes + cntNodes, vertexComparator);
-      createIdTranslationMapping(nodes, vertexOrdering, cntNodes);
+    void hilbertReorder(const Set& vertexSet, vector<int>& vertexOrdering,
+        unsigned hilbertBits, unsigned numThreads) {
+      vector<double> storage;
+      hilbertReorder(spatialCoordinates(vertexSet, storage),
+          vertexSet.getSize(), vertexOrdering, hilbertBits, numThreads);
     }
   } // namespace simit::hilbert
  
+  // ---------- Connectivity Reordering Heuristics ----------
+  // Vertex adjacency in compressed sparse row form, where the vertices of an
+  // edge are all adjacent to each other.
+  struct Adjacency {
+    Adjacency(const int* endpoints, int numEdges, int cardinality,
+        int numVertices) : offsets(numVertices+1, 0) {
+      for (int e=0; e < numEdges; ++e) {
+        const int* edge = endpoints + e*cardinality;
+        for (int i=0; i < cardinality; ++i) {
+          for (int j=0; j < cardinality; ++j) {
+            if (edge[i] != edge[j]) {
+              ++offsets[edge[i]+1];
+            }
+          }
+        }
+      }
+      partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+      neighbors.resize(offsets[numVertices]);
+      vector<int> next(offsets.begin(), offsets.end()-1);
+      for (int e=0; e < numEdges; ++e) {
+        const int* edge = endpoints + e*cardinality;
+        for (int i=0; i < cardinality; ++i) {
+          for (int j=0; j < cardinality; ++j) {
+            if (edge[i] != edge[j]) {
+              neighbors[next[edge[i]]++] = edge[j];
+            }
+          }
+        }
+      }
+
+      // Remove duplicate neighbors in place
+      int size = 0;
+      for (int v=0; v < numVertices; ++v) {
+        auto begin = neighbors.begin() + offsets[v];
+        auto end = neighbors.begin() + offsets[v+1];
+        sort(begin, end);
+        end = unique(begin, end);
+        offsets[v] = size;
+        size = copy(begin, end, neighbors.begin() + size) - neighbors.begin();
+      }
+      offsets[numVertices] = size;
+      neighbors.resize(size);
+    }
+
+    int numVertices() const { return offsets.size() - 1; }
+    int degree(int v) const { return offsets[v+1] - offsets[v]; }
+    const int* begin(int v) const { return neighbors.data() + offsets[v]; }
+    const int* end(int v) const { return neighbors.data() + offsets[v+1]; }
+
+    vector<int> offsets;
+    vector<int> neighbors;
+  };
+
+  // Breadth-first traversals restricted to the vertices of one part.
+  class PartTraversal {
+  public:
+    PartTraversal(const Adjacency& adjacency)
+        : adjacency(adjacency), vertices(adjacency.numVertices()),
+          stamp(0) {}
+
+    int part(int v) const { return vertices[v].part; }
+    void setPart(int v, int part) { vertices[v].part = part; }
+
+    // Appends the vertices reachable from `root` within its part to `order`
+    // in breadth-first order and returns the index in `order` where the last
+    // level starts. If `byDegree` is set the neighbors of every vertex are
+    // visited in order of increasing degree (Cuthill-McKee). The number of
+    // levels after the root is stored in `eccentricity` if it is not null.
+    size_t traverse(int root, vector<int>& order, bool byDegree,
+        int* eccentricity=nullptr) {
+      newStamp();
+      const int rootPart = vertices[root].part;
+      size_t levelBegin = order.size();
+      size_t lastLevel = levelBegin;
+      int numLevels = 0;
+      order.push_back(root);
+      vertices[root].mark = stamp;
+      while (levelBegin < order.size()) {
+        size_t levelEnd = order.size();
+        lastLevel = levelBegin;
+        for (size_t i=levelBegin; i < levelEnd; ++i) {
+          const int v = order[i];
+          size_t firstNeighbor = order.size();
+          for (const int* n=adjacency.begin(v); n != adjacency.end(v); ++n) {
+            VertexState& neighbor = vertices[*n];
+            if (neighbor.part == rootPart && neighbor.mark != stamp) {
+              neighbor.mark = stamp;
+              order.push_back(*n);
+            }
+          }
+          if (byDegree) {
+            stable_sort(order.begin()+firstNeighbor, order.end(),
+                [this](int a, int b) {
+                  return adjacency.degree(a) < adjacency.degree(b);
+                });
+          }
+        }
+        levelBegin = levelEnd;
+        ++numLevels;
+      }
+      if (eccentricity != nullptr) {
+        *eccentricity = numLevels - 1;
+      }
+      return lastLevel;
+    }
+
+    // Finds a pseudo-peripheral vertex of the component of `start` within
+    // its part with the George-Liu algorithm: move to a minimum degree vertex
+    // of the last BFS level for as long as that increases the eccentricity.
+    // The breadth-first order from the returned vertex is appended to `order`
+    // if it is not null.
+    int pseudoPeripheral(int start, vector<int>* order=nullptr) {
+      vector<int>* rootOrder = &scratch[0];
+      vector<int>* candidateOrder = &scratch[1];
+      rootOrder->clear();
+      int root = start;
+      int eccentricity;
+      size_t lastLevel = traverse(root, *rootOrder, false, &eccentricity);
+      for (int iteration=0; iteration < 8 && eccentricity > 0; ++iteration) {
+        int candidate = (*rootOrder)[lastLevel];
+        for (size_t i=lastLevel; i < rootOrder->size(); ++i) {
+          if (adjacency.degree((*rootOrder)[i]) < adjacency.degree(candidate)) {
+            candidate = (*rootOrder)[i];
+          }
+        }
+        candidateOrder->clear();
+        int candidateEccentricity;
+        size_t candidateLastLevel = traverse(candidate, *candidateOrder, false,
+                                             &candidateEccentricity);
+        if (candidateEccentricity <= eccentricity) {
+          break;
+        }
+        root = candidate;
+        eccentricity = candidateEccentricity;
+        lastLevel = candidateLastLevel;
+        swap(rootOrder, candidateOrder);
+      }
+      if (order != nullptr) {
+        order->insert(order->end(), rootOrder->begin(), rootOrder->end());
+      }
+      return root;
+    }
+
+  private:
+    // The part and the stamp of the last traversal that visited a vertex are
+    // kept together so that checking a neighbor touches one cache line.
+    struct VertexState {
+      VertexState() : part(0), mark(0) {}
+      int part;
+      int mark;
+    };
+
+    const Adjacency& adjacency;
+    vector<VertexState> vertices;
+    int stamp;
+    vector<int> scratch[2];
+
+    void newStamp() {
+      if (++stamp == 0) {
+        for (VertexState& vertex : vertices) {
+          vertex.mark = 0;
+        }
+        stamp = 1;
+      }
+    }
+  };
+
+  static void orderingFromSequence(const vector<int>& sequence,
+      vector<int>& vertexOrdering) {
+    vertexOrdering.resize(sequence.size());
+    for (size_t i=0; i < sequence.size(); ++i) {
+      vertexOrdering[sequence[i]] = i;
+    }
+  }
+
+  void rcmReordering(const int* endpoints, int numEdges, int cardinality,
+      int numVertices, vector<int>& vertexOrdering) {
+    Adjacency adjacency(endpoints, numEdges, cardinality, numVertices);
+    PartTraversal traversal(adjacency);
+
+    // Every traversal assigns its vertices to part 1 so that the remaining
+    // components are found by scanning for vertices still in part 0.
+    vector<int> sequence;
+    sequence.reserve(numVertices);
+    for (int v=0; v < numVertices; ++v) {
+      if (traversal.part(v) == 0) {
+        size_t componentBegin = sequence.size();
+        traversal.traverse(traversal.pseudoPeripheral(v), sequence, true);
+        for (size_t i=componentBegin; i < sequence.size(); ++i) {
+          traversal.setPart(sequence[i], 1);
+        }
+      }
+    }
+    reverse(sequence.begin(), sequence.end());
+    orderingFromSequence(sequence, vertexOrdering);
+  }
+
+  void bisectionReordering(const int* endpoints, int numEdges, int
+      cardinality, int numVertices, int partitionSize,
+      vector<int>& vertexOrdering) {
+    uassert(partitionSize > 0) << "Partitions must have at least one vertex";
+    Adjacency adjacency(endpoints, numEdges, cardinality, numVertices);
+    PartTraversal traversal(adjacency);
+
+    // Parts are contiguous ranges of `sequence` whose vertices are labeled
+    // with the part number. The connected components form the first parts,
+    // and components with more than `partitionSize` vertices are split
+    // further. A part is ordered breadth-first from a pseudo-peripheral
+    // vertex (visiting its components in turn) and split into the first and
+    // second half of that order, which keeps the halves connected and their
+    // boundary small on mesh-like graphs.
+    vector<int> sequence;
+    sequence.reserve(numVertices);
+    vector<pair<int,int>> parts;
+    int numParts = 1;
+    auto split = [&](int begin, int end) {
+      const int middle = begin + (end - begin) / 2;
+      const int firstLabel = numParts++;
+      const int secondLabel = numParts++;
+      for (int i=begin; i < end; ++i) {
+        traversal.setPart(sequence[i], (i < middle) ? firstLabel : secondLabel);
+      }
+      if (end - middle > partitionSize) {
+        parts.push_back(make_pair(middle, end));
+      }
+      if (middle - begin > partitionSize) {
+        parts.push_back(make_pair(begin, middle));
+      }
+    };
+
+    for (int v=0; v < numVertices; ++v) {
+      if (traversal.part(v) == 0) {
+        const int begin = sequence.size();
+        traversal.pseudoPeripheral(v, &sequence);
+        const int end = sequence.size();
+        const int label = numParts++;
+        for (int i=begin; i < end; ++i) {
+          traversal.setPart(sequence[i], label);
+        }
+        if (end - begin > partitionSize) {
+          split(begin, end);
+        }
+      }
+    }
+
+    vector<int> order;
+    while (!parts.empty()) {
+      const int begin = parts.back().first;
+      const int end = parts.back().second;
+      parts.pop_back();
+
+      // Move the part out of the way so that visited vertices can be
+      // recognized by their new part label
+      const int label = traversal.part(sequence[begin]);
+      const int visitedLabel = numParts++;
+      order.clear();
+      for (int i=begin; i < end; ++i) {
+        const int v = sequence[i];
+        if (traversal.part(v) == label) {
+          size_t componentBegin = order.size();
+          traversal.pseudoPeripheral(v, &order);
+          for (size_t j=componentBegin; j < order.size(); ++j) {
+            traversal.setPart(order[j], visitedLabel);
+          }
+        }
+      }
+      iassert((int)order.size() == end - begin);
+      copy(order.begin(), order.end(), sequence.begin() + begin);
+      split(begin, end);
+    }
+    orderingFromSequence(sequence, vertexOrdering);
+  }
+
   // ---------- Simit Level Reordering Heuristics ----------
   int qsortCompare( const void* a, const void* b) {
        int int_a = * ( (int*) a );
@@ -123,8 +524,8 @@ namespace simit {
   } 
   
   struct edgeCompare{
-    edgeCompare(int* endpoints, const int cardinality) : endpoints(endpoints),
-      cardinality(cardinality)
+    edgeCompare(const int* endpoints, const int cardinality) : 
+      endpoints(endpoints), cardinality(cardinality)
       {}
     
     bool operator()(int const&left, int const&right) const {
@@ -135,18 +536,21 @@ namespace simit {
         if (leftID != rightID) {
           return leftID < rightID; }
       }
-      return true;
+      // Break ties by index so that the comparison is a strict weak ordering
+      return left < right;
     }
     private:
-      int* endpoints;
+      const int* endpoints;
       const int cardinality;
   };
 
   void edgeVertexSortReordering(Set& edgeSet, vector<int>& edgeOrdering) {
-    int* endpoints = edgeSet.getEndpointsPtr();
-    const int size = edgeSet.getSize();
-    const int cardinality = edgeSet.getCardinality();
-    
+    edgeVertexSortReordering(edgeSet.getEndpointsPtr(), edgeSet.getSize(),
+        edgeSet.getCardinality(), edgeOrdering);
+  }
+
+  void edgeVertexSortReordering(const int* endpoints, int size, int 
+      cardinality, vector<int>& edgeOrdering) {
     assert(edgeOrdering.size() == 0);
     edgeOrdering.resize(size);
     int* sortableEndpoints = static_cast<int *>(malloc(size * cardinality * 
@@ -164,102 +568,325 @@ namespace simit {
     free(sortableEndpoints);
   }
 
-  // ---------- Reordering Helper Functions ----------
-  void reorderFields(vector<Set::FieldData*>& fields, const vector<int>& 
-      ordering) {
-    for (auto f : fields) {
-      switch (f->type->getComponentType()) {
-        case ComponentType::Float: {
-          float* data = static_cast<float *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Double: {
-          double* data = static_cast<double *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Int: {
-          int* data = static_cast<int *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Boolean: {
-          bool* data = static_cast<bool *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-        }
-        case ComponentType::DoubleComplex: {
-          double_complex* data = static_cast<double_complex *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
+  // Number of bits needed to store the values 0 to maxValue.
+  static unsigned bitWidth(uint64_t maxValue) {
+    unsigned bits = 0;
+    while (bits < 64 && (maxValue >> bits) != 0) {
+      ++bits;
+    }
+    return bits;
+  }
+
+  // The edge orders other than SortedEndpoints pack each edge's sort key into
+  // 64 bits and sort the edges with the stable radix sort of the curve
+  // orderings.
+  void computeEdgeOrdering(const int* endpoints, int size, int cardinality,
+      const ReorderOptions& options, vector<int>& edgeOrdering) {
+    edgeOrdering.clear();
+    if (options.edgeOrder == EdgeOrder::SortedEndpoints || cardinality == 0) {
+      edgeVertexSortReordering(endpoints, size, cardinality, edgeOrdering);
+      return;
+    }
+    uassert(options.edgeOrder != EdgeOrder::TargetEndpoint ||
+            options.targetEndpoint < (unsigned)cardinality)
+        << "Target endpoint " << options.targetEndpoint << " of edges with "
+        << cardinality << " endpoints";
+    uassert(options.tileSize > 0) << "Vertex tiles must not be empty";
+
+    const size_t numEndpoints = (size_t)size * cardinality;
+    const unsigned numChunks = util::numThreads(options.numThreads);
+    vector<int> chunkMax(numChunks, 0);
+    util::parallelChunks(numChunks, [&](unsigned chunk) {
+      const size_t end = numEndpoints * (chunk+1) / numChunks;
+      for (size_t i=numEndpoints * chunk / numChunks; i < end; ++i) {
+        chunkMax[chunk] = max(chunkMax[chunk], endpoints[i]);
+      }
+    });
+    const uint64_t maxVertex = *max_element(chunkMax.begin(), chunkMax.end());
+
+    const unsigned vertexBits = bitWidth(maxVertex);
+    const uint64_t tileSize = options.tileSize;
+    const unsigned tileBits = bitWidth(maxVertex / tileSize);
+    const unsigned keyBits = (options.edgeOrder == EdgeOrder::VertexTiles)
+                             ? 2*tileBits + vertexBits : 2*vertexBits;
+    uassert(keyBits <= 64) << "Tiles of " << tileSize << " vertices are too "
+        << "small for " << maxVertex+1 << " vertices";
+
+    vector<uint64_t> keys(size);
+    util::parallelFor(0, size, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        const int* edge = endpoints + i*cardinality;
+        const uint64_t lo = *min_element(edge, edge + cardinality);
+        const uint64_t hi = *max_element(edge, edge + cardinality);
+        switch (options.edgeOrder) {
+          case EdgeOrder::MinEndpoint:
+            keys[i] = (lo << vertexBits) | hi;
+            break;
+          case EdgeOrder::TargetEndpoint:
+            keys[i] = ((uint64_t)edge[options.targetEndpoint] << vertexBits)
+                      | lo;
+            break;
+          case EdgeOrder::VertexTiles:
+            keys[i] = (((lo / tileSize) << tileBits | hi / tileSize)
+                       << vertexBits) | lo;
+            break;
+          case EdgeOrder::SortedEndpoints:
+            unreachable;
+            break;
         }
-        case ComponentType::FloatComplex: {
-          float_complex* data = static_cast<float_complex *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
+      }
+    }, options.numThreads);
+    radixSort(keys, keyBits, options.numThreads, edgeOrdering);
+  }
+
+  void computeEdgeOrdering(const Set& edgeSet, const ReorderOptions& options,
+      vector<int>& edgeOrdering) {
+    computeEdgeOrdering(edgeSet.getEndpointsPtr(), edgeSet.getSize(),
+        edgeSet.getCardinality(), options, edgeOrdering);
+  }
+
+  // ---------- Reordering Helper Functions ----------
+  // Copies `numElements` elements of `elementBytes` bytes each, where element
+  // i comes from element gather[i] of `source`. Elements that are a whole
+  // number of words are copied word by word.
+  static void gatherElements(char* destination, const char* source,
+      size_t elementBytes, const int* gather, size_t numElements) {
+    if (elementBytes % sizeof(uint32_t) == 0) {
+      const size_t words = elementBytes / sizeof(uint32_t);
+      uint32_t* to = reinterpret_cast<uint32_t*>(destination);
+      const uint32_t* from = reinterpret_cast<const uint32_t*>(source);
+      for (size_t i=0; i < numElements; ++i) {
+        const uint32_t* element = from + (size_t)gather[i] * words;
+        for (size_t w=0; w < words; ++w) {
+          to[i*words + w] = element[w];
         }
       }
     }
+    else {
+      for (size_t i=0; i < numElements; ++i) {
+        memcpy(destination + i*elementBytes,
+               source + (size_t)gather[i]*elementBytes, elementBytes);
+      }
+    }
   }
-  
-  void reorderEdgeSet(Set& edgeSet, const vector<int>& edgeOrdering) {
-    iassert(edgeOrdering.size() == (unsigned int) edgeSet.getSize()) << "Edge \
-      Mapping must be the same size as the edge set" << edgeOrdering.size() <<
-      " != " << edgeSet.getSize(); int* endpoints = edgeSet.getEndpointsPtr();
-    const unsigned int size = edgeSet.getSize();
-    const int cardinality = edgeSet.getCardinality();
 
-    int* newEndpoints = static_cast<int *>(malloc(size * cardinality * 
-          sizeof(int)));
-    memcpy(newEndpoints, endpoints, size * cardinality * sizeof(int));
+  // Permutes the endpoints (unless null) and all fields of a set so that
+  // element i takes the values of element gather[i]. All arrays are gathered
+  // in one parallel pass over the elements into a single scratch buffer,
+  // which a second parallel pass copies back.
+  static void permuteElements(vector<Set::FieldData*>& fields, int* endpoints,
+      int cardinality, const vector<int>& gather, unsigned numThreads,
+      vector<char>& scratch) {
+    struct Array {
+      char* data;
+      size_t elementBytes;
+      size_t scratchOffset;
+    };
+    const size_t numElements = gather.size();
+    vector<Array> arrays;
+    size_t scratchBytes = 0;
+    if (endpoints != nullptr && cardinality > 0) {
+      Array array = {reinterpret_cast<char*>(endpoints),
+                     cardinality * sizeof(int), scratchBytes};
+      arrays.push_back(array);
+      scratchBytes += numElements * array.elementBytes;
+    }
+    for (Set::FieldData* field : fields) {
+      Array array = {static_cast<char*>(field->data), field->sizeOfType,
+                     scratchBytes};
+      arrays.push_back(array);
+      scratchBytes += numElements * array.elementBytes;
+    }
+    if (arrays.empty() || numElements == 0) {
+      return;
+    }
 
-    for (unsigned int edgeIndex=0; edgeIndex < size; ++edgeIndex) {
-      iassert(edgeIndex < edgeOrdering.size());
-      iassert(edgeOrdering[edgeIndex] < (int) ((size - 1) * cardinality * 
-            sizeof(int)));
-      memcpy(newEndpoints + edgeIndex * cardinality, endpoints + 
-          edgeOrdering[edgeIndex] * cardinality, cardinality * sizeof(int));
+    if (scratch.size() < scratchBytes) {
+      scratch.resize(scratchBytes);
     }
-    memcpy(endpoints, newEndpoints, size * cardinality * sizeof(int));
-    free(newEndpoints);
-    
-    reorderFields(edgeSet.getFields(), edgeOrdering);
+    util::parallelFor(0, numElements, [&](size_t begin, size_t end) {
+      for (const Array& array : arrays) {
+        gatherElements(scratch.data() + array.scratchOffset +
+                       begin*array.elementBytes, array.data,
+                       array.elementBytes, gather.data() + begin, end - begin);
+      }
+    }, numThreads);
+    util::parallelFor(0, numElements, [&](size_t begin, size_t end) {
+      for (const Array& array : arrays) {
+        memcpy(array.data + begin*array.elementBytes,
+               scratch.data() + array.scratchOffset + begin*array.elementBytes,
+               (end - begin) * array.elementBytes);
+      }
+    }, numThreads);
+  }
+  
+  void reorderEdgeSet(Set& edgeSet, const vector<int>& edgeOrdering,
+      unsigned numThreads) {
+    iassert(edgeOrdering.size() == (unsigned int) edgeSet.getSize()) << "Edge \
+      Mapping must be the same size as the edge set" << edgeOrdering.size() <<
+      " != " << edgeSet.getSize();
+    // Edge orderings list the old edge at every new position, so the
+    // endpoints and the fields are gathered with them directly
+    vector<char> scratch;
+    permuteElements(edgeSet.getFields(), edgeSet.getEndpointsPtr(),
+        edgeSet.getCardinality(), edgeOrdering, numThreads, scratch);
   }
 
   void reorderEdgeSetByVertexOrdering(Set& edgeSet, const vector<int>& 
-      vertexOrdering) {
-    for (int i=0; i < edgeSet.getSize() * edgeSet.getCardinality(); ++i) {
-      edgeSet.getEndpointsPtr()[i] = 
-        vertexOrdering[edgeSet.getEndpointsPtr()[i]]; }
+      vertexOrdering, unsigned numThreads) {
+    int* endpoints = edgeSet.getEndpointsPtr();
+    const size_t numEndpoints =
+        (size_t)edgeSet.getSize() * edgeSet.getCardinality();
+    util::parallelFor(0, numEndpoints, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        endpoints[i] = vertexOrdering[endpoints[i]];
+      }
+    }, numThreads);
   }
     
   void reorderVertexSet(Set& edgeSet, Set& vertexSet, vector<int>& 
-      vertexOrdering) {
+      vertexOrdering, unsigned numThreads) {
     iassert(vertexOrdering.size() == (unsigned int) vertexSet.getSize()) << 
       "Vertex Mapping must be the same size as the vertex set" << 
       vertexOrdering.size() << " != " << vertexSet.getSize(); 
     // Reset Endpoints to reflect reordering
     // Vertex ordering maps old to new identity This itertates over all enpoints 
     // translating from old to new
-    reorderEdgeSetByVertexOrdering(edgeSet, vertexOrdering); 
+    reorderEdgeSetByVertexOrdering(edgeSet, vertexOrdering, numThreads); 
 
-    iassert(vertexOrdering.size() == (unsigned int) vertexSet.getSize()) << 
-      vertexOrdering.size() << ", " << vertexSet.getSize();
-    reorderFields(vertexSet.getFields(), vertexOrdering);
+    // Invert the vertex ordering to gather the vertex fields
+    vector<int> gather(vertexOrdering.size());
+    util::parallelFor(0, gather.size(), [&](size_t begin, size_t end) {
+      for (size_t i=begin; i < end; ++i) {
+        gather[vertexOrdering[i]] = (int)i;
+      }
+    }, numThreads);
+    vector<char> scratch;
+    permuteElements(vertexSet.getFields(), nullptr, 0, gather, numThreads,
+        scratch);
+  }
+
+  void permuteSet(Set& set, const vector<int>& gather, unsigned numThreads,
+      vector<char>* scratch) {
+    iassert(gather.size() == (size_t)set.getSize());
+    vector<char> localScratch;
+    permuteElements(set.getFields(), set.getEndpointsPtr(),
+        set.getCardinality(), gather, numThreads,
+        scratch != nullptr ? *scratch : localScratch);
+  }
+
+  void renumberEndpoints(Set& edgeSet, const Set& endpointSet,
+      const vector<int>& ordering, unsigned numThreads) {
+    const int cardinality = edgeSet.getCardinality();
+    vector<bool> renumbered(cardinality);
+    for (int i=0; i < cardinality; ++i) {
+      renumbered[i] = (edgeSet.getEndpointSet(i) == &endpointSet);
+    }
+    int* endpoints = edgeSet.getEndpointsPtr();
+    util::parallelFor(0, edgeSet.getSize(), [&](size_t begin, size_t end) {
+      for (size_t e=begin; e < end; ++e) {
+        for (int i=0; i < cardinality; ++i) {
+          if (renumbered[i]) {
+            endpoints[e*cardinality + i] = ordering[endpoints[e*cardinality+i]];
+          }
+        }
+      }
+    }, numThreads);
   }
   
+  std::ostream& operator<<(std::ostream& os, ReorderHeuristic heuristic) {
+    switch (heuristic) {
+      case ReorderHeuristic::Hilbert:
+        return os << "hilbert";
+      case ReorderHeuristic::Morton:
+        return os << "morton";
+      case ReorderHeuristic::ReverseCuthillMcKee:
+        return os << "rcm";
+      case ReorderHeuristic::RecursiveBisection:
+        return os << "bisection";
+      case ReorderHeuristic::EdgeSort:
+        return os << "edge-sort";
+    }
+    return os;
+  }
+
+  std::ostream& operator<<(std::ostream& os, EdgeOrder order) {
+    switch (order) {
+      case EdgeOrder::SortedEndpoints:
+        return os << "sorted-endpoints";
+      case EdgeOrder::MinEndpoint:
+        return os << "min-endpoint";
+      case EdgeOrder::TargetEndpoint:
+        return os << "target-endpoint";
+      case EdgeOrder::VertexTiles:
+        return os << "vertex-tiles";
+    }
+    return os;
+  }
+
+  static void checkVertexEndpoints(const Set& edgeSet, const Set& vertexSet) {
+    for (int i=0; i < edgeSet.getCardinality(); ++i) {
+      uassert(edgeSet.getEndpointSet(i) == &vertexSet)
+          << "Connectivity reordering requires all edge endpoints to be in "
+          << "the vertex set";
+    }
+  }
+
+  void computeVertexOrdering(const Set& edgeSet, const Set& vertexSet,
+      const ReorderOptions& options, vector<int>& vertexOrdering) {
+    vertexOrdering.clear();
+    switch (options.heuristic) {
+      case ReorderHeuristic::Hilbert:
+        uassert(vertexSet.hasSpatialField()) << "Vertex Set must have a "
+            << "spatial field set prior to reordering";
+        hilbert::hilbertReorder(vertexSet, vertexOrdering,
+            options.hilbertBits, options.numThreads);
+        break;
+      case ReorderHeuristic::Morton: {
+        uassert(vertexSet.hasSpatialField()) << "Vertex Set must have a "
+            << "spatial field set prior to reordering";
+        vector<double> storage;
+        mortonReordering(spatialCoordinates(vertexSet, storage),
+            vertexSet.getSize(), vertexOrdering, options.hilbertBits,
+            options.numThreads);
+        break;
+      }
+      case ReorderHeuristic::ReverseCuthillMcKee:
+        checkVertexEndpoints(edgeSet, vertexSet);
+        rcmReordering(edgeSet.getEndpointsPtr(), edgeSet.getSize(),
+            edgeSet.getCardinality(), vertexSet.getSize(), vertexOrdering);
+        break;
+      case ReorderHeuristic::RecursiveBisection:
+        checkVertexEndpoints(edgeSet, vertexSet);
+        bisectionReordering(edgeSet.getEndpointsPtr(), edgeSet.getSize(),
+            edgeSet.getCardinality(), vertexSet.getSize(),
+            options.partitionSize, vertexOrdering);
+        break;
+      case ReorderHeuristic::EdgeSort:
+        vertexOrdering.resize(vertexSet.getSize());
+        iota(vertexOrdering.begin(), vertexOrdering.end(), 0);
+        break;
+    }
+  }
+
   void reorder(Set& edgeSet, Set& vertexSet, vector<int>& edgeOrdering, 
       vector<int>& vertexOrdering) {
-    iassert(vertexSet.hasSpatialField()) << "Vertex Set must have a spatial \
-      field set prior to reordering";
+    reorder(edgeSet, vertexSet, ReorderOptions(), edgeOrdering,
+        vertexOrdering);
+  }
+
+  void reorder(Set& edgeSet, Set& vertexSet, const ReorderOptions& options,
+      vector<int>& edgeOrdering, vector<int>& vertexOrdering) {
     vertexOrdering.clear();
     edgeOrdering.clear();
     
     // Get new vertex ordering based on given heuristic 
-    hilbert::hilbertReorder(vertexSet, vertexOrdering);
-    reorderVertexSet(edgeSet, vertexSet, vertexOrdering);
+    computeVertexOrdering(edgeSet, vertexSet, options, vertexOrdering);
+    reorderVertexSet(edgeSet, vertexSet, vertexOrdering, options.numThreads);
 
     // Get new edge ordering based on given heuristic 
-    edgeVertexSortReordering(edgeSet, edgeOrdering); reorderEdgeSet(edgeSet, 
-        edgeOrdering);
+    computeEdgeOrdering(edgeSet, options, edgeOrdering);
+    reorderEdgeSet(edgeSet, edgeOrdering, options.numThreads);
   }
   
   void reorder(Set& edgeSet, Set& vertexSet) {
@@ -267,4 +894,296 @@ namespace simit {
     vector<int> edgeOrdering;
     reorder(edgeSet, vertexSet, edgeOrdering, vertexOrdering);
   }
+
+  // ---------- Ordering Analysis ----------
+  // Set-associative cache with LRU replacement within each set.
+  class CacheSimulator {
+  public:
+    CacheSimulator(const CacheModel& model)
+        : lineBytes(max<size_t>(model.lineBytes, 1)),
+          ways(max<size_t>(model.associativity, 1)),
+          numSets(max<size_t>(model.cacheBytes / (lineBytes * ways), 1)),
+          tags(numSets * ways, EmptyLine), misses(0) {}
+
+    void access(size_t address) {
+      const size_t line = address / lineBytes;
+      size_t* set = tags.data() + (line % numSets) * ways;
+      size_t way = 0;
+      while (way < ways && set[way] != line) {
+        ++way;
+      }
+      if (way == ways) {
+        ++misses;
+        way = ways - 1;
+      }
+      // Move the line to the most recently used position
+      for (; way > 0; --way) {
+        set[way] = set[way-1];
+      }
+      set[0] = line;
+    }
+
+    size_t getMisses() const { return misses; }
+
+  private:
+    static const size_t EmptyLine = SIZE_MAX;
+    size_t lineBytes;
+    size_t ways;
+    size_t numSets;
+    vector<size_t> tags;
+    size_t misses;
+  };
+
+  // Computes the reuse distances of a stream of cache line accesses with a
+  // Fenwick tree over the access times, which marks the latest access to
+  // every line. The distance of an access is the number of marks after the
+  // previous access to its line.
+  class ReuseDistanceCounter {
+  public:
+    ReuseDistanceCounter(size_t numAccesses, size_t numLines)
+        : marks(numAccesses + 1, 0), lastAccess(numLines, NoAccess), time(0),
+          totalDistance(0.0) {}
+
+    void access(size_t line) {
+      const size_t previous = lastAccess[line];
+      if (previous == NoAccess) {
+        ++profile.coldAccesses;
+      }
+      else {
+        const size_t distance = countMarks(time) - countMarks(previous + 1);
+        const size_t bucket = bitWidth(distance);
+        if (profile.histogram.size() <= bucket) {
+          profile.histogram.resize(bucket + 1, 0);
+        }
+        ++profile.histogram[bucket];
+        totalDistance += distance;
+        mark(previous, -1);
+      }
+      mark(time, 1);
+      lastAccess[line] = time;
+      ++time;
+    }
+
+    ReuseProfile getProfile() const {
+      ReuseProfile result = profile;
+      result.accesses = time;
+      const size_t reused = time - profile.coldAccesses;
+      result.meanDistance = (reused > 0) ? totalDistance / reused : 0.0;
+      return result;
+    }
+
+  private:
+    static const size_t NoAccess = SIZE_MAX;
+    vector<int> marks;
+    vector<size_t> lastAccess;
+    size_t time;
+    double totalDistance;
+    ReuseProfile profile;
+
+    // Number of marks at times before `end`
+    size_t countMarks(size_t end) const {
+      size_t count = 0;
+      for (; end > 0; end -= end & (~end + 1)) {
+        count += marks[end];
+      }
+      return count;
+    }
+
+    void mark(size_t t, int delta) {
+      for (++t; t < marks.size(); t += t & (~t + 1)) {
+        marks[t] += delta;
+      }
+    }
+  };
+
+  size_t ReuseProfile::percentile(double fraction) const {
+    const size_t reused = accesses - coldAccesses;
+    const double target = fraction * reused;
+    size_t count = 0;
+    for (size_t k=0; k < histogram.size(); ++k) {
+      count += histogram[k];
+      if (count >= target) {
+        return (k == 0) ? 0 : ((size_t)1 << k) - 1;
+      }
+    }
+    return histogram.empty() ? 0 : ((size_t)1 << (histogram.size()-1)) - 1;
+  }
+
+  double ReuseProfile::hitRate(size_t lines) const {
+    size_t hits = 0;
+    for (size_t k=0; k < histogram.size() && ((size_t)1 << k) <= lines; ++k) {
+      hits += histogram[k];
+    }
+    return (accesses > 0) ? double(hits) / accesses : 0.0;
+  }
+
+  std::ostream& operator<<(std::ostream& os, const ReuseProfile& profile) {
+    os << profile.accesses << " accesses, " << profile.coldAccesses
+       << " cold, mean reuse distance " << profile.meanDistance << " lines";
+    const double reused = max<double>(profile.accesses - profile.coldAccesses,
+                                      1.0);
+    for (size_t k=0; k < profile.histogram.size(); ++k) {
+      if (profile.histogram[k] == 0) {
+        continue;
+      }
+      os << "\n  ";
+      if (k <= 1) {
+        os << k;
+      }
+      else {
+        os << ((size_t)1 << (k-1)) << "-" << ((size_t)1 << k) - 1;
+      }
+      os << ": " << profile.histogram[k] << " ("
+         << profile.histogram[k] / reused * 100.0 << "%)";
+    }
+    return os;
+  }
+
+  OrderingReport analyzeOrdering(const Set& edgeSet,
+      const vector<int>& vertexOrdering, const vector<int>& edgeOrdering,
+      const CacheModel& cache) {
+    const int numEdges = edgeSet.getSize();
+    const int cardinality = edgeSet.getCardinality();
+    const int* endpoints = edgeSet.getEndpointsPtr();
+    iassert(edgeOrdering.empty() || (int)edgeOrdering.size() == numEdges);
+
+    // Size the reuse distance counter by the largest line loaded
+    const size_t lineBytes = max<size_t>(cache.lineBytes, 1);
+    size_t maxVertex = 0;
+    if (!vertexOrdering.empty()) {
+      maxVertex = vertexOrdering.size() - 1;
+    }
+    else if (numEdges > 0 && cardinality > 0) {
+      maxVertex = *max_element(endpoints, endpoints + numEdges * cardinality);
+    }
+    const size_t numLines = maxVertex * cache.bytesPerVertex / lineBytes + 1;
+    ReuseDistanceCounter reuse((size_t)numEdges * cardinality, numLines);
+
+    OrderingReport report;
+    CacheSimulator simulator(cache);
+    double totalSpan = 0.0;
+    for (int i=0; i < numEdges; ++i) {
+      const int edge = edgeOrdering.empty() ? i : edgeOrdering[i];
+      int minVertex = INT_MAX;
+      int maxVertex = INT_MIN;
+      for (int j=0; j < cardinality; ++j) {
+        int vertex = endpoints[edge*cardinality + j];
+        if (!vertexOrdering.empty()) {
+          vertex = vertexOrdering[vertex];
+        }
+        minVertex = min(minVertex, vertex);
+        maxVertex = max(maxVertex, vertex);
+        simulator.access((size_t)vertex * cache.bytesPerVertex);
+        reuse.access((size_t)vertex * cache.bytesPerVertex / lineBytes);
+      }
+      if (cardinality > 0) {
+        report.bandwidth = max(report.bandwidth, maxVertex - minVertex);
+        totalSpan += maxVertex - minVertex;
+      }
+    }
+    report.averageSpan = (numEdges > 0) ? totalSpan / numEdges : 0.0;
+    report.accesses = (size_t)numEdges * cardinality;
+    report.cacheMisses = simulator.getMisses();
+    report.reuse = reuse.getProfile();
+    return report;
+  }
+
+  vector<OrderingReport> compareOrderings(const Set& edgeSet,
+      const Set& vertexSet, const ReorderOptions& options,
+      const CacheModel& cache) {
+    typedef chrono::steady_clock Clock;
+    vector<OrderingReport> reports;
+    reports.push_back(analyzeOrdering(edgeSet, vector<int>(), vector<int>(),
+                                      cache));
+    reports.back().name = "original";
+
+    vector<ReorderHeuristic> heuristics;
+    heuristics.push_back(ReorderHeuristic::EdgeSort);
+    if (vertexSet.hasSpatialField()) {
+      heuristics.push_back(ReorderHeuristic::Hilbert);
+      heuristics.push_back(ReorderHeuristic::Morton);
+    }
+    heuristics.push_back(ReorderHeuristic::ReverseCuthillMcKee);
+    heuristics.push_back(ReorderHeuristic::RecursiveBisection);
+
+    const int cardinality = edgeSet.getCardinality();
+    const size_t numEndpoints = (size_t)edgeSet.getSize() * cardinality;
+    vector<int> renumbered(numEndpoints);
+    for (ReorderHeuristic heuristic : heuristics) {
+      ReorderOptions heuristicOptions = options;
+      heuristicOptions.heuristic = heuristic;
+
+      auto start = Clock::now();
+      vector<int> vertexOrdering;
+      vector<int> edgeOrdering;
+      computeVertexOrdering(edgeSet, vertexSet, heuristicOptions,
+          vertexOrdering);
+      for (size_t i=0; i < numEndpoints; ++i) {
+        renumbered[i] = vertexOrdering[edgeSet.getEndpointsPtr()[i]];
+      }
+      computeEdgeOrdering(renumbered.data(), edgeSet.getSize(), cardinality,
+          heuristicOptions, edgeOrdering);
+      double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+      reports.push_back(analyzeOrdering(edgeSet, vertexOrdering, edgeOrdering,
+                                        cache));
+      std::ostringstream name;
+      name << heuristic;
+      reports.back().name = name.str();
+      reports.back().seconds = seconds;
+    }
+    return reports;
+  }
+
+  vector<OrderingReport> compareEdgeOrders(const Set& edgeSet,
+      const vector<int>& vertexOrdering, const ReorderOptions& options,
+      const CacheModel& cache) {
+    typedef chrono::steady_clock Clock;
+    vector<OrderingReport> reports;
+    reports.push_back(analyzeOrdering(edgeSet, vertexOrdering, vector<int>(),
+                                      cache));
+    reports.back().name = "current";
+
+    const int cardinality = edgeSet.getCardinality();
+    const int* endpoints = edgeSet.getEndpointsPtr();
+    vector<int> renumbered(endpoints,
+                           endpoints + (size_t)edgeSet.getSize()*cardinality);
+    if (!vertexOrdering.empty()) {
+      for (int& vertex : renumbered) {
+        vertex = vertexOrdering[vertex];
+      }
+    }
+
+    const EdgeOrder orders[] = {EdgeOrder::SortedEndpoints,
+                                EdgeOrder::MinEndpoint,
+                                EdgeOrder::TargetEndpoint,
+                                EdgeOrder::VertexTiles};
+    for (EdgeOrder order : orders) {
+      ReorderOptions orderOptions = options;
+      orderOptions.edgeOrder = order;
+
+      auto start = Clock::now();
+      vector<int> edgeOrdering;
+      computeEdgeOrdering(renumbered.data(), edgeSet.getSize(), cardinality,
+          orderOptions, edgeOrdering);
+      double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+      reports.push_back(analyzeOrdering(edgeSet, vertexOrdering, edgeOrdering,
+                                        cache));
+      std::ostringstream name;
+      name << order;
+      reports.back().name = name.str();
+      reports.back().seconds = seconds;
+    }
+    return reports;
+  }
+
+  std::ostream& operator<<(std::ostream& os, const OrderingReport& report) {
+    return os << report.name << ": bandwidth " << report.bandwidth
+              << ", average span " << report.averageSpan << ", "
+              << report.cacheMisses << " misses in " << report.accesses
+              << " accesses (" << report.missRate() * 100.0 << "%), "
+              << "median reuse distance " << report.reuse.percentile(0.5)
+              << " lines, " << report.seconds * 1000.0 << " ms";
+  }
 }
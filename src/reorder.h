@@ -9,10 +9,86 @@
 #include <fstream>
 
 namespace simit { 
+  /// Vertex ordering heuristics.
+  enum class ReorderHeuristic {
+    /// Sort vertices along a 3D Hilbert curve through their spatial field.
+    Hilbert,
+    /// Sort vertices along a 3D Morton (Z-order) curve through their spatial
+    /// field, which is cheaper to compute but has less locality than Hilbert.
+    Morton,
+    /// Reverse Cuthill-McKee, computed from the edge connectivity alone.
+    ReverseCuthillMcKee,
+    /// Recursive bisection of the connectivity graph into BFS level-structure
+    /// halves, so that every part is numbered contiguously.
+    RecursiveBisection,
+    /// Keep the vertex order and only sort the edges by their endpoints.
+    EdgeSort
+  };
+
+  std::ostream& operator<<(std::ostream& os, ReorderHeuristic heuristic);
+
+  /// Edge ordering heuristics, applied after the vertices are renumbered.
+  enum class EdgeOrder {
+    /// Sort the edges lexicographically by their sorted endpoints.
+    SortedEndpoints,
+    /// Sort the edges by their smallest endpoint and then by their largest,
+    /// so that the gathers of consecutive edges start from nearby vertices.
+    MinEndpoint,
+    /// Sort the edges by the endpoint that a map reduces into (the
+    /// `targetEndpoint` option) and then by their smallest endpoint, so that
+    /// the writes of a `reduce +` map sweep the vertices once.
+    TargetEndpoint,
+    /// Group the edges into tiles by the ranges of `tileSize` vertices that
+    /// their smallest and largest endpoints fall in, and sort the edges of
+    /// every tile by their smallest endpoint. The gathers of a tile touch at
+    /// most two vertex ranges, which can be sized to stay in cache.
+    VertexTiles
+  };
+
+  std::ostream& operator<<(std::ostream& os, EdgeOrder order);
+
+  /// Options for reorder.
+  struct ReorderOptions {
+    ReorderOptions() : heuristic(ReorderHeuristic::Hilbert), hilbertBits(8),
+        partitionSize(256), edgeOrder(EdgeOrder::SortedEndpoints),
+        targetEndpoint(0), tileSize(4096), numThreads(0) {}
+
+    ReorderHeuristic heuristic;
+
+    /// Bits per axis of the Hilbert and Morton grids, which have
+    /// 2^hilbertBits cells along each axis. Between 1 and 21; more bits break
+    /// ties on large meshes.
+    unsigned hilbertBits;
+
+    /// Recursive bisection stops splitting parts of at most this many
+    /// vertices.
+    unsigned partitionSize;
+
+    /// How the edges are ordered once their endpoints are renumbered.
+    EdgeOrder edgeOrder;
+
+    /// Endpoint that EdgeOrder::TargetEndpoint sorts by.
+    unsigned targetEndpoint;
+
+    /// Vertices per tile for EdgeOrder::VertexTiles.
+    unsigned tileSize;
+
+    /// Threads used to compute curve orderings and to permute the sets (0
+    /// uses all hardware threads).
+    unsigned numThreads;
+  };
+
   /// Reorders edge set and vertex set by hilbert reordering of the vertex set.
   /// Vertex set must have a set spatial field in 3 dimensions.
   void reorder(Set& edgeSet, Set& vertexSet);
 
+  /// Reorders the vertex set by the heuristic in `options` and then orders the
+  /// edge set by `options.edgeOrder`. The supplied orderings are populated as for
+  /// reorder(Set&, Set&, vector<int>&, vector<int>&). All endpoints of the
+  /// edge set must be in the vertex set.
+  void reorder(Set& edgeSet, Set& vertexSet, const ReorderOptions& options,
+      std::vector<int>& edgeOrdering, std::vector<int>& vertexOrdering);
+
   /// Reorders edge set and vertex set by hilbert reordering of the vertex set.
   /// Vertex set must have a set spatial field in 3 dimensions.
   /// The supplied edge and vertex ordering vectors are populated with the new 
@@ -21,15 +97,74 @@ namespace simit {
       std::vector<int>& vertexOrdering);
   
   /// Reorders edge set and vertex set by the supplied vertex ordering map.
+  /// The vertex fields are permuted in one parallel pass.
   void reorderVertexSet(Set& edgeSet, Set& vertexSet, std::vector<int>& 
-      vertexOrdering);
+      vertexOrdering, unsigned numThreads=0);
   
-  /// Reorders edge set by the supplied edge ordering map.
-  void reorderEdgeSet(Set& edgeSet, const std::vector<int>& edgeOrdering);
+  /// Reorders edge set by the supplied edge ordering map. The endpoints and
+  /// fields are permuted in one parallel pass.
+  void reorderEdgeSet(Set& edgeSet, const std::vector<int>& edgeOrdering,
+      unsigned numThreads=0);
 
   /// Reorders edge set by the supplied vertex ordering map.
   void reorderEdgeSetByVertexOrdering(Set& edgeSet, const std::vector<int>& 
-      vertexOrdering);
+      vertexOrdering, unsigned numThreads=0);
+
+  /// Permutes the elements of a set, moving its endpoints and fields so that
+  /// element i takes the values of element gather[i]. The values are staged in
+  /// `scratch` if given, which grows as needed and can be reused across calls.
+  void permuteSet(Set& set, const std::vector<int>& gather,
+      unsigned numThreads=0, std::vector<char>* scratch=nullptr);
+
+  /// Renumbers the endpoints of `edgeSet` that are elements of `endpointSet`
+  /// by the supplied ordering map (old to new indices). Endpoints in other
+  /// endpoint sets are left unchanged.
+  void renumberEndpoints(Set& edgeSet, const Set& endpointSet,
+      const std::vector<int>& ordering, unsigned numThreads=0);
+
+  /// Computes the vertex ordering (old to new indices) that `options` selects
+  /// for the vertices of `vertexSet` connected by `edgeSet`.
+  void computeVertexOrdering(const Set& edgeSet, const Set& vertexSet,
+      const ReorderOptions& options, std::vector<int>& vertexOrdering);
+
+  /// Computes the Morton vertex ordering (old to new indices) of
+  /// `numVertices` points stored as consecutive xyz triples, on a grid with
+  /// 2^bits cells along each axis.
+  void mortonReordering(const double* coords, int numVertices,
+      std::vector<int>& vertexOrdering, unsigned bits=8,
+      unsigned numThreads=0);
+
+  /// Computes the Reverse Cuthill-McKee vertex ordering (old to new indices)
+  /// of `numVertices` vertices connected by `numEdges` edges with
+  /// `cardinality` endpoints each. Every connected component is started from
+  /// a pseudo-peripheral vertex.
+  void rcmReordering(const int* endpoints, int numEdges, int cardinality,
+      int numVertices, std::vector<int>& vertexOrdering);
+
+  /// Computes a recursive bisection vertex ordering (old to new indices). Each
+  /// part is split in two halves of a breadth-first traversal from a
+  /// pseudo-peripheral vertex until it has at most `partitionSize` vertices.
+  void bisectionReordering(const int* endpoints, int numEdges, int
+      cardinality, int numVertices, int partitionSize,
+      std::vector<int>& vertexOrdering);
+
+  /// Computes the edge ordering that sorts `size` edges with `cardinality`
+  /// endpoints each by their sorted endpoints. edgeOrdering[i] is the index
+  /// of the edge that moves to position i.
+  void edgeVertexSortReordering(const int* endpoints, int size, int 
+      cardinality, std::vector<int>& edgeOrdering);
+
+  /// Computes the edge ordering that `options.edgeOrder` selects for `size`
+  /// edges with `cardinality` endpoints each. edgeOrdering[i] is the index of
+  /// the edge that moves to position i. Edges with equal sort keys keep their
+  /// relative order.
+  void computeEdgeOrdering(const int* endpoints, int size, int cardinality,
+      const ReorderOptions& options, std::vector<int>& edgeOrdering);
+
+  /// Computes the edge ordering that `options.edgeOrder` selects for the
+  /// current endpoints of `edgeSet`.
+  void computeEdgeOrdering(const Set& edgeSet, const ReorderOptions& options,
+      std::vector<int>& edgeOrdering);
 
  
   template<typename T>
@@ -49,6 +184,104 @@ namespace simit {
     memcpy(data, newData, capacity * typeSize); free(newData);
   }
 
+  /// Cache simulated by analyzeOrdering: a set-associative LRU cache that
+  /// holds one `bytesPerVertex` array indexed by vertex.
+  struct CacheModel {
+    CacheModel() : cacheBytes(256*1024), lineBytes(64), associativity(8),
+        bytesPerVertex(8) {}
+
+    size_t cacheBytes;
+    size_t lineBytes;
+    size_t associativity;
+    size_t bytesPerVertex;
+  };
+
+  /// Reuse distances of a stream of cache line accesses. The reuse distance
+  /// of an access is the number of distinct lines accessed since the previous
+  /// access to the same line, so a fully associative LRU cache of `n` lines
+  /// hits exactly the accesses with a distance below `n`.
+  struct ReuseProfile {
+    ReuseProfile() : accesses(0), coldAccesses(0), meanDistance(0.0) {}
+
+    size_t accesses;
+
+    /// First accesses to a line, which have no reuse distance.
+    size_t coldAccesses;
+
+    /// histogram[0] counts the accesses with distance 0 and histogram[k] the
+    /// accesses with a distance in [2^(k-1), 2^k).
+    std::vector<size_t> histogram;
+
+    /// Mean distance of the accesses that are not cold.
+    double meanDistance;
+
+    /// Upper bound of the histogram bucket that holds the given fraction of
+    /// the reused accesses, e.g. 0.5 for the median.
+    size_t percentile(double fraction) const;
+
+    /// Fraction of all accesses that hit in a fully associative LRU cache of
+    /// `lines` lines, to the resolution of the histogram buckets.
+    double hitRate(size_t lines) const;
+  };
+  std::ostream& operator<<(std::ostream& os, const ReuseProfile& profile);
+
+  /// Locality of an edge set under a vertex and edge ordering.
+  struct OrderingReport {
+    OrderingReport() : bandwidth(0), averageSpan(0.0), accesses(0),
+        cacheMisses(0), seconds(0.0) {}
+
+    std::string name;
+
+    /// Largest difference between two endpoints of an edge.
+    int bandwidth;
+
+    /// Average difference between the largest and smallest endpoint of an
+    /// edge.
+    double averageSpan;
+
+    /// Endpoint loads and the simulated cache misses they cause when the
+    /// edges are visited in order.
+    size_t accesses;
+    size_t cacheMisses;
+
+    /// Reuse distances of the endpoint loads, in cache lines.
+    ReuseProfile reuse;
+
+    /// Time taken to compute the ordering.
+    double seconds;
+
+    double missRate() const {
+      return (accesses > 0) ? double(cacheMisses) / accesses : 0.0;
+    }
+  };
+  std::ostream& operator<<(std::ostream& os, const OrderingReport& report);
+
+  /// Reports the locality of `edgeSet` after renumbering its endpoints by
+  /// `vertexOrdering` (old to new indices) and visiting its edges in
+  /// `edgeOrdering` (edgeOrdering[i] is the edge visited i-th). Empty
+  /// orderings leave the current order unchanged.
+  OrderingReport analyzeOrdering(const Set& edgeSet,
+      const std::vector<int>& vertexOrdering,
+      const std::vector<int>& edgeOrdering,
+      const CacheModel& cache=CacheModel());
+
+  /// Reports the locality of the current order and of every heuristic that
+  /// applies to the sets (Hilbert requires a spatial field), each followed by
+  /// sorting the edges as reorder does, without modifying the sets.
+  std::vector<OrderingReport> compareOrderings(const Set& edgeSet,
+      const Set& vertexSet, const ReorderOptions& options=ReorderOptions(),
+      const CacheModel& cache=CacheModel());
+
+  /// Reports the locality of the current edge order and of every edge order
+  /// heuristic after renumbering the endpoints of `edgeSet` by
+  /// `vertexOrdering` (old to new indices, empty to keep the current
+  /// numbering), without modifying the set. `options` supplies the target
+  /// endpoint and the tile size.
+  std::vector<OrderingReport> compareEdgeOrders(const Set& edgeSet,
+      const std::vector<int>& vertexOrdering,
+      const ReorderOptions& options=ReorderOptions(),
+      const CacheModel& cache=CacheModel());
+
   namespace hilbert {
     
     typedef uint64_t vid_t;  // vertex id type
@@ -72,8 +305,18 @@ namespace simit {
 
     typedef std::pair<vid_t, vid_t> edge_t;
 
-    void hilbertReorder(Set& vertexSet, std::vector<int>& vertexOrdering, int 
-        vertexCount);
+    /// Computes the Hilbert vertex ordering (old to new indices) of the
+    /// vertex set's spatial field, which must be a float or double 3-vector.
+    void hilbertReorder(const Set& vertexSet, std::vector<int>& 
+        vertexOrdering, unsigned hilbertBits=8, unsigned numThreads=0);
+
+    /// Computes the Hilbert vertex ordering (old to new indices) of
+    /// `numVertices` points stored as consecutive xyz triples. Vertices with
+    /// the same Hilbert index keep their relative order. The indices are
+    /// computed and sorted in parallel.
+    void hilbertReorder(const double* coords, int numVertices, 
+        std::vector<int>& vertexOrdering, unsigned hilbertBits=8,
+        unsigned numThreads=0);
   } // namespace simit::hilbert
 
 } // namespace simit 
@@ -1,11 +1,14 @@
 #include "runtime.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <time.h>
 #include <chrono>
 #include <vector>
 
 #include "timers.h"
+#include "memory_accounting.h"
+#include "util/memory_pool.h"
 #include "stdio.h"
 
 #ifdef EIGEN
@@ -22,123 +25,45 @@ int loc(int v0, int v1, int *neighbors_start, int *neighbors) {
   return l;
 }
 
-double atan2_f64(double y, double x) {
-  return atan2(y, x);
-}
-
-float atan2_f32(float y, float x) {
-  double d_y = y;
-  double d_x = x;
-  return (float)atan2(d_y, d_x);
-}
-
-double tan_f64(double x) {
-  return tan(x);
-}
-
-float tan_f32(float x) {
-  double d_x = x;
-  return (float)tan(d_x);
-}
-
-double asin_f64(double x) {
-  return asin(x);
-}
-
-float asin_f32(float x) {
-  double d_x = x;
-  return (float)asin(d_x);
-}
-
-double acos_f64(double x) {
-  return acos(x);
-}
-
-float acos_f32(float x) {
-  double d_x = x;
-  return (float)acos(d_x);
-}
-
-double det3_f64(double * a){
-  return a[0] * (a[4]*a[8]-a[5]*a[7])
-       - a[1] * (a[3]*a[8]-a[5]*a[6])
-       + a[2] * (a[3]*a[7]-a[4]*a[6]);
-}
-
-float det3_f32(float * a){
-  return a[0] * (a[4]*a[8]-a[5]*a[7])
-       - a[1] * (a[3]*a[8]-a[5]*a[6])
-       + a[2] * (a[3]*a[7]-a[4]*a[6]);
-}
-
-void inv3_f64(double * a, double * inv){
-  double cof00 = a[4]*a[8]-a[5]*a[7];
-  double cof01 =-a[3]*a[8]+a[5]*a[6];
-  double cof02 = a[3]*a[7]-a[4]*a[6];
-
-  double cof10 =-a[1]*a[8]+a[2]*a[7];
-  double cof11 = a[0]*a[8]-a[2]*a[6];
-  double cof12 =-a[0]*a[7]+a[1]*a[6];
-
-  double cof20 = a[1]*a[5]-a[2]*a[4];
-  double cof21 =-a[0]*a[5]+a[2]*a[3];
-  double cof22 = a[0]*a[4]-a[1]*a[3];
-
-  double determ = a[0] * cof00 + a[1] * cof01 + a[2]*cof02;
-
-  determ = 1.0/determ;
-  inv[0] = cof00 * determ;
-  inv[1] = cof10 * determ;
-  inv[2] = cof20 * determ;
-
-  inv[3] = cof01 * determ;
-  inv[4] = cof11 * determ;
-  inv[5] = cof21 * determ;
-
-  inv[6] = cof02 * determ;
-  inv[7] = cof12 * determ;
-  inv[8] = cof22 * determ;
-}
-
-void inv3_f32(float * a, float * inv){
-  float cof00 = a[4]*a[8]-a[5]*a[7];
-  float cof01 =-a[3]*a[8]+a[5]*a[6];
-  float cof02 = a[3]*a[7]-a[4]*a[6];
-
-  float cof10 =-a[1]*a[8]+a[2]*a[7];
-  float cof11 = a[0]*a[8]-a[2]*a[6];
-  float cof12 =-a[0]*a[7]+a[1]*a[6];
-
-  float cof20 = a[1]*a[5]-a[2]*a[4];
-  float cof21 =-a[0]*a[5]+a[2]*a[3];
-  float cof22 = a[0]*a[4]-a[1]*a[3];
-
-  float determ = a[0] * cof00 + a[1] * cof01 + a[2]*cof02;
-
-  determ = 1.0/determ;
-  inv[0] = cof00 * determ;
-  inv[1] = cof10 * determ;
-  inv[2] = cof20 * determ;
-
-  inv[3] = cof01 * determ;
-  inv[4] = cof11 * determ;
-  inv[5] = cof21 * determ;
-
-  inv[6] = cof02 * determ;
-  inv[7] = cof12 * determ;
-  inv[8] = cof22 * determ;
+void simit_timer_start(void* timers, int id) {
+  if (timers != nullptr) {
+    static_cast<simit::ir::Timers*>(timers)->start(id);
+  }
 }
 
-double complexNorm_f64(double r, double i) {
-  return sqrt(r*r+i*i);
+void simit_timer_stop(void* timers, int id) {
+  if (timers != nullptr) {
+    static_cast<simit::ir::Timers*>(timers)->stop(id);
+  }
 }
 
-float complexNorm_f32(float r, float i) {
-  return sqrt(r*r+i*i);
+void* simit_buffer_allocate(void* pool, void* memory, const char* name,
+                            int bytes) {
+  void* buffer = (pool != nullptr)
+      ? static_cast<simit::util::MemoryPool*>(pool)->allocate(bytes)
+      : malloc(bytes);
+  if (memory != nullptr) {
+    static_cast<simit::MemoryAccounting*>(memory)->allocate(
+        simit::MemoryKind::Buffer, name, bytes);
+  }
+  return buffer;
 }
 
-void simitStoreTime(int i, double value) {
-  simit::ir::TimerStorage::getInstance().storeTime(i, value);
+void simit_buffer_free(void* pool, void* memory, const char* name,
+                       void* buffer) {
+  if (buffer == nullptr) {
+    return;
+  }
+  if (pool != nullptr) {
+    static_cast<simit::util::MemoryPool*>(pool)->free(buffer);
+  }
+  else {
+    free(buffer);
+  }
+  if (memory != nullptr) {
+    static_cast<simit::MemoryAccounting*>(memory)->free(
+        simit::MemoryKind::Buffer, name);
+  }
 }
 
 double simitClock() {
@@ -165,7 +90,9 @@ int spmm(int Bn,  int Bm,  int* Browptr, int* Bcolidx,
 
   SparseMatrix<Float,RowMajor> A(An, Am);
   A = B*C;
-  eigen2csr(A, An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
+  // Simit passes the arrays of the product computed in the previous
+  // iteration of a loop, or null arrays
+  eigen2csr(A, An, Am, Arowptr, Acolidx, Ann, Amm, Avals, true);
 #else
   ierror << "extern spmm requires Eigen";
 #endif
@@ -311,7 +238,7 @@ int lltmatsolve(void** solverPtr,
   SparseMatrix<Float> X(Xn, Xm);
   X = solver->solve(B);
   X = X.transpose();
-  eigen2csr<Float>(X, Xn, Xm, Xrowptr, Xcolidx, Xnn, Xmm, Xvals);
+  eigen2csr<Float>(X, Xn, Xm, Xrowptr, Xcolidx, Xnn, Xmm, Xvals, true);
 #else
   SOLVER_ERROR;
 #endif
@@ -4,6 +4,8 @@
 #include "ffi.h"
 #include <iostream>
 
+/// Allocates the arrays of a CSR matrix. The old values of the pointers are
+/// ignored, so they need not be initialized.
 template <typename Float>
 void mallocMatrix(int n,  int m,  int** rowptr, int** colidx,
                   int nn, int mm, Float** vals,
@@ -13,6 +15,21 @@ void mallocMatrix(int n,  int m,  int** rowptr, int** colidx,
   *vals = static_cast<Float*>(simit::ffi::simit_malloc(nnz * sizeof(Float)));
 }
 
+/// Allocates the arrays of a CSR matrix like mallocMatrix, but resizes the
+/// arrays the pointers already point to, which keeps them in place unless
+/// they grow. Each pointer must be null or point to a live array from
+/// simit_malloc or simit_realloc, such as the arrays of the same product in
+/// the previous iteration of a loop, which Simit starts out null.
+template <typename Float>
+void reallocMatrix(int n,  int m,  int** rowptr, int** colidx,
+                   int nn, int mm, Float** vals,
+                   int nnz) {
+  using simit::ffi::simit_realloc;
+  *rowptr = static_cast<int*>(simit_realloc(*rowptr, (n/nn+1) * sizeof(int)));
+  *colidx = static_cast<int*>(simit_realloc(*colidx, nnz * sizeof(int)));
+  *vals = static_cast<Float*>(simit_realloc(*vals, nnz * sizeof(Float)));
+}
+
 #ifdef EIGEN
 #include <Eigen/Core>
 #include <Eigen/Dense>
@@ -43,14 +60,21 @@ csr2eigen(int n, int m, int* rowptr, int* colidx, int nn, int mm, Float* vals) {
   return mat;
 }
 
+/// Copies `mat` to a CSR matrix. The arrays are allocated with mallocMatrix,
+/// or with reallocMatrix if `reuseArrays` is true.
 template<typename Float,int Major>
 void eigen2csr(Eigen::SparseMatrix<Float,Major> mat,
                int n, int m, int** rowptr, int** colidx,
-               int nn, int mm, Float** vals) {
+               int nn, int mm, Float** vals, bool reuseArrays=false) {
   mat.makeCompressed();
 
   auto nnz = mat.nonZeros();
-  mallocMatrix(n, m, rowptr, colidx, nn, mm, vals, nnz);
+  if (reuseArrays) {
+    reallocMatrix(n, m, rowptr, colidx, nn, mm, vals, nnz);
+  }
+  else {
+    mallocMatrix(n, m, rowptr, colidx, nn, mm, vals, nnz);
+  }
 
   // copy rowptr
   auto matrowptr = mat.outerIndexPtr();
@@ -1,171 +1,526 @@
 #include "timers.h"
 
-#include "storage.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <iomanip>
+#include <map>
+
 #include "ir_builder.h"
 #include "ir_rewriter.h"
-#include "ir_transforms.h"
-#include "inline.h"
-
-#include "ir.h"
+#include "ir_printer.h"
 #include "intrinsics.h"
+#include "util/parallel.h"
 
 using namespace std;
 
 namespace simit {
 namespace ir {
 
-void printTimes() {
-  const int LINE_LIMIT = 80;
-  double percentageSum = 0.0;
-
-  for (auto line: simit::ir::TimerStorage::getInstance().getSourceLines()) {
-    size_t first = line.find_first_not_of(' ');
-    size_t last = line.find_last_not_of('\n');
-    std::string test = "";
-    if ( first != last ) {
-      test = line.substr(first, (last-first+1));
-      line = line.substr(0, (last+1));
-    }
-    int index = simit::ir::TimerStorage::getInstance().getTimedLineIndex(test);
-    if ( index >= 0) {
-      double percentage= TimerStorage::getInstance().getTimingPercentage(index);
-      percentageSum += percentage;
-      unsigned long long int timerCount =
-          TimerStorage::getInstance().getCounter(index);
-      if (line.length() < LINE_LIMIT) {
-        line.append(LINE_LIMIT - line.length(), ' ');
-        printf("%s (%f%s, %llu)\n", line.c_str(), percentage , "%", timerCount);
-      } else {
-        printf("%s (%f%s, %llu)\n", line.substr(0,LINE_LIMIT).c_str(),
-               percentage, "%", timerCount);
-        for (unsigned x=LINE_LIMIT; x < line.length(); x+= LINE_LIMIT) {
-          printf("\t %s\n",line.substr(x, LINE_LIMIT).c_str());
-        }
-      }
-    } else {
-      if (line.length() < LINE_LIMIT) {
-        line.append(LINE_LIMIT - line.length(), ' ');
-        printf("%s\n", line.c_str());
-      } else {
-        printf("%s\n", line.substr(0,LINE_LIMIT).c_str());
-        for (unsigned x=LINE_LIMIT; x < line.length(); x+= LINE_LIMIT) {
-          printf("\t %s\n",line.substr(x, LINE_LIMIT).c_str());
-        }
-      }
+// class CycleClock
+namespace {
+struct CalibrationStart {
+  CalibrationStart()
+      : time(chrono::steady_clock::now()), ticks(CycleClock::now()) {}
+  chrono::steady_clock::time_point time;
+  uint64_t ticks;
+};
+const CalibrationStart calibrationStart;
+}
+
+double CycleClock::secondsPerTick() {
+  static const double calibrated = []() {
+    const chrono::duration<double> minInterval(0.01);
+    chrono::duration<double> interval;
+    uint64_t ticks;
+    do {
+      ticks = now();
+      interval = chrono::steady_clock::now() - calibrationStart.time;
+    } while (interval < minInterval);
+    return interval.count() / (ticks - calibrationStart.ticks);
+  }();
+  return calibrated;
+}
+
+
+// class Timers
+static atomic<uint64_t> nextGeneration(1);
+
+Timers::Timers(unsigned numThreads)
+    : numSlots(util::numThreads(numThreads)), stride(0), generation(0),
+      tracing(false), traces(numSlots), counting(false) {
+  reset();
+}
+
+int Timers::addTimer(const std::string& label, int parent) {
+  iassert(parent < (int)timers.size());
+  timers.push_back({label, parent, false});
+  reset();
+  return timers.size() - 1;
+}
+
+int Timers::findTimer(const std::string& label) const {
+  for (size_t id=0; id < timers.size(); ++id) {
+    if (timers[id].label == label) {
+      return id;
     }
   }
+  return -1;
+}
 
-  printf("Total Time: %f (seconds)\n",
-         simit::ir::TimerStorage::getInstance().getTotalTime() / 1000000.0);
+void Timers::addSourceLines(std::istream& is) {
+  for (string line; getline(is, line); sourceLines.push_back(line));
 }
 
-// Singleton
-class InsertTimers : public IRRewriter {
-  using IRRewriter::visit;
-  public: 
-    static InsertTimers& getInstance() {
-      static InsertTimers instance; 
-      return instance;
-    }
-    
-    void visit(const TensorWrite *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
-    }
+void Timers::reset() {
+  // Pad every slot to whole cache lines plus one, so that no two threads
+  // write to the same line
+  const size_t countersPerLine = 64 / sizeof(Counter);
+  stride = (timers.size() + countersPerLine-1) / countersPerLine
+           * countersPerLine + countersPerLine;
+  counters.assign(numSlots * stride, Counter());
+  generation = nextGeneration++;
+  for (Trace& trace : traces) {
+    trace.size = 0;
+    trace.dropped = 0;
+  }
+  if (counting) {
+    events.assign(numSlots * stride, EventCounter());
+  }
+}
+
+void Timers::enableTracing(size_t maxSpans) {
+  // Touch the buffers now so that recording does not page fault
+  for (Trace& trace : traces) {
+    trace.spans.assign(maxSpans, Span());
+    trace.size = 0;
+    trace.dropped = 0;
+  }
+  tracing = true;
+}
+
+void Timers::disableTracing() {
+  tracing = false;
+}
 
-    void visit(const FieldWrite *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+bool Timers::enableCounters() {
+  if (!util::PerfCounters::isSupported()) {
+    return false;
+  }
+  counting = true;
+  events.assign(numSlots * stride, EventCounter());
+  return true;
+}
+
+void Timers::disableCounters() {
+  counting = false;
+}
+
+/// The perf counters of the calling thread. They count the thread that opens
+/// them, so every thread opens its own on first use, and they are shared by
+/// all Timers since only differences between reads are accumulated.
+static const util::PerfCounters& threadPerfCounters() {
+  static thread_local util::PerfCounters perf;
+  return perf;
+}
+
+void Timers::startEvents(int id) {
+  const util::PerfCounters& perf = threadPerfCounters();
+  if (perf.isValid()) {
+    perf.read(&events[threadSlot() * stride + id].start);
+  }
+}
+
+void Timers::stopEvents(int id) {
+  const util::PerfCounters& perf = threadPerfCounters();
+  if (!perf.isValid()) {
+    return;
+  }
+  util::PerfSample now;
+  perf.read(&now);
+  EventCounter& counter = events[threadSlot() * stride + id];
+  for (int i=0; i < util::PerfSample::NumEvents; ++i) {
+    counter.total.values[i] += now.values[i] - counter.start.values[i];
+  }
+}
+
+uint64_t Timers::getEventCount(int id, util::PerfEvent event) const {
+  if (events.empty()) {
+    return 0;
+  }
+  uint64_t sum = 0;
+  for (size_t slot=0; slot < numSlots; ++slot) {
+    sum += events[slot * stride + id].total[event];
+  }
+  return sum;
+}
+
+double Timers::getIPC(int id) const {
+  uint64_t cycles = getEventCount(id, util::PerfEvent::Cycles);
+  return (cycles > 0)
+      ? (double)getEventCount(id, util::PerfEvent::Instructions) / cycles
+      : 0.0;
+}
+
+double Timers::getLLCMissRate(int id) const {
+  uint64_t references = getEventCount(id, util::PerfEvent::LLCReferences);
+  return (references > 0)
+      ? (double)getEventCount(id, util::PerfEvent::LLCMisses) / references
+      : 0.0;
+}
+
+uint64_t Timers::getMemoryBytes(int id) const {
+  const uint64_t LINE_BYTES = 64;
+  return getEventCount(id, util::PerfEvent::LLCMisses) * LINE_BYTES;
+}
+
+size_t Timers::getDroppedSpans() const {
+  size_t dropped = 0;
+  for (const Trace& trace : traces) {
+    dropped += trace.dropped;
+  }
+  return dropped;
+}
+
+uint64_t Timers::sumCounters(int id, uint64_t Counter::*field) const {
+  uint64_t sum = 0;
+  for (size_t slot=0; slot < numSlots; ++slot) {
+    sum += counters[slot * stride + id].*field;
+  }
+  return sum;
+}
+
+uint64_t Timers::getCount(int id) const {
+  return sumCounters(id, &Counter::count);
+}
+
+double Timers::getSeconds(int id) const {
+  return sumCounters(id, &Counter::ticks) * CycleClock::secondsPerTick();
+}
+
+/// Ticks that a start/stop pair adds to the time of the enclosing timer.
+static uint64_t timerOverheadTicks() {
+  static const uint64_t overhead = []() {
+    Timers timers(1);
+    timers.addTimer("overhead");
+    uint64_t best = UINT64_MAX;
+    for (int i=0; i < 1000; ++i) {
+      uint64_t begin = CycleClock::now();
+      timers.start(0);
+      timers.stop(0);
+      best = min(best, CycleClock::now() - begin);
     }
-    
-    void visit(const Map *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+    return best;
+  }();
+  return overhead;
+}
+
+double Timers::getSelfSeconds(int id) const {
+  int64_t ticks = sumCounters(id, &Counter::ticks);
+  for (size_t child=id+1; child < timers.size(); ++child) {
+    if (timers[child].parent == id) {
+      ticks -= sumCounters(child, &Counter::ticks) +
+               getCount(child) * timerOverheadTicks();
     }
-    
-    void visit(const Store *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+  }
+  return max<int64_t>(ticks, 0) * CycleClock::secondsPerTick();
+}
+
+double Timers::getTotalSeconds() const {
+  double total = 0.0;
+  for (size_t id=0; id < timers.size(); ++id) {
+    if (timers[id].parent < 0 && !timers[id].called) {
+      total += getSeconds(id);
     }
-    
-    void visit(const CallStmt *op) {
-      if (op->callee.getKind() == Func::Intrinsic) { 
-        Var timeStartVar = initTimer(util::toString(*op),stmt);
-        stmt = Block::make(stmt,op);
-        storeTimer(stmt, timeStartVar);
-      } else {
-        stmt = Block::make(stmt, op);
+  }
+  return total;
+}
+
+static string trim(const string& line) {
+  size_t first = line.find_first_not_of(" \t");
+  size_t last = line.find_last_not_of(" \t\n");
+  return (first == string::npos) ? "" : line.substr(first, last-first+1);
+}
+
+void Timers::print(std::ostream& os) const {
+  const size_t LINE_LIMIT = 80;
+  const double total = getTotalSeconds();
+
+  // Timers are matched to the source lines in id order
+  map<string, deque<int>> timersByLabel;
+  for (size_t id=0; id < timers.size(); ++id) {
+    timersByLabel[timers[id].label].push_back(id);
+  }
+
+  char annotation[128];
+  for (string line : sourceLines) {
+    auto timer = timersByLabel.find(trim(line));
+    if (timer != timersByLabel.end() && !timer->second.empty()) {
+      int id = timer->second.front();
+      timer->second.pop_front();
+      double percentage = (total > 0.0) ? getSelfSeconds(id)*100.0/total : 0.0;
+      if (counting) {
+        snprintf(annotation, sizeof(annotation),
+                 " (%f%%, %llu, IPC %.2f, LLC miss %.1f%%)", percentage,
+                 (unsigned long long)getCount(id), getIPC(id),
+                 getLLCMissRate(id)*100.0);
       }
+      else {
+        snprintf(annotation, sizeof(annotation), " (%f%%, %llu)", percentage,
+                 (unsigned long long)getCount(id));
+      }
+    }
+    else {
+      annotation[0] = '\0';
     }
-    
-    void visit(const AssignStmt *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+
+    if (line.length() < LINE_LIMIT) {
+      line.append(LINE_LIMIT - line.length(), ' ');
+      os << line << annotation << endl;
     }
-    
-    void visit(const IfThenElse *op) {
-      Expr start = rewrite(op->condition);
-      Stmt thenBody = rewrite(op->thenBody);
-      Stmt elseBody = rewrite(op->elseBody);
-      
-      stmt = IfThenElse::make(op->condition, thenBody, elseBody);
+    else {
+      os << line.substr(0, LINE_LIMIT) << annotation << endl;
+      for (size_t x=LINE_LIMIT; x < line.length(); x+=LINE_LIMIT) {
+        os << "\t " << line.substr(x, LINE_LIMIT) << endl;
+      }
     }
-    
-    void visit(const ForRange *op) {
-      Expr start = rewrite(op->start);
-      Expr end = rewrite(op->end);
-      Stmt body = rewrite(op->body);
-      
-      stmt = ForRange::make(op->var, start, end, body);
+  }
+  os << "Total Time: " << total << " (seconds)" << endl;
+}
+
+void Timers::writeTrace(std::ostream& os) const {
+  writeChromeTrace(os, {this});
+}
+
+void Timers::writeSummary(std::ostream& os) const {
+  writeTimerSummary(os, {this});
+}
+
+static void writeJSONString(std::ostream& os, const string& str) {
+  os << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':  os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      case '\n': os << "\\n"; break;
+      case '\t': os << "\\t"; break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          os << escaped;
+        }
+        else {
+          os << c;
+        }
     }
-    
-    void visit(const For *op) {
-      Stmt body = rewrite(op->body);
-      
-      stmt = For::make(op->var, op->domain, body);
+  }
+  os << '"';
+}
+
+void writeChromeTrace(std::ostream& os,
+                      const std::vector<const Timers*>& timers) {
+  uint64_t firstTick = UINT64_MAX;
+  for (const Timers* t : timers) {
+    for (const Timers::Trace& trace : t->traces) {
+      for (size_t i=0; i < trace.size; ++i) {
+        firstTick = min(firstTick, trace.spans[i].begin);
+      }
     }
-  
-    Var getTimeVar() {
-      return timeStartVar;
+  }
+  const double microsecondsPerTick = CycleClock::secondsPerTick() * 1e6;
+
+  const ios::fmtflags flags = os.flags();
+  const streamsize precision = os.precision();
+  os << fixed << setprecision(3);
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&]() {
+    os << (first ? "\n" : ",\n");
+    first = false;
+  };
+  for (size_t pid=0; pid < timers.size(); ++pid) {
+    const Timers* t = timers[pid];
+    separator();
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+       << ",\"args\":{\"name\":";
+    writeJSONString(os, t->getName());
+    os << "}}";
+    for (size_t tid=0; tid < t->traces.size(); ++tid) {
+      const Timers::Trace& trace = t->traces[tid];
+      for (size_t i=0; i < trace.size; ++i) {
+        const Timers::Span& span = trace.spans[i];
+        separator();
+        os << "{\"name\":";
+        writeJSONString(os, t->getLabel(span.id));
+        os << ",\"cat\":\"simit\",\"ph\":\"X\",\"pid\":" << pid
+           << ",\"tid\":" << tid
+           << ",\"ts\":" << (span.begin - firstTick) * microsecondsPerTick
+           << ",\"dur\":" << (span.end - span.begin) * microsecondsPerTick
+           << ",\"args\":{\"id\":" << span.id << "}}";
+      }
     }
-  private:
-    int counter = 0;
-    Var timeStartVar = Var("simit_internal_time_var", Float);
-    InsertTimers() {};
-    InsertTimers(InsertTimers const&)    = delete;
-    void operator=(InsertTimers const&)  = delete;
-
-    Var initTimer(string line, Stmt& stmt) {
-      TimerStorage::getInstance().addTimedLine(line);
-      Stmt timeStartStmt =
-          CallStmt::make({getTimeVar()}, intrinsics::clock(), {});
-      stmt = Block::make(timeStartStmt, stmt);
-      return timeStartVar;
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}" << endl;
+  os.flags(flags);
+  os.precision(precision);
+}
+
+void writeTimerSummary(std::ostream& os,
+                       const std::vector<const Timers*>& timers) {
+  const ios::fmtflags flags = os.flags();
+  const streamsize precision = os.precision();
+  os << scientific << setprecision(9);
+  os << "{\"functions\":[";
+  for (size_t f=0; f < timers.size(); ++f) {
+    const Timers* t = timers[f];
+    os << (f == 0 ? "\n" : ",\n") << "{\"name\":";
+    writeJSONString(os, t->getName());
+    os << ",\"totalSeconds\":" << t->getTotalSeconds()
+       << ",\"droppedSpans\":" << t->getDroppedSpans()
+       << ",\"timers\":[";
+    for (size_t id=0; id < t->getNumTimers(); ++id) {
+      os << (id == 0 ? "\n" : ",\n") << "  {\"id\":" << id << ",\"label\":";
+      writeJSONString(os, t->getLabel(id));
+      os << ",\"parent\":" << t->getParent(id)
+         << ",\"count\":" << t->getCount(id)
+         << ",\"seconds\":" << t->getSeconds(id)
+         << ",\"selfSeconds\":" << t->getSelfSeconds(id);
+      if (t->isCounting()) {
+        os << ",\"cycles\":" << t->getEventCount(id, util::PerfEvent::Cycles)
+           << ",\"instructions\":"
+           << t->getEventCount(id, util::PerfEvent::Instructions)
+           << ",\"llcReferences\":"
+           << t->getEventCount(id, util::PerfEvent::LLCReferences)
+           << ",\"llcMisses\":"
+           << t->getEventCount(id, util::PerfEvent::LLCMisses)
+           << ",\"memoryBytes\":" << t->getMemoryBytes(id)
+           << ",\"ipc\":" << t->getIPC(id)
+           << ",\"llcMissRate\":" << t->getLLCMissRate(id);
+      }
+      os << "}";
     }
+    os << "]}";
+  }
+  os << "\n]}" << endl;
+  os.flags(flags);
+  os.precision(precision);
+}
+
+unsigned Timers::threadIndex() {
+  static atomic<unsigned> nextIndex(0);
+  static thread_local unsigned index = nextIndex++;
+  return index;
+}
+
+
+// Timer insertion
+class InsertTimers : public IRRewriter {
+public:
+  InsertTimers(Timers* timers) : timers(timers), parent(-1) {}
 
-    void storeTimer(Stmt& stmt, Var& timeStartVar) {
-      Var clock("clock", Float);
-      Stmt clockDecl = VarDecl::make(clock);
-      Stmt clockStmt = CallStmt::make({clock}, intrinsics::clock(), {});
-      Expr subtraction = Sub::make(clock, VarExpr::make(timeStartVar));
-      Stmt store = CallStmt::make({}, intrinsics::storeTime(),
-          {counter, subtraction});
-      stmt = Block::make({clockDecl, clockStmt, stmt, store});
-      counter++;
+  Func insert(Func func) {
+    int id = timers->addTimer(getLabel(func));
+    return Func(func, timed(rewriteBody(func.getBody(), id), id));
+  }
+
+private:
+  Timers* timers;
+
+  /// Timer of the innermost enclosing loop or function
+  int parent;
+
+  using IRRewriter::visit;
+
+  void visit(const TensorWrite *op) {
+    stmt = timed(op);
+  }
+
+  void visit(const FieldWrite *op) {
+    stmt = timed(op);
+  }
+
+  void visit(const Map *op) {
+    stmt = timed(op);
+  }
+
+  void visit(const Store *op) {
+    stmt = timed(op);
+  }
+
+  // The time of an internal callee is in the timer of every call to it, so
+  // its own function timer is left out of the total
+  void visit(const CallStmt *op) {
+    if (op->callee.getKind() == Func::Internal) {
+      int callee = timers->findTimer(getLabel(op->callee));
+      if (callee >= 0 && timers->getParent(callee) < 0) {
+        timers->setCalled(callee);
+      }
     }
+    stmt = timed(op);
+  }
+
+  void visit(const AssignStmt *op) {
+    stmt = timed(op);
+  }
+
+  void visit(const IfThenElse *op) {
+    Stmt thenBody = rewrite(op->thenBody);
+    Stmt elseBody = rewrite(op->elseBody);
+    stmt = IfThenElse::make(op->condition, thenBody, elseBody);
+  }
+
+  void visit(const ForRange *op) {
+    int id = addTimer(op);
+    Stmt body = rewriteBody(op->body, id);
+    stmt = timed(ForRange::make(op->var, op->start, op->end, body), id);
+  }
+
+  void visit(const For *op) {
+    int id = addTimer(op);
+    Stmt body = rewriteBody(op->body, id);
+    stmt = timed(For::make(op->var, op->domain, body), id);
+  }
+
+  void visit(const While *op) {
+    int id = addTimer(op);
+    Stmt body = rewriteBody(op->body, id);
+    stmt = timed(While::make(op->condition, body), id);
+  }
+
+  /// The first printed line of `op`.
+  template <typename T>
+  static string getLabel(const T& op) {
+    string label = util::toString(op);
+    return trim(label.substr(0, label.find('\n')));
+  }
+
+  /// Register a timer labeled with the first printed line of `op`.
+  int addTimer(Stmt op) {
+    return timers->addTimer(getLabel(op), parent);
+  }
+
+  Stmt rewriteBody(Stmt body, int id) {
+    int outer = parent;
+    parent = id;
+    body = rewrite(body);
+    parent = outer;
+    return body;
+  }
+
+  Stmt timed(Stmt op, int id) {
+    return Block::make({CallStmt::make({}, intrinsics::startTimer(), {id}), op,
+                        CallStmt::make({}, intrinsics::stopTimer(), {id})});
+  }
+
+  Stmt timed(Stmt op) {
+    return timed(op, addTimer(op));
+  }
 };
 
-Func insertTimers(Func func) {
-  Var timeStartVar = InsertTimers::getInstance().getTimeVar();
-  Func timerFunc = Func(func, Block::make(VarDecl::make(timeStartVar), 
-        func.getBody()));
-  timerFunc = InsertTimers::getInstance().rewrite(timerFunc);
-  return timerFunc;
+Func insertTimers(Func func, Timers* timers) {
+  return InsertTimers(timers).insert(func);
 }
 
 }}
@@ -1,83 +1,283 @@
 #ifndef SIMIT_TIMERS_H
 #define SIMIT_TIMERS_H
 
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 #include "ir.h"
+#include "util/perf_counters.h"
 
 namespace simit {
 namespace ir {
 
-void printTimes();
-Func insertTimers(Func func);
+class Timers;
+
+/// Insert timers around the body of `func` and its statements, registering
+/// one timer per timed statement in `timers`. The function timer is the
+/// parent of the statement timers, and loops are the parents of the timers
+/// in their bodies. Calls to internal functions are timed like other
+/// statements, so the timers of callees, which must be inserted first, are
+/// marked as called.
+Func insertTimers(Func func, Timers* timers);
 
-// Singleton
-class TimerStorage {
+/// Reads the processor's time stamp counter, or a nanosecond steady clock on
+/// processors without one.
+class CycleClock {
 public:
-  static TimerStorage& getInstance() {
-    static TimerStorage instance; 
-    return instance;
+  static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
   }
 
-  inline std::vector<std::string>& getSourceLines() {
-    return sourceLines;
-  }
+  /// Seconds per tick, calibrated against the steady clock on the first call
+  /// over the time since the program started (at least 10 ms, waiting if
+  /// necessary).
+  static double secondsPerTick();
+};
 
-  inline void addSourceLines(std::stringstream& ss) {
-    for (std::string line; getline(ss, line); sourceLines.push_back(line));
-  }
+/// The per-statement timers of a compiled function. Every timer has an id
+/// assigned when it is inserted at compile time, and the generated code
+/// brackets the timed statement with start(id) and stop(id). The counters
+/// are preallocated with one padded slot per thread, so timing a statement
+/// costs two counter reads and touches no shared state.
+///
+/// Timers nest: a loop timer is the parent of the timers in its body, and
+/// the self time of a timer excludes the time of its children, including
+/// the overhead of timing them.
+///
+/// With tracing enabled, every stop also records the span of the statement
+/// in a preallocated per-thread buffer, which writeChromeTrace exports.
+///
+/// With counters enabled, every start and stop also reads the hardware
+/// performance counters of the calling thread (see util::PerfCounters), so
+/// that each statement reports its instructions per cycle and last-level
+/// cache miss rate. Reading them costs a system call, which inflates the
+/// self time of the enclosing timers.
+class Timers {
+public:
+  /// Create timers with counter slots for `numThreads` threads (0 uses the
+  /// hardware concurrency). Threads are assigned to slots round-robin, so
+  /// more threads than slots may race on their counters.
+  explicit Timers(unsigned numThreads=0);
 
-  inline void addTimedLine(std::string line) {
-    timedLines.push_back(line);
-  }
+  /// Name of the timed function, used in traces and summaries.
+  const std::string& getName() const {return name;}
+  void setName(const std::string& name) {this->name = name;}
+
+  /// Register a timer and return its id. `parent` is the id of the enclosing
+  /// timer, or -1.
+  int addTimer(const std::string& label, int parent=-1);
+
+  size_t getNumTimers() const {return timers.size();}
+  const std::string& getLabel(int id) const {return timers[id].label;}
+  int getParent(int id) const {return timers[id].parent;}
+
+  /// The id of the first timer labeled `label`, or -1.
+  int findTimer(const std::string& label) const;
 
-  inline int getTimedLineIndex(std::string line) {
-    size_t pos = find(timedLines.begin(), timedLines.end(),
-        line.c_str()) - timedLines.begin();
-    if (pos >= timedLines.size()){
-      pos = -1;
+  /// Mark timer `id` as the timer of a function that timed statements call.
+  /// Its time is already in the timers of the calls, so getTotalSeconds
+  /// leaves it out.
+  void setCalled(int id) {timers[id].called = true;}
+  bool isCalled(int id) const {return timers[id].called;}
+
+  /// Add the lines of the printed function that the report annotates.
+  void addSourceLines(std::istream& is);
+
+  inline void start(int id) {
+    if (counting) {
+      startEvents(id);
     }
-    return pos;
+    threadCounters()[id].start = CycleClock::now();
   }
 
-  inline void storeTime(size_t index, double time) {
-    while (timerCount.size() < index + 1) {
-      timerCount.push_back(0);
-      timerSums.push_back(0);
+  inline void stop(int id) {
+    const uint64_t time = CycleClock::now();
+    const size_t slot = threadSlot();
+    Counter& counter = counters[slot * stride + id];
+    counter.ticks += time - counter.start;
+    counter.count += 1;
+    if (tracing) {
+      traces[slot].record(id, counter.start, time);
+    }
+    if (counting) {
+      stopEvents(id);
     }
-    timerCount[index] += 1;
-    timerSums[index] += time;
   }
 
-  inline double getTime(int index) {
-    return timerSums[index];
-  }
+  /// Record the span of every timed statement from now on, keeping at most
+  /// `maxSpans` spans per thread. Later spans are counted as dropped.
+  void enableTracing(size_t maxSpans=1<<16);
+  void disableTracing();
+  bool isTracing() const {return tracing;}
 
-  inline unsigned long long int getCounter(int index) {
-    return timerCount[index];
-  }
+  /// Count hardware events in every timed statement from now on. Returns
+  /// false, leaving counting disabled, if the counters cannot be opened in
+  /// this process (e.g. in a container without access to the PMU).
+  bool enableCounters();
+  void disableCounters();
+  bool isCounting() const {return counting;}
+
+  /// Zero all counters and discard the recorded spans.
+  void reset();
+
+  /// Number of times timer `id` was stopped, over all threads.
+  uint64_t getCount(int id) const;
+
+  /// Time spent in the statement of timer `id`, including its children.
+  double getSeconds(int id) const;
+
+  /// Time spent in the statement of timer `id`, excluding its children.
+  double getSelfSeconds(int id) const;
+
+  /// Time spent in all timed statements: the time of the timers without a
+  /// parent, except those of called functions.
+  double getTotalSeconds() const;
+
+  /// Number of `event`s in the statement of timer `id`, including its
+  /// children, or 0 if the event was not counted.
+  uint64_t getEventCount(int id, util::PerfEvent event) const;
+
+  /// Instructions per cycle of timer `id`, or 0 if not counted.
+  double getIPC(int id) const;
 
-  inline double getTotalTime() {
-    double sum = 0;
-    for(auto const &time : timerSums) {
-      sum += time;
+  /// Fraction of last-level cache references of timer `id` that missed, or
+  /// 0 if not counted.
+  double getLLCMissRate(int id) const;
+
+  /// Bytes timer `id` read from memory, estimated as one cache line per
+  /// last-level cache miss.
+  uint64_t getMemoryBytes(int id) const;
+
+  /// Print the function's source lines, annotating every timed line with
+  /// the percentage of the total time spent in it (self time) and the number
+  /// of times it ran.
+  void print(std::ostream& os) const;
+
+  /// Write the recorded spans as Chrome trace-event JSON. See
+  /// writeChromeTrace.
+  void writeTrace(std::ostream& os) const;
+
+  /// Write the count and times of every timer as JSON. See
+  /// writeTimerSummary.
+  void writeSummary(std::ostream& os) const;
+
+  /// Number of spans that did not fit in the trace buffers.
+  size_t getDroppedSpans() const;
+
+private:
+  friend void writeChromeTrace(std::ostream&,
+                               const std::vector<const Timers*>&);
+
+  struct Counter {
+    uint64_t start;
+    uint64_t ticks;
+    uint64_t count;
+    uint64_t padding;
+  };
+
+  struct Timer {
+    std::string label;
+    int parent;
+    bool called;
+  };
+
+  struct Span {
+    int id;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  /// Spans recorded by the threads of one counter slot
+  struct Trace {
+    std::vector<Span> spans;
+    size_t size;
+    size_t dropped;
+    char padding[64];
+
+    inline void record(int id, uint64_t begin, uint64_t end) {
+      if (size < spans.size()) {
+        spans[size++] = {id, begin, end};
+      }
+      else {
+        ++dropped;
+      }
+    }
+  };
+
+  std::string name;
+  std::vector<Timer> timers;
+  std::vector<std::string> sourceLines;
+
+  /// Counter slots of all threads, `stride` counters apart
+  std::vector<Counter> counters;
+  size_t numSlots;
+  size_t stride;
+
+  /// Identifies the current counter allocation in the thread-local caches
+  uint64_t generation;
+
+  /// Span buffers of all counter slots
+  bool tracing;
+  std::vector<Trace> traces;
+
+  struct EventCounter {
+    util::PerfSample start;
+    util::PerfSample total;
+  };
+
+  /// Hardware event counts of all counter slots, laid out like `counters`
+  bool counting;
+  std::vector<EventCounter> events;
+
+  uint64_t sumCounters(int id, uint64_t Counter::*field) const;
+
+  void startEvents(int id);
+  void stopEvents(int id);
+
+  inline size_t threadSlot() {
+    static thread_local uint64_t cachedGeneration = 0;
+    static thread_local size_t cachedSlot = 0;
+    if (cachedGeneration != generation) {
+      cachedSlot = threadIndex() % numSlots;
+      cachedGeneration = generation;
     }
-    return sum;
+    return cachedSlot;
   }
 
-  inline double getTimingPercentage(int index) {
-    return getTime(index) * 100.0 / getTotalTime(); 
+  inline Counter* threadCounters() {
+    return &counters[threadSlot() * stride];
   }
-  
-  private:
-    std::vector<std::string> sourceLines;
-    std::vector<std::string> timedLines;
-    std::vector<double> timerSums;
-    std::vector<unsigned long long int> timerCount;
-
-    TimerStorage() {};
-    TimerStorage(TimerStorage const&)    = delete;
-    void operator=(TimerStorage const&)  = delete;
+
+  /// Process-wide index of the calling thread
+  static unsigned threadIndex();
 };
 
+/// Write the spans recorded by `timers` as Chrome trace-event JSON, which
+/// trace viewers such as chrome://tracing and Perfetto load. Every Timers
+/// object is a process named after its function, every counter slot a
+/// thread, and every span a complete event named after its statement, with
+/// times in microseconds since the first span.
+void writeChromeTrace(std::ostream& os,
+                      const std::vector<const Timers*>& timers);
+
+/// Write the count, time and self time of every timer of `timers` as JSON,
+/// grouped by function, for comparing runs.
+void writeTimerSummary(std::ostream& os,
+                       const std::vector<const Timers*>& timers);
+
 }}
 
 #endif
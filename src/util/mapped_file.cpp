@@ -0,0 +1,82 @@
+#include "mapped_file.h"
+
+#include <cstdlib>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace simit {
+namespace util {
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+int MappedFile::open(const std::string& filename) {
+  close();
+#ifndef _WIN32
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  size = st.st_size;
+  if (size == 0) {
+    ::close(fd);
+    return 0;
+  }
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr != MAP_FAILED) {
+    madvise(addr, size, MADV_SEQUENTIAL);
+    data = static_cast<char*>(addr);
+    mapped = true;
+    return 0;
+  }
+  size = 0;
+#endif
+
+  // Fall back to reading the whole file
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in.good()) {
+    return -1;
+  }
+  size = in.tellg();
+  in.seekg(0);
+  data = static_cast<char*>(malloc(size > 0 ? size : 1));
+  in.read(data, size);
+  if (!in.good() && size > 0) {
+    close();
+    return -1;
+  }
+  return 0;
+}
+
+void MappedFile::close() {
+  if (data != nullptr) {
+#ifndef _WIN32
+    if (mapped) {
+      munmap(data, size);
+    }
+    else {
+      free(data);
+    }
+#else
+    free(data);
+#endif
+  }
+  data = nullptr;
+  size = 0;
+  mapped = false;
+}
+
+}}
@@ -0,0 +1,34 @@
+#ifndef SIMIT_UTIL_MAPPED_FILE_H
+#define SIMIT_UTIL_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#include "interfaces/uncopyable.h"
+
+namespace simit {
+namespace util {
+
+/// A read-only view of a whole file. The file is memory-mapped where the
+/// platform supports it, and read into a heap buffer otherwise.
+class MappedFile : interfaces::Uncopyable {
+public:
+  MappedFile() : data(nullptr), size(0), mapped(false) {}
+  ~MappedFile();
+
+  /// Map the file, returning 0 on success and -1 if it could not be read.
+  int open(const std::string& filename);
+  void close();
+
+  const char* begin() const {return data;}
+  const char* end() const {return data + size;}
+  size_t getSize() const {return size;}
+
+private:
+  char* data;
+  size_t size;
+  bool mapped;
+};
+
+}}
+#endif
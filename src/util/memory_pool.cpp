@@ -0,0 +1,115 @@
+#include "memory_pool.h"
+
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "error.h"
+
+namespace simit {
+namespace util {
+
+static size_t roundUp(size_t bytes, size_t multiple) {
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+MemoryPool::MemoryPool(bool hugePages)
+    : hugePages(hugePages), allocatedBytes(0), cachedBytes(0),
+      numAllocations(0), numReuses(0) {
+}
+
+MemoryPool::~MemoryPool() {
+  for (auto& block : blocks) {
+    release(block.first, block.second);
+  }
+}
+
+size_t MemoryPool::getSizeClass(size_t bytes) {
+  if (bytes <= Alignment) {
+    return Alignment;
+  }
+  size_t power = Alignment;
+  while (power <= bytes / 2) {
+    power *= 2;
+  }
+  size_t step = (power / 4 > Alignment) ? power / 4 : Alignment;
+  return roundUp(bytes, step);
+}
+
+void* MemoryPool::allocate(size_t bytes) {
+  const size_t size = getSizeClass(bytes);
+  ++numAllocations;
+
+  std::vector<void*>& freeList = freeLists[size];
+  if (!freeList.empty()) {
+    void* block = freeList.back();
+    freeList.pop_back();
+    cachedBytes -= size;
+    allocatedBytes += size;
+    ++numReuses;
+    return block;
+  }
+
+  void* block = nullptr;
+  bool mapped = false;
+#ifdef __linux__
+  if (hugePages && size >= HugePageSize) {
+    void* mem = mmap(nullptr, roundUp(size, HugePageSize),
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (mem != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+      madvise(mem, roundUp(size, HugePageSize), MADV_HUGEPAGE);
+#endif
+      block = mem;
+      mapped = true;
+    }
+  }
+#endif
+  if (block == nullptr && posix_memalign(&block, Alignment, size) != 0) {
+    block = nullptr;
+  }
+  uassert(block != nullptr) << "Could not allocate " << size << " bytes";
+
+  blocks.insert({block, {size, mapped}});
+  allocatedBytes += size;
+  return block;
+}
+
+void MemoryPool::free(void* block) {
+  if (block == nullptr) {
+    return;
+  }
+  auto it = blocks.find(block);
+  iassert(it != blocks.end()) << "Block not allocated by this pool";
+  const size_t size = it->second.size;
+  freeLists[size].push_back(block);
+  allocatedBytes -= size;
+  cachedBytes += size;
+}
+
+void MemoryPool::trim() {
+  for (auto& freeList : freeLists) {
+    for (void* block : freeList.second) {
+      auto it = blocks.find(block);
+      release(block, it->second);
+      blocks.erase(it);
+    }
+  }
+  freeLists.clear();
+  cachedBytes = 0;
+}
+
+void MemoryPool::release(void* block, const Block& info) {
+#ifdef __linux__
+  if (info.mapped) {
+    munmap(block, roundUp(info.size, HugePageSize));
+    return;
+  }
+#endif
+  std::free(block);
+}
+
+}}
@@ -0,0 +1,74 @@
+#ifndef SIMIT_UTIL_MEMORY_POOL_H
+#define SIMIT_UTIL_MEMORY_POOL_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "interfaces/uncopyable.h"
+
+namespace simit {
+namespace util {
+
+/// A size-classed pool of 64-byte aligned memory blocks. Freed blocks are
+/// kept in a free list per size class and handed out again to requests of
+/// the same class, so that a function that is initialized over and over
+/// reuses its temporaries instead of returning them to the system allocator.
+/// Size classes are spaced four per power of two, so a block is at most 25%
+/// larger than the request it serves.
+///
+/// With huge pages, blocks of at least HugePageSize bytes are mapped
+/// directly and advised to be backed by transparent huge pages (on Linux),
+/// which cuts TLB misses on large matrices.
+///
+/// The pool is not thread-safe.
+class MemoryPool : interfaces::Uncopyable {
+public:
+  static const size_t Alignment = 64;
+  static const size_t HugePageSize = 2 * 1024 * 1024;
+
+  explicit MemoryPool(bool hugePages=false);
+
+  /// Free all blocks, including those still allocated.
+  ~MemoryPool();
+
+  /// Allocate a block of at least `bytes` bytes, reusing a free block of the
+  /// same size class if there is one. The block is not zeroed.
+  void* allocate(size_t bytes);
+
+  /// Return a block to its free list. Ignores nullptr.
+  void free(void* block);
+
+  /// Return the free blocks to the system.
+  void trim();
+
+  /// Bytes in allocated and in free blocks.
+  size_t getAllocatedBytes() const {return allocatedBytes;}
+  size_t getCachedBytes() const {return cachedBytes;}
+
+  /// Number of allocations served, and how many of them reused a block.
+  size_t getNumAllocations() const {return numAllocations;}
+  size_t getNumReuses() const {return numReuses;}
+
+  /// The block size that serves requests of `bytes` bytes.
+  static size_t getSizeClass(size_t bytes);
+
+private:
+  struct Block {
+    size_t size;
+    bool mapped;
+  };
+
+  bool hugePages;
+  std::map<void*, Block> blocks;
+  std::map<size_t, std::vector<void*>> freeLists;
+  size_t allocatedBytes;
+  size_t cachedBytes;
+  size_t numAllocations;
+  size_t numReuses;
+
+  void release(void* block, const Block& info);
+};
+
+}}
+#endif
@@ -0,0 +1,220 @@
+#ifndef SIMIT_UTIL_NUMBER_PARSING_H
+#define SIMIT_UTIL_NUMBER_PARSING_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <locale.h>
+#include <vector>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+namespace simit {
+namespace util {
+
+// Locale-independent number parsing in the style of std::from_chars. The
+// functions parse a number at the start of [first,last) and return a pointer
+// one past the last consumed character, or nullptr if no number was found.
+// They never read past `last`, so they can be used on memory-mapped files
+// that are not NUL-terminated.
+
+inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+/// Skip spaces and tabs (but not newlines).
+inline const char* skipBlanks(const char* first, const char* last) {
+  while (first < last && isBlank(*first)) {
+    ++first;
+  }
+  return first;
+}
+
+/// Parse a signed decimal integer.
+template <typename T>
+const char* parseInt(const char* first, const char* last, T& value) {
+  const char* p = first;
+  bool negative = false;
+  if (p < last && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == last || !isDigit(*p)) {
+    return nullptr;
+  }
+  int64_t result = 0;
+  while (p < last && isDigit(*p)) {
+    result = result*10 + (*p - '0');
+    ++p;
+  }
+  value = static_cast<T>(negative ? -result : result);
+  return p;
+}
+
+/// The "C" locale, for library conversions that must not depend on the
+/// locale the program has set.
+inline locale_t cLocale() {
+  static locale_t locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+  return locale;
+}
+
+/// Parse a decimal floating point number. Numbers with at most 19 significant
+/// digits whose value can be computed exactly with one multiplication or
+/// division (Clinger's fast path) are converted without library calls; all
+/// other numbers fall back to strtod_l in the "C" locale, so results are
+/// always correctly rounded and '.' is the decimal point in every locale.
+inline const char* parseDouble(const char* first, const char* last,
+                               double& value) {
+  static const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const uint64_t maxExactMantissa = uint64_t(1) << 53;
+
+  const char* p = first;
+  bool negative = false;
+  if (p < last && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int numDigits = 0;      // significant digits consumed into the mantissa
+  int exponent = 0;       // decimal exponent adjustment
+  bool sawDigit = false;
+  bool truncated = false; // more than 19 significant digits
+
+  while (p < last && isDigit(*p)) {
+    sawDigit = true;
+    if (mantissa != 0 || *p != '0') {
+      if (numDigits < 19) {
+        mantissa = mantissa*10 + (*p - '0');
+        ++numDigits;
+      }
+      else {
+        ++exponent;
+        truncated = true;
+      }
+    }
+    ++p;
+  }
+  if (p < last && *p == '.') {
+    ++p;
+    while (p < last && isDigit(*p)) {
+      sawDigit = true;
+      if (mantissa != 0 || *p != '0') {
+        if (numDigits < 19) {
+          mantissa = mantissa*10 + (*p - '0');
+          ++numDigits;
+          --exponent;
+        }
+        else {
+          truncated = true;
+        }
+      }
+      else {
+        --exponent;
+      }
+      ++p;
+    }
+  }
+
+  if (!sawDigit) {
+    // inf, nan, hex floats etc. are left to the C library
+    truncated = true;
+  }
+  else if (p < last && (*p == 'e' || *p == 'E')) {
+    int exp = 0;
+    const char* expEnd = parseInt(p+1, last, exp);
+    if (expEnd != nullptr) {
+      exponent += exp;
+      p = expEnd;
+    }
+  }
+
+  if (!truncated && mantissa <= maxExactMantissa &&
+      exponent >= -22 && exponent <= 22) {
+    double result = static_cast<double>(mantissa);
+    result = (exponent < 0) ? result / powersOfTen[-exponent]
+                            : result * powersOfTen[exponent];
+    value = negative ? -result : result;
+    return p;
+  }
+
+  // Slow path: copy the token into a NUL-terminated buffer for strtod_l.
+  const char* tokenEnd = first;
+  while (tokenEnd < last && !isBlank(*tokenEnd) && *tokenEnd != '\n') {
+    ++tokenEnd;
+  }
+  char buffer[128];
+  size_t length = tokenEnd - first;
+  std::vector<char> longBuffer;
+  char* token = buffer;
+  if (length >= sizeof(buffer)) {
+    longBuffer.resize(length+1);
+    token = longBuffer.data();
+  }
+  memcpy(token, first, length);
+  token[length] = '\0';
+  char* end = nullptr;
+  double result = strtod_l(token, &end, cLocale());
+  if (end == token) {
+    return nullptr;
+  }
+  value = result;
+  return first + (end - token);
+}
+
+/// Parse the next blank-separated integer on a line. Returns nullptr if `p` is
+/// nullptr, so that a sequence of numbers can be parsed before checking.
+template <typename T>
+const char* nextInt(const char* p, const char* lineEnd, T& value) {
+  return (p == nullptr) ? nullptr
+                        : parseInt(skipBlanks(p, lineEnd), lineEnd, value);
+}
+
+/// Parse the next blank-separated floating point number on a line, like
+/// nextInt.
+inline const char* nextDouble(const char* p, const char* lineEnd,
+                              double& value) {
+  return (p == nullptr) ? nullptr
+                        : parseDouble(skipBlanks(p, lineEnd), lineEnd, value);
+}
+
+/// Return a pointer to the first character after the next newline in
+/// [first,last), or `last` if there is none.
+inline const char* nextLine(const char* first, const char* last) {
+  const char* newline =
+      static_cast<const char*>(memchr(first, '\n', last - first));
+  return (newline != nullptr) ? newline + 1 : last;
+}
+
+/// Split [first,last) into at most `numChunks` chunks whose boundaries fall on
+/// line starts. Returns the chunk boundaries (one more than the number of
+/// chunks).
+inline std::vector<const char*> splitLines(const char* first, const char* last,
+                                           unsigned numChunks) {
+  std::vector<const char*> bounds;
+  bounds.push_back(first);
+  size_t size = last - first;
+  for (unsigned i=1; i < numChunks; ++i) {
+    const char* approx = first + (size * i) / numChunks;
+    if (approx <= bounds.back()) {
+      continue;
+    }
+    const char* bound = nextLine(approx-1, last);
+    if (bound > bounds.back() && bound < last) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(last);
+  return bounds;
+}
+
+}}
+#endif
@@ -0,0 +1,85 @@
+#ifndef SIMIT_UTIL_PARALLEL_H
+#define SIMIT_UTIL_PARALLEL_H
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace simit {
+namespace util {
+
+/// Return the number of threads host-side parallel loops should use. If
+/// `requested` is zero, the hardware concurrency is used.
+inline unsigned numThreads(unsigned requested=0) {
+  if (requested > 0) {
+    return requested;
+  }
+  unsigned hardwareThreads = std::thread::hardware_concurrency();
+  return (hardwareThreads > 0) ? hardwareThreads : 1;
+}
+
+/// Call `f(chunk)` for every chunk in [0,numChunks), each on its own thread.
+/// The first exception thrown by any chunk is rethrown after all threads have
+/// joined.
+template <typename F>
+void parallelChunks(unsigned numChunks, F f) {
+  if (numChunks <= 1) {
+    if (numChunks == 1) {
+      f(0u);
+    }
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(numChunks);
+  std::vector<std::thread> threads;
+  threads.reserve(numChunks-1);
+  for (unsigned chunk=1; chunk < numChunks; ++chunk) {
+    threads.push_back(std::thread([&f,&errors,chunk]() {
+      try {
+        f(chunk);
+      }
+      catch (...) {
+        errors[chunk] = std::current_exception();
+      }
+    }));
+  }
+  try {
+    f(0u);
+  }
+  catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+/// Split [begin,end) into contiguous ranges of at least `grain` iterations
+/// and call `f(rangeBegin, rangeEnd)` on each range in parallel.
+template <typename F>
+void parallelFor(size_t begin, size_t end, F f, unsigned threads=0,
+                 size_t grain=4096) {
+  if (end <= begin) {
+    return;
+  }
+  size_t n = end - begin;
+  size_t maxChunks = (n + grain - 1) / grain;
+  unsigned numChunks = numThreads(threads);
+  if (maxChunks < numChunks) {
+    numChunks = (unsigned)maxChunks;
+  }
+  parallelChunks(numChunks, [&](unsigned chunk) {
+    size_t chunkBegin = begin + (n * chunk) / numChunks;
+    size_t chunkEnd   = begin + (n * (chunk+1)) / numChunks;
+    f(chunkBegin, chunkEnd);
+  });
+}
+
+}}
+#endif
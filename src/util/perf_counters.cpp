@@ -0,0 +1,113 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace simit {
+namespace util {
+
+std::ostream& operator<<(std::ostream& os, const PerfEvent& event) {
+  switch (event) {
+    case PerfEvent::Cycles:
+      return os << "cycles";
+    case PerfEvent::Instructions:
+      return os << "instructions";
+    case PerfEvent::LLCReferences:
+      return os << "llc-references";
+    case PerfEvent::LLCMisses:
+      return os << "llc-misses";
+  }
+  return os;
+}
+
+#ifdef __linux__
+static int openCounter(uint64_t config, int groupFd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.disabled = (groupFd < 0) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Count the calling thread on any CPU
+  return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+PerfCounters::PerfCounters() : groupFd(-1), numOpened(0) {
+  for (int i=0; i < PerfSample::NumEvents; ++i) {
+    fds[i] = -1;
+    positions[i] = -1;
+  }
+#ifdef __linux__
+  const uint64_t configs[PerfSample::NumEvents] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES
+  };
+  groupFd = openCounter(configs[0], -1);
+  if (groupFd < 0) {
+    error = std::string("perf_event_open: ") + strerror(errno);
+    return;
+  }
+  fds[0] = groupFd;
+  positions[0] = numOpened++;
+  for (int i=1; i < PerfSample::NumEvents; ++i) {
+    fds[i] = openCounter(configs[i], groupFd);
+    if (fds[i] >= 0) {
+      positions[i] = numOpened++;
+    }
+  }
+  ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  error = "hardware counters are only supported on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (int i=PerfSample::NumEvents-1; i >= 0; --i) {
+    if (fds[i] >= 0) {
+      close(fds[i]);
+    }
+  }
+#endif
+}
+
+void PerfCounters::read(PerfSample* sample) const {
+  memset(sample->values, 0, sizeof(sample->values));
+#ifdef __linux__
+  if (groupFd < 0) {
+    return;
+  }
+  // PERF_FORMAT_GROUP layout: the number of counters, then their values
+  uint64_t buffer[1 + PerfSample::NumEvents];
+  ssize_t bytes = ::read(groupFd, buffer, sizeof(buffer));
+  if (bytes < (ssize_t)sizeof(uint64_t)) {
+    return;
+  }
+  for (int i=0; i < PerfSample::NumEvents; ++i) {
+    if (positions[i] >= 0 && positions[i] < (int)buffer[0]) {
+      sample->values[i] = buffer[1 + positions[i]];
+    }
+  }
+#endif
+}
+
+bool PerfCounters::isSupported() {
+  static const bool supported = PerfCounters().isValid();
+  return supported;
+}
+
+}}
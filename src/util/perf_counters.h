@@ -0,0 +1,68 @@
+#ifndef SIMIT_UTIL_PERF_COUNTERS_H
+#define SIMIT_UTIL_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "interfaces/uncopyable.h"
+
+namespace simit {
+namespace util {
+
+/// Hardware events counted by PerfCounters.
+enum class PerfEvent {
+  Cycles,
+  Instructions,
+  LLCReferences,
+  LLCMisses
+};
+std::ostream& operator<<(std::ostream&, const PerfEvent&);
+
+/// Event counts, indexed by PerfEvent.
+struct PerfSample {
+  static const int NumEvents = 4;
+  uint64_t values[NumEvents];
+
+  uint64_t& operator[](PerfEvent e) {return values[(int)e];}
+  uint64_t operator[](PerfEvent e) const {return values[(int)e];}
+};
+
+/// A group of hardware performance counters that count the events of the
+/// calling thread, opened with perf_event_open on Linux. The counters are
+/// read together with one system call. Counters the PMU or the kernel do not
+/// support (e.g. inside containers, or with a restrictive
+/// perf_event_paranoid) are unavailable and read as zero; if no counter can
+/// be opened the group is not valid and read does nothing.
+class PerfCounters : interfaces::Uncopyable {
+public:
+  /// Open the counters for the calling thread.
+  PerfCounters();
+  ~PerfCounters();
+
+  /// True if at least the cycle counter was opened.
+  bool isValid() const {return groupFd >= 0;}
+
+  /// True if the counter of `event` was opened.
+  bool isAvailable(PerfEvent event) const {return fds[(int)event] >= 0;}
+
+  /// Read the current counts into `sample`. Unavailable events read as zero.
+  void read(PerfSample* sample) const;
+
+  /// Why the counters could not be opened, or the empty string.
+  const std::string& getError() const {return error;}
+
+  /// True if the counters can be opened in this process.
+  static bool isSupported();
+
+private:
+  int groupFd;
+  int fds[PerfSample::NumEvents];
+  /// Position of every opened counter in the group read
+  int positions[PerfSample::NumEvents];
+  int numOpened;
+  std::string error;
+};
+
+}}
+#endif
@@ -0,0 +1,89 @@
+#ifndef SIMIT_UTIL_TEXT_RECORDS_H
+#define SIMIT_UTIL_TEXT_RECORDS_H
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "util/number_parsing.h"
+#include "util/parallel.h"
+
+namespace simit {
+namespace util {
+
+// Parallel parsing of line-oriented text files, where every data line holds
+// one record and blank lines and comments are skipped.
+
+/// Smallest chunk of text worth handing to its own thread.
+static const size_t MinChunkBytes = 1 << 16;
+
+/// Split text into line-aligned chunks, at most one per thread.
+inline std::vector<const char*> chunkLines(const char* begin, const char* end,
+                                           unsigned threads) {
+  size_t maxChunks = (end-begin)/MinChunkBytes + 1;
+  unsigned numChunks = numThreads(threads);
+  if (maxChunks < numChunks) {
+    numChunks = (unsigned)maxChunks;
+  }
+  return splitLines(begin, end, numChunks);
+}
+
+/// True if the line is neither blank nor a comment starting with one of the
+/// `commentChars`.
+inline bool isDataLine(const char* line, const char* lineEnd,
+                       const char* commentChars="#") {
+  line = skipBlanks(line, lineEnd);
+  return line < lineEnd && *line != '\n' && strchr(commentChars, *line) == 0;
+}
+
+/// Call `parseRecord(chunk, record, line, lineEnd)` for every data line, where
+/// `record` is the index of the line among all data lines and `chunk` the
+/// index of the chunk (and thread) parsing it. Data lines are counted in a
+/// first parallel pass and `prepare(numRecords, numChunks)` is called before
+/// the second pass, so that records can be written straight to their final
+/// position. Returns false if `prepare` or any record fails.
+template <typename Prepare, typename ParseRecord>
+bool parseRecords(const char* begin, const char* end, unsigned threads,
+                  const char* commentChars, Prepare prepare,
+                  ParseRecord parseRecord) {
+  std::vector<const char*> bounds = chunkLines(begin, end, threads);
+  unsigned numChunks = bounds.size()-1;
+
+  std::vector<size_t> offsets(numChunks+1, 0);
+  parallelChunks(numChunks, [&](unsigned chunk) {
+    const char* chunkEnd = bounds[chunk+1];
+    size_t count = 0;
+    for (const char* line = bounds[chunk]; line < chunkEnd;
+         line = nextLine(line, chunkEnd)) {
+      if (isDataLine(line, chunkEnd, commentChars)) {
+        count++;
+      }
+    }
+    offsets[chunk+1] = count;
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  if (!prepare(offsets[numChunks], numChunks)) {
+    return false;
+  }
+
+  std::vector<char> ok(numChunks, 1);
+  parallelChunks(numChunks, [&](unsigned chunk) {
+    const char* chunkEnd = bounds[chunk+1];
+    size_t record = offsets[chunk];
+    for (const char* line = bounds[chunk]; line < chunkEnd;) {
+      const char* lineEnd = nextLine(line, chunkEnd);
+      if (isDataLine(line, lineEnd, commentChars)) {
+        if (!parseRecord(chunk, record, line, lineEnd)) {
+          ok[chunk] = 0;
+          return;
+        }
+        record++;
+      }
+      line = lineEnd;
+    }
+  });
+  return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+}}
+#endif
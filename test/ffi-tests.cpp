@@ -607,6 +607,42 @@ TEST(ffi, matrix_neg) {
   ASSERT_EQ(-10.0, (double)a(v2));
 }
 
+TEST(ffi, matrix_neg_loop) {
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  ElementRef v0 = V.add();
+  ElementRef v1 = V.add();
+  ElementRef v2 = V.add();
+  b(v0) = 1.0;
+  b(v1) = 2.0;
+  b(v2) = 3.0;
+
+  Set E(V,V);
+  FieldRef<simit_float> e = E.addField<simit_float>("e");
+  ElementRef e0 = E.add(v0,v1);
+  ElementRef e1 = E.add(v1,v2);
+  e(e0) = 1.0;
+  e(e1) = 2.0;
+
+  // Compile program and bind arguments
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+
+  // The extern allocates new arrays for its result in every iteration
+  func.runSafe();
+  ASSERT_EQ(-9.0,  (double)a(v0));
+  ASSERT_EQ(-39.0, (double)a(v1));
+  ASSERT_EQ(-30.0, (double)a(v2));
+
+  func.runSafe();
+  ASSERT_EQ(-18.0, (double)a(v0));
+  ASSERT_EQ(-78.0, (double)a(v1));
+  ASSERT_EQ(-60.0, (double)a(v2));
+}
+
 TEST(ffi, matrix_neg_generics) {
   Set V;
   FieldRef<simit_float> a = V.addField<simit_float>("a");
@@ -0,0 +1,57 @@
+#include "simit-test.h"
+
+#include "flatten.h"
+#include "ir.h"
+#include "ir_queries.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::ir;
+
+TEST(Flatten, elementwise) {
+  Type VType = UnstructuredSetType::make(ElementType::make("Vertex", {}), {});
+  Var V("V", VType);
+  IndexDomain dim({V});
+  IndexVar i("i", dim);
+  IndexVar i2("i2", dim);
+  Type vectorType = ir::TensorType::make(ScalarType::Float, {dim});
+
+  // x = x + alpha*(r + p)
+  Var x("x", vectorType);
+  Expr r = Var("r", vectorType);
+  Expr p = Var("p", vectorType);
+  Expr alpha = Var("alpha", ir::Float);
+  Expr rp = IndexExpr::make({i2}, r(i2) + p(i2));
+  Expr xExpr = VarExpr::make(x);
+  Stmt axpy = AssignStmt::make(x, IndexExpr::make({i},
+                                   xExpr(i) + Mul::make(alpha, rp(i))));
+
+  // The update is computed in one index expression, without temporaries
+  Stmt flattened = flattenIndexExpressions(axpy);
+  ASSERT_TRUE(isa<AssignStmt>(flattened));
+  ASSERT_TRUE(isFlattened(flattened));
+}
+
+TEST(Flatten, reduction) {
+  Type VType = UnstructuredSetType::make(ElementType::make("Vertex", {}), {});
+  Var V("V", VType);
+  IndexDomain dim({V});
+  IndexVar i("i", dim);
+  IndexVar i2("i2", dim);
+  IndexVar j("j", dim, ReductionOperator::Sum);
+  Type vectorType = ir::TensorType::make(ScalarType::Float, {dim});
+  Type matrixType = ir::TensorType::make(ScalarType::Float, {dim,dim});
+
+  // x = p + B*x
+  Var x("x", vectorType);
+  Expr B = Var("B", matrixType);
+  Expr p = Var("p", vectorType);
+  Expr xExpr = VarExpr::make(x);
+  Expr Bx = IndexExpr::make({i2}, B(i2,j) * xExpr(j));
+  Stmt update = AssignStmt::make(x, IndexExpr::make({i}, p(i) + Bx(i)));
+
+  // The matrix-vector product is computed into a temporary first
+  Stmt flattened = flattenIndexExpressions(update);
+  ASSERT_TRUE(isa<Block>(flattened));
+  ASSERT_FALSE(containsReductionVar(to<Block>(flattened)->rest));
+}
@@ -1,5 +1,10 @@
 #include "simit-test.h"
 
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#include "init.h"
 #include "tensor.h"
 #include "tensor_data.h"
 #include "graph.h"
@@ -64,6 +69,54 @@ TEST(Function, bindScalar) {
   ASSERT_EQ(42, bArg);
 }
 
+TEST(Function, sourceLines) {
+  Var a("a", Int);
+  Var b("b", Int);
+  Stmt neg = SourceLine::make("test.sim", 7, AssignStmt::make(a, -b));
+
+  bool debugInfo = simit::kDebugInfo;
+  bool perfMap = simit::kPerfMap;
+  simit::kDebugInfo = true;
+  simit::kPerfMap = true;
+  Environment env;
+  env.addExtern(a);
+  env.addExtern(b);
+  simit::Function function = getTestBackend()->compile(neg, env);
+  simit::kDebugInfo = debugInfo;
+  simit::kPerfMap = perfMap;
+
+  simit::Tensor<int> aArg = 0;
+  simit::Tensor<int> bArg = 42;
+  function.bind("a", &aArg);
+  function.bind("b", &bArg);
+  function.runSafe();
+  ASSERT_EQ(-42, aArg);
+
+  if (simit::kBackend == "cpu") {
+    // Entries are "<start> <size> <name>", and the code of the statement is
+    // named after its source line
+    std::string mapFile = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    std::ifstream map(mapFile);
+    ASSERT_TRUE(map.good());
+    std::vector<std::string> names;
+    std::string start, size, name;
+    while (map >> start >> size && std::getline(map >> std::ws, name)) {
+      names.push_back(name);
+    }
+    map.close();
+    remove(mapFile.c_str());
+
+    size_t lines = 0;
+    for (const std::string& name : names) {
+      if (name.find(" test.sim:") != std::string::npos) {
+        ASSERT_EQ("simit::main test.sim:7", name);
+        lines++;
+      }
+    }
+    ASSERT_LT(0u, lines);
+  }
+}
+
 TEST(Function, bindVector) {
   Var a("a", Vec3i);
   Var b("b", Vec3i);
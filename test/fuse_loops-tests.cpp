@@ -0,0 +1,167 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "lower/fuse_loops.h"
+
+using namespace std;
+using namespace simit::ir;
+
+static const For* getLoop(Stmt stmt) {
+  while (isa<Scope>(stmt) || isa<SourceLine>(stmt)) {
+    stmt = isa<Scope>(stmt) ? to<Scope>(stmt)->scopedStmt
+                            : to<SourceLine>(stmt)->stmt;
+  }
+  return isa<For>(stmt) ? to<For>(stmt) : nullptr;
+}
+
+static int countLoops(Stmt stmt) {
+  int loops = 0;
+  stmt = to<Scope>(stmt)->scopedStmt;
+  while (isa<Block>(stmt)) {
+    loops += (getLoop(to<Block>(stmt)->first) != nullptr);
+    stmt = to<Block>(stmt)->rest;
+  }
+  return loops + (stmt.defined() && getLoop(stmt) != nullptr);
+}
+
+TEST(FuseLoops, elementwise) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  Var i("i", Int);
+  Var j("j", Int);
+  Var k("k", Int);
+  Expr b = FieldRead::make(V, "b");
+
+  // x = V.b; y = 2*x; V.b = x + y
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    For::make(i, ForDomain(IndexSet(V)),
+              Store::make(x, i, Load::make(b, i))),
+    VarDecl::make(y),
+    For::make(j, ForDomain(IndexSet(V)),
+              Store::make(y, j, Mul::make(2.0, Load::make(x, j)))),
+    For::make(k, ForDomain(IndexSet(V)),
+              Store::make(b, k, Add::make(Load::make(x, k),
+                                          Load::make(y, k))))
+  });
+  Func func("f", {V}, {}, Scope::make(body));
+
+  // The loops read and write the element of the iteration only
+  Func fused = fuseLoops(func);
+  ASSERT_EQ(1, countLoops(fused.getBody()));
+}
+
+TEST(FuseLoops, sourceLines) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  Var i("i", Int);
+  Var j("j", Int);
+  Var k("k", Int);
+  Expr b = FieldRead::make(V, "b");
+
+  // The elementwise loops with debug info, which wraps the statements of
+  // every source line
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    SourceLine::make("test.sim", 1,
+                     For::make(i, ForDomain(IndexSet(V)),
+                               Store::make(x, i, Load::make(b, i)))),
+    VarDecl::make(y),
+    SourceLine::make("test.sim", 2,
+                     For::make(j, ForDomain(IndexSet(V)),
+                               Store::make(y, j, Mul::make(2.0,
+                                                           Load::make(x, j))))),
+    SourceLine::make("test.sim", 3,
+                     Block::make(Comment::make("V.b = x + y"),
+                                 For::make(k, ForDomain(IndexSet(V)),
+                                           Store::make(b, k, Add::make(
+                                               Load::make(x, k),
+                                               Load::make(y, k))))))
+  });
+  Func func("f", {V}, {}, Scope::make(body));
+
+  // The fused loop keeps the line of every statement
+  Func fused = fuseLoops(func);
+  ASSERT_EQ(1, countLoops(fused.getBody()));
+  int lines = 0;
+  match(fused.getBody(),
+        function<void(const SourceLine*)>([&](const SourceLine*) {
+          lines++;
+        }));
+  ASSERT_EQ(4, lines);
+}
+
+TEST(FuseLoops, dependent) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var s("s", Float);
+  Var i("i", Int);
+  Var j("j", Int);
+  Var k("k", Int);
+  Expr b = FieldRead::make(V, "b");
+
+  // x = V.b; V.b = x(0); s = sum(x)
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    For::make(i, ForDomain(IndexSet(V)),
+              Store::make(x, i, Load::make(b, i))),
+    For::make(j, ForDomain(IndexSet(V)),
+              Store::make(b, j, Load::make(x, 0))),
+    For::make(k, ForDomain(IndexSet(V)),
+              AssignStmt::make(s, Load::make(b, k), CompoundOperator::Add))
+  });
+  Func func("f", {V}, {s}, Scope::make(body));
+
+  // The second loop reads another iteration's element of x, and the third
+  // accumulates into a scalar that the second loop does not touch, so only
+  // the last two loops are fused
+  Func fused = fuseLoops(func);
+  ASSERT_EQ(2, countLoops(fused.getBody()));
+}
+
+TEST(FuseLoops, spmvDot) {
+  Type vertexType = ElementType::make("Vertex", {});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var p("p", vectorType);
+  Var Ap("Ap", vectorType);
+  Var nbrs("nbrs", vectorType);
+  Var s("s", Float);
+  Var i("i", Int);
+  Var j("j", Int);
+
+  // Ap(i) = p(i) + p(nbrs(i)); s = dot(p, Ap)
+  Expr nbr = Load::make(nbrs, i);
+  Stmt body = Block::make({
+    VarDecl::make(Ap),
+    For::make(i, ForDomain(IndexSet(V)),
+              Store::make(Ap, i, Add::make(Load::make(p, i),
+                                           Load::make(p, nbr)))),
+    For::make(j, ForDomain(IndexSet(V)),
+              AssignStmt::make(s, Mul::make(Load::make(p, j),
+                                            Load::make(Ap, j)),
+                               CompoundOperator::Add))
+  });
+  Func func("f", {V, p, nbrs}, {s}, Scope::make(body));
+
+  // The product gathers p from other elements, but p is only read, so the
+  // dot product is accumulated in the loop that computes Ap
+  Func fused = fuseLoops(func);
+  ASSERT_EQ(1, countLoops(fused.getBody()));
+}
@@ -0,0 +1,176 @@
+#include "simit-test.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <utility>
+
+#include "graph.h"
+#include "graph_io.h"
+
+using namespace std;
+using namespace simit;
+
+static string graphFile(const string &name) {
+  return string(TEST_INPUT_DIR) + "/graph/" + name;
+}
+
+static set<pair<int,int>> getEdges(const Set &edges) {
+  set<pair<int,int>> result;
+  for (auto e : edges) {
+    result.insert({edges.getEndpoint(e,0).getIdent(),
+                   edges.getEndpoint(e,1).getIdent()});
+  }
+  return result;
+}
+
+static void checkWebGraph(const Set &pages, Set &links) {
+  ASSERT_EQ(5, pages.getSize());
+  ASSERT_EQ(7, links.getSize());
+  FieldRef<simit_float> weight = links.getField<simit_float>("weight");
+  const int endpoints[] = {0,4, 1,0, 1,4, 2,0, 2,4, 3,0, 3,4};
+  const simit_float weights[] = {0.5, 2, 1, 0.15, 3, -1, 7.25};
+  int i = 0;
+  for (auto link : links) {
+    ASSERT_EQ(endpoints[2*i], links.getEndpoint(link,0).getIdent());
+    ASSERT_EQ(endpoints[2*i+1], links.getEndpoint(link,1).getIdent());
+    SIMIT_ASSERT_FLOAT_EQ(weights[i], weight.get(link));
+    ++i;
+  }
+}
+
+TEST(GraphIO, EdgeList) {
+  Set pages;
+  Set links(pages,pages);
+  links.addField<simit_float>("weight");
+
+  GraphLoadOptions options;
+  options.weightField = "weight";
+  options.numThreads = 2;
+  GraphLoadStats stats;
+  ASSERT_EQ(0, loadEdgeList(graphFile("web.txt"), &pages, &links, options,
+                            &stats));
+  ASSERT_EQ(5u, stats.numVertices);
+  ASSERT_EQ(7u, stats.numEdges);
+  checkWebGraph(pages, links);
+}
+
+TEST(GraphIO, MatrixMarket) {
+  Set pages;
+  Set links(pages,pages);
+  links.addField<simit_float>("weight");
+
+  GraphLoadOptions options;
+  options.weightField = "weight";
+  ASSERT_EQ(0, loadGraph(graphFile("web.mtx"), &pages, &links, options));
+  checkWebGraph(pages, links);
+}
+
+TEST(GraphIO, MatrixMarketSymmetric) {
+  Set verts;
+  Set edges(verts,verts);
+  ASSERT_EQ(0, loadMatrixMarket(graphFile("ring.mtx"), &verts, &edges));
+  ASSERT_EQ(4, verts.getSize());
+  set<pair<int,int>> expected = {{1,0}, {0,1}, {2,1}, {1,2}, {3,2}, {2,3},
+                                 {3,0}, {0,3}, {3,3}};
+  ASSERT_EQ(9, edges.getSize());
+  ASSERT_EQ(expected, getEdges(edges));
+}
+
+TEST(GraphIO, Snapshot) {
+  const string snapshot = "graph-io-test.sgs";
+  Set pages;
+  Set links(pages,pages);
+  links.addField<simit_float>("weight");
+  FieldRef<int> rank = pages.addField<int>("rank");
+
+  GraphLoadOptions options;
+  options.weightField = "weight";
+  ASSERT_EQ(0, loadEdgeList(graphFile("web.txt"), &pages, &links, options));
+  int r = 0;
+  for (auto page : pages) {
+    rank.set(page, r++);
+  }
+  ASSERT_EQ(0, saveGraphSnapshot(snapshot, pages, links));
+
+  Set reloadedPages;
+  Set reloadedLinks(reloadedPages,reloadedPages);
+  ASSERT_EQ(0, loadGraph(snapshot, &reloadedPages, &reloadedLinks));
+  remove(snapshot.c_str());
+  checkWebGraph(reloadedPages, reloadedLinks);
+  FieldRef<int> reloadedRank = reloadedPages.getField<int>("rank");
+  r = 0;
+  for (auto page : reloadedPages) {
+    ASSERT_EQ(r++, reloadedRank.get(page));
+  }
+}
+
+TEST(GraphIO, Malformed) {
+  Set pages;
+  Set links(pages,pages);
+  ASSERT_EQ(-1, loadEdgeList(graphFile("missing.txt"), &pages, &links));
+  ASSERT_EQ(-1, loadGraphSnapshot(graphFile("web.txt"), &pages, &links));
+}
+
+TEST(GraphIO, MalformedLeavesSetsUnchanged) {
+  Set pages;
+  Set links(pages,pages);
+  GraphLoadOptions options;
+  options.weightField = "weight";
+  options.numThreads = 2;
+  ASSERT_EQ(-1, loadEdgeList(graphFile("malformed.txt"), &pages, &links,
+                             options));
+  ASSERT_EQ(0, pages.getSize());
+  ASSERT_EQ(0, links.getSize());
+  ASSERT_FALSE(links.hasField("weight"));
+
+  ASSERT_EQ(-1, loadMatrixMarket(graphFile("malformed.mtx"), &pages, &links,
+                                 options));
+  ASSERT_EQ(0, pages.getSize());
+  ASSERT_EQ(0, links.getSize());
+  ASSERT_FALSE(links.hasField("weight"));
+
+  ASSERT_EQ(-1, loadEdgeList(graphFile("bad_weight.txt"), &pages, &links,
+                             options));
+  ASSERT_EQ(0, pages.getSize());
+  ASSERT_EQ(0, links.getSize());
+  ASSERT_FALSE(links.hasField("weight"));
+
+  // The sets can still be loaded
+  links.addField<simit_float>("weight");
+  ASSERT_EQ(0, loadEdgeList(graphFile("web.txt"), &pages, &links, options));
+  checkWebGraph(pages, links);
+}
+
+TEST(GraphIO, MalformedSnapshotLeavesSetsUnchanged) {
+  const string snapshot = "graph-io-truncated.sgs";
+  Set pages;
+  Set links(pages,pages);
+  links.addField<simit_float>("weight");
+  pages.addField<int>("rank");
+  GraphLoadOptions options;
+  options.weightField = "weight";
+  ASSERT_EQ(0, loadEdgeList(graphFile("web.txt"), &pages, &links, options));
+  ASSERT_EQ(0, saveGraphSnapshot(snapshot, pages, links));
+
+  // Cut the snapshot off in the middle of the edge weights
+  string contents;
+  {
+    ifstream in(snapshot, ios::binary);
+    contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  {
+    ofstream out(snapshot, ios::binary | ios::trunc);
+    out.write(contents.data(), contents.size() - sizeof(simit_float));
+  }
+
+  Set reloadedPages;
+  Set reloadedLinks(reloadedPages,reloadedPages);
+  ASSERT_EQ(-1, loadGraphSnapshot(snapshot, &reloadedPages, &reloadedLinks));
+  remove(snapshot.c_str());
+  ASSERT_EQ(0, reloadedPages.getSize());
+  ASSERT_EQ(0, reloadedLinks.getSize());
+  ASSERT_FALSE(reloadedPages.hasField("rank"));
+  ASSERT_FALSE(reloadedLinks.hasField("weight"));
+}
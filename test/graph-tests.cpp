@@ -1,8 +1,12 @@
 #include "simit-test.h"
 
+#include <algorithm>
+#include <set>
 #include <vector>
 
 #include "graph.h"
+#include "mesh.h"
+#include "reorder.h"
 
 using namespace std;
 using namespace simit;
@@ -322,3 +326,212 @@ TEST(GraphGenerator, createBox) {
 
   ASSERT_EQ(box.getEdges().size(), 54u);
 }
+
+static MeshVol createTwoTetMesh() {
+  MeshVol mesh;
+  mesh.v = {{{0.0, 0.0, 0.0}}, {{1.0, 0.0, 0.0}}, {{0.0, 1.0, 0.0}},
+            {{0.0, 0.0, 1.0}}, {{1.0, 1.0, 1.0}}};
+  mesh.e = {{4, 1, 2, 3}, {0, 1, 2, 3}};
+  mesh.edges = {{{0, 1}}, {{1, 4}}, {{2, 3}}};
+  return mesh;
+}
+
+TEST(Set, AddElements) {
+  Set points;
+  FieldRef<int> a = points.addField<int>("a");
+  points.add();
+  ElementRef first = points.addElements(2000);
+  ASSERT_EQ(1, first.getIdent());
+  ASSERT_EQ(2001, points.getSize());
+  a.set(first, 7);
+  ASSERT_EQ(7, a.get(first));
+  for (auto p : points) {
+    if (p != first) {
+      ASSERT_EQ(0, a.get(p));
+    }
+  }
+
+  Set edges(points, points);
+  edges.add(first, first);
+  edges.addElements(3);
+  ASSERT_EQ(4, edges.getSize());
+  ASSERT_EQ(0, edges.getEndpointsPtr()[7]);
+}
+
+TEST(GraphGenerator, createMeshSets) {
+  MeshVol mesh = createTwoTetMesh();
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  Set springs(verts, verts);
+  FieldRef<simit_float,3> x = verts.addField<simit_float,3>("x");
+
+  vector<ElementRef> refs = createMeshSets(mesh, &verts, &tets, &springs);
+  ASSERT_EQ(5, verts.getSize());
+  ASSERT_EQ(2, tets.getSize());
+  ASSERT_EQ(3, springs.getSize());
+  for (size_t i=0; i < mesh.v.size(); ++i) {
+    for (int k=0; k < 3; ++k) {
+      SIMIT_ASSERT_FLOAT_EQ(mesh.v[i][k], x.get(refs[i])(k));
+    }
+  }
+  for (auto tet : tets) {
+    for (int k=0; k < 4; ++k) {
+      ASSERT_EQ(refs[mesh.e[tet.getIdent()][k]], tets.getEndpoint(tet, k));
+    }
+  }
+  for (auto spring : springs) {
+    for (int k=0; k < 2; ++k) {
+      ASSERT_EQ(refs[mesh.edges[spring.getIdent()][k]],
+                springs.getEndpoint(spring, k));
+    }
+  }
+}
+
+TEST(GraphGenerator, createMeshSetsReordered) {
+  MeshVol mesh = createTwoTetMesh();
+
+  // Reference: add elements one by one and reorder afterwards
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  FieldRef<double,3> x = verts.addField<double,3>("x");
+  vector<ElementRef> vertRefs;
+  for (auto &v : mesh.v) {
+    ElementRef vert = verts.add();
+    x.set(vert, {v[0], v[1], v[2]});
+    vertRefs.push_back(vert);
+  }
+  for (auto &e : mesh.e) {
+    tets.add(vertRefs[e[0]], vertRefs[e[1]], vertRefs[e[2]], vertRefs[e[3]]);
+  }
+  verts.setSpatialField("x");
+  reorder(tets, verts);
+
+  Set bulkVerts;
+  Set bulkTets(bulkVerts, bulkVerts, bulkVerts, bulkVerts);
+  MeshSetOptions options;
+  options.reorder = true;
+  createMeshSets(mesh, &bulkVerts, &bulkTets, nullptr, options);
+  FieldRef<double,3> bulkX = bulkVerts.getField<double,3>("x");
+
+  ASSERT_EQ(verts.getSize(), bulkVerts.getSize());
+  auto it = bulkVerts.begin();
+  for (auto vert : verts) {
+    for (int k=0; k < 3; ++k) {
+      ASSERT_EQ(x.get(vert)(k), bulkX.get(*it)(k));
+    }
+    ++it;
+  }
+  ASSERT_EQ(tets.getSize(), bulkTets.getSize());
+  for (int i=0; i < tets.getSize()*4; ++i) {
+    ASSERT_EQ(tets.getEndpointsPtr()[i], bulkTets.getEndpointsPtr()[i]);
+  }
+}
+
+TEST(GraphGenerator, createBoxWithoutEdgeMap) {
+  Set points;
+  Set edges(points,points);
+  Box box = createBox(&points, &edges, 4, 3, 2);
+  Set lazyPoints;
+  Set lazyEdges(lazyPoints,lazyPoints);
+  Box lazyBox = createBox(&lazyPoints, &lazyEdges, 4, 3, 2, false);
+
+  ASSERT_EQ(edges.getSize(), lazyEdges.getSize());
+  for (int i=0; i < edges.getSize()*2; ++i) {
+    ASSERT_EQ(edges.getEndpointsPtr()[i], lazyEdges.getEndpointsPtr()[i]);
+  }
+  ASSERT_EQ(box.getEdges().size(), lazyBox.getEdges().size());
+  for (auto p1 : points) {
+    for (auto p2 : points) {
+      ASSERT_EQ(box.getEdge(p1,p2), lazyBox.getEdge(p1,p2));
+    }
+  }
+}
+
+TEST(GraphGenerator, createTetBox) {
+  Set points;
+  Set tets(points,points,points,points);
+  createTetBox(&points, &tets, 3, 4, 2);
+  ASSERT_EQ(24, points.getSize());
+  ASSERT_EQ(6*2*3*1, tets.getSize());
+
+  // Every tet is positively oriented and the tets fill the box
+  FieldRef<double,3> x = points.getField<double,3>("x");
+  double volume = 0.0;
+  for (auto tet : tets) {
+    double d[3][3];
+    TensorRef<double,3> x0 = x.get(tets.getEndpoint(tet,0));
+    for (int i=0; i < 3; ++i) {
+      TensorRef<double,3> xi = x.get(tets.getEndpoint(tet,i+1));
+      for (int k=0; k < 3; ++k) {
+        d[i][k] = xi(k) - x0(k);
+      }
+    }
+    double det = d[0][0]*(d[1][1]*d[2][2] - d[1][2]*d[2][1])
+               - d[0][1]*(d[1][0]*d[2][2] - d[1][2]*d[2][0])
+               + d[0][2]*(d[1][0]*d[2][1] - d[1][1]*d[2][0]);
+    ASSERT_GT(det, 0.0);
+    volume += det / 6.0;
+  }
+  ASSERT_NEAR(2*3*1, volume, 1e-12);
+}
+
+TEST(GraphGenerator, createRandomGeometricGraph) {
+  Set points;
+  Set edges(points,points);
+  const double radius = 0.2;
+  createRandomGeometricGraph(&points, &edges, 500, radius, 7, "x", 3);
+  ASSERT_EQ(500, points.getSize());
+
+  // Compare with all pairs within the radius
+  FieldRef<double,3> x = points.getField<double,3>("x");
+  std::set<pair<int,int>> expected;
+  for (auto p : points) {
+    for (auto q : points) {
+      double dist2 = 0.0;
+      for (int k=0; k < 3; ++k) {
+        dist2 += (x.get(p)(k) - x.get(q)(k)) * (x.get(p)(k) - x.get(q)(k));
+      }
+      if (p.getIdent() < q.getIdent() && dist2 < radius*radius) {
+        expected.insert({p.getIdent(), q.getIdent()});
+      }
+    }
+  }
+  std::set<pair<int,int>> actual;
+  for (auto e : edges) {
+    actual.insert({edges.getEndpoint(e,0).getIdent(),
+                   edges.getEndpoint(e,1).getIdent()});
+  }
+  ASSERT_EQ((size_t)edges.getSize(), actual.size());
+  ASSERT_EQ(expected, actual);
+
+  // The graph does not depend on the number of threads
+  Set points1;
+  Set edges1(points1,points1);
+  createRandomGeometricGraph(&points1, &edges1, 500, radius, 7, "x", 1);
+  ASSERT_EQ(edges.getSize(), edges1.getSize());
+  for (int i=0; i < edges.getSize()*2; ++i) {
+    ASSERT_EQ(edges.getEndpointsPtr()[i], edges1.getEndpointsPtr()[i]);
+  }
+}
+
+TEST(GraphGenerator, createRMATGraph) {
+  Set points;
+  Set edges(points,points);
+  createRMATGraph(&points, &edges, 12, 4, 0.57, 0.19, 0.19, 3, 4);
+  ASSERT_EQ(4096, points.getSize());
+  ASSERT_EQ(4*4096, edges.getSize());
+
+  Set points1;
+  Set edges1(points1,points1);
+  createRMATGraph(&points1, &edges1, 12, 4, 0.57, 0.19, 0.19, 3, 1);
+  for (int i=0; i < edges.getSize()*2; ++i) {
+    ASSERT_EQ(edges.getEndpointsPtr()[i], edges1.getEndpointsPtr()[i]);
+  }
+
+  // Power-law graphs have vertices of much higher than average degree
+  vector<int> degree(points.getSize(), 0);
+  for (auto e : edges) {
+    degree[edges.getEndpoint(e,0).getIdent()]++;
+  }
+  ASSERT_GT(*max_element(degree.begin(), degree.end()), 40);
+}
@@ -0,0 +1,130 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "ir_transforms.h"
+#include "intrinsics.h"
+
+using namespace std;
+using namespace simit::ir;
+
+static int countReads(Stmt stmt) {
+  int reads = 0;
+  match(stmt, function<void(const TensorRead*)>([&](const TensorRead*) {
+    reads++;
+  }));
+  return reads;
+}
+
+static Stmt getLoopBody(Stmt stmt) {
+  Stmt body;
+  match(stmt, function<void(const ForRange*)>([&](const ForRange *op) {
+    body = op->body;
+  }));
+  return body;
+}
+
+TEST(IRTransforms, pure) {
+  ASSERT_TRUE(isPure(intrinsics::sin()));
+  ASSERT_TRUE(isPure(intrinsics::det()));
+  ASSERT_TRUE(isPure(intrinsics::loc()));
+  ASSERT_FALSE(isPure(intrinsics::solve()));
+
+  Var a("a", Float);
+  Var b("b", Float);
+  Func square("square", {a}, {b}, AssignStmt::make(b, Mul::make(a, a)));
+  ASSERT_TRUE(isPure(square));
+
+  Func print("print", {a}, {b}, Block::make(Print::make(a),
+                                            AssignStmt::make(b, a)));
+  ASSERT_FALSE(isPure(print));
+}
+
+TEST(IRTransforms, hoistLoopInvariants) {
+  Type vertexType = ElementType::make("Vertex", {Field("x", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Var v("v", Int);
+  Var i("i", Int);
+  Var t("t", Float);
+  Var s("s", Float);
+  Expr x = TensorRead::make(FieldRead::make(V, "x"), {VarExpr::make(v)});
+
+  // for v in V: s = 0; for i in 0:3: t = V.x(v)*2; s = s + t
+  Stmt inner = Block::make({
+    VarDecl::make(t),
+    AssignStmt::make(t, Mul::make(x, 2.0)),
+    AssignStmt::make(s, Add::make(s, t))
+  });
+  Stmt body = Block::make({
+    VarDecl::make(s),
+    AssignStmt::make(s, 0.0),
+    ForRange::make(i, 0, 3, inner)
+  });
+  Func func("f", {V}, {}, For::make(v, ForDomain(IndexSet(V)), body));
+
+  // t does not change between iterations, so the field is read once, before
+  // the inner loop
+  Func hoisted = hoistLoopInvariants(func);
+  ASSERT_EQ(1, countReads(hoisted.getBody()));
+  ASSERT_EQ(0, countReads(getLoopBody(hoisted.getBody())));
+}
+
+TEST(IRTransforms, hoistLoopInvariantsSourceLines) {
+  Type vertexType = ElementType::make("Vertex", {Field("x", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Var v("v", Int);
+  Var i("i", Int);
+  Var t("t", Float);
+  Var s("s", Float);
+  Expr x = TensorRead::make(FieldRead::make(V, "x"), {VarExpr::make(v)});
+
+  // The loops of hoistLoopInvariants with debug info, which wraps the
+  // statements of every source line
+  Stmt inner = Block::make({
+    VarDecl::make(t),
+    SourceLine::make("test.sim", 3, AssignStmt::make(t, Mul::make(x, 2.0))),
+    SourceLine::make("test.sim", 4, AssignStmt::make(s, Add::make(s, t)))
+  });
+  Stmt body = Block::make({
+    VarDecl::make(s),
+    SourceLine::make("test.sim", 1, AssignStmt::make(s, 0.0)),
+    SourceLine::make("test.sim", 2, ForRange::make(i, 0, 3, inner))
+  });
+  Func func("f", {V}, {}, For::make(v, ForDomain(IndexSet(V)), body));
+
+  // The assignment to t is hoisted with its line, and not just its read
+  Func hoisted = hoistLoopInvariants(func);
+  ASSERT_EQ(1, countReads(hoisted.getBody()));
+  ASSERT_EQ(0, countReads(getLoopBody(hoisted.getBody())));
+  int assignments = 0;
+  match(getLoopBody(hoisted.getBody()),
+        function<void(const AssignStmt*)>([&](const AssignStmt*) {
+          assignments++;
+        }));
+  ASSERT_EQ(1, assignments);
+}
+
+TEST(IRTransforms, eliminateCommonSubexpressions) {
+  Type vertexType = ElementType::make("Vertex", {Field("x", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Var v("v", Int);
+  Var s("s", Float);
+  Expr x = FieldRead::make(V, "x");
+
+  // for v in V: s = V.x(v) * V.x(v); V.x(v) = s; s = s + V.x(v)
+  Stmt body = Block::make({
+    VarDecl::make(s),
+    AssignStmt::make(s, Mul::make(TensorRead::make(x, {VarExpr::make(v)}),
+                                  TensorRead::make(x, {VarExpr::make(v)}))),
+    TensorWrite::make(x, {VarExpr::make(v)}, s),
+    AssignStmt::make(s, Add::make(s, TensorRead::make(x, {VarExpr::make(v)})))
+  });
+  Func func("f", {V}, {}, For::make(v, ForDomain(IndexSet(V)), body));
+
+  // The second read reuses the first, but the write in between means the
+  // last read must read the field again
+  Func eliminated = eliminateCommonSubexpressions(func);
+  ASSERT_EQ(2, countReads(eliminated.getBody()));
+}
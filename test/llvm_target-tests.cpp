@@ -0,0 +1,84 @@
+#include "simit-test.h"
+
+#include "init.h"
+#include "backend/llvm/llvm_target.h"
+
+using namespace std;
+using namespace simit::backend;
+
+TEST(LLVMTarget, features) {
+  string cpu = simit::kCPU;
+  string cpuFeatures = simit::kCPUFeatures;
+  simit::kCPU = "generic";
+
+  simit::kCPUFeatures = "";
+  ASSERT_EQ("generic", getTargetCPU());
+  ASSERT_TRUE(getTargetFeatures().empty());
+  ASSERT_FALSE(hasTargetFeature("avx2"));
+
+  simit::kCPUFeatures = "+avx2";
+  ASSERT_EQ(vector<string>({"+avx2"}), getTargetFeatures());
+  ASSERT_TRUE(hasTargetFeature("avx2"));
+  ASSERT_FALSE(hasTargetFeature("avx"));
+
+  // Empty entries are skipped
+  simit::kCPUFeatures = "+fma,,-avx512f,";
+  ASSERT_EQ(vector<string>({"+fma", "-avx512f"}), getTargetFeatures());
+  ASSERT_TRUE(hasTargetFeature("fma"));
+  ASSERT_FALSE(hasTargetFeature("avx512f"));
+
+  // Later features override earlier ones
+  simit::kCPUFeatures = "+avx2,-avx2";
+  ASSERT_FALSE(hasTargetFeature("avx2"));
+  simit::kCPUFeatures = "-avx2,+avx2";
+  ASSERT_TRUE(hasTargetFeature("avx2"));
+
+  simit::kCPU = cpu;
+  simit::kCPUFeatures = cpuFeatures;
+}
+
+TEST(LLVMTarget, hostFeatures) {
+  string cpu = simit::kCPU;
+  string cpuFeatures = simit::kCPUFeatures;
+  simit::kCPU = "host";
+
+  simit::kCPUFeatures = "";
+  ASSERT_NE("host", getTargetCPU());
+  ASSERT_FALSE(getTargetCPU().empty());
+  size_t hostFeatures = getTargetFeatures().size();
+
+  // Settings::cpuFeatures come after, and override, the host's features
+  simit::kCPUFeatures = "-avx2";
+  vector<string> features = getTargetFeatures();
+  ASSERT_EQ(hostFeatures + 1, features.size());
+  ASSERT_EQ("-avx2", features.back());
+  ASSERT_FALSE(hasTargetFeature("avx2"));
+
+  simit::kCPUFeatures = "+avx2";
+  ASSERT_TRUE(hasTargetFeature("avx2"));
+
+  simit::kCPU = cpu;
+  simit::kCPUFeatures = cpuFeatures;
+}
+
+TEST(LLVMTarget, invalidFeatures) {
+  string cpu = simit::kCPU;
+  string cpuFeatures = simit::kCPUFeatures;
+  simit::Settings settings;
+  settings.backend = simit::kBackend;
+  settings.floatSize = simit::ir::ScalarType::floatBytes;
+  settings.cpu = cpu;
+
+  settings.cpuFeatures = "avx2";
+  ASSERT_THROW(simit::init(settings), simit::SimitException);
+  settings.cpuFeatures = "+fma,avx2";
+  ASSERT_THROW(simit::init(settings), simit::SimitException);
+  ASSERT_EQ(cpuFeatures, simit::kCPUFeatures);
+
+  settings.cpu = "";
+  settings.cpuFeatures = "";
+  ASSERT_THROW(simit::init(settings), simit::SimitException);
+
+  simit::kCPU = cpu;
+  simit::kCPUFeatures = cpuFeatures;
+}
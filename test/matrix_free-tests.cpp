@@ -0,0 +1,99 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "ir_visitor.h"
+#include "lower/matrix_free.h"
+
+using namespace std;
+using namespace simit::ir;
+
+static vector<const Map*> getMaps(Func func) {
+  class GetMaps : public IRVisitor {
+  public:
+    vector<const Map*> maps;
+    using IRVisitor::visit;
+    void visit(const Map* op) {maps.push_back(op);}
+  };
+  GetMaps visitor;
+  func.getBody().accept(&visitor);
+  return visitor.maps;
+}
+
+/// A(v(0),v(1)) = e.a
+static Func makeAssemblyFunc(Type vType, Type eType, Type matrixType) {
+  Var e("e", eType);
+  Var v("v", TupleType::make(vType, 2));
+  Var A("A", matrixType);
+  Stmt body = TensorWrite::make(A, {TupleRead::make(v, 0),
+                                    TupleRead::make(v, 1)},
+                                FieldRead::make(e, "a"));
+  return Func("f", {e, v}, {A}, body);
+}
+
+TEST(MatrixFree, product) {
+  Type vType = ElementType::make("Vertex", {});
+  Type eType = ElementType::make("Edge", {Field("a", Float)});
+  Var V("V", UnstructuredSetType::make(vType, {}));
+  Var E("E", UnstructuredSetType::make(eType, {V,V}));
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Type matrixType = TensorType::make(ScalarType::Float, {dim,dim});
+  Func f = makeAssemblyFunc(vType, eType, matrixType);
+  Var A("A", matrixType);
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim, ReductionOperator::Sum);
+
+  // A = map f to E reduce +; y = A*x
+  Stmt body = Block::make({
+    VarDecl::make(A),
+    Map::make({A}, f, {}, E, V, Expr(),
+              ReductionOperator::Sum),
+    VarDecl::make(y),
+    AssignStmt::make(y, IndexExpr::make({i}, Expr(A)(i,j) * Expr(x)(j)))
+  });
+  Func func("main", {V, E, x}, {y}, body);
+
+  // y is computed by a map that multiplies the blocks of A by x
+  Func lowered = lowerMatrixFree(func, true);
+  vector<const Map*> maps = getMaps(lowered);
+  ASSERT_EQ(1u, maps.size());
+  ASSERT_EQ(y, maps[0]->vars[0]);
+  ASSERT_EQ(1u, maps[0]->partial_actuals.size());
+  ASSERT_TRUE(isa<VarExpr>(maps[0]->partial_actuals[0]));
+  ASSERT_EQ(x, to<VarExpr>(maps[0]->partial_actuals[0])->var);
+}
+
+TEST(MatrixFree, clobbered) {
+  Type vType = ElementType::make("Vertex", {});
+  Type eType = ElementType::make("Edge", {Field("a", Float)});
+  Var V("V", UnstructuredSetType::make(vType, {}));
+  Var E("E", UnstructuredSetType::make(eType, {V,V}));
+  IndexDomain dim({V});
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Type matrixType = TensorType::make(ScalarType::Float, {dim,dim});
+  Func f = makeAssemblyFunc(vType, eType, matrixType);
+  Var A("A", matrixType);
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim, ReductionOperator::Sum);
+
+  // A = map f to E reduce +; for E: E.a = 0; y = A*x
+  Stmt body = Block::make({
+    VarDecl::make(A),
+    Map::make({A}, f, {}, E, V, Expr(),
+              ReductionOperator::Sum),
+    FieldWrite::make(E, "a", 0.0),
+    VarDecl::make(y),
+    AssignStmt::make(y, IndexExpr::make({i}, Expr(A)(i,j) * Expr(x)(j)))
+  });
+  Func func("main", {V, E, x}, {y}, body);
+
+  // The product must use the values of e.a at the time of assembly
+  Func lowered = lowerMatrixFree(func, true);
+  vector<const Map*> maps = getMaps(lowered);
+  ASSERT_EQ(1u, maps.size());
+  ASSERT_EQ(A, maps[0]->vars[0]);
+}
@@ -0,0 +1,123 @@
+#include "simit-test.h"
+
+#include <sstream>
+
+#include "memory_accounting.h"
+#include "graph.h"
+#include "program.h"
+#include "function.h"
+
+using namespace std;
+using namespace simit;
+
+TEST(MemoryAccounting, records) {
+  MemoryAccounting memory;
+  memory.allocate(MemoryKind::Temporary, "A", 100);
+  memory.allocate(MemoryKind::Buffer, "x", 50);
+  ASSERT_EQ(150u, memory.getBytes());
+  ASSERT_EQ(150u, memory.getPeakBytes());
+  ASSERT_EQ(100u, memory.getBytes(MemoryKind::Temporary));
+
+  memory.free(MemoryKind::Temporary, "A");
+  ASSERT_EQ(50u, memory.getBytes());
+  ASSERT_EQ(150u, memory.getPeakBytes());
+
+  // Views of other records do not count towards the totals
+  memory.alias(MemoryKind::TensorIndex, "A.index", 40, "x");
+  ASSERT_EQ(50u, memory.getBytes());
+  ASSERT_EQ(0u, memory.getBytes(MemoryKind::TensorIndex));
+  ASSERT_EQ("x", memory.getRecord(MemoryKind::TensorIndex, "A.index")->owner);
+
+  memory.allocate(MemoryKind::Temporary, "A", 20);
+  const MemoryRecord* a = memory.getRecord(MemoryKind::Temporary, "A");
+  ASSERT_NE(nullptr, a);
+  ASSERT_EQ(20u, a->bytes);
+  ASSERT_EQ(100u, a->peakBytes);
+  ASSERT_EQ(2u, a->allocations);
+  ASSERT_EQ(nullptr, memory.getRecord(MemoryKind::Buffer, "A"));
+  ASSERT_EQ(3u, memory.getRecords().size());
+
+  stringstream table;
+  memory.print(table);
+  ASSERT_NE(string::npos, table.str().find("tensor index"));
+  ASSERT_NE(string::npos, table.str().find("(in x)"));
+
+  memory.clear();
+  ASSERT_EQ(0u, memory.getBytes());
+  ASSERT_EQ(0u, memory.getRecords().size());
+}
+
+TEST(MemoryAccounting, sets) {
+  Set points;
+  Set springs(points, points);
+  points.addField<double,3>("x");
+  createBox(&points, &springs, 3, 1, 1);
+
+  MemoryAccounting memory;
+  memory.recordSet("points", points);
+  memory.recordSet("springs", springs);
+  const MemoryRecord* x = memory.getRecord(MemoryKind::SetField, "points.x");
+  ASSERT_NE(nullptr, x);
+  ASSERT_EQ(points.getCapacity() * 3 * sizeof(double), x->bytes);
+  const MemoryRecord* endpoints =
+      memory.getRecord(MemoryKind::SetField, "springs.endpoints");
+  ASSERT_NE(nullptr, endpoints);
+  ASSERT_EQ(springs.getCapacity() * 2 * sizeof(int), endpoints->bytes);
+
+  // Recording unchanged sets again does not count them twice
+  memory.recordSet("points", points);
+  ASSERT_EQ(1u, memory.getRecord(MemoryKind::SetField, "points.x")->allocations);
+  ASSERT_EQ(x->bytes + endpoints->bytes, memory.getBytes());
+}
+
+TEST(MemoryAccounting, function) {
+  Program program;
+  program.loadString(
+      "element Point\n"
+      "  b : float;\n"
+      "  c : float;\n"
+      "end\n"
+      "element Spring\n"
+      "  a : float;\n"
+      "end\n"
+      "extern points  : set{Point};\n"
+      "extern springs : set{Spring}(points,points);\n"
+      "func f(s : Spring, p : (Point*2)) -> "
+      "    (A : tensor[points,points](float))\n"
+      "  A(p(0),p(0)) = s.a;\n"
+      "  A(p(0),p(1)) = s.a;\n"
+      "  A(p(1),p(0)) = s.a;\n"
+      "  A(p(1),p(1)) = s.a;\n"
+      "end\n"
+      "export func main()\n"
+      "  A = map f to springs reduce +;\n"
+      "  points.c = A * points.b;\n"
+      "end\n");
+  Function function = program.compile("main");
+  ASSERT_TRUE(function.defined());
+
+  Set points;
+  Set springs(points, points);
+  points.addField<simit_float>("b");
+  points.addField<simit_float>("c");
+  springs.addField<simit_float>("a");
+  createBox(&points, &springs, 3, 1, 1);
+
+  function.bind("points", &points);
+  function.bind("springs", &springs);
+  function.runSafe();
+
+  shared_ptr<MemoryAccounting> memory = function.getMemoryAccounting();
+  ASSERT_NE(nullptr, memory);
+  const MemoryRecord* b = memory->getRecord(MemoryKind::SetField, "points.b");
+  ASSERT_NE(nullptr, b);
+  ASSERT_EQ(points.getCapacity() * sizeof(simit_float), b->bytes);
+
+  // The matrix has 3 diagonal and 4 off-diagonal entries
+  ASSERT_EQ((3 + 1 + 7) * sizeof(uint32_t),
+            memory->getBytes(MemoryKind::PathIndex));
+  ASSERT_GE(memory->getBytes(MemoryKind::Buffer) +
+            memory->getBytes(MemoryKind::Temporary),
+            7 * sizeof(simit_float));
+  ASSERT_GE(memory->getPeakBytes(), memory->getBytes());
+}
@@ -0,0 +1,66 @@
+#include "simit-test.h"
+
+#include <cstdint>
+
+#include "util/memory_pool.h"
+
+using namespace std;
+using namespace simit::util;
+
+TEST(MemoryPool, sizeClasses) {
+  ASSERT_EQ(64u, MemoryPool::getSizeClass(1));
+  ASSERT_EQ(64u, MemoryPool::getSizeClass(64));
+  ASSERT_EQ(128u, MemoryPool::getSizeClass(65));
+  ASSERT_EQ(1024u, MemoryPool::getSizeClass(1024));
+  ASSERT_EQ(1280u, MemoryPool::getSizeClass(1025));
+  ASSERT_EQ(1536u, MemoryPool::getSizeClass(1500));
+
+  // A block is at most 25% larger than the request
+  for (size_t bytes = 64; bytes < 1000000; bytes = bytes * 3 / 2 + 1) {
+    size_t size = MemoryPool::getSizeClass(bytes);
+    ASSERT_GE(size, bytes);
+    ASSERT_LE(size, bytes + bytes / 4 + 64);
+  }
+}
+
+TEST(MemoryPool, reuse) {
+  MemoryPool pool;
+  void* a = pool.allocate(1000);
+  void* b = pool.allocate(100);
+  ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(a) % MemoryPool::Alignment);
+  ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(b) % MemoryPool::Alignment);
+  ASSERT_EQ(MemoryPool::getSizeClass(1000) + MemoryPool::getSizeClass(100),
+            pool.getAllocatedBytes());
+
+  // A freed block serves the next request of its size class
+  pool.free(a);
+  ASSERT_EQ(MemoryPool::getSizeClass(1000), pool.getCachedBytes());
+  void* c = pool.allocate(990);
+  ASSERT_EQ(a, c);
+  ASSERT_EQ(1u, pool.getNumReuses());
+  ASSERT_EQ(0u, pool.getCachedBytes());
+
+  // But not requests of other classes
+  pool.free(c);
+  void* d = pool.allocate(5000);
+  ASSERT_NE(a, d);
+  ASSERT_EQ(1u, pool.getNumReuses());
+  ASSERT_EQ(4u, pool.getNumAllocations());
+
+  pool.trim();
+  ASSERT_EQ(0u, pool.getCachedBytes());
+  pool.free(b);
+  pool.free(d);
+  pool.free(nullptr);
+}
+
+TEST(MemoryPool, hugePages) {
+  MemoryPool pool(true);
+  size_t bytes = 3 * MemoryPool::HugePageSize;
+  char* a = static_cast<char*>(pool.allocate(bytes));
+  ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(a) % MemoryPool::Alignment);
+  a[0] = 1;
+  a[bytes - 1] = 1;
+  pool.free(a);
+  ASSERT_EQ(a, pool.allocate(bytes));
+}
@@ -6,8 +6,10 @@
 #include <fstream>
 #include <iostream>
 #include <dirent.h>
+#include <clocale>
 
 #include "mesh.h"
+#include "util/number_parsing.h"
 
 using namespace std;
 using namespace simit;
@@ -309,3 +311,153 @@ const string inputEdge = R"(24  1
   
 }
 
+
+TEST(Mesh, ParallelParserTest) {
+  const string input = R"(# Blender v2.71 (sub 0) OBJ File: ''
+o Cube
+v 1.000000 -1.000000 -1.000000
+v 1.000000 -1.000000 1.000000
+v -1.000000 -1.000000 1.000000
+v -1.000000 -1.000000 -1.000000
+vt 1.000000 0.333333
+vt 1.000000 0.666667
+s off
+f 2/1 3/2 4/1
+f 1 2 3 4
+#end
+v 5.0 5.0 5.0
+)";
+  Mesh m;
+  ASSERT_EQ(0, m.parse(input.data(), input.data()+input.size(), 4));
+  ASSERT_EQ(4u, m.v.size());
+  ASSERT_EQ(3u, m.t.size());
+  ASSERT_EQ(-1.0, m.v[2][0]);
+  ASSERT_EQ(1.0,  m.v[1][2]);
+  ASSERT_EQ(1,    m.t[0][0]);
+  ASSERT_EQ(3,    m.t[0][2]);
+  ASSERT_EQ(0,    m.t[2][0]);
+  ASSERT_EQ(3,    m.t[2][2]);
+}
+
+TEST(MeshVol, ParallelParserTest) {
+  const string input = R"(#v 3
+#e 2
+0 0 0
+0 0 0.5
+0.25 1e-3 -2.5E2
+4 0 1 2 0
+3 2 1 0
+)";
+  MeshVol m;
+  ASSERT_EQ(0, m.parse(input.data(), input.data()+input.size(), 2));
+  ASSERT_EQ(3u, m.v.size());
+  ASSERT_EQ(2u, m.e.size());
+  ASSERT_EQ(0.5,    m.v[1][2]);
+  ASSERT_EQ(1e-3,   m.v[2][1]);
+  ASSERT_EQ(-250.0, m.v[2][2]);
+  ASSERT_EQ(4u,     m.e[0].size());
+  ASSERT_EQ(3u,     m.e[1].size());
+  ASSERT_EQ(2,      m.e[1][0]);
+}
+
+TEST(MeshVol, ParallelTetgenTest) {
+  const string inputNode = R"(5  3  0  0
+   0    0.01  0  0.01
+# comment
+   1    0  0  0.01
+
+   2    0  0.10000000000000001  0
+   3    0.01  0.025000000000000001  0
+   4    -1.5e-2  0.075000000000000011  0.01
+# Generated by ./tetgen -pqzV ../cubeb.stl 
+)";
+  const string inputEle = R"(2  4  0
+    0       0    3     2    4
+    1       1    4     0    2
+)";
+  const string inputEdge = R"(2  1
+    0      2     3  -1
+    1      4     0  -1
+)";
+  MeshVol m;
+  ASSERT_EQ(0, m.parseTet(inputNode.data(), inputNode.data()+inputNode.size(),
+                          inputEle.data(), inputEle.data()+inputEle.size(), 3));
+  ASSERT_EQ(0.01,  m.v[0][0]);
+  ASSERT_EQ(0.1,   m.v[2][1]);
+  ASSERT_EQ(0.025, m.v[3][1]);
+  ASSERT_EQ(-1.5e-2, m.v[4][0]);
+  ASSERT_EQ(4,     m.e[0][3]);
+  ASSERT_EQ(1,     m.e[1][0]);
+
+  ASSERT_EQ(0, m.parseTetEdge(inputEdge.data(),
+                              inputEdge.data()+inputEdge.size()));
+  ASSERT_EQ(3,     m.edges[0][1]);
+  ASSERT_EQ(4,     m.edges[1][0]);
+}
+
+TEST(MeshVol, ParallelMalformedTest) {
+  const string node = "3  3  0  0\n0 0 0 0\n1 0 0 1\n2 0 1 0\n";
+  const string ele = "1  4  0\n0 0 1 2 1\n";
+  MeshVol m;
+  ASSERT_EQ(0, m.parseTet(node.data(), node.data()+node.size(),
+                          ele.data(), ele.data()+ele.size()));
+
+  // Fewer records than the headers promise
+  const string shortNode = "4  3  0  0\n0 0 0 0\n1 0 0 1\n2 0 1 0\n";
+  ASSERT_EQ(-1, m.parseTet(shortNode.data(), shortNode.data()+shortNode.size(),
+                           ele.data(), ele.data()+ele.size()));
+  const string shortEle = "2  4  0\n0 0 1 2 1\n";
+  ASSERT_EQ(-1, m.parseTet(node.data(), node.data()+node.size(),
+                           shortEle.data(), shortEle.data()+shortEle.size()));
+  const string shortEdge = "2  1\n0 0 1 -1\n";
+  ASSERT_EQ(-1, m.parseTetEdge(shortEdge.data(),
+                               shortEdge.data()+shortEdge.size()));
+  const string shortVol = "#v 2\n#e 1\n0 0 0\n1 0 0\n";
+  ASSERT_EQ(-1, m.parse(shortVol.data(), shortVol.data()+shortVol.size()));
+
+  // Vertex indices out of range
+  const string badEle = "1  4  0\n0 0 1 2 3\n";
+  ASSERT_EQ(-1, m.parseTet(node.data(), node.data()+node.size(),
+                           badEle.data(), badEle.data()+badEle.size()));
+  const string badVol = "#v 2\n#e 1\n0 0 0\n1 0 0\n2 0 -1\n";
+  ASSERT_EQ(-1, m.parse(badVol.data(), badVol.data()+badVol.size()));
+
+  Mesh obj;
+  const string badFace = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n";
+  ASSERT_EQ(-1, obj.parse(badFace.data(), badFace.data()+badFace.size()));
+  const string zeroFace = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n";
+  ASSERT_EQ(-1, obj.parse(zeroFace.data(), zeroFace.data()+zeroFace.size()));
+}
+
+TEST(Mesh, ParseDoubleLocaleTest) {
+  // Switch to a locale where ',' is the decimal point, if one is installed
+  const char* commaLocales[] = {"de_DE.UTF-8", "de_DE.utf8", "de_DE",
+                                "fr_FR.UTF-8", "fr_FR.utf8", "fr_FR"};
+  string oldLocale = setlocale(LC_NUMERIC, nullptr);
+  bool commaLocale = false;
+  for (const char* locale : commaLocales) {
+    if (setlocale(LC_NUMERIC, locale) != nullptr) {
+      commaLocale = true;
+      break;
+    }
+  }
+  if (!commaLocale) {
+    std::cout << "No comma-decimal locale installed, skipping" << std::endl;
+    return;
+  }
+
+  // 1.5e30 and the 20-digit number take the strtod slow path
+  const string input = "1.5 1.5e30 1.2345678901234567890";
+  const char* p = input.data();
+  const char* last = input.data() + input.size();
+  double a = 0.0, b = 0.0, c = 0.0;
+  p = simit::util::nextDouble(p, last, a);
+  p = simit::util::nextDouble(p, last, b);
+  p = simit::util::nextDouble(p, last, c);
+  setlocale(LC_NUMERIC, oldLocale.c_str());
+
+  ASSERT_EQ(last, p);
+  ASSERT_EQ(1.5,    a);
+  ASSERT_EQ(1.5e30, b);
+  ASSERT_EQ(1.2345678901234567890, c);
+}
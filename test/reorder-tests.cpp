@@ -3,10 +3,17 @@
 
 #include "graph.h"
 #include "reorder.h"
+#include "hilbert.h"
 #include "program.h"
 #include "error.h"
 #include "mesh.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <random>
+
 using namespace std;
 using namespace simit;
 void vertexDataChecks(FieldRef<simit_float,3>& x, vector<ElementRef>& vertRefs, 
@@ -440,6 +447,70 @@ TEST(Program, reorderFemSpecificTest) {
   SIMIT_ASSERT_FLOAT_EQ(0.030173075240629205,  x.get(vertRefs[three])(2));
 }
 
+void runFemReordered(string& filename, Set& m_verts, Set& m_tets,
+    const unsigned int nSteps, const ReorderOptions& options) {
+  Function precomputation = loadFunction(filename, "initializeTet");
+  precomputation.setReordering(options);
+  precomputation.bind("verts", &m_verts);
+  precomputation.bind("tets", &m_tets);
+  for (unsigned int i=0; i < nSteps; ++i) {
+    precomputation.runSafe();
+  }
+
+  Function timeStepper = loadFunction(filename, "main");
+  timeStepper.setReordering(options);
+  timeStepper.bind("verts", &m_verts);
+  timeStepper.bind("tets", &m_tets);
+  timeStepper.init();
+
+  // The sets stay in the function's order until mapArgs
+  timeStepper.unmapArgs();
+  for (unsigned int i=0; i < nSteps; ++i) {
+    timeStepper.run();
+  }
+  timeStepper.mapArgs();
+  ASSERT_THROW(timeStepper.run(), SimitException);
+}
+
+TEST(Program, reorderOnInit) {
+  // Reordering on init is invisible to the host, so the results match an
+  // unreordered run element by element
+  string prefix = string(TEST_INPUT_DIR) + "/program/fem/cube";
+  string filename = string(TEST_INPUT_DIR) + "/" +
+                         toLower(test_info_->test_case_name()) + "/" +
+                         "femTet.sim";
+  unsigned int nSteps = 10;
+  MeshVol mv;
+  mv.loadTet(prefix + ".node", prefix + ".ele");
+
+  Set m_verts;
+  Set m_tets(m_verts,m_verts,m_verts,m_verts);
+  vector<ElementRef> vertRefs;
+  FieldRef<simit_float,3> x = initializeFem(mv, m_verts, m_tets, vertRefs);
+  loadAndRunFem(filename, m_verts, m_tets, nSteps);
+
+  for (ReorderHeuristic heuristic : {ReorderHeuristic::Hilbert,
+                                     ReorderHeuristic::ReverseCuthillMcKee,
+                                     ReorderHeuristic::EdgeSort}) {
+    Set reorder_m_verts;
+    Set reorder_m_tets(reorder_m_verts, reorder_m_verts, reorder_m_verts,
+                       reorder_m_verts);
+    vector<ElementRef> reorder_vertRefs;
+    FieldRef<simit_float,3> reorder_x = initializeFem(mv, reorder_m_verts,
+        reorder_m_tets, reorder_vertRefs);
+    reorder_m_verts.setSpatialField("x");
+
+    ReorderOptions options;
+    options.heuristic = heuristic;
+    runFemReordered(filename, reorder_m_verts, reorder_m_tets, nSteps,
+                    options);
+
+    vector<int> identity(vertRefs.size());
+    iota(identity.begin(), identity.end(), 0);
+    vertexDataChecks(x, vertRefs, reorder_x, reorder_vertRefs, identity);
+  }
+}
+
 TEST(Program, reorderSquare) {
   string dir(TEST_INPUT_DIR);
   string prefix=dir+"/program/fem/square";
@@ -469,3 +540,410 @@ TEST(Program, reorderFemTest) {
   unsigned int nSteps = 10;
   femTest(filename, prefix, nSteps);
 }
+
+static void createShuffledGrid(int n, Set& verts, Set& edges) {
+  // An n x n grid graph whose vertex indices are a random permutation of the
+  // row-major grid indices
+  vector<int> label(n*n);
+  iota(label.begin(), label.end(), 0);
+  shuffle(label.begin(), label.end(), mt19937(n));
+  verts.addElements(n*n);
+  for (int y=0; y < n; ++y) {
+    for (int x=0; x < n; ++x) {
+      if (x+1 < n) {
+        edges.addElements(1);
+        edges.getEndpointsPtr()[2*(edges.getSize()-1)] = label[y*n+x];
+        edges.getEndpointsPtr()[2*(edges.getSize()-1)+1] = label[y*n+x+1];
+      }
+      if (y+1 < n) {
+        edges.addElements(1);
+        edges.getEndpointsPtr()[2*(edges.getSize()-1)] = label[y*n+x];
+        edges.getEndpointsPtr()[2*(edges.getSize()-1)+1] = label[(y+1)*n+x];
+      }
+    }
+  }
+}
+
+static bool isPermutation(const vector<int>& ordering) {
+  vector<int> sorted(ordering);
+  sort(sorted.begin(), sorted.end());
+  for (size_t i=0; i < sorted.size(); ++i) {
+    if (sorted[i] != (int)i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(Reorder, rcm) {
+  // A path with scrambled labels gets bandwidth 1
+  const int n = 101;
+  vector<int> endpoints;
+  for (int i=0; i+1 < n; ++i) {
+    endpoints.push_back((i * 37) % n);
+    endpoints.push_back(((i+1) * 37) % n);
+  }
+  vector<int> vertexOrdering;
+  rcmReordering(endpoints.data(), n-1, 2, n, vertexOrdering);
+  ASSERT_TRUE(isPermutation(vertexOrdering));
+  for (int i=0; i+1 < n; ++i) {
+    ASSERT_EQ(1, abs(vertexOrdering[endpoints[2*i]] -
+                     vertexOrdering[endpoints[2*i+1]]));
+  }
+
+  // An n x n grid gets bandwidth of about n
+  Set verts;
+  Set edges(verts, verts);
+  createShuffledGrid(32, verts, edges);
+  rcmReordering(edges.getEndpointsPtr(), edges.getSize(), 2, verts.getSize(),
+                vertexOrdering);
+  ASSERT_TRUE(isPermutation(vertexOrdering));
+  OrderingReport report = analyzeOrdering(edges, vertexOrdering,
+                                          vector<int>());
+  ASSERT_LE(report.bandwidth, 33);
+}
+
+TEST(Reorder, bisection) {
+  Set verts;
+  Set edges(verts, verts);
+  createShuffledGrid(64, verts, edges);
+  CacheModel cache;
+  cache.cacheBytes = 4096;
+  OrderingReport original = analyzeOrdering(edges, vector<int>(),
+                                            vector<int>(), cache);
+
+  ReorderOptions options;
+  options.heuristic = ReorderHeuristic::RecursiveBisection;
+  options.partitionSize = 64;
+  vector<int> vertexOrdering;
+  vector<int> edgeOrdering;
+  reorder(edges, verts, options, edgeOrdering, vertexOrdering);
+  ASSERT_TRUE(isPermutation(vertexOrdering));
+  OrderingReport bisected = analyzeOrdering(edges, vector<int>(),
+                                            vector<int>(), cache);
+  ASSERT_LT(bisected.averageSpan * 10, original.averageSpan);
+  ASSERT_LT(bisected.cacheMisses * 2, original.cacheMisses);
+
+  // Isolated vertices and separate components are still ordered
+  vector<int> endpoints = {0, 2, 2, 4};
+  bisectionReordering(endpoints.data(), 2, 2, 6, 1, vertexOrdering);
+  ASSERT_TRUE(isPermutation(vertexOrdering));
+  ASSERT_EQ(6u, vertexOrdering.size());
+}
+
+TEST(Reorder, options) {
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  createTetBox(&verts, &tets, 6, 5, 4);
+
+  for (unsigned bits : {1u, 8u, 21u}) {
+    vector<int> vertexOrdering;
+    hilbert::hilbertReorder(verts, vertexOrdering, bits);
+    ASSERT_TRUE(isPermutation(vertexOrdering));
+  }
+  vector<int> vertexOrdering;
+  ASSERT_THROW(hilbert::hilbertReorder(verts, vertexOrdering, 22),
+               SimitException);
+
+  for (ReorderHeuristic heuristic : {ReorderHeuristic::Hilbert,
+                                     ReorderHeuristic::Morton,
+                                     ReorderHeuristic::ReverseCuthillMcKee,
+                                     ReorderHeuristic::RecursiveBisection}) {
+    Set reorderVerts;
+    Set reorderTets(reorderVerts, reorderVerts, reorderVerts, reorderVerts);
+    createTetBox(&reorderVerts, &reorderTets, 6, 5, 4);
+    FieldRef<double,3> x = reorderVerts.getField<double,3>("x");
+    vector<array<double,3>> before;
+    for (auto v : reorderVerts) {
+      before.push_back({{x.get(v)(0), x.get(v)(1), x.get(v)(2)}});
+    }
+
+    ReorderOptions options;
+    options.heuristic = heuristic;
+    options.partitionSize = 8;
+    vector<int> edgeOrdering;
+    reorder(reorderTets, reorderVerts, options, edgeOrdering, vertexOrdering);
+    ASSERT_TRUE(isPermutation(vertexOrdering));
+    ASSERT_TRUE(isPermutation(edgeOrdering));
+    vector<ElementRef> vertRefs;
+    for (auto v : reorderVerts) {
+      vertRefs.push_back(v);
+    }
+    for (size_t i=0; i < before.size(); ++i) {
+      ASSERT_EQ(before[i][0], x.get(vertRefs[vertexOrdering[i]])(0));
+      ASSERT_EQ(before[i][2], x.get(vertRefs[vertexOrdering[i]])(2));
+    }
+  }
+
+  vector<OrderingReport> reports = compareOrderings(tets, verts);
+  ASSERT_EQ(6u, reports.size());
+  ASSERT_EQ("original", reports[0].name);
+  ASSERT_EQ("edge-sort", reports[1].name);
+  ASSERT_EQ("hilbert", reports[2].name);
+  ASSERT_EQ("morton", reports[3].name);
+  ASSERT_EQ("rcm", reports[4].name);
+  ASSERT_EQ("bisection", reports[5].name);
+  for (const OrderingReport& report : reports) {
+    ASSERT_EQ(4u * tets.getSize(), report.accesses);
+    ASSERT_LE(report.cacheMisses, report.accesses);
+    ASSERT_LT(report.bandwidth, verts.getSize());
+  }
+}
+
+TEST(Reorder, hilbertParallel) {
+  // The parallel radix sort must produce the stable sort of the Hilbert
+  // indices, including the order of vertices that share a lattice point
+  const int n = 200000;
+  mt19937 rng(31);
+  uniform_real_distribution<double> uniform(-2.0, 3.0);
+  vector<double> coords(3*n);
+  for (int i=0; i < n; ++i) {
+    for (int d=0; d < 3; ++d) {
+      coords[i*3+d] = (i % 7 == 0) ? coords[(i/7)*3+d] : uniform(rng);
+    }
+  }
+
+  for (unsigned bits : {4u, 8u, 16u}) {
+    double min[3], max[3];
+    for (int d=0; d < 3; ++d) {
+      min[d] = max[d] = coords[d];
+      for (int i=0; i < n; ++i) {
+        min[d] = fmin(min[d], coords[i*3+d]);
+        max[d] = fmax(max[d], coords[i*3+d]);
+      }
+    }
+    vector<bitmask_t> keys(n);
+    for (int i=0; i < n; ++i) {
+      bitmask_t lattice[3];
+      for (int d=0; d < 3; ++d) {
+        double scale = ((uint64_t(1) << bits) - 1) / (max[d] - min[d]);
+        lattice[d] = (uint64_t)round((coords[i*3+d] - min[d]) * scale);
+      }
+      keys[i] = hilbert_c2i(3, bits, lattice);
+    }
+    vector<int> ids(n);
+    iota(ids.begin(), ids.end(), 0);
+    stable_sort(ids.begin(), ids.end(),
+                [&](int a, int b) { return keys[a] < keys[b]; });
+    vector<int> expected(n);
+    for (int i=0; i < n; ++i) {
+      expected[ids[i]] = i;
+    }
+
+    for (unsigned threads : {1u, 4u}) {
+      vector<int> vertexOrdering;
+      hilbert::hilbertReorder(coords.data(), n, vertexOrdering, bits,
+                              threads);
+      ASSERT_EQ(expected, vertexOrdering);
+    }
+  }
+}
+
+TEST(Reorder, morton) {
+  // The corners of a cube in Z-order
+  vector<double> coords;
+  for (int i=7; i >= 0; --i) {
+    coords.push_back(i & 1);
+    coords.push_back((i >> 1) & 1);
+    coords.push_back((i >> 2) & 1);
+  }
+  vector<int> vertexOrdering;
+  mortonReordering(coords.data(), 8, vertexOrdering, 1);
+  ASSERT_EQ(vector<int>({7, 6, 5, 4, 3, 2, 1, 0}), vertexOrdering);
+}
+
+TEST(Reorder, lattice) {
+  // Give the lattice points positions in reverse order, which a Hilbert
+  // ordering would undo if the points were reordered
+  Set points;
+  FieldRef<simit_float> b = points.addField<simit_float>("b");
+  FieldRef<simit_float> c = points.addField<simit_float>("c");
+  FieldRef<simit_float,3> x = points.addField<simit_float,3>("x");
+  Set springs(points,{3,2});
+  FieldRef<simit_float> a = springs.addField<simit_float>("a");
+
+  vector<ElementRef> pointRefs;
+  for (int j=0; j < 2; ++j) {
+    for (int i=0; i < 3; ++i) {
+      ElementRef p = springs.getLatticePoint({i,j});
+      b.set(p, 3*j + i + 1);
+      x.set(p, {(simit_float)(2-i), (simit_float)(1-j), 0.0});
+      pointRefs.push_back(p);
+      for (int dir=0; dir < 2; ++dir) {
+        a.set(springs.getLatticeLink({i,j},dir), 6*dir + 3*j + i + 1);
+      }
+    }
+  }
+  points.setSpatialField("x");
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  ReorderOptions options;
+  options.heuristic = ReorderHeuristic::Hilbert;
+  func.setReordering(options);
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+  func.mapArgs();
+
+  const simit_float expected[] = {100.0, 146.0, 211.0, 181.0, 224.0, 304.0};
+  for (size_t i=0; i < pointRefs.size(); ++i) {
+    ASSERT_EQ(simit_float(i+1), (simit_float)b.get(pointRefs[i]));
+    ASSERT_EQ(expected[i], (simit_float)c.get(pointRefs[i]));
+  }
+}
+
+TEST(Reorder, permuteFields) {
+  Set verts;
+  Set edges(verts, verts);
+  FieldRef<int> id = verts.addField<int>("id");
+  FieldRef<double,3> x = verts.addField<double,3>("x");
+  FieldRef<int> source = edges.addField<int>("source");
+  FieldRef<bool> flag = edges.addField<bool>("flag");
+  const int n = 10000;
+  vector<ElementRef> vertRefs;
+  for (int i=0; i < n; ++i) {
+    vertRefs.push_back(verts.add());
+    id.set(vertRefs.back(), i);
+    x.set(vertRefs.back(), {double(i), 2.0*i, 3.0*i});
+  }
+  for (int i=0; i < n; ++i) {
+    ElementRef edge = edges.add(vertRefs[i], vertRefs[(i+1) % n]);
+    source.set(edge, i);
+    flag.set(edge, i % 3 == 0);
+  }
+
+  vector<int> vertexOrdering(n);
+  vector<int> edgeOrdering(n);
+  for (int i=0; i < n; ++i) {
+    vertexOrdering[i] = (i * 7) % n;
+    edgeOrdering[i] = (i * 3) % n;
+  }
+  reorderVertexSet(edges, verts, vertexOrdering, 4);
+  reorderEdgeSet(edges, edgeOrdering, 4);
+
+  // Every vertex and edge keeps its field values
+  for (auto vert : verts) {
+    int i = id.get(vert);
+    ASSERT_EQ(vertexOrdering[i], vert.getIdent());
+    ASSERT_EQ(3.0*i, x.get(vert)(2));
+  }
+  for (auto edge : edges) {
+    int i = source.get(edge);
+    ASSERT_EQ(edgeOrdering[edge.getIdent()], i);
+    ASSERT_EQ(i % 3 == 0, flag.get(edge));
+    ASSERT_EQ(i, id.get(edges.getEndpoint(edge, 0)));
+    ASSERT_EQ((i+1) % n, id.get(edges.getEndpoint(edge, 1)));
+  }
+}
+
+TEST(Reorder, edgeOrders) {
+  Set verts;
+  Set edges(verts, verts);
+  createShuffledGrid(64, verts, edges);
+  const int* endpoints = edges.getEndpointsPtr();
+  auto lo = [&](int e) { return min(endpoints[2*e], endpoints[2*e+1]); };
+  auto hi = [&](int e) { return max(endpoints[2*e], endpoints[2*e+1]); };
+
+  ReorderOptions options;
+  options.edgeOrder = EdgeOrder::MinEndpoint;
+  vector<int> edgeOrdering;
+  computeEdgeOrdering(edges, options, edgeOrdering);
+  ASSERT_TRUE(isPermutation(edgeOrdering));
+  for (size_t i=1; i < edgeOrdering.size(); ++i) {
+    int prev = edgeOrdering[i-1];
+    int edge = edgeOrdering[i];
+    ASSERT_TRUE(lo(prev) < lo(edge) ||
+                (lo(prev) == lo(edge) && hi(prev) <= hi(edge)));
+  }
+
+  // Edges with the same target keep their relative order
+  options.edgeOrder = EdgeOrder::TargetEndpoint;
+  options.targetEndpoint = 1;
+  computeEdgeOrdering(edges, options, edgeOrdering);
+  ASSERT_TRUE(isPermutation(edgeOrdering));
+  for (size_t i=1; i < edgeOrdering.size(); ++i) {
+    int prev = edgeOrdering[i-1];
+    int edge = edgeOrdering[i];
+    ASSERT_LE(endpoints[2*prev+1], endpoints[2*edge+1]);
+    if (endpoints[2*prev+1] == endpoints[2*edge+1] && lo(prev) == lo(edge)) {
+      ASSERT_LT(prev, edge);
+    }
+  }
+
+  options.edgeOrder = EdgeOrder::VertexTiles;
+  options.tileSize = 256;
+  computeEdgeOrdering(edges, options, edgeOrdering);
+  ASSERT_TRUE(isPermutation(edgeOrdering));
+  auto tile = [&](int e) { return make_pair(lo(e) / 256, hi(e) / 256); };
+  for (size_t i=1; i < edgeOrdering.size(); ++i) {
+    int prev = edgeOrdering[i-1];
+    int edge = edgeOrdering[i];
+    ASSERT_LE(tile(prev), tile(edge));
+    if (tile(prev) == tile(edge)) {
+      ASSERT_LE(lo(prev), lo(edge));
+    }
+  }
+
+  options.edgeOrder = EdgeOrder::TargetEndpoint;
+  options.targetEndpoint = 2;
+  ASSERT_THROW(computeEdgeOrdering(edges, options, edgeOrdering),
+               SimitException);
+
+  // Every edge order improves on shuffled edges
+  vector<int> vertexOrdering;
+  rcmReordering(endpoints, edges.getSize(), 2, verts.getSize(),
+                vertexOrdering);
+  vector<int> shuffled(edges.getSize());
+  iota(shuffled.begin(), shuffled.end(), 0);
+  shuffle(shuffled.begin(), shuffled.end(), mt19937(7));
+  reorderEdgeSet(edges, shuffled);
+
+  CacheModel cache;
+  cache.cacheBytes = 1024;
+  options = ReorderOptions();
+  options.tileSize = 256;
+  vector<OrderingReport> reports = compareEdgeOrders(edges, vertexOrdering,
+                                                     options, cache);
+  ASSERT_EQ(5u, reports.size());
+  ASSERT_EQ("current", reports[0].name);
+  ASSERT_EQ("sorted-endpoints", reports[1].name);
+  ASSERT_EQ("min-endpoint", reports[2].name);
+  ASSERT_EQ("target-endpoint", reports[3].name);
+  ASSERT_EQ("vertex-tiles", reports[4].name);
+  for (size_t i=1; i < reports.size(); ++i) {
+    ASSERT_EQ(reports[0].accesses, reports[i].accesses);
+    ASSERT_EQ(reports[0].bandwidth, reports[i].bandwidth);
+    ASSERT_LT(reports[i].cacheMisses * 2, reports[0].cacheMisses);
+    ASSERT_LT(reports[i].reuse.percentile(0.5),
+              reports[0].reuse.percentile(0.5));
+  }
+}
+
+TEST(Reorder, reuseDistance) {
+  // One vertex per cache line, loaded in the order 0 1 2 0 1 2 3 3
+  Set verts;
+  Set edges(verts, verts);
+  verts.addElements(4);
+  vector<int> endpoints = {0, 1, 2, 0, 1, 2, 3, 3};
+  edges.addElements(4);
+  copy(endpoints.begin(), endpoints.end(), edges.getEndpointsPtr());
+
+  CacheModel cache;
+  cache.lineBytes = 8;
+  cache.bytesPerVertex = 8;
+  ReuseProfile reuse = analyzeOrdering(edges, vector<int>(), vector<int>(),
+                                       cache).reuse;
+  ASSERT_EQ(8u, reuse.accesses);
+  ASSERT_EQ(4u, reuse.coldAccesses);
+  ASSERT_EQ(vector<size_t>({1, 0, 3}), reuse.histogram);
+  ASSERT_DOUBLE_EQ(1.5, reuse.meanDistance);
+  ASSERT_EQ(3u, reuse.percentile(0.5));
+  ASSERT_DOUBLE_EQ(1.0/8, reuse.hitRate(1));
+  ASSERT_DOUBLE_EQ(4.0/8, reuse.hitRate(4));
+
+  // Two vertices per line halve the distinct lines
+  cache.lineBytes = 16;
+  reuse = analyzeOrdering(edges, vector<int>(), vector<int>(), cache).reuse;
+  ASSERT_EQ(2u, reuse.coldAccesses);
+}
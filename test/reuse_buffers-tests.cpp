@@ -0,0 +1,176 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "insert_frees.h"
+#include "intrinsics.h"
+#include "lower/reuse_buffers.h"
+#include "path_expressions.h"
+#include "storage.h"
+#include "tensor_index.h"
+
+using namespace std;
+using namespace simit::ir;
+
+static int countDecls(Stmt stmt) {
+  int decls = 0;
+  match(stmt, function<void(const VarDecl*)>([&](const VarDecl*) {
+    decls++;
+  }));
+  return decls;
+}
+
+static int countFrees(Stmt stmt) {
+  int frees = 0;
+  match(stmt, function<void(const CallStmt*)>([&](const CallStmt *op) {
+    frees += (op->callee == intrinsics::free());
+  }));
+  return frees;
+}
+
+static Func makeFunc(vector<Var> args, Stmt body, vector<Var> temporaries) {
+  Func func("f", args, {}, Scope::make(body));
+  for (auto &temporary : temporaries) {
+    func.getStorage().add(temporary, TensorStorage::Dense);
+  }
+  return func;
+}
+
+TEST(ReuseBuffers, elementwise) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Expr setExpr = V;
+  IndexDomain dim = IndexSet(setExpr);
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  Var z("z", vectorType);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim);
+  IndexVar k("k", dim);
+  Expr b = FieldRead::make(setExpr, "b");
+
+  // x = V.b; y = 2*x; z = y + V.b; V.b = z
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    AssignStmt::make(x, IndexExpr::make({i}, b(i))),
+    VarDecl::make(y),
+    AssignStmt::make(y, IndexExpr::make({j}, Mul::make(2.0, Expr(x)(j)))),
+    VarDecl::make(z),
+    AssignStmt::make(z, IndexExpr::make({k}, Add::make(Expr(y)(k), b(k)))),
+    FieldWrite::make(V, "b", z)
+  });
+  Func func = makeFunc({V}, body, {x, y, z});
+
+  // x dies where y is computed from it element by element, and so does y
+  // where z is, so they all update the same buffer
+  Func reused = reuseBuffers(func);
+  ASSERT_EQ(1, countDecls(reused.getBody()));
+}
+
+TEST(ReuseBuffers, reduction) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Expr setExpr = V;
+  IndexDomain dim = IndexSet(setExpr);
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Type matrixType = TensorType::make(ScalarType::Float, {dim, dim});
+  Var A("A", matrixType);
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim);
+  IndexVar k("k", dim, ReductionOperator::Sum);
+  Expr b = FieldRead::make(setExpr, "b");
+
+  // x = V.b; y = A*x; V.b = y
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    AssignStmt::make(x, IndexExpr::make({i}, b(i))),
+    VarDecl::make(y),
+    AssignStmt::make(y, IndexExpr::make({j}, Mul::make(Expr(A)(j,k),
+                                                       Expr(x)(k)))),
+    FieldWrite::make(V, "b", y)
+  });
+  Func func = makeFunc({V, A}, body, {x, y});
+
+  // Every element of y reads all of x, so y needs a buffer of its own
+  Func reused = reuseBuffers(func);
+  ASSERT_EQ(2, countDecls(reused.getBody()));
+}
+
+TEST(ReuseBuffers, loop) {
+  Type vertexType = ElementType::make("Vertex", {Field("b", Float)});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  Expr setExpr = V;
+  IndexDomain dim = IndexSet(setExpr);
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var y("y", vectorType);
+  Var t("t", vectorType);
+  Var n("n", Int);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim);
+  IndexVar k("k", dim);
+  IndexVar l("l", dim);
+  Expr b = FieldRead::make(setExpr, "b");
+
+  // x = V.b; y = V.b; for n in 0:10: t = x + y; x = t*t end; V.b = y
+  Stmt loopBody = Block::make({
+    VarDecl::make(t),
+    AssignStmt::make(t, IndexExpr::make({k}, Add::make(Expr(x)(k),
+                                                       Expr(y)(k)))),
+    AssignStmt::make(x, IndexExpr::make({l}, Mul::make(Expr(t)(l),
+                                                       Expr(t)(l))))
+  });
+  Stmt body = Block::make({
+    VarDecl::make(x),
+    AssignStmt::make(x, IndexExpr::make({i}, b(i))),
+    VarDecl::make(y),
+    AssignStmt::make(y, IndexExpr::make({j}, b(j))),
+    ForRange::make(n, 0, 10, loopBody),
+    FieldWrite::make(V, "b", y)
+  });
+  Func func = makeFunc({V}, body, {x, y, t});
+
+  // x and y are read in the loop, and so are live until it ends, and t is
+  // live at the same time as them
+  Func reused = reuseBuffers(func);
+  ASSERT_EQ(3, countDecls(reused.getBody()));
+}
+
+TEST(InsertFrees, loop) {
+  Type vertexType = ElementType::make("Vertex", {});
+  Type vertexSetType = UnstructuredSetType::make(vertexType, {});
+  Var V("V", vertexSetType);
+  IndexDomain dim({V});
+  Type matrixType = TensorType::make(ScalarType::Float, {dim, dim});
+  Var A("A", matrixType);
+  Var B("B", matrixType);
+  Var n("n", Int);
+  IndexVar i("i", dim);
+  IndexVar j("j", dim);
+  IndexVar k("k", dim, ReductionOperator::Sum);
+
+  // for n in 0:10: B = A*A end
+  Stmt loopBody = Block::make({
+    VarDecl::make(B),
+    AssignStmt::make(B, IndexExpr::make({i,j}, Mul::make(Expr(A)(i,k),
+                                                         Expr(A)(k,j))))
+  });
+  Func func("f", {V, A}, {}, Scope::make(ForRange::make(n,0,10, loopBody)));
+  TensorIndex index("B_index", simit::pe::PathExpression());
+  func.getStorage().add(B, TensorStorage(TensorStorage::Indexed, index));
+
+  // The product has no path expression, so its arrays are allocated by the
+  // runtime, which reuses them in every iteration. They are freed once.
+  Func freed = insertFrees(func);
+  ASSERT_EQ(3, countFrees(freed.getBody()));
+  ASSERT_EQ(1, countDecls(freed.getBody()));
+  match(freed.getBody(), function<void(const ForRange*)>([](const ForRange *op){
+    ASSERT_EQ(0, countDecls(op->body));
+    ASSERT_EQ(0, countFrees(op->body));
+  }));
+}
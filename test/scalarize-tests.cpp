@@ -0,0 +1,73 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "lower/scalarize.h"
+
+using namespace std;
+using namespace simit::ir;
+
+static int countLoops(Stmt stmt) {
+  int loops = 0;
+  match(stmt, function<void(const ForRange*)>([&](const ForRange*) {
+    loops++;
+  }));
+  return loops;
+}
+
+static int countLoads(Stmt stmt, const Var &var) {
+  int loads = 0;
+  match(stmt, function<void(const Load*)>([&](const Load *op) {
+    loads += isa<VarExpr>(op->buffer) && to<VarExpr>(op->buffer)->var == var;
+  }));
+  return loads;
+}
+
+TEST(Scalarize, vector) {
+  IndexDomain dim(IndexSet(3));
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var t("t", vectorType);
+  Var y("y", vectorType);
+  Var i("i", Int);
+  Var j("j", Int);
+
+  // for i in 0:3: t[i] = 2*x[i] end; for j in 0:3: y[j] = t[j] + x[j] end
+  Stmt body = Block::make({
+    VarDecl::make(t),
+    ForRange::make(i, 0, 3, Store::make(t, i, Mul::make(2.0,
+                                                        Load::make(x, i)))),
+    ForRange::make(j, 0, 3, Store::make(y, j, Add::make(Load::make(t, j),
+                                                        Load::make(x, j))))
+  });
+  Func func("f", {x}, {y}, Scope::make(body));
+
+  // The loops are unrolled and t is kept in three scalars
+  Func scalarized = scalarize(func, 3);
+  ASSERT_EQ(0, countLoops(scalarized.getBody()));
+  ASSERT_EQ(0, countLoads(scalarized.getBody(), t));
+  ASSERT_EQ(6, countLoads(scalarized.getBody(), x));
+}
+
+TEST(Scalarize, large) {
+  IndexDomain dim(IndexSet(4));
+  Type vectorType = TensorType::make(ScalarType::Float, {dim});
+  Var x("x", vectorType);
+  Var t("t", vectorType);
+  Var y("y", vectorType);
+  Var i("i", Int);
+  Var j("j", Int);
+
+  Stmt body = Block::make({
+    VarDecl::make(t),
+    ForRange::make(i, 0, 4, Store::make(t, i, Mul::make(2.0,
+                                                        Load::make(x, i)))),
+    ForRange::make(j, 0, 4, Store::make(y, j, Add::make(Load::make(t, j),
+                                                        Load::make(x, j))))
+  });
+  Func func("f", {x}, {y}, Scope::make(body));
+
+  // The tensors have more components than the threshold
+  Func scalarized = scalarize(func, 3);
+  ASSERT_EQ(2, countLoops(scalarized.getBody()));
+  ASSERT_EQ(1, countLoads(scalarized.getBody(), t));
+}
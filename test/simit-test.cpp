@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <string>
 #include <iostream>
+#include <fstream>
 #include <vector>
 
 #include "timers.h"
@@ -31,6 +32,15 @@ void ParseEnvironmentOptions(const char *progName, const char *envvar,
 
 static bool PROFILE(false);
 
+// Count hardware events in the profiled functions (--counters)
+static bool COUNTERS(false);
+
+// File prefix of the Chrome trace and timer summary written with --trace
+static std::string TRACE;
+
+// Timers of the functions compiled with timers, printed after the tests
+static std::vector<std::shared_ptr<simit::ir::Timers>> profiledTimers;
+
 #ifdef F32
 // F32 environment setup
 class F32Environment : public ::testing::Environment {
@@ -58,7 +68,9 @@ int main(int argc, char **argv) {
       (lastArgLen == 1 ||
        (lastArgLen >= 2 && 
         (std::string(argv[argc-1]).substr(0,2) != "--" ||
-         simit::util::split(argv[argc-1],"=")[0] == "--profile")))) {
+         simit::util::split(argv[argc-1],"=")[0] == "--profile" ||
+         simit::util::split(argv[argc-1],"=")[0] == "--counters" ||
+         simit::util::split(argv[argc-1],"=")[0] == "--trace")))) {
       filter = std::string(argv[1]);
 
       char *dotPtr = strchr(argv[1], '.');
@@ -85,6 +97,15 @@ int main(int argc, char **argv) {
         if (keyValPair[0] == "--profile") {
           PROFILE = true;
         }
+        else if (keyValPair[0] == "--counters") {
+          PROFILE = true;
+          COUNTERS = true;
+          if (!simit::util::PerfCounters::isSupported()) {
+            std::cerr << "Hardware counters are unavailable, "
+                      << "profiling times only" << std::endl;
+            COUNTERS = false;
+          }
+        }
         else {
           std::cerr << "Unrecognized arg: " << arg << std::endl;
           return 1;
@@ -93,7 +114,11 @@ int main(int argc, char **argv) {
       else if (keyValPair.size() == 2) {
         if (keyValPair[0] == "--backend") {
           simitBackend = keyValPair[1];
-        } 
+        }
+        else if (keyValPair[0] == "--trace") {
+          PROFILE = true;
+          TRACE = keyValPair[1];
+        }
         else {
           std::cerr << "Unrecognized arg: " << keyValPair[0] << std::endl;
           return 1;
@@ -120,7 +145,19 @@ int main(int argc, char **argv) {
   int returnValue = RUN_ALL_TESTS();
 
   if (PROFILE) {
-    simit::ir::printTimes();
+    for (auto& timers : profiledTimers) {
+      timers->print(std::cout);
+    }
+  }
+  if (!TRACE.empty()) {
+    std::vector<const simit::ir::Timers*> traced;
+    for (auto& timers : profiledTimers) {
+      traced.push_back(timers.get());
+    }
+    std::ofstream trace(TRACE + ".trace.json");
+    simit::ir::writeChromeTrace(trace, traced);
+    std::ofstream summary(TRACE + ".summary.json");
+    simit::ir::writeTimerSummary(summary, traced);
   }
   return returnValue;
 }
@@ -145,6 +182,15 @@ simit::Function loadFunction(std::string fileName, std::string funcName="main"){
   simit::Function f;
   if (PROFILE) {
     f = program.compileWithTimers(funcName);
+    if (f.defined()) {
+      profiledTimers.push_back(f.getTimers());
+      if (!TRACE.empty()) {
+        f.getTimers()->enableTracing();
+      }
+      if (COUNTERS) {
+        f.getTimers()->enableCounters();
+      }
+    }
   } else {
     f = program.compile(funcName);
   }
@@ -169,6 +215,15 @@ simit::Function loadFunctionWithTimers(std::string fileName, std::string funcNam
   if (!f.defined()) {
     std::cerr << program.getDiagnostics().getMessage();
   }
+  else {
+    profiledTimers.push_back(f.getTimers());
+    if (!TRACE.empty()) {
+      f.getTimers()->enableTracing();
+    }
+    if (COUNTERS) {
+      f.getTimers()->enableCounters();
+    }
+  }
 
   return f;
 }
@@ -0,0 +1,340 @@
+#include "simit-test.h"
+
+#include <sstream>
+#include <thread>
+
+#include "graph.h"
+#include "program.h"
+#include "timers.h"
+
+using namespace std;
+using namespace simit::ir;
+
+/// The spans of a trace, in the order they were recorded.
+struct Span {
+  int id;
+  double begin;
+  double end;
+};
+
+static vector<Span> getSpans(const Timers& timers) {
+  stringstream trace;
+  timers.writeTrace(trace);
+  string json = trace.str();
+  vector<Span> spans;
+  for (size_t pos = json.find("\"ph\":\"X\""); pos != string::npos;
+       pos = json.find("\"ph\":\"X\"", pos + 1)) {
+    double ts = stod(json.substr(json.find("\"ts\":", pos) + 5));
+    double dur = stod(json.substr(json.find("\"dur\":", pos) + 6));
+    int id = stoi(json.substr(json.find("\"id\":", pos) + 5));
+    spans.push_back({id, ts, ts + dur});
+  }
+  return spans;
+}
+
+TEST(Timers, cycleClock) {
+  uint64_t begin = CycleClock::now();
+  double secondsPerTick = CycleClock::secondsPerTick();
+  uint64_t end = CycleClock::now();
+  ASSERT_LE(begin, end);
+  ASSERT_GT(secondsPerTick, 0.0);
+  ASSERT_EQ(secondsPerTick, CycleClock::secondsPerTick());
+}
+
+TEST(Timers, nesting) {
+  Timers timers(1);
+  int loop = timers.addTimer("for i in 0:2:");
+  int body = timers.addTimer("x = 1;", loop);
+  int after = timers.addTimer("y = 2;");
+  ASSERT_EQ(3u, timers.getNumTimers());
+  ASSERT_EQ(loop, timers.getParent(body));
+  ASSERT_EQ(-1, timers.getParent(after));
+  timers.enableTracing();
+
+  timers.start(loop);
+  for (int i=0; i < 2; ++i) {
+    timers.start(body);
+    timers.stop(body);
+  }
+  timers.stop(loop);
+  timers.start(after);
+  timers.stop(after);
+
+  ASSERT_EQ(1u, timers.getCount(loop));
+  ASSERT_EQ(2u, timers.getCount(body));
+  ASSERT_EQ(1u, timers.getCount(after));
+
+  // Spans are recorded when they stop, and the body spans lie one after the
+  // other in the loop span. Times are printed to the nanosecond.
+  const double rounding = 0.002;
+  vector<Span> spans = getSpans(timers);
+  ASSERT_EQ(4u, spans.size());
+  ASSERT_EQ(body, spans[0].id);
+  ASSERT_EQ(body, spans[1].id);
+  ASSERT_EQ(loop, spans[2].id);
+  ASSERT_EQ(after, spans[3].id);
+  ASSERT_LE(spans[2].begin, spans[0].begin + rounding);
+  ASSERT_LE(spans[0].end, spans[1].begin + rounding);
+  ASSERT_LE(spans[1].end, spans[2].end + rounding);
+  ASSERT_LE(spans[2].end, spans[3].begin + rounding);
+
+  // A parent's time includes its children's, and its self time excludes it
+  ASSERT_LE(timers.getSeconds(body), timers.getSeconds(loop));
+  ASSERT_LE(timers.getSelfSeconds(loop),
+            timers.getSeconds(loop) - timers.getSeconds(body));
+  ASSERT_DOUBLE_EQ(timers.getSeconds(body), timers.getSelfSeconds(body));
+  ASSERT_DOUBLE_EQ(timers.getSeconds(loop) + timers.getSeconds(after),
+                   timers.getTotalSeconds());
+
+  // Timed source lines are annotated in order
+  stringstream source;
+  source << "for i in 0:2:\n  x = 1;\n  z = 3;\ny = 2;\n";
+  timers.addSourceLines(source);
+  stringstream report;
+  timers.print(report);
+  string line;
+  getline(report, line);
+  ASSERT_NE(string::npos, line.find("%, 1)"));
+  getline(report, line);
+  ASSERT_NE(string::npos, line.find("%, 2)"));
+  getline(report, line);
+  ASSERT_EQ(string::npos, line.find("%"));
+
+  timers.reset();
+  ASSERT_EQ(0u, timers.getCount(body));
+  ASSERT_EQ(0.0, timers.getTotalSeconds());
+}
+
+TEST(Timers, threads) {
+  Timers timers(4);
+  int id = timers.addTimer("x = 1;");
+  vector<thread> threads;
+  for (int t=0; t < 4; ++t) {
+    threads.push_back(thread([&timers, id]() {
+      for (int i=0; i < 10000; ++i) {
+        timers.start(id);
+        timers.stop(id);
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(40000u, timers.getCount(id));
+}
+
+TEST(Timers, trace) {
+  Timers timers(1);
+  timers.setName("step");
+  int loop = timers.addTimer("for i in 0:2:");
+  int body = timers.addTimer("x = \"a\";", loop);
+  timers.enableTracing(2);
+  ASSERT_TRUE(timers.isTracing());
+
+  timers.start(loop);
+  for (int i=0; i < 2; ++i) {
+    timers.start(body);
+    timers.stop(body);
+  }
+  timers.stop(loop);
+  ASSERT_EQ(1u, timers.getDroppedSpans());
+
+  stringstream trace;
+  timers.writeTrace(trace);
+  string json = trace.str();
+  ASSERT_NE(string::npos, json.find("\"traceEvents\""));
+  ASSERT_NE(string::npos, json.find("\"name\":\"step\""));
+  ASSERT_NE(string::npos, json.find("x = \\\"a\\\";"));
+  size_t events = 0;
+  for (size_t pos = json.find("\"ph\":\"X\""); pos != string::npos;
+       pos = json.find("\"ph\":\"X\"", pos + 1)) {
+    ++events;
+  }
+  ASSERT_EQ(2u, events);
+
+  stringstream summary;
+  timers.writeSummary(summary);
+  ASSERT_NE(string::npos, summary.str().find("\"count\":2"));
+  ASSERT_NE(string::npos, summary.str().find("\"droppedSpans\":1"));
+
+  timers.reset();
+  ASSERT_EQ(0u, timers.getDroppedSpans());
+}
+
+TEST(Timers, insertTimers) {
+  Var x("x", Int);
+  Var i("i", Int);
+  Stmt body = Block::make(VarDecl::make(x),
+                          ForRange::make(i, 0, 10, AssignStmt::make(x, i)));
+  Func func("f", {}, {}, body);
+  Timers timers(1);
+  insertTimers(func, &timers);
+  ASSERT_EQ(3u, timers.getNumTimers());
+  ASSERT_EQ(-1, timers.getParent(0));
+  ASSERT_EQ(0, timers.getParent(1));
+  ASSERT_EQ(1, timers.getParent(2));
+}
+
+TEST(Timers, insertTimersCall) {
+  Var a("a", Float);
+  Var b("b", Float);
+  Func square("square", {a}, {b}, AssignStmt::make(b, Mul::make(a, a)));
+  Var x("x", Float);
+  Var i("i", Int);
+  Stmt body = Block::make(VarDecl::make(x),
+                          ForRange::make(i, 0, 10,
+                                         CallStmt::make({x}, square, {x})));
+  Func func("f", {}, {}, body);
+
+  // Callees are timed first, and the call is timed in the loop
+  Timers timers(1);
+  insertTimers(square, &timers);
+  insertTimers(func, &timers);
+  ASSERT_EQ(5u, timers.getNumTimers());
+  ASSERT_EQ(-1, timers.getParent(0));
+  ASSERT_TRUE(timers.isCalled(0));
+  ASSERT_EQ(-1, timers.getParent(2));
+  ASSERT_FALSE(timers.isCalled(2));
+  ASSERT_EQ(3, timers.getParent(4));
+}
+
+TEST(Timers, internalCall) {
+  simit::Set points;
+  simit::FieldRef<simit_float> x = points.addField<simit_float>("x");
+  simit::ElementRef p0 = points.add();
+  x.set(p0, 3.0);
+
+  simit::Function func = loadFunctionWithTimers(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.runSafe();
+  SIMIT_ASSERT_FLOAT_EQ(6.0, x.get(p0));
+
+  // The callee's time is in the timers of the calls, so the total is the time
+  // of the exported function
+  shared_ptr<Timers> timers = func.getTimers();
+  int main = -1;
+  int callee = -1;
+  for (size_t id=0; id < timers->getNumTimers(); ++id) {
+    if (timers->getParent(id) < 0) {
+      ASSERT_EQ(timers->getLabel(id).find("func main") == 0,
+                !timers->isCalled(id));
+      if (timers->isCalled(id)) {
+        callee = id;
+      }
+      else {
+        main = id;
+      }
+    }
+  }
+  ASSERT_NE(-1, main);
+  ASSERT_NE(-1, callee);
+  ASSERT_EQ(4u, timers->getCount(callee));
+  ASSERT_DOUBLE_EQ(timers->getSeconds(main), timers->getTotalSeconds());
+}
+
+TEST(Timers, counters) {
+  Timers timers(1);
+  int loop = timers.addTimer("for i in 0:n:");
+  if (!timers.enableCounters()) {
+    // Counters are unavailable (e.g. in a container), and timing still works
+    ASSERT_FALSE(timers.isCounting());
+    timers.start(loop);
+    timers.stop(loop);
+    ASSERT_EQ(1u, timers.getCount(loop));
+    ASSERT_EQ(0u, timers.getEventCount(loop, simit::util::PerfEvent::Cycles));
+    ASSERT_EQ(0.0, timers.getIPC(loop));
+    return;
+  }
+  ASSERT_TRUE(timers.isCounting());
+
+  volatile double sum = 0.0;
+  timers.start(loop);
+  for (int i=0; i < 1000000; ++i) {
+    sum = sum + i;
+  }
+  timers.stop(loop);
+  ASSERT_LT(1000000u,
+            timers.getEventCount(loop, simit::util::PerfEvent::Instructions));
+  ASSERT_GT(timers.getIPC(loop), 0.0);
+  ASSERT_LE(timers.getLLCMissRate(loop), 1.0);
+
+  stringstream summary;
+  timers.writeSummary(summary);
+  ASSERT_NE(string::npos, summary.str().find("\"ipc\":"));
+}
+
+TEST(Timers, countersThreads) {
+  // The threads share the counter slot, but each counts its own events
+  Timers timers(1);
+  int loop = timers.addTimer("for i in 0:n:");
+  if (!timers.enableCounters()) {
+    return;
+  }
+  const int numThreads = 4;
+  for (int t=0; t < numThreads; ++t) {
+    thread([&]() {
+      volatile double sum = 0.0;
+      timers.start(loop);
+      for (int i=0; i < 1000000; ++i) {
+        sum = sum + i;
+      }
+      timers.stop(loop);
+    }).join();
+  }
+  ASSERT_EQ((uint64_t)numThreads, timers.getCount(loop));
+  ASSERT_LT(numThreads * 1000000u,
+            timers.getEventCount(loop, simit::util::PerfEvent::Instructions));
+}
+
+TEST(Timers, program) {
+  simit::Set points;
+  simit::Set springs(points,points);
+  simit::FieldRef<simit_float> x = points.addField<simit_float>("x");
+  simit::FieldRef<simit_float> k = springs.addField<simit_float>("k");
+  simit::ElementRef p0 = points.add();
+  simit::ElementRef p1 = points.add();
+  simit::ElementRef p2 = points.add();
+  k.set(springs.add(p0,p1), 1.0);
+  k.set(springs.add(p1,p2), 2.0);
+
+  simit::Function func = loadFunctionWithTimers(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  const int runs = 2;
+  for (int i=0; i < runs; ++i) {
+    func.runSafe();
+  }
+  SIMIT_ASSERT_FLOAT_EQ(6.0,   x.get(p0));
+  SIMIT_ASSERT_FLOAT_EQ(6.0,   x.get(p1));
+  SIMIT_ASSERT_FLOAT_EQ(-12.0, x.get(p2));
+
+  // Every statement is counted once per run, times the iterations of the
+  // loops around it
+  shared_ptr<Timers> timers = func.getTimers();
+  auto iterations = [&](int loop) -> uint64_t {
+    const string& label = timers->getLabel(loop);
+    if (label.find("while") == 0) {
+      return 3;
+    }
+    else if (label.find(" in springs") != string::npos) {
+      return springs.getSize();
+    }
+    else if (label.find(" in points") != string::npos) {
+      return points.getSize();
+    }
+    return 1;
+  };
+  int loops = 0;
+  for (size_t id=0; id < timers->getNumTimers(); ++id) {
+    uint64_t count = runs;
+    for (int loop = timers->getParent(id); loop >= 0;
+         loop = timers->getParent(loop)) {
+      count *= iterations(loop);
+    }
+    ASSERT_EQ(count, timers->getCount(id)) << timers->getLabel(id);
+    loops += (iterations(id) > 1);
+  }
+  ASSERT_EQ(3, loops);
+}
@@ -14,6 +14,7 @@
 #include "error.h"
 #include "util/util.h"
 #include "storage.h"
+#include "memory_accounting.h"
 
 #include "backend/backend.h"
 #include "backend/backend_function.h"
@@ -28,6 +29,7 @@ static void printUsage() {
        << "-emit-simit"         << endl
        << "-emit-llvm"          << endl
        << "-emit-asm"           << endl
+       << "-emit-memory"        << endl
        << "-files"              << endl
        << "-compile=<function>" << endl
        << "-section=<section>"  << endl
@@ -49,6 +51,7 @@ int main(int argc, const char* argv[]) {
   bool compile = false;
   bool fileoutput = false;
   bool gpu = false;
+  bool memory = false;
 
   ostream* simitos = nullptr;
   ostream* llvmos  = nullptr;
@@ -82,6 +85,9 @@ int main(int argc, const char* argv[]) {
         else if (arg == "-emit-asm") {
           asmos = &cout;
         }
+        else if (arg == "-emit-memory") {
+          memory = true;
+        }
         else if (arg == "-compile") {
           compile = true;
         }
@@ -250,6 +256,14 @@ int main(int argc, const char* argv[]) {
 
     func = lower(func, simitos);
 
+    // Print what the function allocates at init, in terms of set sizes
+    if (memory) {
+      if (simitos) {
+        *simitos << "--- Emitting Memory" << endl;
+      }
+      printMemoryPlan(cout, func);
+    }
+
     // Emit and print llvm code
     // NB: The LLVM code gets further optimized at init time (OSR, etc.)
     if (llvmos || asmos) {